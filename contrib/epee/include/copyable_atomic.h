@@ -30,25 +30,35 @@
 
 namespace epee
 {
-  class copyable_atomic: public std::atomic<uint32_t>
+  template<typename T>
+  class copyable_atomic_t: public std::atomic<T>
   {
   public:
-    copyable_atomic()
+    copyable_atomic_t()
     {};
-    copyable_atomic(const copyable_atomic& a):std::atomic<uint32_t>(a.load())
+    copyable_atomic_t(T v):std::atomic<T>(v)
     {}
-    copyable_atomic& operator= (const copyable_atomic& a)
+    copyable_atomic_t(const copyable_atomic_t& a):std::atomic<T>(a.load())
+    {}
+    copyable_atomic_t& operator= (const copyable_atomic_t& a)
     {
-      store(a.load());
+      this->store(a.load());
       return *this;
     }
-    uint32_t operator++()
+    T operator= (T v)
+    {
+      this->store(v);
+      return v;
+    }
+    T operator++()
     {
-      return std::atomic<uint32_t>::operator++();
+      return std::atomic<T>::operator++();
     }
-    uint32_t operator++(int fake)
+    T operator++(int fake)
     {
-      return std::atomic<uint32_t>::operator++(fake);
+      return std::atomic<T>::operator++(fake);
     }
   };
+
+  typedef copyable_atomic_t<uint32_t> copyable_atomic;
 }
@@ -59,6 +59,8 @@
 #include "../../../../src/p2p/network_throttle-detail.hpp"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_COALESCE_MAX_COUNT 64 // max queue entries gathered into one write
+#define ABSTRACT_SERVER_SEND_COALESCE_MAX_BYTES (64 * 1024) // max bytes gathered into one write (a single bigger entry is still sent whole)
 
 namespace epee
 {
@@ -114,7 +116,8 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
-    virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
+    virtual bool do_send_shared(const boost::shared_ptr<const std::string>& buff); ///< (see do_send_shared from i_service_endpoint)
+    virtual bool do_send_chunk(const boost::shared_ptr<const std::string>& buff, size_t offset, size_t cb); ///< will send (or queue) a part of data
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
@@ -131,6 +134,9 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Start one gathered write of the entries at the front of the send queue.
+    void start_write_from_que(const boost::shared_ptr<connection<t_protocol_handler> >& self);
+
     /// Buffer for incoming data.
     boost::array<char, 8192> buffer_;
     //boost::array<char, 1024> buffer_;
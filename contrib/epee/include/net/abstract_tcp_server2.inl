@@ -366,7 +366,26 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     auto self = safe_shared_from_this();
     if (!self) return false;
     if (m_was_shutdown) return false;
-		// TODO avoid copy
+
+    // the only copy of the data: chunks and queue entries below just reference this buffer
+    boost::shared_ptr<const std::string> buff(new std::string((const char*)ptr, cb));
+    return do_send_shared(buff);
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+  } // do_send()
+
+  //---------------------------------------------------------------------------------
+    template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_shared(const boost::shared_ptr<const std::string>& buff) {
+    TRY_ENTRY();
+
+    // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
+    auto self = safe_shared_from_this();
+    if (!self) return false;
+    if (m_was_shutdown) return false;
+    CHECK_AND_ASSERT_MES(buff, false, "do_send_shared() called with empty buffer");
+    const char* ptr = buff->data();
+    const size_t cb = buff->size();
 
 		const double factor = 32; // TODO config
 		typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
@@ -404,14 +423,11 @@ PRAGMA_WARNING_DISABLE_VS(4355)
                     ASRT(len>0); // (redundand)
                     ASRT(len_unsigned < std::numeric_limits<size_t>::max());   // yeap we want strong < then max size, to be sure
 					
-					void *chunk_start = ((char*)ptr) + pos;
-					_fact_c("net/out/size","chunk_start="<<chunk_start<<" ptr="<<ptr<<" pos="<<pos);
-					ASRT(chunk_start >= ptr); // not wrapped around address?
-					//std::memcpy( (void*)buf, chunk_start, len);
+					_fact_c("net/out/size","chunk_start="<<(void*)(ptr + pos)<<" ptr="<<(void*)ptr<<" pos="<<pos);
 
 					_dbg3_c("net/out/size", "part of " << lenall << ": pos="<<pos << " len="<<len);
 
-					bool ok = do_send_chunk(chunk_start, len); // <====== ***
+					bool ok = do_send_chunk(buff, pos, len); // <====== ***
 
 					all_ok = all_ok && ok;
 					if (!all_ok) {
@@ -434,15 +450,15 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 			} // LOCK: chunking
 		} // a big block (to be chunked) - all chunks
 		else { // small block
-			return do_send_chunk(ptr,cb); // just send as 1 big chunk
+			return do_send_chunk(buff, 0, cb); // just send as 1 big chunk
 		}
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
-	} // do_send()
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_shared", false);
+	} // do_send_shared()
 
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send_chunk(const void* ptr, size_t cb)
+  bool connection<t_protocol_handler>::do_send_chunk(const boost::shared_ptr<const std::string>& buff, size_t offset, size_t cb)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -493,40 +509,32 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         }
     }
 
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
-    
-    if(m_send_que.size() > 1)
-    { // active operation should be in progress, nothing to do, just wait last operation callback
-        auto size_now = cb;
-        _info_c("net/out/size", "do_send() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
-        //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
-      
-      LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
+    send_que_entry entry;
+    entry.buffer = buff;
+    entry.offset = offset;
+    entry.size = cb;
+    m_send_que.push_back(entry);
+    m_send_que_bytes += cb;
+    context.m_send_queue_depth = m_send_que.size();
+
+    if(m_send_que_in_flight)
+    { // active operation should be in progress, nothing to do, just wait last operation callback, it will pick this up
+        _info_c("net/out/size", "do_send() NOW just queues: packet="<<cb<<" B, is added to queue-size="<<m_send_que.size());
+        LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send queued " << cb << ", queue: " << m_send_que.size() << " entries, " << m_send_que_bytes << " bytes");
     }
     else
     { // no active operation
-
         if(m_send_que.size()!=1)
         {
             _erro("Looks like no active operations, but send que size != 1!!");
             return false;
         }
 
-        auto size_now = m_send_que.front().size();
-        _dbg1_c("net/out/size", "do_send() NOW SENSD: packet="<<size_now<<" B");
+        _dbg1_c("net/out/size", "do_send() NOW SENSD: packet="<<cb<<" B");
         if (speed_limit_is_enabled())
-			do_send_handler_write( ptr , size_now ); // (((H)))
-
-        ASRT( size_now == m_send_que.front().size() );
-        boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 //strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 //)
-                                 );
-        //_dbg3("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //_info("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
+			do_send_handler_write( m_send_que.front().data() , cb ); // (((H)))
+
+        start_write_from_que(self);
     }
     
     //do_send_handler_stop( ptr , cb ); // empty function
@@ -537,6 +545,34 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   } // do_send_chunk
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write_from_que(const boost::shared_ptr<connection<t_protocol_handler> >& self)
+  {
+    // m_send_que_lock is held by the caller and no write is in progress.
+    // Gather as many queued entries as the limits allow into one scatter/gather write,
+    // so a burst of small messages costs one syscall instead of one per message.
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t bytes = 0;
+    for(const send_que_entry& entry: m_send_que)
+    {
+      if(buffers.size() >= ABSTRACT_SERVER_SEND_COALESCE_MAX_COUNT)
+        break;
+      if(!buffers.empty() && bytes + entry.size > ABSTRACT_SERVER_SEND_COALESCE_MAX_BYTES)
+        break;
+      buffers.push_back(boost::asio::buffer(entry.data(), entry.size));
+      bytes += entry.size;
+    }
+    m_send_que_in_flight = buffers.size();
+    m_send_que_bytes_in_flight = bytes;
+    context.m_send_bytes_in_flight = bytes;
+    LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Async send requested " << bytes << " bytes in " << buffers.size() << " buffers");
+    boost::asio::async_write(socket_, buffers,
+                             //strand_.wrap(
+                             boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
+                             //)
+                             );
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool connection<t_protocol_handler>::shutdown()
   {
     // Initiate graceful connection closure.
@@ -593,7 +629,17 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    if(m_send_que_in_flight > m_send_que.size())
+    {
+      _erro("[sock " << socket_.native_handle() << "] m_send_que_in_flight > m_send_que.size() at handle_write!");
+      m_send_que_in_flight = m_send_que.size();
+    }
+    m_send_que.erase(m_send_que.begin(), m_send_que.begin() + m_send_que_in_flight);
+    m_send_que_bytes -= m_send_que_bytes_in_flight;
+    m_send_que_in_flight = 0;
+    m_send_que_bytes_in_flight = 0;
+    context.m_send_queue_depth = m_send_que.size();
+    context.m_send_bytes_in_flight = 0;
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -603,17 +649,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     }else
     {
       //have more data to send
-		auto size_now = m_send_que.front().size();
-		_dbg1_c("net/out/size", "handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
+		_dbg1_c("net/out/size", "handle_write() NOW SENDS: queue size="<<m_send_que.size()<<", bytes="<<m_send_que_bytes);
 		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		ASRT( size_now == m_send_que.front().size() );
-		boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now) , 
-        // strand_.wrap(
-          boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-				// )
-        );
-      //_dbg3("(normal)" << size_now);
+			do_send_handler_write_from_queue(e, m_send_que.front().size , m_send_que.size()); // (((H)))
+		start_write_from_que(connection<t_protocol_handler>::shared_from_this());
     }
     CRITICAL_REGION_END();
 
@@ -105,6 +105,51 @@
       LOG_PRINT( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms", LOG_LEVEL_2); \
     }
 
+// The _CACHED variants serve repeated requests from serialized responses
+// kept by the handler class, keyed by the uri (or json rpc method) and the
+// re-serialized request (or its params). The class provides:
+//   bool get_cached_response(const std::string& key, std::string& body, uint64_t& version);
+//     returns true on a hit, otherwise sets the version to cache the new response at
+//   template<class t_response> void add_cached_response(const std::string& key, uint64_t version, const t_response& res, const std::string& body);
+#define MAP_URI_AUTO_CACHED2(s_pattern, callback_f, command_type, load_f, store_f, mime) \
+    else if(query_info.m_URI == s_pattern) \
+    { \
+      handled = true; \
+      uint64_t ticks = epee::misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::request> req; \
+      bool parse_res = load_f(static_cast<command_type::request&>(req), query_info.m_body); \
+      CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse request body, body size=" << query_info.m_body.size()); \
+      std::string cache_key = std::string(s_pattern) + epee::serialization::store_t_to_binary(static_cast<command_type::request&>(req)); \
+      uint64_t cache_version = 0; \
+      response_info.m_mime_tipe = mime; \
+      response_info.m_header_info.m_content_type = " " mime; \
+      if(get_cached_response(cache_key, response_info.m_body, cache_version)) \
+      { \
+        LOG_PRINT( s_pattern << " served from cache in " << epee::misc_utils::get_tick_count()-ticks << "ms", LOG_LEVEL_2); \
+        return true; \
+      } \
+      uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::response> resp;\
+      if(!callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp))) \
+      { \
+        LOG_ERROR("Failed to " << #callback_f << "()"); \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
+      store_f(static_cast<command_type::response&>(resp), response_info.m_body); \
+      add_cached_response(cache_key, cache_version, static_cast<command_type::response&>(resp), response_info.m_body); \
+      uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+      LOG_PRINT( s_pattern << " processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms", LOG_LEVEL_2); \
+    }
+
+#define MAP_URI_AUTO_JON2_CACHED(s_pattern, callback_f, command_type) \
+  MAP_URI_AUTO_CACHED2(s_pattern, callback_f, command_type, epee::serialization::load_t_from_json, epee::serialization::store_t_to_json, "application/json")
+
+#define MAP_URI_AUTO_BIN2_CACHED(s_pattern, callback_f, command_type) \
+  MAP_URI_AUTO_CACHED2(s_pattern, callback_f, command_type, epee::serialization::load_t_from_binary, epee::serialization::store_t_to_binary, "application/octet-stream")
+
 #define CHAIN_URI_MAP2(callback) else {callback(query_info, response_info, m_conn_context);handled = true;}
 
 #define END_URI_MAP2() return handled;}
@@ -182,6 +227,40 @@
   return true;\
 }
 
+// Keyed by the uri, method and params, not the id, so the cache holds the
+// serialized result and each caller gets it back under its own id.
+#define MAP_JON_RPC_WE_CACHED(method_name, callback_f, command_type) \
+    else if(callback_name == method_name) \
+{ \
+  PREPARE_OBJECTS_FROM_JSON(command_type) \
+  std::string cache_key = query_info.m_URI + "/" + method_name + epee::serialization::store_t_to_binary(req.params); \
+  uint64_t cache_version = 0; \
+  std::string result_json; \
+  response_info.m_mime_tipe = "application/json"; \
+  response_info.m_header_info.m_content_type = " application/json"; \
+  if(get_cached_response(cache_key, result_json, cache_version)) \
+  { \
+    epee::json_rpc::make_response_body(req.id, result_json, response_info.m_body); \
+    LOG_PRINT( query_info.m_URI << "[" << method_name << "] served from cache in " << epee::misc_utils::get_tick_count()-ticks << "ms", LOG_LEVEL_2); \
+    return true; \
+  } \
+  epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
+  fail_resp.jsonrpc = "2.0"; \
+  fail_resp.id = req.id; \
+  if(!callback_f(req.params, resp.result, fail_resp.error)) \
+  { \
+    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
+    return true; \
+  } \
+  uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
+  epee::serialization::store_t_to_json(resp.result, result_json); \
+  epee::json_rpc::make_response_body(req.id, result_json, response_info.m_body); \
+  uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+  LOG_PRINT( query_info.m_URI << "[" << method_name << "] processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms", LOG_LEVEL_2); \
+  add_cached_response(cache_key, cache_version, resp.result, result_json); \
+  return true;\
+}
+
 #define MAP_JON_RPC_WERI(method_name, callback_f, command_type) \
     else if(callback_name == method_name) \
 { \
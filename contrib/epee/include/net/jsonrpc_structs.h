@@ -5,6 +5,7 @@
 #include <cstdint>
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage_base.h"
+#include "storages/portable_storage_template_helper.h"
 
 namespace epee 
 {
@@ -90,6 +91,31 @@ namespace epee
     };
 
     typedef response<dummy_result, error> error_response;
+
+    // what a response holds besides its result
+    struct response_header
+    {
+      std::string jsonrpc;
+      epee::serialization::storage_entry id;
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(jsonrpc)
+        KV_SERIALIZE(id)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    // builds a response body around an already serialized result, which
+    // goes last as store_t_to_json orders members by name
+    inline void make_response_body(const epee::serialization::storage_entry& id, const std::string& result_json, std::string& body)
+    {
+      response_header header;
+      header.jsonrpc = "2.0";
+      header.id = id;
+      epee::serialization::store_t_to_json(header, body, 0, false);
+      body.resize(body.rfind('}'));
+      body += ", \"result\": ";
+      body += result_json;
+      body += "}";
+    }
   }
 }
 
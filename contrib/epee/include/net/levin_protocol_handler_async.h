@@ -43,6 +43,81 @@ namespace epee
 namespace levin
 {
 
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+// Spare packet body buffers, shared by the connections of a server so that
+// receiving a packet usually reuses the capacity of one already handled
+// instead of allocating.  Buffers too big to be worth keeping, or past
+// the pool limits, are just freed.
+class recv_buffer_pool
+{
+public:
+  static const size_t max_buffers = 64;
+  static const size_t max_buffer_size = 4 * 1024 * 1024;
+  static const size_t max_pooled_bytes = 32 * 1024 * 1024;
+
+  recv_buffer_pool(): m_pooled_bytes(0), m_allocated(0), m_reused(0)
+  {}
+
+  // makes buff an empty buffer with room for size bytes
+  void acquire(std::string& buff, size_t size)
+  {
+    buff.clear();
+    if(size <= buff.capacity())
+      return;
+    CRITICAL_REGION_BEGIN(m_lock);
+    size_t best = m_free.size();
+    for(size_t n = 0; n < m_free.size(); ++n)
+    {
+      if(m_free[n].capacity() >= size && (best == m_free.size() || m_free[n].capacity() < m_free[best].capacity()))
+        best = n;
+    }
+    if(best != m_free.size())
+    {
+      buff.swap(m_free[best]);
+      m_free[best].swap(m_free.back());
+      m_free.pop_back();
+      m_pooled_bytes -= buff.capacity();
+      ++m_reused;
+      return;
+    }
+    CRITICAL_REGION_END();
+    ++m_allocated;
+    buff.reserve(size);
+  }
+
+  // takes buff back, leaving it empty
+  void release(std::string& buff)
+  {
+    size_t capacity = buff.capacity();
+    if(capacity && capacity <= max_buffer_size)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      if(m_free.size() < max_buffers && m_pooled_bytes + capacity <= max_pooled_bytes)
+      {
+        buff.clear();
+        m_free.push_back(std::string());
+        m_free.back().swap(buff);
+        m_pooled_bytes += capacity;
+        return;
+      }
+    }
+    std::string().swap(buff);
+  }
+
+  // number of buffers that had to be allocated, and that were reused
+  uint64_t get_allocated_count() const { return m_allocated; }
+  uint64_t get_reused_count() const { return m_reused; }
+
+private:
+  critical_section m_lock;
+  std::vector<std::string> m_free;
+  size_t m_pooled_bytes;
+  std::atomic<uint64_t> m_allocated;
+  std::atomic<uint64_t> m_reused;
+};
+
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
@@ -69,12 +144,16 @@ public:
   levin_commands_handler<t_connection_context>* m_pcommands_handler;
   uint64_t m_max_packet_size; 
   uint64_t m_invoke_timeout;
+  recv_buffer_pool m_recv_buffers;
 
   int invoke(int command, const std::string& in_buff, std::string& buff_out, boost::uuids::uuid connection_id);
   template<class callback_t>
   int invoke_async(int command, const std::string& in_buff, boost::uuids::uuid connection_id, callback_t cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const std::string& in_buff, boost::uuids::uuid connection_id);
+  // framed notification built once by make_notify_packet(), to be sent unchanged to any number of connections
+  int notify_packet(const boost::shared_ptr<const std::string>& packet, boost::uuids::uuid connection_id);
+  static boost::shared_ptr<const std::string> make_notify_packet(int command, const std::string& in_buff);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -124,6 +203,7 @@ public:
   t_connection_context& m_connection_context;
 
   std::string m_cache_in_buffer;
+  std::string m_cache_in_body;
   stream_state m_state;
 
   int32_t m_oponent_protocol_ver;
@@ -232,6 +312,7 @@ public:
   virtual ~async_protocol_handler()
   {
     m_deletion_initiated = true;
+    m_config.m_recv_buffers.release(m_cache_in_body);
     if(m_connection_initialized)
     {
       m_config.del_connection(this);
@@ -319,36 +400,36 @@ public:
       return false;
     }
 
-    if(m_cache_in_buffer.size() +  cb > m_config.m_max_packet_size)
+    if(m_cache_in_buffer.size() + m_cache_in_body.size() + cb > m_config.m_max_packet_size)
     {
       LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
-                          << ", packet received " << m_cache_in_buffer.size() +  cb 
+                          << ", packet received " << m_cache_in_buffer.size() + m_cache_in_body.size() + cb 
                           << ", connection will be closed.");
       return false;
     }
 
-    m_cache_in_buffer.append((const char*)ptr, cb);
-
-    bool is_continue = true;
-    while(is_continue)
+    // Incoming bytes are copied once, straight into the buffer of the packet
+    // they belong to: the (small) header into m_cache_in_buffer, the body
+    // into m_cache_in_body, which is sized from the header up front and
+    // handed to the commands handler as is.
+    const char* pdata = (const char*)ptr;
+    size_t left = cb;
+    while(true)
     {
       switch(m_state)
       {
       case stream_state_body:
-        if(m_cache_in_buffer.size() < m_current_head.m_cb)
         {
-          is_continue = false;
-          break;
+          size_t body_left = (size_t)m_current_head.m_cb - m_cache_in_body.size();
+          size_t to_copy = (std::min)(body_left, left);
+          m_cache_in_body.append(pdata, to_copy);
+          pdata += to_copy;
+          left -= to_copy;
+          if(m_cache_in_body.size() < m_current_head.m_cb)
+            return true;
         }
         {
-          std::string buff_to_invoke;
-          if(m_cache_in_buffer.size()  == m_current_head.m_cb)
-            buff_to_invoke.swap(m_cache_in_buffer);
-          else
-          {
-            buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
-            m_cache_in_buffer.erase(0, (std::string::size_type)m_current_head.m_cb);
-          }
+          std::string& buff_to_invoke = m_cache_in_body;
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
@@ -422,10 +503,19 @@ public:
               m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context);
           }
         }
+        m_config.m_recv_buffers.release(m_cache_in_body);
         m_state = stream_state_head;
         break;
       case stream_state_head:
         {
+          if(!left)
+            return true;
+
+          size_t to_copy = (std::min)(sizeof(bucket_head2) - m_cache_in_buffer.size(), left);
+          m_cache_in_buffer.append(pdata, to_copy);
+          pdata += to_copy;
+          left -= to_copy;
+
           if(m_cache_in_buffer.size() < sizeof(bucket_head2))
           {
             if(m_cache_in_buffer.size() >= sizeof(uint64_t) && *((uint64_t*)m_cache_in_buffer.data()) != LEVIN_SIGNATURE)
@@ -433,8 +523,7 @@ public:
               LOG_ERROR_CC(m_connection_context, "Signature mismatch, connection will be closed");
               return false;
             }
-            is_continue = false;
-            break;
+            return true;
           }
 
           bucket_head2* phead = (bucket_head2*)m_cache_in_buffer.data();
@@ -445,7 +534,7 @@ public:
           }
           m_current_head = *phead;
 
-          m_cache_in_buffer.erase(0, sizeof(bucket_head2));
+          m_cache_in_buffer.clear();
           m_state = stream_state_body;
           m_oponent_protocol_ver = m_current_head.m_protocol_version;
           if(m_current_head.m_cb > m_config.m_max_packet_size)
@@ -455,6 +544,7 @@ public:
               << ", connection will be closed.");
             return false;
           }
+          m_config.m_recv_buffers.acquire(m_cache_in_body, (size_t)m_current_head.m_cb);
         }
         break;
       default:
@@ -658,6 +748,31 @@ public:
     return 1;
   }
   //------------------------------------------------------------------------------------------
+  int notify_packet(const boost::shared_ptr<const std::string>& packet)
+  {
+    misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
+                          boost::bind(&async_protocol_handler::finish_outer_call, this));
+
+    if(m_deletion_initiated)
+      return LEVIN_ERROR_CONNECTION_DESTROYED;
+
+    CRITICAL_REGION_LOCAL(m_call_lock);
+
+    if(m_deletion_initiated)
+      return LEVIN_ERROR_CONNECTION_DESTROYED;
+
+    CRITICAL_REGION_BEGIN(m_send_lock);
+    if(!m_pservice_endpoint->do_send_shared(packet))
+    {
+      LOG_ERROR_CC(m_connection_context, "Failed to do_send_shared()");
+      return -1;
+    }
+    CRITICAL_REGION_END();
+    LOG_PRINT_CC_L4(m_connection_context, "LEVIN_PACKET_SENT (shared). [len=" << packet->size() << "]");
+
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------
   boost::uuids::uuid get_connection_id() {return m_connection_context.m_connection_id;}
   //------------------------------------------------------------------------------------------
   t_connection_context& get_context_ref() {return m_connection_context;}
@@ -773,6 +888,33 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify_packet(const boost::shared_ptr<const std::string>& packet, boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify_packet(packet) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
+boost::shared_ptr<const std::string> async_protocol_handler_config<t_connection_context>::make_notify_packet(int command, const std::string& in_buff)
+{
+  bucket_head2 head = {0};
+  head.m_signature = LEVIN_SIGNATURE;
+  head.m_have_to_return_data = false;
+  head.m_cb = in_buff.size();
+
+  head.m_command = command;
+  head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
+  head.m_flags = LEVIN_PACKET_REQUEST;
+
+  boost::shared_ptr<std::string> packet(new std::string());
+  packet->reserve(sizeof(head) + in_buff.size());
+  packet->append(reinterpret_cast<const char*>(&head), sizeof(head));
+  packet->append(in_buff);
+  return packet;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
   CRITICAL_REGION_LOCAL(m_connects_lock);
@@ -30,7 +30,9 @@
 #define _NET_UTILS_BASE_H_
 
 #include <boost/uuid/uuid.hpp>
+#include <boost/shared_ptr.hpp>
 #include "string_tools.h"
+#include "copyable_atomic.h"
 
 #ifndef MAKE_IP
 #define MAKE_IP( a1, a2, a3, a4 )	(a1|(a2<<8)|(a3<<16)|(a4<<24))
@@ -57,6 +59,9 @@ namespace net_utils
     uint64_t m_send_cnt;
     double m_current_speed_down;
     double m_current_speed_up;
+    // written by the connection's io threads, read by anyone
+    copyable_atomic_t<uint64_t> m_send_queue_depth;     // buffers waiting in the connection send queue, including the ones being written
+    copyable_atomic_t<uint64_t> m_send_bytes_in_flight; // bytes handed to the current write operation
 
     connection_context_base(boost::uuids::uuid connection_id,
                             long remote_ip, int remote_port, bool is_income,
@@ -72,7 +77,9 @@ namespace net_utils
                                             m_recv_cnt(recv_cnt),
                                             m_send_cnt(send_cnt),
                                             m_current_speed_down(0),
-                                            m_current_speed_up(0)
+                                            m_current_speed_up(0),
+                                            m_send_queue_depth(0),
+                                            m_send_bytes_in_flight(0)
     {}
 
     connection_context_base(): m_connection_id(),
@@ -85,7 +92,9 @@ namespace net_utils
                                m_recv_cnt(0),
                                m_send_cnt(0),
                                m_current_speed_down(0),
-                               m_current_speed_up(0)
+                               m_current_speed_up(0),
+                               m_send_queue_depth(0),
+                               m_send_bytes_in_flight(0)
     {}
 
     connection_context_base& operator=(const connection_context_base& a)
@@ -111,6 +120,8 @@ namespace net_utils
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    //send an immutable buffer which may be shared with other connections (e.g. one relayed packet sent to many peers)
+    virtual bool do_send_shared(const boost::shared_ptr<const std::string>& buff){return do_send(buff->data(), buff->size());}
     virtual bool close()=0;
     virtual bool call_run_once_service_io()=0;
     virtual bool request_callback()=0;
@@ -0,0 +1,672 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <boost/mpl/contains.hpp>
+#include "misc_language.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_bin.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+#pragma pack(push)
+#pragma pack(1)
+    struct portable_storage_block_header
+    {
+      uint32_t m_signature_a;
+      uint32_t m_signature_b;
+      uint8_t  m_ver;
+    };
+#pragma pack(pop)
+
+    template<class t_type> struct portable_storage_type_code;
+    template<> struct portable_storage_type_code<int64_t>     { enum { value = SERIALIZE_TYPE_INT64 }; };
+    template<> struct portable_storage_type_code<int32_t>     { enum { value = SERIALIZE_TYPE_INT32 }; };
+    template<> struct portable_storage_type_code<int16_t>     { enum { value = SERIALIZE_TYPE_INT16 }; };
+    template<> struct portable_storage_type_code<int8_t>      { enum { value = SERIALIZE_TYPE_INT8 }; };
+    template<> struct portable_storage_type_code<uint64_t>    { enum { value = SERIALIZE_TYPE_UINT64 }; };
+    template<> struct portable_storage_type_code<uint32_t>    { enum { value = SERIALIZE_TYPE_UINT32 }; };
+    template<> struct portable_storage_type_code<uint16_t>    { enum { value = SERIALIZE_TYPE_UINT16 }; };
+    template<> struct portable_storage_type_code<uint8_t>     { enum { value = SERIALIZE_TYPE_UINT8 }; };
+    template<> struct portable_storage_type_code<double>      { enum { value = SERIALIZE_TYPE_DUOBLE }; };
+    template<> struct portable_storage_type_code<bool>        { enum { value = SERIALIZE_TYPE_BOOL }; };
+    template<> struct portable_storage_type_code<std::string> { enum { value = SERIALIZE_TYPE_STRING }; };
+
+    /************************************************************************/
+    /* Writes KV_SERIALIZE maps straight into the binary format, without    */
+    /* building a section tree first. Counts are patched in when a section  */
+    /* or array is left, so the output is readable by portable_storage.     */
+    /* Entries come out in map order rather than sorted by name.            */
+    /************************************************************************/
+    class portable_storage_writer
+    {
+    public:
+      struct frame
+      {
+        size_t m_count_pos; //offset of the (one byte, patched later) count varint
+        size_t m_count;
+        bool m_is_array;
+      };
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_writer();
+
+      hsection   open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       set_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      bool       set_value(const std::string& value_name, const storage_entry& target, hsection hparent_section);
+      template<class t_value>
+      harray     insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool       insert_next_value(harray hval_array, const t_value& target);
+      harray     insert_first_section(const std::string& sec_name, hsection& hinserted_childsection, hsection hparent_section);
+      bool       insert_next_section(harray hsec_array, hsection& hinserted_childsection);
+
+      //closes everything still open and hands the buffer over, the writer is empty afterwards
+      bool       store_to_binary(binarybuffer& target);
+
+      //stream interface for pack_varint/pack_entry_to_buff
+      void       write(const char* data, size_t size) { m_buff.append(data, size); }
+
+    private:
+      hsection   enter(hsection hparent_section);
+      void       begin_entry(const std::string& name, hsection hparent_section, uint8_t type);
+      frame*     push_frame(bool is_array);
+      void       close_frame();
+      void       write_raw(const std::string& v) { put_string(*this, v); }
+      template<class t_value>
+      void       write_raw(const t_value& v) { write((const char*)&v, sizeof(v)); }
+
+      std::string m_buff;
+      std::deque<frame> m_frames;
+    };
+
+    inline portable_storage_writer::portable_storage_writer()
+    {
+      portable_storage_block_header sbh = AUTO_VAL_INIT(sbh);
+      sbh.m_signature_a = PORTABLE_STORAGE_SIGNATUREA;
+      sbh.m_signature_b = PORTABLE_STORAGE_SIGNATUREB;
+      sbh.m_ver = PORTABLE_STORAGE_FORMAT_VER;
+      write((const char*)&sbh, sizeof(sbh));
+      push_frame(false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::frame* portable_storage_writer::push_frame(bool is_array)
+    {
+      frame f = {m_buff.size(), 0, is_array};
+      m_buff.push_back(0);
+      m_frames.push_back(f);
+      return &m_frames.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::close_frame()
+    {
+      const frame& f = m_frames.back();
+      if(f.m_count <= 63)
+      {
+        m_buff[f.m_count_pos] = (char)((f.m_count << 2) | PORTABLE_RAW_SIZE_MARK_BYTE);
+      }
+      else
+      {
+        struct varint_buff
+        {
+          char m_data[8];
+          size_t m_size;
+          void write(const char* data, size_t size) { memcpy(m_data + m_size, data, size); m_size += size; }
+        } vb;
+        vb.m_size = 0;
+        pack_varint(vb, f.m_count);
+        m_buff.replace(f.m_count_pos, 1, vb.m_data, vb.m_size);
+      }
+      m_frames.pop_back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::hsection portable_storage_writer::enter(hsection hparent_section)
+    {
+      CHECK_AND_ASSERT_THROW_MES(!m_frames.empty(), "portable_storage_writer: storage already stored");
+      if(!hparent_section)
+        hparent_section = &m_frames.front();
+      //everything opened after hparent_section is complete now
+      while(&m_frames.back() != hparent_section)
+      {
+        CHECK_AND_ASSERT_THROW_MES(m_frames.size() > 1, "portable_storage_writer: section or array handle is not open any more");
+        close_frame();
+      }
+      return hparent_section;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::begin_entry(const std::string& name, hsection hparent_section, uint8_t type)
+    {
+      frame* f = enter(hparent_section);
+      CHECK_AND_ASSERT_THROW_MES(!f->m_is_array, "portable_storage_writer: named entry " << name << " added to array");
+      CHECK_AND_ASSERT_THROW_MES(name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << name.size() << ", val: " << name);
+      uint8_t len = static_cast<uint8_t>(name.size());
+      write((const char*)&len, sizeof(len));
+      write(name.data(), name.size());
+      write((const char*)&type, sizeof(type));
+      ++f->m_count;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::hsection portable_storage_writer::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_MES(create_if_notexist, nullptr, "portable_storage_writer can only create sections");
+      begin_entry(section_name, hparent_section, SERIALIZE_TYPE_OBJECT);
+      return push_frame(false);
+      CATCH_ENTRY("portable_storage_writer::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::set_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      begin_entry(value_name, hparent_section, portable_storage_type_code<t_value>::value);
+      write_raw(v);
+      return true;
+      CATCH_ENTRY("portable_storage_writer::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::set_value(const std::string& value_name, const storage_entry& v, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      frame* f = enter(hparent_section);
+      CHECK_AND_ASSERT_THROW_MES(!f->m_is_array, "portable_storage_writer: named entry " << value_name << " added to array");
+      CHECK_AND_ASSERT_THROW_MES(value_name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << value_name.size() << ", val: " << value_name);
+      uint8_t len = static_cast<uint8_t>(value_name.size());
+      write((const char*)&len, sizeof(len));
+      write(value_name.data(), value_name.size());
+      ++f->m_count;
+      return pack_entry_to_buff(*this, v);
+      CATCH_ENTRY("portable_storage_writer::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_writer::harray portable_storage_writer::insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      begin_entry(value_name, hparent_section, portable_storage_type_code<t_value>::value | SERIALIZE_FLAG_ARRAY);
+      frame* arr = push_frame(true);
+      write_raw(target);
+      arr->m_count = 1;
+      return arr;
+      CATCH_ENTRY("portable_storage_writer::insert_first_value", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::insert_next_value(harray hval_array, const t_value& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hval_array, false);
+      frame* arr = enter(hval_array);
+      CHECK_AND_ASSERT_MES(arr->m_is_array, false, "portable_storage_writer: insert_next_value on a section");
+      write_raw(target);
+      ++arr->m_count;
+      return true;
+      CATCH_ENTRY("portable_storage_writer::insert_next_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::harray portable_storage_writer::insert_first_section(const std::string& sec_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      begin_entry(sec_name, hparent_section, SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY);
+      frame* arr = push_frame(true);
+      arr->m_count = 1;
+      hinserted_childsection = push_frame(false);
+      return arr;
+      CATCH_ENTRY("portable_storage_writer::insert_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hsec_array, false);
+      frame* arr = enter(hsec_array);
+      CHECK_AND_ASSERT_MES(arr->m_is_array, false, "portable_storage_writer: insert_next_section on a section");
+      ++arr->m_count;
+      hinserted_childsection = push_frame(false);
+      return true;
+      CATCH_ENTRY("portable_storage_writer::insert_next_section", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::store_to_binary(binarybuffer& target)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT_MES(!m_frames.empty(), false, "portable_storage_writer: storage already stored");
+      while(!m_frames.empty())
+        close_frame();
+      target.swap(m_buff);
+      m_buff.clear();
+      return true;
+      CATCH_ENTRY("portable_storage_writer::store_to_binary", false);
+    }
+
+    /************************************************************************/
+    /* Reads KV_SERIALIZE maps straight from a binary buffer. Sections are  */
+    /* indexed (name -> position) as they are opened, values are decoded   */
+    /* only when asked for. The buffer must outlive the reader.             */
+    /************************************************************************/
+    class portable_storage_reader
+    {
+    public:
+      struct entry
+      {
+        const char* m_name;
+        size_t m_name_len;
+        const uint8_t* m_data; //type byte, followed by the value
+        const uint8_t* m_end;
+      };
+      struct section_index
+      {
+        std::vector<entry> m_entries;
+      };
+      struct array_cursor
+      {
+        const uint8_t* m_ptr;
+        const uint8_t* m_end;
+        size_t m_remaining;
+        uint8_t m_type;
+        section_index* m_section;
+      };
+      typedef section_index* hsection;
+      typedef array_cursor* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_reader(): m_recursion_count(0) {}
+
+      bool       load_from_binary(const binarybuffer& source);
+      hsection   open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool       get_value(const std::string& value_name, t_value& val, hsection hparent_section);
+      bool       get_value(const std::string& value_name, storage_entry& val, hsection hparent_section);
+      template<class t_value>
+      harray     get_first_value(const std::string& value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool       get_next_value(harray hval_array, t_value& target);
+      harray     get_first_section(const std::string& sec_name, hsection& h_child_section, hsection hparent_section);
+      bool       get_next_section(harray hsec_array, hsection& h_child_section);
+
+    private:
+      struct recursion_guard
+      {
+        size_t& m_count;
+        recursion_guard(size_t& count): m_count(count)
+        {
+          CHECK_AND_ASSERT_THROW_MES(m_count + 1 < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+          ++m_count;
+        }
+        ~recursion_guard() { --m_count; }
+      };
+
+      const entry* find_entry(const std::string& name, hsection hparent_section) const;
+      void       index_section(const uint8_t*& ptr, const uint8_t* end, section_index& index);
+      void       skip_value(uint8_t type, const uint8_t*& ptr, const uint8_t* end);
+      static size_t read_varint(const uint8_t*& ptr, const uint8_t* end);
+      static void read_raw(void* target, size_t size, const uint8_t*& ptr, const uint8_t* end);
+      static void read_value(uint8_t type, const uint8_t*& ptr, const uint8_t* end, std::string& target);
+      template<class t_value>
+      static void read_value(uint8_t type, const uint8_t*& ptr, const uint8_t* end, t_value& target);
+      template<class from_type, class t_value>
+      static void read_pod(const uint8_t*& ptr, const uint8_t* end, t_value& target);
+
+      section_index m_root;
+      section_index m_empty;
+      std::deque<section_index> m_sections;
+      std::deque<array_cursor> m_arrays;
+      size_t m_recursion_count;
+    };
+
+    inline
+    bool portable_storage_reader::load_from_binary(const binarybuffer& source)
+    {
+      m_root.m_entries.clear();
+      m_sections.clear();
+      m_arrays.clear();
+      m_recursion_count = 0;
+      if(source.size() < sizeof(portable_storage_block_header))
+      {
+        LOG_ERROR("portable_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)=" << sizeof(portable_storage_block_header));
+        return false;
+      }
+      const portable_storage_block_header* pbuff = (const portable_storage_block_header*)source.data();
+      if(pbuff->m_signature_a != PORTABLE_STORAGE_SIGNATUREA ||
+        pbuff->m_signature_b != PORTABLE_STORAGE_SIGNATUREB
+        )
+      {
+        LOG_ERROR("portable_storage: wrong binary format - signature missmatch");
+        return false;
+      }
+      if(pbuff->m_ver != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage: wrong binary format - unknown format ver = " << pbuff->m_ver);
+        return false;
+      }
+      TRY_ENTRY();
+      const uint8_t* ptr = (const uint8_t*)source.data() + sizeof(portable_storage_block_header);
+      const uint8_t* end = (const uint8_t*)source.data() + source.size();
+      //indexing the root walks (and so validates) the whole buffer
+      index_section(ptr, end, m_root);
+      return true;
+      CATCH_ENTRY("portable_storage_reader::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_reader::read_varint(const uint8_t*& ptr, const uint8_t* end)
+    {
+      CHECK_AND_ASSERT_THROW_MES(ptr < end, "empty buff, expected place for varint");
+      size_t v = 0;
+      switch(*ptr & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE:  { uint8_t  r; read_raw(&r, sizeof(r), ptr, end); v = r; break; }
+      case PORTABLE_RAW_SIZE_MARK_WORD:  { uint16_t r; read_raw(&r, sizeof(r), ptr, end); v = r; break; }
+      case PORTABLE_RAW_SIZE_MARK_DWORD: { uint32_t r; read_raw(&r, sizeof(r), ptr, end); v = r; break; }
+      default:                           { uint64_t r; read_raw(&r, sizeof(r), ptr, end); v = r; break; }
+      }
+      return v >> 2;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::read_raw(void* target, size_t size, const uint8_t*& ptr, const uint8_t* end)
+    {
+      CHECK_AND_ASSERT_THROW_MES((size_t)(end - ptr) >= size, " attempt to read " << size << " bytes from buffer with " << (end - ptr) << " bytes remained");
+      memcpy(target, ptr, size);
+      ptr += size;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::index_section(const uint8_t*& ptr, const uint8_t* end, section_index& index)
+    {
+      index.m_entries.clear();
+      size_t count = read_varint(ptr, end);
+      CHECK_AND_ASSERT_THROW_MES(count <= (size_t)(end - ptr), "section entries count " << count << " goes out of remain storage len " << (end - ptr));
+      index.m_entries.reserve(count);
+      while(count--)
+      {
+        entry e;
+        uint8_t name_len = 0;
+        read_raw(&name_len, sizeof(name_len), ptr, end);
+        CHECK_AND_ASSERT_THROW_MES((size_t)(end - ptr) > name_len, "section name len " << (size_t)name_len << " goes out of remain storage len " << (end - ptr));
+        e.m_name = (const char*)ptr;
+        e.m_name_len = name_len;
+        ptr += name_len;
+        e.m_data = ptr;
+        uint8_t type = *ptr++;
+        skip_value(type, ptr, end);
+        e.m_end = ptr;
+        index.m_entries.push_back(e);
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::skip_value(uint8_t type, const uint8_t*& ptr, const uint8_t* end)
+    {
+      recursion_guard rg(m_recursion_count);
+
+      size_t count = 1;
+      if(type & SERIALIZE_FLAG_ARRAY)
+      {
+        type &= ~SERIALIZE_FLAG_ARRAY;
+        count = read_varint(ptr, end);
+      }
+      size_t pod_size = 0;
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  pod_size = sizeof(int64_t); break;
+      case SERIALIZE_TYPE_INT32:  pod_size = sizeof(int32_t); break;
+      case SERIALIZE_TYPE_INT16:  pod_size = sizeof(int16_t); break;
+      case SERIALIZE_TYPE_INT8:   pod_size = sizeof(int8_t); break;
+      case SERIALIZE_TYPE_UINT64: pod_size = sizeof(uint64_t); break;
+      case SERIALIZE_TYPE_UINT32: pod_size = sizeof(uint32_t); break;
+      case SERIALIZE_TYPE_UINT16: pod_size = sizeof(uint16_t); break;
+      case SERIALIZE_TYPE_UINT8:  pod_size = sizeof(uint8_t); break;
+      case SERIALIZE_TYPE_DUOBLE: pod_size = sizeof(double); break;
+      case SERIALIZE_TYPE_BOOL:   pod_size = sizeof(bool); break;
+      case SERIALIZE_TYPE_STRING:
+        while(count--)
+        {
+          size_t len = read_varint(ptr, end);
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          CHECK_AND_ASSERT_THROW_MES((size_t)(end - ptr) >= len, "string len count value " << len << " goes out of remain storage len " << (end - ptr));
+          ptr += len;
+        }
+        return;
+      case SERIALIZE_TYPE_OBJECT:
+        {
+          section_index skipped;
+          while(count--)
+            index_section(ptr, end, skipped);
+        }
+        return;
+      case SERIALIZE_TYPE_ARRAY:
+        while(count--)
+        {
+          uint8_t ent_type = 0;
+          read_raw(&ent_type, sizeof(ent_type), ptr, end);
+          CHECK_AND_ASSERT_THROW_MES(ent_type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+          skip_value(ent_type, ptr, end);
+        }
+        return;
+      default:
+        CHECK_AND_ASSERT_THROW_MES(false, "unknown entry_type code = " << (int)type);
+      }
+      CHECK_AND_ASSERT_THROW_MES(count <= (size_t)(end - ptr) / pod_size, "array of " << count << " values goes out of remain storage len " << (end - ptr));
+      ptr += count * pod_size;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const portable_storage_reader::entry* portable_storage_reader::find_entry(const std::string& name, hsection hparent_section) const
+    {
+      const section_index& index = hparent_section ? *hparent_section : m_root;
+      //first one wins, like in portable_storage
+      for(const entry& e: index.m_entries)
+        if(e.m_name_len == name.size() && !memcmp(e.m_name, name.data(), e.m_name_len))
+          return &e;
+      return nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class from_type, class t_value>
+    void portable_storage_reader::read_pod(const uint8_t*& ptr, const uint8_t* end, t_value& target)
+    {
+      from_type v;
+      read_raw(&v, sizeof(v), ptr, end);
+      convert_t(v, target);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_reader::read_value(uint8_t type, const uint8_t*& ptr, const uint8_t* end, std::string& target)
+    {
+      if(type != SERIALIZE_TYPE_STRING)
+      {
+        read_value<std::string>(type, ptr, end, target);
+        return;
+      }
+      size_t len = read_varint(ptr, end);
+      CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+      CHECK_AND_ASSERT_THROW_MES((size_t)(end - ptr) >= len, "string len count value " << len << " goes out of remain storage len " << (end - ptr));
+      target.assign((const char*)ptr, len);
+      ptr += len;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_reader::read_value(uint8_t type, const uint8_t*& ptr, const uint8_t* end, t_value& target)
+    {
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  read_pod<int64_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_INT32:  read_pod<int32_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_INT16:  read_pod<int16_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_INT8:   read_pod<int8_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_UINT64: read_pod<uint64_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_UINT32: read_pod<uint32_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_UINT16: read_pod<uint16_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_UINT8:  read_pod<uint8_t>(ptr, end, target); break;
+      case SERIALIZE_TYPE_DUOBLE: read_pod<double>(ptr, end, target); break;
+      case SERIALIZE_TYPE_BOOL:   read_pod<bool>(ptr, end, target); break;
+      case SERIALIZE_TYPE_STRING:
+        {
+          std::string s;
+          read_value(type, ptr, end, s);
+          convert_t(s, target);
+        }
+        break;
+      default:
+        //sections and arrays can't be converted to values
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from type code=" << (int)type << " to type " << typeid(t_value).name());
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_reader::hsection portable_storage_reader::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      TRY_ENTRY();
+      const entry* e = find_entry(section_name, hparent_section);
+      if(!e || *e->m_data != SERIALIZE_TYPE_OBJECT)
+      {
+        //portable_storage creates an empty section in this case
+        if(!create_if_notexist)
+          return nullptr;
+        m_empty.m_entries.clear();
+        return &m_empty;
+      }
+      m_sections.push_back(section_index());
+      const uint8_t* ptr = e->m_data + 1;
+      index_section(ptr, e->m_end, m_sections.back());
+      return &m_sections.back();
+      CATCH_ENTRY("portable_storage_reader::open_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const entry* e = find_entry(value_name, hparent_section);
+      if(!e)
+        return false;
+      const uint8_t* ptr = e->m_data + 1;
+      read_value(*e->m_data, ptr, e->m_end, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+    {
+      const entry* e = find_entry(value_name, hparent_section);
+      if(!e)
+        return false;
+      throwable_buffer_reader buf_reader(e->m_data, e->m_end - e->m_data);
+      val = buf_reader.load_storage_entry();
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_reader::harray portable_storage_reader::get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      const entry* e = find_entry(value_name, hparent_section);
+      if(!e || !(*e->m_data & SERIALIZE_FLAG_ARRAY))
+        return nullptr;
+      array_cursor c = AUTO_VAL_INIT(c);
+      c.m_ptr = e->m_data + 1;
+      c.m_end = e->m_end;
+      c.m_type = *e->m_data & ~SERIALIZE_FLAG_ARRAY;
+      c.m_remaining = read_varint(c.m_ptr, c.m_end);
+      if(!c.m_remaining)
+        return nullptr;
+      m_arrays.push_back(c);
+      if(!get_next_value(&m_arrays.back(), target))
+        return nullptr;
+      return &m_arrays.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_reader::get_next_value(harray hval_array, t_value& target)
+    {
+      BOOST_MPL_ASSERT(( boost::mpl::contains<storage_entry::types, t_value> ));
+      CHECK_AND_ASSERT(hval_array, false);
+      if(!hval_array->m_remaining)
+        return false;
+      read_value(hval_array->m_type, hval_array->m_ptr, hval_array->m_end, target);
+      --hval_array->m_remaining;
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_reader::harray portable_storage_reader::get_first_section(const std::string& sec_name, hsection& h_child_section, hsection hparent_section)
+    {
+      TRY_ENTRY();
+      const entry* e = find_entry(sec_name, hparent_section);
+      if(!e || *e->m_data != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY))
+        return nullptr;
+      array_cursor c = AUTO_VAL_INIT(c);
+      c.m_ptr = e->m_data + 1;
+      c.m_end = e->m_end;
+      c.m_type = SERIALIZE_TYPE_OBJECT;
+      c.m_remaining = read_varint(c.m_ptr, c.m_end);
+      if(!c.m_remaining)
+        return nullptr;
+      //one index per array, reused for every element: the previous one is done with when the next is asked for
+      m_sections.push_back(section_index());
+      c.m_section = &m_sections.back();
+      m_arrays.push_back(c);
+      if(!get_next_section(&m_arrays.back(), h_child_section))
+        return nullptr;
+      return &m_arrays.back();
+      CATCH_ENTRY("portable_storage_reader::get_first_section", nullptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_reader::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      TRY_ENTRY();
+      CHECK_AND_ASSERT(hsec_array, false);
+      if(hsec_array->m_type != SERIALIZE_TYPE_OBJECT || !hsec_array->m_remaining)
+        return false;
+      index_section(hsec_array->m_ptr, hsec_array->m_end, *hsec_array->m_section);
+      --hsec_array->m_remaining;
+      h_child_section = hsec_array->m_section;
+      return true;
+      CATCH_ENTRY("portable_storage_reader::get_next_section", false);
+    }
+  }
+}
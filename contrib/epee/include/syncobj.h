@@ -35,6 +35,9 @@
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <atomic>
 #include <thread>
 #include <chrono>
 
@@ -144,6 +147,116 @@ namespace epee
   };
 
 
+  /*
+    Reader/writer section which, like critical_section, may be re-entered by
+    the thread holding it. lock() takes it exclusively; lock_shared() lets
+    any number of readers in at once. A thread which already owns it
+    exclusively and asks for shared access simply re-enters its exclusive
+    hold. Upgrading a shared hold to an exclusive one is not supported and
+    will deadlock.
+  */
+  class recursive_shared_critical_section
+  {
+    boost::shared_mutex m_section;
+    std::atomic<std::thread::id> m_owner;
+    unsigned int m_exclusive_depth;
+    boost::thread_specific_ptr<unsigned int> m_shared_depth;
+
+    recursive_shared_critical_section(const recursive_shared_critical_section&);
+    recursive_shared_critical_section& operator=(const recursive_shared_critical_section&);
+
+    bool owned_by_this_thread() const
+    {
+      return m_owner.load() == std::this_thread::get_id();
+    }
+
+  public:
+    recursive_shared_critical_section(): m_owner(std::thread::id()), m_exclusive_depth(0)
+    {
+    }
+
+    void lock()
+    {
+      if (owned_by_this_thread())
+      {
+        ++m_exclusive_depth;
+        return;
+      }
+      m_section.lock();
+      m_owner = std::this_thread::get_id();
+      m_exclusive_depth = 1;
+    }
+
+    void unlock()
+    {
+      if (--m_exclusive_depth == 0)
+      {
+        m_owner = std::thread::id();
+        m_section.unlock();
+      }
+    }
+
+    void lock_shared()
+    {
+      if (owned_by_this_thread())
+      {
+        ++m_exclusive_depth;
+        return;
+      }
+      unsigned int* depth = m_shared_depth.get();
+      if (!depth)
+      {
+        depth = new unsigned int(0);
+        m_shared_depth.reset(depth);
+      }
+      // a nested reader must not queue behind a waiting writer
+      if ((*depth)++ == 0)
+        m_section.lock_shared();
+    }
+
+    void unlock_shared()
+    {
+      if (owned_by_this_thread())
+      {
+        unlock();
+        return;
+      }
+      unsigned int* depth = m_shared_depth.get();
+      if (--(*depth) == 0)
+        m_section.unlock_shared();
+    }
+  };
+
+  template<class t_lock>
+  class shared_critical_region_t
+  {
+    t_lock&	m_locker;
+    bool m_unlocked;
+
+    shared_critical_region_t(const shared_critical_region_t&) {}
+
+  public:
+    shared_critical_region_t(t_lock& cs): m_locker(cs), m_unlocked(false)
+    {
+      m_locker.lock_shared();
+    }
+
+    ~shared_critical_region_t()
+    {
+      unlock();
+    }
+
+    void unlock()
+    {
+      if (!m_unlocked)
+      {
+        m_locker.unlock_shared();
+        m_unlocked = true;
+      }
+    }
+  };
+
+
 #if defined(WINDWOS_PLATFORM)
   class shared_critical_section
   {
@@ -224,6 +337,8 @@ namespace epee
 #define  CRITICAL_REGION_LOCAL1(x) {std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep));} epee::critical_region_t<decltype(x)>   critical_region_var1(x)
 #define  CRITICAL_REGION_BEGIN1(x) {  std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep)); epee::critical_region_t<decltype(x)>   critical_region_var1(x)
 
+#define  SHARED_CRITICAL_REGION_LOCAL(x) {std::this_thread::sleep_for(std::chrono::milliseconds(epee::g_test_dbg_lock_sleep));}   epee::shared_critical_region_t<decltype(x)>   critical_region_var(x)
+
 #define  CRITICAL_REGION_END() }
 
 
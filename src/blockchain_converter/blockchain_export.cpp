@@ -29,26 +29,17 @@
 #include <algorithm>
 #include <cstdio>
 #include <fstream>
-#include <boost/iostreams/copy.hpp>
 #include <atomic>
 
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/iostreams/stream_buffer.hpp>
-#include <boost/iostreams/stream.hpp>
-#include <boost/iostreams/device/back_inserter.hpp>
-#include <boost/iostreams/filtering_streambuf.hpp>
-#include <boost/iostreams/filter/bzip2.hpp>
 #include "common/command_line.h"
 #include "version.h"
 #include "blockchain_export.h"
-#include "cryptonote_core/cryptonote_boost_serialization.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
 
 #include "import.h"
 
 unsigned int epee::g_test_dbg_lock_sleep = 0;
 
-static int max_chunk = 0;
 static size_t height;
 
 namespace po = boost::program_options;
@@ -75,167 +66,50 @@ bool BlockchainExport::open(const boost::filesystem::path& dir_path)
     }
   }
 
-  std::string file_path = (dir_path / BLOCKCHAIN_RAW).string();
-  m_raw_data_file = new std::ofstream();
-  m_raw_data_file->open(file_path , std::ios_base::binary | std::ios_base::out| std::ios::trunc);
-  if (m_raw_data_file->fail())
-    return false;
-
-  m_output_stream = new boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>(m_buffer);
-  m_raw_archive = new boost::archive::binary_oarchive(*m_output_stream);
-  if (m_raw_archive == NULL)
-    return false;
-
-  return true;
-}
-
-void BlockchainExport::flush_chunk()
-{
-  m_output_stream->flush();
-  char buffer[STR_LENGTH_OF_INT + 1];
-  int chunk_size = (int) m_buffer.size();
-  if (chunk_size > BUFFER_SIZE)
-  {
-    LOG_PRINT_L0("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
-  }
-  sprintf(buffer, STR_FORMAT_OF_INT, chunk_size);
-  m_raw_data_file->write(buffer, STR_LENGTH_OF_INT);
-  if (max_chunk < chunk_size)
-  {
-    max_chunk = chunk_size;
-  }
-  long pos_before = m_raw_data_file->tellp();
-  std::copy(m_buffer.begin(), m_buffer.end(), std::ostreambuf_iterator<char>(*m_raw_data_file));
-  m_raw_data_file->flush();
-  long pos_after = m_raw_data_file->tellp();
-  long num_chars_written = pos_after - pos_before;
-  if ((int) num_chars_written != chunk_size)
-  {
-    LOG_PRINT_RED_L0("INTERNAL ERROR: num chars wrote NEQ buffer size. height = " << height);
-  }
-
-  m_buffer.clear();
-  delete m_raw_archive;
-  delete m_output_stream;
-  m_output_stream = new boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>(m_buffer);
-  m_raw_archive = new boost::archive::binary_oarchive(*m_output_stream);
-}
-
-void BlockchainExport::serialize_block_to_text_buffer(const block& block)
-{
-  *m_raw_archive << block;
-}
-
-void BlockchainExport::buffer_serialize_tx(const transaction& tx)
-{
-  *m_raw_archive << tx;
-}
-
-void BlockchainExport::buffer_write_num_txs(const std::list<transaction> txs)
-{
-  int n = txs.size();
-  *m_raw_archive << n;
+  return m_writer.open(dir_path / BLOCKCHAIN_RAW);
 }
 
-void BlockchainExport::write_block(block& block)
-{
-  serialize_block_to_text_buffer(block);
-  std::list<transaction> txs;
-
-  uint64_t block_height = boost::get<txin_gen>(block.miner_tx.vin.front()).height;
-
-  // put coinbase transaction first
-  transaction coinbase_tx = block.miner_tx;
-  crypto::hash coinbase_tx_hash = get_transaction_hash(coinbase_tx);
 #if SOURCE_DB == DB_MEMORY
-  const transaction* cb_tx_full = m_blockchain_storage->get_tx(coinbase_tx_hash);
-#else
-  transaction cb_tx_full = m_blockchain_storage->get_db().get_tx(coinbase_tx_hash);
-#endif
-
-#if SOURCE_DB == DB_MEMORY
-  if (cb_tx_full != NULL)
-  {
-    txs.push_back(*cb_tx_full);
-  }
-#else
-  // TODO: should check and abort if cb_tx_full equals null_hash?
-  txs.push_back(cb_tx_full);
-#endif
+bool BlockchainExport::write_block(uint64_t block_height, const block& block)
+{
+  std::vector<blobdata> tx_blobs;
+  tx_blobs.reserve(block.tx_hashes.size());
 
-  // now add all regular transactions
+  // the miner tx is part of the block blob, so only regular transactions
   BOOST_FOREACH(const auto& tx_id, block.tx_hashes)
   {
-#if SOURCE_DB == DB_MEMORY
     const transaction* tx = m_blockchain_storage->get_tx(tx_id);
-#else
-    transaction tx = m_blockchain_storage->get_db().get_tx(tx_id);
-#endif
-
-#if SOURCE_DB == DB_MEMORY
     if(tx == NULL)
     {
       if (! m_tx_pool)
         throw std::runtime_error("Aborting: tx == NULL, so memory pool required to get tx, but memory pool isn't enabled");
       else
       {
-        transaction tx;
-        if(m_tx_pool->get_transaction(tx_id, tx))
-          txs.push_back(tx);
+        transaction pool_tx;
+        if(m_tx_pool->get_transaction(tx_id, pool_tx))
+          tx_blobs.push_back(tx_to_blob(pool_tx));
         else
           throw std::runtime_error("Aborting: tx not found in pool");
       }
     }
     else
-      txs.push_back(*tx);
-#else
-    txs.push_back(tx);
-#endif
-  }
-
-  // serialize all txs to the persistant storage
-  buffer_write_num_txs(txs);
-  BOOST_FOREACH(const auto& tx, txs)
-  {
-    buffer_serialize_tx(tx);
+      tx_blobs.push_back(tx_to_blob(*tx));
   }
 
   // These three attributes are currently necessary for a fast import that adds blocks without verification.
-  bool include_extra_block_data = true;
-  if (include_extra_block_data)
-  {
-#if SOURCE_DB == DB_MEMORY
-    size_t block_size = m_blockchain_storage->get_block_size(block_height);
-#else
-    size_t block_size = m_blockchain_storage->get_db().get_block_size(block_height);
-#endif
-#if SOURCE_DB == DB_MEMORY
-    difficulty_type cumulative_difficulty = m_blockchain_storage->get_block_cumulative_difficulty(block_height);
-#else
-    difficulty_type cumulative_difficulty = m_blockchain_storage->get_db().get_block_cumulative_difficulty(block_height);
-#endif
-#if SOURCE_DB == DB_MEMORY
-    uint64_t coins_generated = m_blockchain_storage->get_block_coins_generated(block_height);
-#else
-    // TODO TEST to verify that this is the equivalent. make sure no off-by-one error with block height vs block number
-    uint64_t coins_generated = m_blockchain_storage->get_db().get_block_already_generated_coins(block_height);
-#endif
+  size_t block_size = m_blockchain_storage->get_block_size(block_height);
+  difficulty_type cumulative_difficulty = m_blockchain_storage->get_block_cumulative_difficulty(block_height);
+  uint64_t coins_generated = m_blockchain_storage->get_block_coins_generated(block_height);
 
-    *m_raw_archive << block_size;
-    *m_raw_archive << cumulative_difficulty;
-    *m_raw_archive << coins_generated;
-  }
+  return m_writer.add_block(block_height, block_to_blob(block), tx_blobs, block_size, cumulative_difficulty, coins_generated);
 }
+#endif
 
 bool BlockchainExport::BlockchainExport::close()
 {
-  if (m_raw_data_file->fail())
+  if (!m_writer.close())
     return false;
-
-  m_raw_data_file->flush();
-  delete m_raw_archive;
-  delete m_output_stream;
-  delete m_raw_data_file;
+  LOG_PRINT_L0("longest chunk was " << m_writer.get_largest_chunk_size() << " bytes");
   return true;
 }
 
@@ -257,7 +131,6 @@ bool BlockchainExport::store_blockchain_raw(Blockchain* _blockchain_storage, tx_
     LOG_PRINT_RED_L0("failed to open raw file for write");
     return false;
   }
-  block b;
   LOG_PRINT_L0("source blockchain height: " <<  m_blockchain_storage->get_current_blockchain_height());
   LOG_PRINT_L0("requested block height: " << requested_block_height);
   if ((requested_block_height > 0) && (requested_block_height < m_blockchain_storage->get_current_blockchain_height()))
@@ -267,27 +140,42 @@ bool BlockchainExport::store_blockchain_raw(Blockchain* _blockchain_storage, tx_
     block_height = m_blockchain_storage->get_current_blockchain_height();
     LOG_PRINT_L0("Using block height of source blockchain: " << block_height);
   }
+
+  auto show_progress = [&](uint64_t h) {
+    if (h % progress_interval == 0) {
+      std::cout << refresh_string;
+      std::cout << "height " << h << "/" << block_height << std::flush;
+    }
+  };
+
+#if SOURCE_DB == DB_MEMORY
+  block b;
   for (height=0; height < block_height; ++height)
   {
     crypto::hash hash = m_blockchain_storage->get_block_id_by_height(height);
     m_blockchain_storage->get_block_by_hash(hash, b);
-    write_block(b);
-    if (height % NUM_BLOCKS_PER_CHUNK == 0) {
-      flush_chunk();
-    }
-    if (height % progress_interval == 0) {
-      std::cout << refresh_string;
-      std::cout << "height " << height << "/" << block_height << std::flush;
-    }
-  }
-  if (height % NUM_BLOCKS_PER_CHUNK != 0)
-  {
-    flush_chunk();
+    if (!write_block(height, b))
+      return false;
+    show_progress(height);
   }
+#else
+  // read the stored blobs straight from the db rather than parsing and
+  // re-serializing every block and transaction
+  BlockchainLMDB* db = dynamic_cast<BlockchainLMDB*>(&m_blockchain_storage->get_db());
+  CHECK_AND_ASSERT_MES(db, false, "Exporting requires an LMDB source blockchain");
+  height = 0;
+  if (block_height > 0 && !db->for_blocks_range(0, block_height - 1,
+      [&](uint64_t h, const blobdata& block_blob, const std::vector<blobdata>& tx_blobs,
+          size_t block_size, difficulty_type cumulative_difficulty, uint64_t coins_generated) {
+        height = h + 1;
+        show_progress(h);
+        return m_writer.add_block(h, block_blob, tx_blobs, block_size, cumulative_difficulty, coins_generated);
+      }))
+    return false;
+#endif
   std::cout << refresh_string;
   std::cout << "height " << height << "/" << block_height << ENDL;
 
-  LOG_PRINT_L0("longest chunk was " << max_chunk << " bytes");
   return BlockchainExport::close();
 }
 
@@ -28,15 +28,12 @@
 
 #pragma once
 
-#include <boost/archive/binary_oarchive.hpp>
-#include <boost/iostreams/stream_buffer.hpp>
-#include <boost/iostreams/stream.hpp>
-#include <boost/iostreams/device/back_inserter.hpp>
 #include "cryptonote_core/cryptonote_basic.h"
 #include "cryptonote_core/blockchain_storage.h"
 #include "cryptonote_core/blockchain.h"
 #include "blockchain_db/blockchain_db.h"
 #include "blockchain_db/lmdb/db_lmdb.h"
+#include "bootstrap_file.h"
 
 // CONFIG: choose one of the three #define's
 //
@@ -70,18 +67,12 @@ protected:
 #endif
 
   tx_memory_pool* m_tx_pool;
-  typedef std::vector<char> buffer_type;
-  std::ofstream * m_raw_data_file;
-  boost::archive::binary_oarchive * m_raw_archive;
-  buffer_type m_buffer;
-  boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>* m_output_stream;
+  bootstrap::writer m_writer;
 
   // open export file for write
   bool open(const boost::filesystem::path& dir_path);
   bool close();
-  void write_block(block& block);
-  void serialize_block_to_text_buffer(const block& block);
-  void buffer_serialize_tx(const transaction& tx);
-  void buffer_write_num_txs(const std::list<transaction> txs);
-  void flush_chunk();
+#if SOURCE_DB == DB_MEMORY
+  bool write_block(uint64_t block_height, const block& block);
+#endif
 };
@@ -44,7 +44,9 @@
 
 #include <lmdb.h> // for db flag arguments
 
+#include "common/thread_pool.h"
 #include "import.h"
+#include "bootstrap_file.h"
 #include "fake_core.h"
 
 unsigned int epee::g_test_dbg_lock_sleep = 0;
@@ -128,6 +130,14 @@ int count_blocks(std::string& import_file_path)
     LOG_PRINT_L0("import file not found: " << raw_file_path);
     throw std::runtime_error("Aborting");
   }
+  if (bootstrap::reader::is_bootstrap_file(raw_file_path))
+  {
+    bootstrap::reader bootstrap_file;
+    if (!bootstrap_file.open(raw_file_path))
+      throw std::runtime_error("Aborting");
+    std::cout << "Height: " << bootstrap_file.get_num_blocks() << ENDL;
+    return bootstrap_file.get_num_blocks();
+  }
   std::ifstream import_file;
   import_file.open(import_file_path, std::ios_base::binary | std::ifstream::in);
 
@@ -206,6 +216,63 @@ int count_blocks(std::string& import_file_path)
   return h;
 }
 
+// Adds a block and its txs, other than the miner tx, to the core.  With
+// --verify they go through the tx pool and add_new_block() to be checked,
+// otherwise straight into the db with the block's stored size, cumulative
+// difficulty and coins generated.  Returns 0 if the block was added, 1 if the
+// import should stop keeping what's been added so far, or 2 if it should
+// stop without committing the pending batch.
+template <typename FakeCore>
+int add_block_to_core(FakeCore& simple_core, const block& b, const std::vector<transaction>& txs,
+    size_t block_size, difficulty_type cumulative_difficulty, uint64_t coins_generated, uint64_t h)
+{
+  if (opt_verify)
+  {
+    for (const auto& tx : txs)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if (!simple_core.m_pool.add_tx(tx, tvc, true))
+      {
+        std::cout << refresh_string;
+        LOG_PRINT_RED_L0("failed to add transaction to transaction pool, height=" << h);
+        return 1;
+      }
+    }
+
+    block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    simple_core.m_storage.add_new_block(b, bvc);
+    if (bvc.m_verifivation_failed)
+    {
+      LOG_PRINT_L0("Failed to add block to blockchain, verification failed, height = " << h);
+      LOG_PRINT_L0("skipping rest of import file");
+      // ok to commit previously batched data because it failed only in
+      // verification of potential new block with nothing added to batch
+      // yet
+      return 1;
+    }
+    if (! bvc.m_added_to_main_chain)
+    {
+      LOG_PRINT_L0("Failed to add block to blockchain, height = " << h);
+      LOG_PRINT_L0("skipping rest of import file");
+      // make sure we don't commit partial block data
+      return 2;
+    }
+    return 0;
+  }
+
+  try
+  {
+    simple_core.add_block(b, block_size, cumulative_difficulty, coins_generated, txs);
+  }
+  catch (const std::exception& e)
+  {
+    std::cout << refresh_string;
+    LOG_PRINT_RED_L0("Error adding block to blockchain: " << e.what());
+    return 2; // make sure we don't commit partial block data
+  }
+  return 0;
+}
+
 template <typename FakeCore>
 int import_from_file(FakeCore& simple_core, std::string& import_file_path)
 {
@@ -276,7 +343,7 @@ int import_from_file(FakeCore& simple_core, std::string& import_file_path)
   }
 
   if (use_batch)
-    simple_core.batch_start();
+    simple_core.batch_start(db_batch_size);
 
   LOG_PRINT_L0("Reading blockchain from import file...");
   std::cout << ENDL;
@@ -405,71 +472,19 @@ int import_from_file(FakeCore& simple_core, std::string& import_file_path)
           // LOG_PRINT_L0("tx " << tx_num << "  " << hsh << " : " << ENDL);
           // LOG_PRINT_L0(obj_to_json_str(tx) << ENDL);
 
-          // add blocks with verification.
-          // for Blockchain and blockchain_storage add_new_block().
-          if (opt_verify)
-          {
-            if (tx_num == 1) {
-              continue; // coinbase transaction. no need to insert to tx_pool.
-            }
-            // crypto::hash hsh = null_hash;
-            // size_t blob_size = 0;
-            // get_transaction_hash(tx, hsh, blob_size);
-            tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-            bool r = true;
-            r = simple_core.m_pool.add_tx(tx, tvc, true);
-            if (!r)
-            {
-              LOG_PRINT_RED_L0("failed to add transaction to transaction pool, height=" << h <<", tx_num=" << tx_num);
-              quit = 1;
-              break;
-            }
-          }
-          else
-          {
-            // for add_block() method, without (much) processing.
-            // don't add coinbase transaction to txs.
-            //
-            // because add_block() calls
-            // add_transaction(blk_hash, blk.miner_tx) first, and
-            // then a for loop for the transactions in txs.
-            if (tx_num > 1)
-            {
-              txs.push_back(tx);
-            }
-          }
+          // the miner tx is added with the block
+          if (tx_num > 1)
+            txs.push_back(tx);
         }
+        if (quit)
+          break;
 
-        if (opt_verify)
-        {
-          block_verification_context bvc = boost::value_initialized<block_verification_context>();
-          simple_core.m_storage.add_new_block(b, bvc);
-
-          if (bvc.m_verifivation_failed)
-          {
-            LOG_PRINT_L0("Failed to add block to blockchain, verification failed, height = " << h);
-            LOG_PRINT_L0("skipping rest of import file");
-            // ok to commit previously batched data because it failed only in
-            // verification of potential new block with nothing added to batch
-            // yet
-            quit = 1;
-            break;
-          }
-          if (! bvc.m_added_to_main_chain)
-          {
-            LOG_PRINT_L0("Failed to add block to blockchain, height = " << h);
-            LOG_PRINT_L0("skipping rest of import file");
-            // make sure we don't commit partial block data
-            quit = 2;
-            break;
-          }
-        }
-        else
+        // the file only has these without --verify
+        size_t block_size = 0;
+        difficulty_type cumulative_difficulty = 0;
+        uint64_t coins_generated = 0;
+        if (!opt_verify)
         {
-          size_t block_size;
-          difficulty_type cumulative_difficulty;
-          uint64_t coins_generated;
-
           a >> block_size;
           a >> cumulative_difficulty;
           a >> coins_generated;
@@ -478,20 +493,12 @@ int import_from_file(FakeCore& simple_core, std::string& import_file_path)
           LOG_PRINT_L2("block_size: " << block_size);
           LOG_PRINT_L2("cumulative_difficulty: " << cumulative_difficulty);
           LOG_PRINT_L2("coins_generated: " << coins_generated);
-
-          try
-          {
-            simple_core.add_block(b, block_size, cumulative_difficulty, coins_generated, txs);
-          }
-          catch (const std::exception& e)
-          {
-            std::cout << refresh_string;
-            LOG_PRINT_RED_L0("Error adding block to blockchain: " << e.what());
-            quit = 2; // make sure we don't commit partial block data
-            break;
-          }
         }
 
+        quit = add_block_to_core(simple_core, b, txs, block_size, cumulative_difficulty, coins_generated, h);
+        if (quit)
+          break;
+
         if (use_batch)
         {
           if (h % db_batch_size == 0)
@@ -499,7 +506,7 @@ int import_from_file(FakeCore& simple_core, std::string& import_file_path)
             std::cout << refresh_string;
             std::cout << ENDL << "[- batch commit at height " << h << " -]" << ENDL;
             simple_core.batch_stop();
-            simple_core.batch_start();
+            simple_core.batch_start(db_batch_size);
             std::cout << ENDL;
 #if !defined(BLOCKCHAIN_DB) || (BLOCKCHAIN_DB == DB_LMDB)
             simple_core.m_storage.get_db().show_stats();
@@ -539,6 +546,169 @@ int import_from_file(FakeCore& simple_core, std::string& import_file_path)
   return 0;
 }
 
+// Imports from a bootstrap file.  Chunks are hash checked and parsed on all
+// cores a group at a time, the next group while the blocks of the current
+// one are handed to the core in height order.
+template <typename FakeCore>
+int import_from_bootstrap(FakeCore& simple_core, std::string& import_file_path)
+{
+#if !defined(BLOCKCHAIN_DB) || (BLOCKCHAIN_DB == DB_LMDB)
+  if (std::is_same<fake_core_lmdb, FakeCore>::value)
+  {
+    // Reset stats, in case we're using newly created db, accumulating stats
+    // from addition of genesis block.
+    // This aligns internal db counts with importer counts.
+    simple_core.m_storage.get_db().reset_stats();
+  }
+#endif
+  bootstrap::reader bootstrap_file;
+  if (!bootstrap_file.open(import_file_path))
+    return 2;
+
+  LOG_PRINT_L0("import file blockchain height: " << bootstrap_file.get_num_blocks());
+
+  uint64_t start_height = 1;
+  if (opt_resume)
+    start_height = simple_core.m_storage.get_current_blockchain_height();
+  uint64_t stop_height = bootstrap_file.get_num_blocks();
+  LOG_PRINT_L0("start height: " << start_height << "  stop height: " <<
+      stop_height);
+
+  bool use_batch = false;
+  if (opt_batch)
+  {
+    if (simple_core.support_batch)
+      use_batch = true;
+    else
+      LOG_PRINT_L0("WARNING: batch transactions enabled but unsupported or unnecessary for this database engine - ignoring");
+  }
+
+  if (use_batch)
+    simple_core.batch_start(db_batch_size);
+
+  LOG_PRINT_L0("Reading blockchain from import file...");
+  std::cout << ENDL;
+
+  // chunks read and parsed on the pool while the previous group goes into
+  // the db
+  struct chunk_group
+  {
+    size_t first;
+    std::vector<std::vector<bootstrap::parsed_block>> blocks;
+    std::vector<char> ok;
+    tools::thread_pool::waiter waiter;
+  };
+  // declared before the pool, so that if adding a block throws, the pool's
+  // threads are joined before the groups they write to go away
+  chunk_group groups[2];
+  tools::thread_pool pool(boost::thread::hardware_concurrency());
+  const size_t chunks_per_group = pool.get_max_concurrency() * 2;
+  auto start_reading = [&](chunk_group& g, size_t first)
+  {
+    g.first = first;
+    size_t group_size = first < bootstrap_file.get_num_chunks() ? std::min(chunks_per_group, bootstrap_file.get_num_chunks() - first) : 0;
+    g.blocks.clear();
+    g.blocks.resize(group_size);
+    g.ok.assign(group_size, 0);
+    for (size_t i = 0; i < group_size; ++i)
+    {
+      pool.submit(&g.waiter, [&g, &bootstrap_file, i]() {
+        g.ok[i] = bootstrap_file.read_chunk(g.first + i, g.blocks[i]);
+      });
+    }
+  };
+
+  uint64_t h = start_height;
+  int quit = 0;
+  uint64_t blocks_in_batch = 0;
+  size_t current = 0;
+  start_reading(groups[current], bootstrap_file.find_chunk(start_height));
+  while (!quit && !groups[current].blocks.empty())
+  {
+    chunk_group& group = groups[current];
+    pool.wait(group.waiter);
+    start_reading(groups[current ^ 1], group.first + group.blocks.size());
+
+    for (size_t i = 0; i < group.blocks.size() && !quit; ++i)
+    {
+      if (!group.ok[i])
+      {
+        std::cout << refresh_string;
+        LOG_PRINT_RED_L0("Failed to read chunk " << group.first + i << " of the import file, height=" << h);
+        quit = 1;
+        break;
+      }
+      for (auto& pb : group.blocks[i])
+      {
+        if (pb.height < start_height)
+          continue;
+        h = pb.height + 1;
+
+        if (h % 10 == 0)
+        {
+          std::cout << refresh_string << "block " << h-1
+            << std::flush;
+        }
+
+        quit = add_block_to_core(simple_core, pb.b, pb.txs, pb.block_size, pb.cumulative_difficulty, pb.coins_generated, h);
+        if (quit)
+          break;
+        ++blocks_in_batch;
+      }
+      // free the parsed blocks as soon as they're in
+      std::vector<bootstrap::parsed_block>().swap(group.blocks[i]);
+
+      // batches end on chunk boundaries, so a resumed import starts on one
+      if (!quit && use_batch && blocks_in_batch >= db_batch_size)
+      {
+        std::cout << refresh_string;
+        std::cout << ENDL << "[- batch commit at height " << h << " -]" << ENDL;
+        simple_core.batch_stop();
+        simple_core.batch_start(db_batch_size);
+        blocks_in_batch = 0;
+        std::cout << ENDL;
+#if !defined(BLOCKCHAIN_DB) || (BLOCKCHAIN_DB == DB_LMDB)
+        simple_core.m_storage.get_db().show_stats();
+#endif
+      }
+    }
+    current ^= 1;
+  }
+  // the group read ahead may still be in flight
+  pool.wait(groups[0].waiter);
+  pool.wait(groups[1].waiter);
+  std::cout << refresh_string;
+
+  if (use_batch)
+  {
+    if (quit > 1)
+    {
+      // There was an error, so don't commit pending data.
+      // Destructor will abort write txn.
+    }
+    else
+    {
+      simple_core.batch_stop();
+    }
+#if !defined(BLOCKCHAIN_DB) || (BLOCKCHAIN_DB == DB_LMDB)
+    simple_core.m_storage.get_db().show_stats();
+#endif
+    if (h > 0)
+      LOG_PRINT_L0("Finished at height: " << h << "  block: " << h-1);
+  }
+  std::cout << ENDL;
+  return quit > 1 ? 2 : 0;
+}
+
+// picks the importer for the file's format
+template <typename FakeCore>
+int import_from_any(FakeCore& simple_core, std::string& import_file_path)
+{
+  if (bootstrap::reader::is_bootstrap_file(import_file_path))
+    return import_from_bootstrap(simple_core, import_file_path);
+  return import_from_file(simple_core, import_file_path);
+}
+
 int main(int argc, char* argv[])
 {
   std::string import_filename = BLOCKCHAIN_RAW;
@@ -707,12 +877,12 @@ int main(int argc, char* argv[])
   if (db_engine == "lmdb")
   {
     fake_core_lmdb simple_core(dirname, opt_testnet, opt_batch, mdb_flags);
-    import_from_file(simple_core, import_file_path);
+    import_from_any(simple_core, import_file_path);
   }
   else if (db_engine == "memory")
   {
     fake_core_memory simple_core(dirname, opt_testnet);
-    import_from_file(simple_core, import_file_path);
+    import_from_any(simple_core, import_file_path);
   }
   else
   {
@@ -733,7 +903,7 @@ int main(int argc, char* argv[])
   fake_core_memory simple_core(dirname, opt_testnet);
 #endif
 
-  import_from_file(simple_core, import_file_path);
+  import_from_any(simple_core, import_file_path);
 #endif
 
   }
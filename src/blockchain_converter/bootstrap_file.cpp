@@ -0,0 +1,359 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include "include_base_utils.h"
+#include "common/int-util.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "bootstrap_file.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  // the file is little endian whatever the host is; each of these converts
+  // either way
+  uint32_t le(uint32_t v) { return swap32le(v); }
+  uint64_t le(uint64_t v) { return swap64le(v); }
+
+  void swap_le(bootstrap::file_header& h)
+  {
+    h.magic = le(h.magic);
+    h.version = le(h.version);
+  }
+
+  void swap_le(bootstrap::chunk_header& h)
+  {
+    h.first_height = le(h.first_height);
+    h.num_blocks = le(h.num_blocks);
+    h.payload_size = le(h.payload_size);
+  }
+
+  void swap_le(bootstrap::index_entry& e)
+  {
+    e.offset = le(e.offset);
+    e.first_height = le(e.first_height);
+    e.num_blocks = le(e.num_blocks);
+    e.payload_size = le(e.payload_size);
+  }
+
+  void swap_le(bootstrap::file_trailer& t)
+  {
+    t.index_offset = le(t.index_offset);
+    t.num_chunks = le(t.num_chunks);
+    t.num_blocks = le(t.num_blocks);
+    t.magic = le(t.magic);
+    t.version = le(t.version);
+  }
+
+  template<typename T>
+  void append_pod(std::string& s, T t)
+  {
+    t = le(t);
+    s.append(reinterpret_cast<const char*>(&t), sizeof(t));
+  }
+
+  void append_blob(std::string& s, const blobdata& blob)
+  {
+    append_pod(s, static_cast<uint32_t>(blob.size()));
+    s.append(blob);
+  }
+
+  // bounds checked reads from a chunk payload
+  struct payload_cursor
+  {
+    const char* p;
+    const char* end;
+
+    template<typename T>
+    bool read_pod(T& t)
+    {
+      if (static_cast<size_t>(end - p) < sizeof(T))
+        return false;
+      memcpy(&t, p, sizeof(T));
+      t = le(t);
+      p += sizeof(T);
+      return true;
+    }
+
+    bool read_blob(blobdata& blob)
+    {
+      uint32_t size;
+      if (!read_pod(size) || static_cast<size_t>(end - p) < size)
+        return false;
+      blob.assign(p, size);
+      p += size;
+      return true;
+    }
+  };
+}
+
+namespace bootstrap
+{
+  writer::writer(size_t blocks_per_chunk)
+    : m_blocks_per_chunk(blocks_per_chunk ? blocks_per_chunk : 1)
+    , m_chunk_first_height(0)
+    , m_chunk_blocks(0)
+    , m_num_blocks(0)
+    , m_largest_chunk(0)
+  {
+  }
+
+  writer::~writer()
+  {
+    if (m_file.is_open())
+      close();
+  }
+
+  bool writer::open(const boost::filesystem::path& file_path)
+  {
+    m_file.open(file_path.string(), std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    if (m_file.fail())
+    {
+      LOG_PRINT_RED_L0("Failed to open bootstrap file for write: " << file_path);
+      return false;
+    }
+
+    file_header header;
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    swap_le(header);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return !m_file.fail();
+  }
+
+  bool writer::add_block(uint64_t height, const blobdata& block_blob, const std::vector<blobdata>& tx_blobs,
+      uint64_t block_size, difficulty_type cumulative_difficulty, uint64_t coins_generated)
+  {
+    if (!m_chunk_blocks)
+      m_chunk_first_height = height;
+    else
+      CHECK_AND_ASSERT_MES(height == m_chunk_first_height + m_chunk_blocks, false,
+          "Blocks must be added to a bootstrap file in height order, got " << height);
+
+    append_blob(m_payload, block_blob);
+    append_pod(m_payload, static_cast<uint32_t>(tx_blobs.size()));
+    for (const auto& tx_blob : tx_blobs)
+      append_blob(m_payload, tx_blob);
+    append_pod(m_payload, block_size);
+    append_pod(m_payload, static_cast<uint64_t>(cumulative_difficulty));
+    append_pod(m_payload, coins_generated);
+    ++m_chunk_blocks;
+    ++m_num_blocks;
+
+    if (m_chunk_blocks >= m_blocks_per_chunk)
+      return flush_chunk();
+    return true;
+  }
+
+  bool writer::flush_chunk()
+  {
+    if (!m_chunk_blocks)
+      return true;
+
+    CHECK_AND_ASSERT_MES(m_payload.size() <= std::numeric_limits<uint32_t>::max(), false,
+        "Bootstrap chunk too large: " << m_payload.size() << " bytes");
+
+    index_entry entry;
+    entry.offset = m_file.tellp();
+    entry.first_height = m_chunk_first_height;
+    entry.num_blocks = m_chunk_blocks;
+    entry.payload_size = m_payload.size();
+
+    chunk_header header;
+    header.first_height = m_chunk_first_height;
+    header.num_blocks = m_chunk_blocks;
+    header.payload_size = m_payload.size();
+    crypto::cn_fast_hash(m_payload.data(), m_payload.size(), header.payload_hash);
+    swap_le(header);
+
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.write(m_payload.data(), m_payload.size());
+    if (m_file.fail())
+    {
+      LOG_PRINT_RED_L0("Failed to write bootstrap chunk at height " << m_chunk_first_height);
+      return false;
+    }
+
+    m_index.push_back(entry);
+    m_largest_chunk = std::max(m_largest_chunk, m_payload.size());
+    m_payload.clear();
+    m_chunk_blocks = 0;
+    return true;
+  }
+
+  bool writer::close()
+  {
+    bool r = flush_chunk();
+
+    file_trailer trailer;
+    trailer.index_offset = m_file.tellp();
+    trailer.num_chunks = m_index.size();
+    trailer.num_blocks = m_num_blocks;
+    trailer.magic = FILE_MAGIC;
+    trailer.version = FILE_VERSION;
+
+    for (index_entry e : m_index)
+    {
+      swap_le(e);
+      m_file.write(reinterpret_cast<const char*>(&e), sizeof(e));
+    }
+    swap_le(trailer);
+    m_file.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    m_file.close();
+    return r && !m_file.fail();
+  }
+
+  reader::reader() : m_data(NULL), m_size(0), m_num_chunks(0)
+  {
+    memset(&m_trailer, 0, sizeof(m_trailer));
+  }
+
+  bool reader::is_bootstrap_file(const boost::filesystem::path& file_path)
+  {
+    std::ifstream file(file_path.string(), std::ios_base::binary | std::ios_base::in);
+    file_header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    swap_le(header);
+    return file && header.magic == FILE_MAGIC;
+  }
+
+  bool reader::open(const boost::filesystem::path& file_path)
+  {
+    try
+    {
+      boost::interprocess::file_mapping mapping(file_path.string().c_str(), boost::interprocess::read_only);
+      boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+      m_mapping.swap(mapping);
+      m_region.swap(region);
+    }
+    catch (const std::exception& e)
+    {
+      LOG_PRINT_RED_L0("Failed to map bootstrap file " << file_path << ": " << e.what());
+      return false;
+    }
+    m_data = static_cast<const char*>(m_region.get_address());
+    m_size = m_region.get_size();
+
+    file_header header;
+    CHECK_AND_ASSERT_MES(m_size >= sizeof(header) + sizeof(m_trailer), false, "Bootstrap file too small");
+    memcpy(&header, m_data, sizeof(header));
+    memcpy(&m_trailer, m_data + m_size - sizeof(m_trailer), sizeof(m_trailer));
+    swap_le(header);
+    swap_le(m_trailer);
+    CHECK_AND_ASSERT_MES(header.magic == FILE_MAGIC && m_trailer.magic == FILE_MAGIC, false, "Not a bootstrap file, or it was not completely written");
+    CHECK_AND_ASSERT_MES(header.version == FILE_VERSION, false, "Unsupported bootstrap file version " << header.version);
+
+    size_t index_end = m_size - sizeof(m_trailer);
+    CHECK_AND_ASSERT_MES(m_trailer.index_offset <= index_end
+        && m_trailer.num_chunks == (index_end - m_trailer.index_offset) / sizeof(index_entry)
+        && (index_end - m_trailer.index_offset) % sizeof(index_entry) == 0, false, "Corrupt bootstrap file index");
+    m_num_chunks = m_trailer.num_chunks;
+    m_index.resize(m_num_chunks);
+    for (size_t i = 0; i < m_num_chunks; ++i)
+    {
+      memcpy(&m_index[i], m_data + m_trailer.index_offset + i * sizeof(index_entry), sizeof(index_entry));
+      swap_le(m_index[i]);
+    }
+
+    for (size_t i = 0; i < m_num_chunks; ++i)
+    {
+      const index_entry& e = m_index[i];
+      CHECK_AND_ASSERT_MES(e.offset <= m_trailer.index_offset
+          && m_trailer.index_offset - e.offset >= sizeof(chunk_header) + e.payload_size, false,
+          "Corrupt bootstrap file index, chunk " << i << " out of bounds");
+      CHECK_AND_ASSERT_MES(i == 0 || e.first_height == m_index[i - 1].first_height + m_index[i - 1].num_blocks, false,
+          "Corrupt bootstrap file index, chunk " << i << " out of order");
+    }
+    return true;
+  }
+
+  size_t reader::find_chunk(uint64_t height) const
+  {
+    size_t lo = 0, hi = m_num_chunks;
+    while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (m_index[mid].first_height + m_index[mid].num_blocks <= height)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo < m_num_chunks && m_index[lo].first_height <= height)
+      return lo;
+    return m_num_chunks;
+  }
+
+  bool reader::read_chunk(size_t i, std::vector<parsed_block>& blocks) const
+  {
+    CHECK_AND_ASSERT_MES(i < m_num_chunks, false, "Bootstrap chunk " << i << " out of range");
+    const index_entry& e = m_index[i];
+
+    chunk_header header;
+    memcpy(&header, m_data + e.offset, sizeof(header));
+    swap_le(header);
+    CHECK_AND_ASSERT_MES(header.first_height == e.first_height && header.num_blocks == e.num_blocks
+        && header.payload_size == e.payload_size, false, "Bootstrap chunk " << i << " does not match the index");
+
+    const char* payload = m_data + e.offset + sizeof(header);
+    crypto::hash h;
+    crypto::cn_fast_hash(payload, header.payload_size, h);
+    CHECK_AND_ASSERT_MES(h == header.payload_hash, false, "Bootstrap chunk " << i << " is corrupt, hash mismatch");
+
+    payload_cursor cur = {payload, payload + header.payload_size};
+    blobdata blob;
+    blocks.resize(header.num_blocks);
+    for (uint32_t n = 0; n < header.num_blocks; ++n)
+    {
+      parsed_block& pb = blocks[n];
+      pb.height = header.first_height + n;
+
+      CHECK_AND_ASSERT_MES(cur.read_blob(blob) && parse_and_validate_block_from_blob(blob, pb.b), false,
+          "Failed to parse block at height " << pb.height);
+
+      uint32_t num_txs;
+      CHECK_AND_ASSERT_MES(cur.read_pod(num_txs) && num_txs == pb.b.tx_hashes.size(), false,
+          "Wrong number of txs for block at height " << pb.height);
+      pb.txs.resize(num_txs);
+      for (uint32_t t = 0; t < num_txs; ++t)
+      {
+        CHECK_AND_ASSERT_MES(cur.read_blob(blob) && parse_and_validate_tx_from_blob(blob, pb.txs[t]), false,
+            "Failed to parse tx " << t << " of block at height " << pb.height);
+        CHECK_AND_ASSERT_MES(get_transaction_hash(pb.txs[t]) == pb.b.tx_hashes[t], false,
+            "Tx " << t << " of block at height " << pb.height << " does not match the block");
+      }
+
+      uint64_t cumulative_difficulty;
+      CHECK_AND_ASSERT_MES(cur.read_pod(pb.block_size) && cur.read_pod(cumulative_difficulty) && cur.read_pod(pb.coins_generated), false,
+          "Truncated block at height " << pb.height);
+      pb.cumulative_difficulty = cumulative_difficulty;
+    }
+    CHECK_AND_ASSERT_MES(cur.p == cur.end, false, "Trailing data in bootstrap chunk " << i);
+    return true;
+  }
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "cryptonote_core/cryptonote_basic.h"
+#include "cryptonote_core/difficulty.h"
+#include "cryptonote_protocol/blobdatatype.h"
+#include "crypto/hash.h"
+
+// A bootstrap file is a header, a sequence of chunks and an index of those
+// chunks, followed by a fixed size trailer pointing at the index:
+//
+//   file_header
+//   chunk_header, payload      (repeated)
+//   index_entry                (one per chunk)
+//   file_trailer
+//
+// A chunk's payload holds its blocks back to back, each one as
+//
+//   uint32 block blob size, block blob,
+//   uint32 number of txs, then per tx (miner tx excluded): uint32 size, tx blob,
+//   uint64 block size, uint64 cumulative difficulty, uint64 coins generated
+//
+// All integers are little endian.  Blobs are stored exactly as the
+// blockchain db stores them, so neither side needs to re-serialize, and each
+// chunk carries the hash of its payload so chunks can be checked and parsed
+// independently of each other.
+
+namespace bootstrap
+{
+  const uint32_t FILE_MAGIC = 0x544f4f42; // "BOOT"
+  const uint32_t FILE_VERSION = 1;
+
+#pragma pack(push, 1)
+  struct file_header
+  {
+    uint32_t magic;
+    uint32_t version;
+  };
+
+  struct chunk_header
+  {
+    uint64_t first_height;
+    uint32_t num_blocks;
+    uint32_t payload_size;
+    crypto::hash payload_hash;
+  };
+
+  struct index_entry
+  {
+    uint64_t offset; // of the chunk_header
+    uint64_t first_height;
+    uint32_t num_blocks;
+    uint32_t payload_size;
+  };
+
+  struct file_trailer
+  {
+    uint64_t index_offset;
+    uint64_t num_chunks;
+    uint64_t num_blocks;
+    uint32_t magic;
+    uint32_t version;
+  };
+#pragma pack(pop)
+
+  // a block read back from a chunk, parsed and ready for the db
+  struct parsed_block
+  {
+    uint64_t height;
+    cryptonote::block b;
+    std::vector<cryptonote::transaction> txs; // without the miner tx
+    uint64_t block_size;
+    cryptonote::difficulty_type cumulative_difficulty;
+    uint64_t coins_generated;
+  };
+
+  /*! \brief appends blocks to a new bootstrap file, a chunk at a time */
+  class writer
+  {
+  public:
+    writer(size_t blocks_per_chunk = 100);
+    ~writer();
+
+    bool open(const boost::filesystem::path& file_path);
+    bool add_block(uint64_t height, const cryptonote::blobdata& block_blob, const std::vector<cryptonote::blobdata>& tx_blobs,
+        uint64_t block_size, cryptonote::difficulty_type cumulative_difficulty, uint64_t coins_generated);
+    //! flushes the last chunk and writes the index; the file is unusable without it
+    bool close();
+
+    size_t get_largest_chunk_size() const { return m_largest_chunk; }
+
+  private:
+    bool flush_chunk();
+
+    std::ofstream m_file;
+    size_t m_blocks_per_chunk;
+    std::string m_payload;
+    uint64_t m_chunk_first_height;
+    uint32_t m_chunk_blocks;
+    uint64_t m_num_blocks;
+    std::vector<index_entry> m_index;
+    size_t m_largest_chunk;
+  };
+
+  /*! \brief reads a bootstrap file through a read only memory map */
+  class reader
+  {
+  public:
+    reader();
+
+    //! true if the file starts with a bootstrap header, as opposed to the older raw format
+    static bool is_bootstrap_file(const boost::filesystem::path& file_path);
+
+    bool open(const boost::filesystem::path& file_path);
+
+    uint64_t get_num_blocks() const { return m_trailer.num_blocks; }
+    size_t get_num_chunks() const { return m_num_chunks; }
+    const index_entry& get_chunk(size_t i) const { return m_index[i]; }
+
+    //! index of the chunk holding the block at height, or get_num_chunks() if none does
+    size_t find_chunk(uint64_t height) const;
+
+    /*! \brief checks a chunk's payload hash and parses its blocks
+     *
+     * Safe to call for different chunks from several threads at once.
+     */
+    bool read_chunk(size_t i, std::vector<parsed_block>& blocks) const;
+
+  private:
+    boost::interprocess::file_mapping m_mapping;
+    boost::interprocess::mapped_region m_region;
+    const char* m_data;
+    size_t m_size;
+    file_trailer m_trailer;
+    std::vector<index_entry> m_index;
+    size_t m_num_chunks;
+  };
+}
@@ -30,6 +30,7 @@
 #include <boost/filesystem.hpp>
 #include <memory>  // std::unique_ptr
 #include <cstring>  // memcpy
+#include <algorithm>  // std::sort
 
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
@@ -514,8 +515,7 @@ blobdata BlockchainBDB::output_to_blob(const tx_out& output)
 tx_out BlockchainBDB::output_from_blob(const blobdata& blob) const
 {
   LOG_PRINT_L3("BlockchainBDB::" << __func__);
-  std::stringstream ss;
-  ss << blob;
+  binary_span_istream ss(blob);
   binary_archive<false> ba(ss);
   tx_out o;
 
@@ -565,6 +565,57 @@ uint64_t BlockchainBDB::get_output_global_index(const uint64_t& amount, const ui
   return glob_index;
 }
 
+void BlockchainBDB::get_output_global_indices(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<uint64_t>& global_indices) const
+{
+  LOG_PRINT_L3("BlockchainBDB::" << __func__);
+  check_open();
+
+  global_indices.clear();
+  if (offsets.empty())
+    return;
+
+  std::vector<size_t> order(offsets.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&offsets](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+  bdb_txn_safe txn;
+  if (m_env->txn_begin(NULL, txn, 0))
+    throw0(DB_ERROR("Failed to create a transaction for the db"));
+
+  bdb_cur cur(txn, m_output_amounts);
+
+  Dbt_copy<uint64_t> k(amount);
+  Dbt_copy<uint32_t> v;
+
+  auto result = cur->get(&k, &v, DB_SET);
+  if (result == DB_NOTFOUND)
+    throw1(OUTPUT_DNE("Attempting to get output indices by amount and amount index, but amount not found"));
+  else if (result)
+    throw0(DB_ERROR("DB error attempting to get an output"));
+
+  db_recno_t num_elems;
+  cur->count(&num_elems, 0);
+
+  if (num_elems <= offsets[order.back()])
+    throw1(OUTPUT_DNE("Attempting to get output indices by amount and amount index, but output not found"));
+
+  global_indices.resize(offsets.size());
+  uint64_t pos = 0;
+  for (size_t i : order)
+  {
+    for (; pos < offsets[i]; ++pos)
+    {
+      cur->get(&k, &v, DB_NEXT_DUP);
+    }
+    global_indices[i] = v;
+  }
+
+  cur.close();
+
+  txn.commit();
+}
+
 void BlockchainBDB::check_open() const
 {
   LOG_PRINT_L3("BlockchainBDB::" << __func__);
@@ -1276,12 +1327,34 @@ std::vector<transaction> BlockchainBDB::get_tx_list(const std::vector<crypto::ha
   LOG_PRINT_L3("BlockchainBDB::" << __func__);
   check_open();
   std::vector<transaction> v;
+  v.reserve(hlist.size());
+
+  bdb_txn_safe txn;
+  if (m_env->txn_begin(NULL, txn, 0))
+    throw0(DB_ERROR("Failed to create a transaction for the db"));
 
   for (auto& h : hlist)
   {
-    v.push_back(get_tx(h));
+    Dbt_copy<crypto::hash> key(h);
+    Dbt_safe result;
+    auto get_result = m_txs->get(txn, &key, &result, 0);
+    if (get_result == DB_NOTFOUND)
+      throw1(TX_DNE(std::string("tx with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
+    else if (get_result)
+      throw0(DB_ERROR("DB error attempting to fetch tx from hash"));
+
+    blobdata bd;
+    bd.assign(reinterpret_cast<char*>(result.get_data()), result.get_size());
+
+    transaction tx;
+    if (!parse_and_validate_tx_from_blob(bd, tx))
+      throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+
+    v.push_back(tx);
   }
 
+  txn.commit();
+
   return v;
 }
 
@@ -1373,6 +1446,37 @@ crypto::public_key BlockchainBDB::get_output_key(const uint64_t& amount, const u
   return v;
 }
 
+void BlockchainBDB::get_output_keys(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<crypto::public_key>& keys) const
+{
+  LOG_PRINT_L3("BlockchainBDB::" << __func__);
+  check_open();
+
+  std::vector<uint64_t> global_indices;
+  get_output_global_indices(amount, offsets, global_indices);
+
+  keys.clear();
+  keys.reserve(global_indices.size());
+
+  bdb_txn_safe txn;
+  if (m_env->txn_begin(NULL, txn, 0))
+    throw0(DB_ERROR("Failed to create a transaction for the db"));
+
+  for (const uint64_t& glob_index : global_indices)
+  {
+    Dbt_copy<uint32_t> k(glob_index);
+    Dbt_copy<crypto::public_key> v;
+    auto get_result = m_output_keys->get(txn, &k, &v, 0);
+    if (get_result == DB_NOTFOUND)
+      throw0(DB_ERROR("Attempting to get output pubkey by global index, but key does not exist"));
+    else if (get_result)
+      throw0(DB_ERROR("Error attempting to retrieve an output pubkey from the db"));
+
+    keys.push_back(v);
+  }
+
+  txn.commit();
+}
+
 // As this is not used, its return is now a blank output.
 // This will save on space in the db.
 tx_out BlockchainBDB::get_output(const crypto::hash& h, const uint64_t& index) const
@@ -1461,6 +1565,47 @@ tx_out_index BlockchainBDB::get_output_tx_and_index(const uint64_t& amount, cons
   return get_output_tx_and_index_from_global(glob_index);
 }
 
+void BlockchainBDB::get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<tx_out_index>& indices) const
+{
+  LOG_PRINT_L3("BlockchainBDB::" << __func__);
+  check_open();
+
+  std::vector<uint64_t> global_indices;
+  get_output_global_indices(amount, offsets, global_indices);
+
+  indices.clear();
+  indices.reserve(global_indices.size());
+
+  bdb_txn_safe txn;
+  if (m_env->txn_begin(NULL, txn, 0))
+    throw0(DB_ERROR("Failed to create a transaction for the db"));
+
+  for (const uint64_t& glob_index : global_indices)
+  {
+    Dbt_copy<uint32_t> k(glob_index);
+    Dbt_copy<crypto::hash> v;
+
+    auto get_result = m_output_txs->get(txn, &k, &v, 0);
+    if (get_result == DB_NOTFOUND)
+      throw1(OUTPUT_DNE("output with given index not in db"));
+    else if (get_result)
+      throw0(DB_ERROR("DB error attempting to fetch output tx hash"));
+
+    crypto::hash tx_hash = v;
+
+    Dbt_copy<uint64_t> result;
+    get_result = m_output_indices->get(txn, &k, &result, 0);
+    if (get_result == DB_NOTFOUND)
+      throw1(OUTPUT_DNE("output with given index not in db"));
+    else if (get_result)
+      throw0(DB_ERROR("DB error attempting to fetch output tx index"));
+
+    indices.push_back(tx_out_index(tx_hash, result));
+  }
+
+  txn.commit();
+}
+
 std::vector<uint64_t> BlockchainBDB::get_tx_output_indices(const crypto::hash& h) const
 {
   LOG_PRINT_L3("BlockchainBDB::" << __func__);
@@ -1595,7 +1740,7 @@ bool BlockchainBDB::has_key_image(const crypto::key_image& img) const
 // Ostensibly BerkeleyDB has batch transaction support built-in,
 // so the following few functions will be NOP.
 
-void BlockchainBDB::batch_start()
+void BlockchainBDB::batch_start(uint64_t batch_num_blocks)
 {
   LOG_PRINT_L3("BlockchainBDB::" << __func__);
 }
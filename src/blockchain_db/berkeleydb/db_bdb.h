@@ -161,6 +161,8 @@ public:
 
   virtual crypto::public_key get_output_key(const uint64_t& amount, const uint64_t& index) const;
 
+  virtual void get_output_keys(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<crypto::public_key>& keys) const;
+
   virtual tx_out get_output(const crypto::hash& h, const uint64_t& index) const;
 
   /**
@@ -178,6 +180,8 @@ public:
 
   virtual tx_out_index get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const;
 
+  virtual void get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<tx_out_index>& indices) const;
+
   virtual std::vector<uint64_t> get_tx_output_indices(const crypto::hash& h) const;
   virtual std::vector<uint64_t> get_tx_amount_output_indices(const crypto::hash& h) const;
 
@@ -191,7 +195,7 @@ public:
                             );
 
   virtual void set_batch_transactions(bool batch_transactions);
-  virtual void batch_start();
+  virtual void batch_start(uint64_t batch_num_blocks = 0);
   virtual void batch_commit();
   virtual void batch_stop();
   virtual void batch_abort();
@@ -253,6 +257,18 @@ private:
    */
   uint64_t get_output_global_index(const uint64_t& amount, const uint64_t& index) const;
 
+  /**
+   * @brief get the global indices of several outputs of the same amount
+   *
+   * The offsets are visited in ascending order, so the outputs of <amount>
+   * are walked once however many are asked for.
+   *
+   * @param amount the output amount
+   * @param offsets indices into the set of outputs of that amount
+   * @param global_indices filled with the global index for each offset, in order
+   */
+  void get_output_global_indices(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<uint64_t>& global_indices) const;
+
   void check_open() const;
 
   DbEnv* m_env;
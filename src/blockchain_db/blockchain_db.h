@@ -107,9 +107,11 @@
  *   index       get_random_output(amount)
  *   uint64_t    get_num_outputs(amount)
  *   pub_key     get_output_key(amount, index)
+ *   void        get_output_keys(amount, index_list, pub_key_list)
  *   tx_out      get_output(tx_hash, index)
  *   hash,index  get_output_tx_and_index_from_global(index)
  *   hash,index  get_output_tx_and_index(amount, index)
+ *   void        get_output_tx_and_index(amount, index_list, hash_index_list)
  *   vec<uint64> get_tx_output_indices(tx_hash)
  *
  *
@@ -357,7 +359,9 @@ public:
   // release db lock
   virtual void unlock() = 0;
 
-  virtual void batch_start() = 0;
+  // batch_num_blocks is how many blocks the caller expects to add before
+  // committing, or 0 if it doesn't know
+  virtual void batch_start(uint64_t batch_num_blocks = 0) = 0;
   virtual void batch_stop() = 0;
   virtual void set_batch_transactions(bool) = 0;
 
@@ -446,7 +450,7 @@ public:
   // returns the total number of transactions in all blocks
   virtual uint64_t get_tx_count() const = 0;
 
-  // return list of tx with hashes <hlist>.
+  // return list of tx with hashes <hlist>, all read in one transaction.
   // TODO: decide if a missing hash means return empty list
   // or just skip that hash
   virtual std::vector<transaction> get_tx_list(const std::vector<crypto::hash>& hlist) const = 0;
@@ -463,6 +467,13 @@ public:
   // return public key for output with global output amount <amount> and index <index>
   virtual crypto::public_key get_output_key(const uint64_t& amount, const uint64_t& index) const = 0;
 
+  // fill <keys> with the public keys for the outputs of amount <amount> at
+  // each of <offsets>, in the same order.  The lookups share one transaction
+  // and one pass over the outputs of that amount, which is much cheaper than
+  // calling get_output_key() for each ring member.
+  // throw OUTPUT_DNE if any of them does not exist
+  virtual void get_output_keys(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<crypto::public_key>& keys) const = 0;
+
   // returns the output indexed by <index> in the transaction with hash <h>
   virtual tx_out get_output(const crypto::hash& h, const uint64_t& index) const = 0;
 
@@ -473,6 +484,10 @@ public:
   // return type is pair of tx hash and index
   virtual tx_out_index get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const = 0;
 
+  // as above, for each of <offsets>, filling <indices> in the same order
+  // throw OUTPUT_DNE if any of them does not exist
+  virtual void get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<tx_out_index>& indices) const = 0;
+
   // return a vector of indices corresponding to the global output index for
   // each output in the transaction with hash <h>
   virtual std::vector<uint64_t> get_tx_output_indices(const crypto::hash& h) const = 0;
@@ -30,6 +30,7 @@
 #include <boost/filesystem.hpp>
 #include <memory>  // std::unique_ptr
 #include <cstring>  // memcpy
+#include <algorithm>  // std::sort
 
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
@@ -117,6 +118,26 @@ auto compare_uint64 = [](const MDB_val *a, const MDB_val *b) {
   else return 1;
 };
 
+// the map starts at this size (or the size of an existing db) and grows in
+// steps of the resize increment whenever less than a quarter of a step is left
+const uint64_t DEFAULT_MAPSIZE = 1LL << 30;
+const uint64_t DEFAULT_MAP_RESIZE_INCREMENT = 1LL << 30;
+
+// a write which still runs out of room after this many resizes gives up;
+// every retry grows the map by twice as much as the one before
+const unsigned int MAX_MAP_FULL_RETRIES = 8;
+
+// a batch txn can't grow the map, so room for the whole batch is made
+// before it starts: the blocks it is expected to add, each taking
+// BATCH_BLOCK_FOOTPRINT_FACTOR times the average size of the last
+// BATCH_SIZE_ESTIMATE_BLOCKS blocks (but at least BATCH_MIN_BLOCK_FOOTPRINT),
+// plus BATCH_TXN_OVERHEAD for the pages every write txn copies
+const uint64_t DEFAULT_BATCH_NUM_BLOCKS = 100;
+const uint64_t BATCH_SIZE_ESTIMATE_BLOCKS = 100;
+const uint64_t BATCH_BLOCK_FOOTPRINT_FACTOR = 4;
+const uint64_t BATCH_MIN_BLOCK_FOOTPRINT = 16 << 10;
+const uint64_t BATCH_TXN_OVERHEAD = 1 << 20;
+
 const char* const LMDB_BLOCKS = "blocks";
 const char* const LMDB_BLOCK_TIMESTAMPS = "block_timestamps";
 const char* const LMDB_BLOCK_HEIGHTS = "block_heights";
@@ -144,6 +165,14 @@ inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi
     throw0(cryptonote::DB_OPEN_FAILURE(error_string.c_str()));
 }
 
+// a full map gets its own exception, so add_block() can grow it and retry
+inline void throw_put_error(const char* error_string, int result)
+{
+  if (result == MDB_MAP_FULL)
+    throw1(cryptonote::DB_MAP_FULL(error_string));
+  throw0(cryptonote::DB_ERROR(std::string(error_string).append(": ").append(mdb_strerror(result)).c_str()));
+}
+
 }  // anonymous namespace
 
 namespace cryptonote
@@ -162,6 +191,76 @@ namespace cryptonote
 // A regular network sync without batch writes is expected to open a new read
 // transaction, as those lookups are part of the validation done prior to the
 // write for block and tx data, so no write transaction is open at the time.
+//
+// Only the thread which owns the write transaction reads through it. Lookups
+// from any other thread (RPC, p2p handlers) use that thread's own read-only
+// transaction, see mdb_read_txn below, so they run concurrently with each
+// other and with the writer.
+
+mdb_threadinfo::~mdb_threadinfo()
+{
+  if (m_ti_rtxn && !m_ti_env.expired())
+    mdb_txn_abort(m_ti_rtxn);
+}
+
+mdb_read_txn::mdb_read_txn(const BlockchainLMDB& db) : m_txn(NULL), m_tinfo(NULL), m_resize_lock(NULL)
+{
+  // m_write_txn is only ever set and cleared by the thread in m_writer, so
+  // it is safe to look at once m_writer says that is this thread
+  if (db.m_writer == std::this_thread::get_id() && db.m_write_txn)
+  {
+    m_txn = *db.m_write_txn;
+    return;
+  }
+
+  mdb_threadinfo* tinfo = db.m_tinfo.get();
+  if (!tinfo)
+  {
+    tinfo = new mdb_threadinfo();
+    db.m_tinfo.reset(tinfo);
+  }
+
+  if (tinfo->m_ti_depth == 0)
+  {
+    // keeps the map from being resized under this txn, see do_resize()
+    db.m_resize_lock.lock_shared();
+    m_resize_lock = &db.m_resize_lock;
+
+    // a txn left over from before the db was closed and reopened can't be
+    // renewed, nor safely freed
+    if (tinfo->m_ti_rtxn && tinfo->m_ti_env.expired())
+      tinfo->m_ti_rtxn = NULL;
+
+    int result;
+    if (tinfo->m_ti_rtxn)
+    {
+      result = mdb_txn_renew(tinfo->m_ti_rtxn);
+    }
+    else
+    {
+      result = mdb_txn_begin(db.m_env, NULL, MDB_RDONLY, &tinfo->m_ti_rtxn);
+      tinfo->m_ti_env = db.m_env_open;
+    }
+    if (result)
+    {
+      m_resize_lock->unlock_shared();
+      throw0(DB_ERROR(std::string("Failed to start a read transaction for the db: ").append(mdb_strerror(result)).c_str()));
+    }
+  }
+  ++tinfo->m_ti_depth;
+
+  m_txn = tinfo->m_ti_rtxn;
+  m_tinfo = tinfo;
+}
+
+mdb_read_txn::~mdb_read_txn()
+{
+  if (m_tinfo && --m_tinfo->m_ti_depth == 0)
+  {
+    mdb_txn_reset(m_tinfo->m_ti_rtxn);
+    m_resize_lock->unlock_shared();
+  }
+}
 
 void BlockchainLMDB::add_block( const block& blk
               , const size_t& block_size
@@ -196,31 +295,30 @@ void BlockchainLMDB::add_block( const block& blk
   MDB_val_copy<uint64_t> key(m_height);
 
   MDB_val_copy<blobdata> blob(block_to_blob(blk));
-  auto res = mdb_put(*m_write_txn, m_blocks, &key, &blob, 0);
-  if (res)
-    throw0(DB_ERROR(std::string("Failed to add block blob to db transaction: ").append(mdb_strerror(res)).c_str()));
+  if (auto result = mdb_put(*m_write_txn, m_blocks, &key, &blob, 0))
+    throw_put_error("Failed to add block blob to db transaction", result);
 
   MDB_val_copy<size_t> sz(block_size);
-  if (mdb_put(*m_write_txn, m_block_sizes, &key, &sz, 0))
-    throw0(DB_ERROR("Failed to add block size to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_block_sizes, &key, &sz, 0))
+    throw_put_error("Failed to add block size to db transaction", result);
 
   MDB_val_copy<uint64_t> ts(blk.timestamp);
-  if (mdb_put(*m_write_txn, m_block_timestamps, &key, &ts, 0))
-    throw0(DB_ERROR("Failed to add block timestamp to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_block_timestamps, &key, &ts, 0))
+    throw_put_error("Failed to add block timestamp to db transaction", result);
 
   MDB_val_copy<difficulty_type> diff(cumulative_difficulty);
-  if (mdb_put(*m_write_txn, m_block_diffs, &key, &diff, 0))
-    throw0(DB_ERROR("Failed to add block cumulative difficulty to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_block_diffs, &key, &diff, 0))
+    throw_put_error("Failed to add block cumulative difficulty to db transaction", result);
 
   MDB_val_copy<uint64_t> coinsgen(coins_generated);
-  if (mdb_put(*m_write_txn, m_block_coins, &key, &coinsgen, 0))
-    throw0(DB_ERROR("Failed to add block total generated coins to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_block_coins, &key, &coinsgen, 0))
+    throw_put_error("Failed to add block total generated coins to db transaction", result);
 
-  if (mdb_put(*m_write_txn, m_block_heights, &val_h, &key, 0))
-    throw0(DB_ERROR("Failed to add block height by hash to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_block_heights, &val_h, &key, 0))
+    throw_put_error("Failed to add block height by hash to db transaction", result);
 
-  if (mdb_put(*m_write_txn, m_block_hashes, &key, &val_h, 0))
-    throw0(DB_ERROR("Failed to add block hash to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_block_hashes, &key, &val_h, 0))
+    throw_put_error("Failed to add block hash to db transaction", result);
 
 }
 
@@ -270,16 +368,16 @@ void BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, const tr
       throw1(TX_EXISTS("Attempting to add transaction that's already in the db"));
 
   MDB_val_copy<blobdata> blob(tx_to_blob(tx));
-  if (mdb_put(*m_write_txn, m_txs, &val_h, &blob, 0))
-    throw0(DB_ERROR("Failed to add tx blob to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_txs, &val_h, &blob, 0))
+    throw_put_error("Failed to add tx blob to db transaction", result);
 
   MDB_val_copy<uint64_t> height(m_height);
-  if (mdb_put(*m_write_txn, m_tx_heights, &val_h, &height, 0))
-    throw0(DB_ERROR("Failed to add tx block height to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_tx_heights, &val_h, &height, 0))
+    throw_put_error("Failed to add tx block height to db transaction", result);
 
   MDB_val_copy<uint64_t> unlock_time(tx.unlock_time);
-  if (mdb_put(*m_write_txn, m_tx_unlocks, &val_h, &unlock_time, 0))
-    throw0(DB_ERROR("Failed to add tx unlock time to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_tx_unlocks, &val_h, &unlock_time, 0))
+    throw_put_error("Failed to add tx unlock time to db transaction", result);
 }
 
 void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const transaction& tx)
@@ -314,24 +412,24 @@ void BlockchainLMDB::add_output(const crypto::hash& tx_hash, const tx_out& tx_ou
   MDB_val_copy<uint64_t> k(m_num_outputs);
   MDB_val_copy<crypto::hash> v(tx_hash);
 
-  if (mdb_put(*m_write_txn, m_output_txs, &k, &v, 0))
-    throw0(DB_ERROR("Failed to add output tx hash to db transaction"));
-  if (mdb_put(*m_write_txn, m_tx_outputs, &v, &k, 0))
-    throw0(DB_ERROR("Failed to add tx output index to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_output_txs, &k, &v, 0))
+    throw_put_error("Failed to add output tx hash to db transaction", result);
+  if (auto result = mdb_put(*m_write_txn, m_tx_outputs, &v, &k, 0))
+    throw_put_error("Failed to add tx output index to db transaction", result);
 
   MDB_val_copy<uint64_t> val_local_index(local_index);
-  if (mdb_put(*m_write_txn, m_output_indices, &k, &val_local_index, 0))
-    throw0(DB_ERROR("Failed to add tx output index to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_output_indices, &k, &val_local_index, 0))
+    throw_put_error("Failed to add tx output index to db transaction", result);
 
   MDB_val_copy<uint64_t> val_amount(tx_output.amount);
   if (auto result = mdb_put(*m_write_txn, m_output_amounts, &val_amount, &k, 0))
-    throw0(DB_ERROR(std::string("Failed to add output amount to db transaction").append(mdb_strerror(result)).c_str()));
+    throw_put_error("Failed to add output amount to db transaction", result);
 
   if (tx_output.target.type() == typeid(txout_to_key))
   {
     MDB_val_copy<crypto::public_key> val_pubkey(boost::get<txout_to_key>(tx_output.target).key);
-    if (mdb_put(*m_write_txn, m_output_keys, &k, &val_pubkey, 0))
-      throw0(DB_ERROR("Failed to add output pubkey to db transaction"));
+    if (auto result = mdb_put(*m_write_txn, m_output_keys, &k, &val_pubkey, 0))
+      throw_put_error("Failed to add output pubkey to db transaction", result);
   }
 
 
@@ -341,10 +439,10 @@ void BlockchainLMDB::add_output(const crypto::hash& tx_hash, const tx_out& tx_ou
 
   v.mv_size = b.size();
   v.mv_data = &b;
-  if (mdb_put(*m_write_txn, m_outputs, &k, &v, 0))
-    throw0(DB_ERROR("Failed to add output to db transaction"));
-  if (mdb_put(*m_write_txn, m_output_gindices, &v, &k, 0))
-    throw0(DB_ERROR("Failed to add output global index to db transaction"));
+  if (auto result = mdb_put(*m_write_txn, m_outputs, &k, &v, 0))
+    throw_put_error("Failed to add output to db transaction", result);
+  if (auto result = mdb_put(*m_write_txn, m_output_gindices, &v, &k, 0))
+    throw_put_error("Failed to add output global index to db transaction", result);
 ************************************************************************/
 
   m_num_outputs++;
@@ -525,7 +623,7 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
   unused.mv_size = sizeof(char);
   unused.mv_data = &anything;
   if (auto result = mdb_put(*m_write_txn, m_spent_keys, &val_key, &unused, 0))
-    throw1(DB_ERROR(std::string("Error adding spent key image to db transaction: ").append(mdb_strerror(result)).c_str()));
+    throw_put_error("Error adding spent key image to db transaction", result);
 }
 
 void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
@@ -551,8 +649,7 @@ blobdata BlockchainLMDB::output_to_blob(const tx_out& output)
 tx_out BlockchainLMDB::output_from_blob(const blobdata& blob) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  std::stringstream ss;
-  ss << blob;
+  binary_span_istream ss(blob);
   binary_archive<false> ba(ss);
   tx_out o;
 
@@ -567,9 +664,7 @@ uint64_t BlockchainLMDB::get_output_global_index(const uint64_t& amount, const u
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   lmdb_cur cur(txn, m_output_amounts);
 
@@ -600,11 +695,55 @@ uint64_t BlockchainLMDB::get_output_global_index(const uint64_t& amount, const u
 
   cur.close();
 
-  txn.commit();
-
   return glob_index;
 }
 
+void BlockchainLMDB::get_output_global_indices(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<uint64_t>& global_indices) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  global_indices.clear();
+  if (offsets.empty())
+    return;
+
+  std::vector<size_t> order(offsets.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&offsets](size_t a, size_t b) { return offsets[a] < offsets[b]; });
+
+  mdb_read_txn txn(*this);
+
+  lmdb_cur cur(txn, m_output_amounts);
+
+  MDB_val_copy<uint64_t> k(amount);
+  MDB_val v;
+
+  auto result = mdb_cursor_get(cur, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    throw1(OUTPUT_DNE("Attempting to get output indices by amount and amount index, but amount not found"));
+  else if (result)
+    throw0(DB_ERROR("DB error attempting to get an output"));
+
+  size_t num_elems = 0;
+  mdb_cursor_count(cur, &num_elems);
+  if (num_elems <= offsets[order.back()])
+    throw1(OUTPUT_DNE("Attempting to get output indices by amount and amount index, but output not found"));
+
+  mdb_cursor_get(cur, &k, &v, MDB_FIRST_DUP);
+
+  global_indices.resize(offsets.size());
+  uint64_t pos = 0;
+  for (size_t i : order)
+  {
+    for (; pos < offsets[i]; ++pos)
+    {
+      mdb_cursor_get(cur, &k, &v, MDB_NEXT_DUP);
+    }
+    global_indices[i] = *(const uint64_t*)v.mv_data;
+  }
+}
+
 void BlockchainLMDB::check_open() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -631,8 +770,17 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions)
 
   m_batch_transactions = batch_transactions;
   m_write_txn = nullptr;
+  m_writer = std::thread::id();
   m_batch_active = false;
   m_height = 0;
+  m_initial_map_size = DEFAULT_MAPSIZE;
+  m_map_resize_increment = DEFAULT_MAP_RESIZE_INCREMENT;
+  m_map_resize_count = 0;
+  m_map_full_retry_count = 0;
+  m_batch_num_blocks = 0;
+  m_batch_blocks_added = 0;
+  m_batch_start_height = 0;
+  m_batch_start_num_outputs = 0;
 }
 
 void BlockchainLMDB::open(const std::string& filename, const int mdb_flags)
@@ -672,8 +820,8 @@ void BlockchainLMDB::open(const std::string& filename, const int mdb_flags)
   if (mdb_env_set_maxdbs(m_env, 20))
     throw0(DB_ERROR("Failed to set max number of dbs"));
 
-  size_t mapsize = 1LL << 34;
-  if (auto result = mdb_env_set_mapsize(m_env, mapsize))
+  // an existing db keeps its own size if that is larger
+  if (auto result = mdb_env_set_mapsize(m_env, m_initial_map_size))
     throw0(DB_ERROR(std::string("Failed to set max memory map size: ").append(mdb_strerror(result)).c_str()));
   if (auto result = mdb_env_open(m_env, filename.c_str(), mdb_flags, 0644))
     throw0(DB_ERROR(std::string("Failed to open lmdb environment: ").append(mdb_strerror(result)).c_str()));
@@ -729,7 +877,16 @@ void BlockchainLMDB::open(const std::string& filename, const int mdb_flags)
   // commit the transaction
   txn.commit();
 
+  m_env_open = std::make_shared<bool>(true);
+  m_map_resize_count = 0;
+  m_map_full_retry_count = 0;
   m_open = true;
+
+  if (need_resize())
+  {
+    LOG_PRINT_L0("LMDB memory map is nearly full, growing it...");
+    do_resize();
+  }
   // from here, init should be finished
 }
 
@@ -743,8 +900,14 @@ void BlockchainLMDB::close()
   }
   this->sync();
 
+  // read txns must be gone before the environment is; other threads' ones
+  // are abandoned, as mdb_env_close() releases their reader slots
+  m_tinfo.reset();
+  m_env_open.reset();
+
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
+  m_open = false;
 }
 
 void BlockchainLMDB::sync()
@@ -809,23 +972,19 @@ bool BlockchainLMDB::block_exists(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<crypto::hash> key(h);
   MDB_val result;
   auto get_result = mdb_get(txn, m_block_heights, &key, &result);
   if (get_result == MDB_NOTFOUND)
   {
-    txn.commit();
     LOG_PRINT_L3("Block with hash " << epee::string_tools::pod_to_hex(h) << " not found in db");
     return false;
   }
   else if (get_result)
     throw0(DB_ERROR("DB error attempting to fetch block index from hash"));
 
-  txn.commit();
   return true;
 }
 
@@ -842,9 +1001,7 @@ uint64_t BlockchainLMDB::get_block_height(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<crypto::hash> key(h);
   MDB_val result;
@@ -854,7 +1011,6 @@ uint64_t BlockchainLMDB::get_block_height(const crypto::hash& h) const
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve a block height from the db"));
 
-  txn.commit();
   return *(const uint64_t*)result.mv_data;
 }
 
@@ -872,9 +1028,7 @@ block BlockchainLMDB::get_block_from_height(const uint64_t& height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
@@ -886,8 +1040,6 @@ block BlockchainLMDB::get_block_from_height(const uint64_t& height) const
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve a block from the db"));
 
-  txn.commit();
-
   blobdata bd;
   bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
 
@@ -903,18 +1055,10 @@ uint64_t BlockchainLMDB::get_block_timestamp(const uint64_t& height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
-  auto get_result = mdb_get(*txn_ptr, m_block_timestamps, &key, &result);
+  auto get_result = mdb_get(txn, m_block_timestamps, &key, &result);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(DB_ERROR(std::string("Attempt to get timestamp from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- timestamp not in db").c_str()));
@@ -922,8 +1066,6 @@ uint64_t BlockchainLMDB::get_block_timestamp(const uint64_t& height) const
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve a timestamp from the db"));
 
-  if (! m_batch_active)
-    txn.commit();
   return *(const uint64_t*)result.mv_data;
 }
 
@@ -932,13 +1074,15 @@ uint64_t BlockchainLMDB::get_top_block_timestamp() const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  uint64_t num_blocks = height();
+
   // if no blocks, return 0
-  if (m_height == 0)
+  if (num_blocks == 0)
   {
     return 0;
   }
 
-  return get_block_timestamp(m_height - 1);
+  return get_block_timestamp(num_blocks - 1);
 }
 
 size_t BlockchainLMDB::get_block_size(const uint64_t& height) const
@@ -946,19 +1090,11 @@ size_t BlockchainLMDB::get_block_size(const uint64_t& height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
-  auto get_result = mdb_get(*txn_ptr, m_block_sizes, &key, &result);
+  auto get_result = mdb_get(txn, m_block_sizes, &key, &result);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(DB_ERROR(std::string("Attempt to get block size from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block size not in db").c_str()));
@@ -966,8 +1102,6 @@ size_t BlockchainLMDB::get_block_size(const uint64_t& height) const
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve a block size from the db"));
 
-  if (! m_batch_active)
-    txn.commit();
   return *(const size_t*)result.mv_data;
 }
 
@@ -976,18 +1110,10 @@ difficulty_type BlockchainLMDB::get_block_cumulative_difficulty(const uint64_t&
   LOG_PRINT_L3("BlockchainLMDB::" << __func__ << "  height: " << height);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
-  auto get_result = mdb_get(*txn_ptr, m_block_diffs, &key, &result);
+  auto get_result = mdb_get(txn, m_block_diffs, &key, &result);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(DB_ERROR(std::string("Attempt to get cumulative difficulty from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- difficulty not in db").c_str()));
@@ -995,8 +1121,6 @@ difficulty_type BlockchainLMDB::get_block_cumulative_difficulty(const uint64_t&
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve a cumulative difficulty from the db"));
 
-  if (! m_batch_active)
-    txn.commit();
   return *(difficulty_type*)result.mv_data;
 }
 
@@ -1022,19 +1146,11 @@ uint64_t BlockchainLMDB::get_block_already_generated_coins(const uint64_t& heigh
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
-  auto get_result = mdb_get(*txn_ptr, m_block_coins, &key, &result);
+  auto get_result = mdb_get(txn, m_block_coins, &key, &result);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(DB_ERROR(std::string("Attempt to get generated coins from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block size not in db").c_str()));
@@ -1042,8 +1158,6 @@ uint64_t BlockchainLMDB::get_block_already_generated_coins(const uint64_t& heigh
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve a total generated coins from the db"));
 
-  if (! m_batch_active)
-    txn.commit();
   return *(const uint64_t*)result.mv_data;
 }
 
@@ -1052,19 +1166,11 @@ crypto::hash BlockchainLMDB::get_block_hash_from_height(const uint64_t& height)
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<uint64_t> key(height);
   MDB_val result;
-  auto get_result = mdb_get(*txn_ptr, m_block_hashes, &key, &result);
+  auto get_result = mdb_get(txn, m_block_hashes, &key, &result);
   if (get_result == MDB_NOTFOUND)
   {
     throw0(BLOCK_DNE(std::string("Attempt to get hash from height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- hash not in db").c_str()));
@@ -1073,8 +1179,6 @@ crypto::hash BlockchainLMDB::get_block_hash_from_height(const uint64_t& height)
     throw0(DB_ERROR(std::string("Error attempting to retrieve a block hash from the db: ").
           append(mdb_strerror(get_result)).c_str()));
 
-  if (! m_batch_active)
-    txn.commit();
   return *(crypto::hash*)result.mv_data;
 }
 
@@ -1106,13 +1210,72 @@ std::vector<crypto::hash> BlockchainLMDB::get_hashes_range(const uint64_t& h1, c
   return v;
 }
 
+bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, const raw_block_visitor& f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (h1 > h2)
+    return true;
+
+  mdb_read_txn txn(*this);
+
+  lmdb_cur cur_blocks(txn, m_blocks);
+  lmdb_cur cur_sizes(txn, m_block_sizes);
+  lmdb_cur cur_diffs(txn, m_block_diffs);
+  lmdb_cur cur_coins(txn, m_block_coins);
+
+  MDB_val_copy<uint64_t> start(h1);
+  MDB_val k = start;
+  MDB_val v_block, v_size, v_diff, v_coins;
+  MDB_cursor_op op = MDB_SET;
+
+  blobdata block_blob;
+  std::vector<blobdata> tx_blobs;
+  block b;
+  for (uint64_t height = h1; height <= h2; ++height)
+  {
+    if (mdb_cursor_get(cur_blocks, &k, &v_block, op)
+        || mdb_cursor_get(cur_sizes, &k, &v_size, op)
+        || mdb_cursor_get(cur_diffs, &k, &v_diff, op)
+        || mdb_cursor_get(cur_coins, &k, &v_coins, op))
+      throw0(DB_ERROR(std::string("Failed to read block data at height ").append(boost::lexical_cast<std::string>(height)).c_str()));
+    op = MDB_NEXT;
+
+    block_blob.assign(reinterpret_cast<const char*>(v_block.mv_data), v_block.mv_size);
+    if (!parse_and_validate_block_from_blob(block_blob, b))
+      throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
+
+    tx_blobs.resize(b.tx_hashes.size());
+    for (size_t i = 0; i < b.tx_hashes.size(); ++i)
+    {
+      MDB_val_copy<crypto::hash> key(b.tx_hashes[i]);
+      MDB_val result;
+      auto get_result = mdb_get(txn, m_txs, &key, &result);
+      if (get_result == MDB_NOTFOUND)
+        throw1(TX_DNE(std::string("tx with hash ").append(epee::string_tools::pod_to_hex(b.tx_hashes[i])).append(" not found in db").c_str()));
+      else if (get_result)
+        throw0(DB_ERROR("DB error attempting to fetch tx from hash"));
+      tx_blobs[i].assign(reinterpret_cast<const char*>(result.mv_data), result.mv_size);
+    }
+
+    if (!f(height, block_blob, tx_blobs, *(const size_t*)v_size.mv_data,
+          *(const difficulty_type*)v_diff.mv_data, *(const uint64_t*)v_coins.mv_data))
+      return false;
+  }
+
+  return true;
+}
+
 crypto::hash BlockchainLMDB::top_block_hash() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
-  if (m_height != 0)
+
+  uint64_t num_blocks = height();
+  if (num_blocks != 0)
   {
-    return get_block_hash_from_height(m_height - 1);
+    return get_block_hash_from_height(num_blocks - 1);
   }
 
   return null_hash;
@@ -1123,9 +1286,10 @@ block BlockchainLMDB::get_top_block() const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  if (m_height != 0)
+  uint64_t num_blocks = height();
+  if (num_blocks != 0)
   {
-    return get_block_from_height(m_height - 1);
+    return get_block_from_height(num_blocks - 1);
   }
 
   block b;
@@ -1137,6 +1301,18 @@ uint64_t BlockchainLMDB::height() const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  // m_height counts what a batch txn on another thread has added, which
+  // this thread's snapshot can't see, so count the blocks in the snapshot
+  std::thread::id writer = m_writer;
+  if (m_batch_active && writer != std::this_thread::get_id())
+  {
+    mdb_read_txn txn(*this);
+    MDB_stat db_stats;
+    if (mdb_stat(txn, m_blocks, &db_stats))
+      throw0(DB_ERROR("Failed to query m_blocks"));
+    return db_stats.ms_entries;
+  }
+
   return m_height;
 }
 
@@ -1145,27 +1321,17 @@ bool BlockchainLMDB::tx_exists(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<crypto::hash> key(h);
   MDB_val result;
 
   TIME_MEASURE_START(time1);
-  auto get_result = mdb_get(*txn_ptr, m_txs, &key, &result);
+  auto get_result = mdb_get(txn, m_txs, &key, &result);
   TIME_MEASURE_FINISH(time1);
   time_tx_exists += time1;
   if (get_result == MDB_NOTFOUND)
   {
-    if (! m_batch_active)
-      txn.commit();
     LOG_PRINT_L1("transaction with hash " << epee::string_tools::pod_to_hex(h) << " not found in db");
     return false;
   }
@@ -1180,9 +1346,7 @@ uint64_t BlockchainLMDB::get_tx_unlock_time(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<crypto::hash> key(h);
   MDB_val result;
@@ -1200,19 +1364,11 @@ transaction BlockchainLMDB::get_tx(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<crypto::hash> key(h);
   MDB_val result;
-  auto get_result = mdb_get(*txn_ptr, m_txs, &key, &result);
+  auto get_result = mdb_get(txn, m_txs, &key, &result);
   if (get_result == MDB_NOTFOUND)
     throw1(TX_DNE(std::string("tx with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
   else if (get_result)
@@ -1224,8 +1380,6 @@ transaction BlockchainLMDB::get_tx(const crypto::hash& h) const
   transaction tx;
   if (!parse_and_validate_tx_from_blob(bd, tx))
     throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
-  if (! m_batch_active)
-    txn.commit();
 
   return tx;
 }
@@ -1235,16 +1389,12 @@ uint64_t BlockchainLMDB::get_tx_count() const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_stat db_stats;
   if (mdb_stat(txn, m_txs, &db_stats))
     throw0(DB_ERROR("Failed to query m_txs"));
 
-  txn.commit();
-
   return db_stats.ms_entries;
 }
 
@@ -1253,6 +1403,10 @@ std::vector<transaction> BlockchainLMDB::get_tx_list(const std::vector<crypto::h
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
   std::vector<transaction> v;
+  v.reserve(hlist.size());
+
+  // get_tx() nests inside this txn rather than renewing one per tx
+  mdb_read_txn txn(*this);
 
   for (auto& h : hlist)
   {
@@ -1267,19 +1421,11 @@ uint64_t BlockchainLMDB::get_tx_block_height(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<crypto::hash> key(h);
   MDB_val result;
-  auto get_result = mdb_get(*txn_ptr, m_tx_heights, &key, &result);
+  auto get_result = mdb_get(txn, m_tx_heights, &key, &result);
   if (get_result == MDB_NOTFOUND)
   {
     throw1(TX_DNE(std::string("tx height with hash ").append(epee::string_tools::pod_to_hex(h)).append(" not found in db").c_str()));
@@ -1287,9 +1433,6 @@ uint64_t BlockchainLMDB::get_tx_block_height(const crypto::hash& h) const
   else if (get_result)
     throw0(DB_ERROR("DB error attempting to fetch tx height from hash"));
 
-  if (! m_batch_active)
-    txn.commit();
-
   return *(const uint64_t*)result.mv_data;
 }
 
@@ -1311,9 +1454,7 @@ uint64_t BlockchainLMDB::get_num_outputs(const uint64_t& amount) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   lmdb_cur cur(txn, m_output_amounts);
 
@@ -1330,8 +1471,6 @@ uint64_t BlockchainLMDB::get_num_outputs(const uint64_t& amount) const
   size_t num_elems = 0;
   mdb_cursor_count(cur, &num_elems);
 
-  txn.commit();
-
   return num_elems;
 }
 
@@ -1342,9 +1481,7 @@ crypto::public_key BlockchainLMDB::get_output_key(const uint64_t& amount, const
 
   uint64_t glob_index = get_output_global_index(amount, index);
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<uint64_t> k(glob_index);
   MDB_val v;
@@ -1357,14 +1494,41 @@ crypto::public_key BlockchainLMDB::get_output_key(const uint64_t& amount, const
   return *(crypto::public_key*)v.mv_data;
 }
 
+void BlockchainLMDB::get_output_keys(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<crypto::public_key>& keys) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  mdb_read_txn txn(*this);
+
+  std::vector<uint64_t> global_indices;
+  get_output_global_indices(amount, offsets, global_indices);
+
+  keys.clear();
+  keys.reserve(global_indices.size());
+
+  lmdb_cur cur(txn, m_output_keys);
+
+  for (const uint64_t& glob_index : global_indices)
+  {
+    MDB_val_copy<uint64_t> k(glob_index);
+    MDB_val v;
+    auto get_result = mdb_cursor_get(cur, &k, &v, MDB_SET);
+    if (get_result == MDB_NOTFOUND)
+      throw0(DB_ERROR("Attempting to get output pubkey by global index, but key does not exist"));
+    else if (get_result)
+      throw0(DB_ERROR("Error attempting to retrieve an output pubkey from the db"));
+
+    keys.push_back(*(const crypto::public_key*)v.mv_data);
+  }
+}
+
 tx_out BlockchainLMDB::get_output(const crypto::hash& h, const uint64_t& index) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   lmdb_cur cur(txn, m_tx_outputs);
 
@@ -1394,7 +1558,6 @@ tx_out BlockchainLMDB::get_output(const crypto::hash& h, const uint64_t& index)
   b = *(blobdata*)v.mv_data;
 
   cur.close();
-  txn.commit();
 
   return output_from_blob(b);
 }
@@ -1407,9 +1570,7 @@ tx_out BlockchainLMDB::get_output(const uint64_t& index) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<uint64_t> k(index);
   MDB_val v;
@@ -1431,19 +1592,11 @@ tx_out_index BlockchainLMDB::get_output_tx_and_index_from_global(const uint64_t&
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
+  mdb_read_txn txn(*this);
   MDB_val_copy<uint64_t> k(index);
   MDB_val v;
 
-  auto get_result = mdb_get(*txn_ptr, m_output_txs, &k, &v);
+  auto get_result = mdb_get(txn, m_output_txs, &k, &v);
   if (get_result == MDB_NOTFOUND)
     throw1(OUTPUT_DNE("output with given index not in db"));
   else if (get_result)
@@ -1451,13 +1604,11 @@ tx_out_index BlockchainLMDB::get_output_tx_and_index_from_global(const uint64_t&
 
   crypto::hash tx_hash = *(crypto::hash*)v.mv_data;
 
-  get_result = mdb_get(*txn_ptr, m_output_indices, &k, &v);
+  get_result = mdb_get(txn, m_output_indices, &k, &v);
   if (get_result == MDB_NOTFOUND)
     throw1(OUTPUT_DNE("output with given index not in db"));
   else if (get_result)
     throw0(DB_ERROR("DB error attempting to fetch output tx index"));
-  if (! m_batch_active)
-    txn.commit();
 
   return tx_out_index(tx_hash, *(const uint64_t *)v.mv_data);
 }
@@ -1467,16 +1618,8 @@ tx_out_index BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, con
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  mdb_txn_safe* txn_ptr = &txn;
-  if (m_batch_active)
-    txn_ptr = m_write_txn;
-  else
-  {
-    if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-      throw0(DB_ERROR("Failed to create a transaction for the db"));
-  }
-  lmdb_cur cur(*txn_ptr, m_output_amounts);
+  mdb_read_txn txn(*this);
+  lmdb_cur cur(txn, m_output_amounts);
 
   MDB_val_copy<uint64_t> k(amount);
   MDB_val v;
@@ -1505,21 +1648,55 @@ tx_out_index BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, con
 
   cur.close();
 
-  if (! m_batch_active)
-    txn.commit();
-
   return get_output_tx_and_index_from_global(glob_index);
 }
 
+void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<tx_out_index>& indices) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  mdb_read_txn txn(*this);
+
+  std::vector<uint64_t> global_indices;
+  get_output_global_indices(amount, offsets, global_indices);
+
+  indices.clear();
+  indices.reserve(global_indices.size());
+
+  lmdb_cur cur_txs(txn, m_output_txs);
+  lmdb_cur cur_indices(txn, m_output_indices);
+
+  for (const uint64_t& glob_index : global_indices)
+  {
+    MDB_val_copy<uint64_t> k(glob_index);
+    MDB_val v;
+
+    auto get_result = mdb_cursor_get(cur_txs, &k, &v, MDB_SET);
+    if (get_result == MDB_NOTFOUND)
+      throw1(OUTPUT_DNE("output with given index not in db"));
+    else if (get_result)
+      throw0(DB_ERROR("DB error attempting to fetch output tx hash"));
+
+    crypto::hash tx_hash = *(const crypto::hash*)v.mv_data;
+
+    get_result = mdb_cursor_get(cur_indices, &k, &v, MDB_SET);
+    if (get_result == MDB_NOTFOUND)
+      throw1(OUTPUT_DNE("output with given index not in db"));
+    else if (get_result)
+      throw0(DB_ERROR("DB error attempting to fetch output tx index"));
+
+    indices.push_back(tx_out_index(tx_hash, *(const uint64_t *)v.mv_data));
+  }
+}
+
 std::vector<uint64_t> BlockchainLMDB::get_tx_output_indices(const crypto::hash& h) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
   std::vector<uint64_t> index_vec;
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   lmdb_cur cur(txn, m_tx_outputs);
 
@@ -1544,7 +1721,6 @@ std::vector<uint64_t> BlockchainLMDB::get_tx_output_indices(const crypto::hash&
   }
 
   cur.close();
-  txn.commit();
 
   return index_vec;
 }
@@ -1562,9 +1738,7 @@ std::vector<uint64_t> BlockchainLMDB::get_tx_amount_output_indices(const crypto:
 
   transaction tx = get_tx(h);
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   uint64_t i = 0;
   uint64_t global_index;
@@ -1613,7 +1787,6 @@ std::vector<uint64_t> BlockchainLMDB::get_tx_amount_output_indices(const crypto:
     {
       // not found
       cur.close();
-      txn.commit();
       throw1(OUTPUT_DNE("specified output not found in db"));
     }
 
@@ -1621,8 +1794,6 @@ std::vector<uint64_t> BlockchainLMDB::get_tx_amount_output_indices(const crypto:
     ++i;
   }
 
-  txn.commit();
-
   return index_vec2;
 }
 
@@ -1633,23 +1804,19 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  mdb_txn_safe txn;
-  if (mdb_txn_begin(m_env, NULL, MDB_RDONLY, txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  mdb_read_txn txn(*this);
 
   MDB_val_copy<crypto::key_image> val_key(img);
   MDB_val unused;
   if (mdb_get(txn, m_spent_keys, &val_key, &unused) == 0)
   {
-    txn.commit();
     return true;
   }
 
-  txn.commit();
   return false;
 }
 
-void BlockchainLMDB::batch_start()
+void BlockchainLMDB::batch_start(uint64_t batch_num_blocks)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   if (! m_batch_transactions)
@@ -1659,17 +1826,54 @@ void BlockchainLMDB::batch_start()
   if (m_write_txn)
     throw0(DB_ERROR("batch transaction attempted, but m_write_txn already in use"));
   check_open();
+  m_batch_num_blocks = batch_num_blocks ? batch_num_blocks : DEFAULT_BATCH_NUM_BLOCKS;
+  check_and_resize_for_batch();
   // NOTE: need to make sure it's destroyed properly when done
-  if (mdb_txn_begin(m_env, NULL, 0, m_write_batch_txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  begin_batch_txn();
   // indicates this transaction is for batch transactions, but not whether it's
   // active
   m_write_batch_txn.m_batch_txn = true;
-  m_write_txn = &m_write_batch_txn;
+  m_writer = std::this_thread::get_id();
   m_batch_active = true;
   LOG_PRINT_L3("batch transaction: begin");
 }
 
+void BlockchainLMDB::begin_batch_txn()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (mdb_txn_begin(m_env, NULL, 0, m_write_batch_txn))
+    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  m_write_txn = &m_write_batch_txn;
+  m_batch_blocks_added = 0;
+  m_batch_start_height = m_height;
+  m_batch_start_num_outputs = m_num_outputs;
+}
+
+uint64_t BlockchainLMDB::get_estimated_batch_size(uint64_t batch_num_blocks) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t height = m_height;
+  uint64_t count = std::min(height, BATCH_SIZE_ESTIMATE_BLOCKS);
+  uint64_t total_size = 0;
+  for (uint64_t i = height - count; i < height; ++i)
+    total_size += get_block_size(i);
+  uint64_t block_footprint = count ? total_size / count * BATCH_BLOCK_FOOTPRINT_FACTOR : 0;
+  block_footprint = std::max(block_footprint, BATCH_MIN_BLOCK_FOOTPRINT);
+  return BATCH_TXN_OVERHEAD + batch_num_blocks * block_footprint;
+}
+
+void BlockchainLMDB::check_and_resize_for_batch()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t threshold_size = get_estimated_batch_size(m_batch_num_blocks);
+  if (need_resize(threshold_size))
+  {
+    LOG_PRINT_L1("LMDB memory map too small for a batch of " << m_batch_num_blocks << " blocks (about "
+        << (threshold_size >> 20) << " MiB), growing it");
+    do_resize(std::max(threshold_size, m_map_resize_increment));
+  }
+}
+
 void BlockchainLMDB::batch_commit()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -1685,11 +1889,12 @@ void BlockchainLMDB::batch_commit()
   time_commit1 += time1;
   LOG_PRINT_L3("batch transaction: committed");
 
-  if (mdb_txn_begin(m_env, NULL, 0, m_write_batch_txn))
-    throw0(DB_ERROR("Failed to create a transaction for the db"));
+  m_write_txn = nullptr;
+  check_and_resize_for_batch();
+
+  begin_batch_txn();
   if (! m_write_batch_txn.m_batch_txn)
     throw0(DB_ERROR("m_write_batch_txn not marked as a batch transaction"));
-  m_write_txn = &m_write_batch_txn;
 }
 
 void BlockchainLMDB::batch_stop()
@@ -1707,6 +1912,7 @@ void BlockchainLMDB::batch_stop()
   time_commit1 += time1;
   // for destruction of batch transaction
   m_write_txn = nullptr;
+  m_writer = std::thread::id();
   m_batch_active = false;
   LOG_PRINT_L3("batch transaction: end");
 }
@@ -1721,9 +1927,14 @@ void BlockchainLMDB::batch_abort()
   check_open();
   // for destruction of batch transaction
   m_write_txn = nullptr;
+  m_writer = std::thread::id();
   // explicitly call in case mdb_env_close() (BlockchainLMDB::close()) called before BlockchainLMDB destructor called.
-  m_write_batch_txn.abort();
+  if (m_write_batch_txn.m_txn)
+    m_write_batch_txn.abort();
   m_batch_active = false;
+  // nothing the batch txn added is left
+  m_height = m_batch_start_height;
+  m_num_outputs = m_batch_start_num_outputs;
   LOG_PRINT_L3("batch transaction: aborted");
 }
 
@@ -1734,6 +1945,97 @@ void BlockchainLMDB::set_batch_transactions(bool batch_transactions)
   LOG_PRINT_L3("batch transactions " << (m_batch_transactions ? "enabled" : "disabled"));
 }
 
+void BlockchainLMDB::set_map_resize_increment(uint64_t increment)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (increment)
+    m_map_resize_increment = increment;
+}
+
+uint64_t BlockchainLMDB::get_map_size() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  MDB_envinfo mei;
+  mdb_env_info(m_env, &mei);
+  return mei.me_mapsize;
+}
+
+uint64_t BlockchainLMDB::get_map_used() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  MDB_envinfo mei;
+  MDB_stat mst;
+  mdb_env_info(m_env, &mei);
+  mdb_env_stat(m_env, &mst);
+  return mst.ms_psize * (mei.me_last_pgno + 1);
+}
+
+uint64_t BlockchainLMDB::get_map_resize_count() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  return m_map_resize_count;
+}
+
+uint64_t BlockchainLMDB::get_map_full_retry_count() const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  return m_map_full_retry_count;
+}
+
+void BlockchainLMDB::set_initial_map_size(uint64_t size)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (size)
+    m_initial_map_size = size;
+}
+
+bool BlockchainLMDB::need_resize(uint64_t threshold_size) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (threshold_size == 0)
+    threshold_size = m_map_resize_increment / 4;
+
+  uint64_t mapsize = get_map_size();
+  uint64_t used = get_map_used();
+  LOG_PRINT_L3("LMDB memory map: " << (used >> 20) << " of " << (mapsize >> 20) << " MiB used");
+
+  return used + threshold_size > mapsize;
+}
+
+void BlockchainLMDB::do_resize(uint64_t increase_size)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (m_write_txn)
+    throw0(DB_ERROR("Attempted to resize the memory map with a write transaction open"));
+  if (increase_size == 0)
+    increase_size = m_map_resize_increment;
+
+  // every read txn on another thread holds this shared, and the map is
+  // unmapped and mapped again below
+  boost::unique_lock<boost::shared_mutex> lock(m_resize_lock);
+
+  MDB_envinfo mei;
+  MDB_stat mst;
+  mdb_env_info(m_env, &mei);
+  mdb_env_stat(m_env, &mst);
+
+  uint64_t new_mapsize = mei.me_mapsize + increase_size;
+  new_mapsize = (new_mapsize + mst.ms_psize - 1) / mst.ms_psize * mst.ms_psize;
+
+  if (auto result = mdb_env_set_mapsize(m_env, new_mapsize))
+    throw0(DB_ERROR(std::string("Failed to grow the memory map: ").append(mdb_strerror(result)).c_str()));
+  ++m_map_resize_count;
+
+  LOG_PRINT_L0("LMDB memory map grown from " << (mei.me_mapsize >> 20) << " MiB to " << (new_mapsize >> 20)
+      << " MiB, " << ((mst.ms_psize * (mei.me_last_pgno + 1)) >> 20) << " MiB in use");
+}
+
 uint64_t BlockchainLMDB::add_block( const block& blk
                                   , const size_t& block_size
                                   , const difficulty_type& cumulative_difficulty
@@ -1744,12 +2046,56 @@ uint64_t BlockchainLMDB::add_block( const block& blk
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_batch_active)
+  {
+    // the map was grown for m_batch_num_blocks blocks before the batch txn
+    // began, and can only grow between batch txns
+    if (m_batch_blocks_added >= m_batch_num_blocks)
+      batch_commit();
+    add_block_txn(blk, block_size, cumulative_difficulty, coins_generated, txs);
+    ++m_batch_blocks_added;
+    return ++m_height;
+  }
+
+  if (need_resize())
+    do_resize();
+
+  for (unsigned int retries = 0; ; ++retries)
+  {
+    try
+    {
+      add_block_txn(blk, block_size, cumulative_difficulty, coins_generated, txs);
+      break;
+    }
+    catch (const DB_MAP_FULL&)
+    {
+      if (retries == MAX_MAP_FULL_RETRIES)
+        throw;
+      LOG_PRINT_L0("LMDB memory map full while adding block, growing it and retrying");
+      ++m_map_full_retry_count;
+      do_resize(m_map_resize_increment << retries);
+    }
+  }
+
+  return ++m_height;
+}
+
+void BlockchainLMDB::add_block_txn( const block& blk
+                                  , const size_t& block_size
+                                  , const difficulty_type& cumulative_difficulty
+                                  , const uint64_t& coins_generated
+                                  , const std::vector<transaction>& txs
+                                  )
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
   mdb_txn_safe txn;
   if (! m_batch_active)
   {
     if (mdb_txn_begin(m_env, NULL, 0, txn))
       throw0(DB_ERROR("Failed to create a transaction for the db"));
     m_write_txn = &txn;
+    m_writer = std::this_thread::get_id();
   }
 
   uint64_t num_outputs = m_num_outputs;
@@ -1759,6 +2105,7 @@ uint64_t BlockchainLMDB::add_block( const block& blk
     if (! m_batch_active)
     {
       m_write_txn = NULL;
+      m_writer = std::thread::id();
 
       TIME_MEASURE_START(time1);
       txn.commit();
@@ -1770,11 +2117,12 @@ uint64_t BlockchainLMDB::add_block( const block& blk
   {
     m_num_outputs = num_outputs;
     if (! m_batch_active)
+    {
       m_write_txn = NULL;
+      m_writer = std::thread::id();
+    }
     throw;
   }
-
-  return ++m_height;
 }
 
 void BlockchainLMDB::pop_block(block& blk, std::vector<transaction>& txs)
@@ -1782,21 +2130,34 @@ void BlockchainLMDB::pop_block(block& blk, std::vector<transaction>& txs)
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  // deletes need free pages too, as LMDB copies on write, and the map can
+  // only grow between batch txns, so the batch so far is committed.
+  if (m_batch_active)
+    batch_commit();
+  else if (need_resize())
+    do_resize();
+
   mdb_txn_safe txn;
   if (! m_batch_active)
   {
     if (mdb_txn_begin(m_env, NULL, 0, txn))
       throw0(DB_ERROR("Failed to create a transaction for the db"));
     m_write_txn = &txn;
+    m_writer = std::this_thread::get_id();
   }
 
   uint64_t num_outputs = m_num_outputs;
+  uint64_t height = m_height;
   try
   {
     BlockchainDB::pop_block(blk, txs);
+    // lowered before the commit, so no reader sees a height whose top
+    // block is already gone
+    --m_height;
     if (! m_batch_active)
     {
       m_write_txn = NULL;
+      m_writer = std::thread::id();
 
       txn.commit();
     }
@@ -1804,11 +2165,11 @@ void BlockchainLMDB::pop_block(block& blk, std::vector<transaction>& txs)
   catch (...)
   {
     m_num_outputs = num_outputs;
+    m_height = height;
     m_write_txn = NULL;
+    m_writer = std::thread::id();
     throw;
   }
-
-  --m_height;
 }
 
 }  // namespace cryptonote
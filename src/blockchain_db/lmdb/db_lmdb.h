@@ -29,11 +29,27 @@
 #include "blockchain_db/blockchain_db.h"
 #include "cryptonote_protocol/blobdatatype.h" // for type blobdata
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/tss.hpp>
+
 #include <lmdb.h>
 
 namespace cryptonote
 {
 
+// a write ran out of room in the memory map; the map can be grown and the
+// write retried
+class DB_MAP_FULL : public DB_ERROR
+{
+  public:
+    DB_MAP_FULL() : DB_ERROR("LMDB memory map is full") { }
+    DB_MAP_FULL(const char* s) : DB_ERROR(s) { }
+};
+
 struct mdb_txn_safe
 {
   mdb_txn_safe() : m_txn(NULL) { }
@@ -67,10 +83,12 @@ struct mdb_txn_safe
       message = "Failed to commit a transaction to the db";
     }
 
-    if (mdb_txn_commit(m_txn))
+    if (auto result = mdb_txn_commit(m_txn))
     {
       m_txn = NULL;
       LOG_PRINT_L0(message);
+      if (result == MDB_MAP_FULL)
+        throw DB_MAP_FULL(message.c_str());
       throw DB_ERROR(message.c_str());
     }
     m_txn = NULL;
@@ -108,9 +126,47 @@ struct mdb_txn_safe
   bool m_batch_txn = false;
 };
 
+class BlockchainLMDB;
+
+// A thread's reusable read-only transaction. LMDB gives each thread a reader
+// slot of its own, so instead of beginning and aborting a transaction for
+// every lookup the txn is kept around, reset when idle and renewed when the
+// next lookup on that thread comes in.
+struct mdb_threadinfo
+{
+  mdb_threadinfo() : m_ti_rtxn(NULL), m_ti_depth(0) { }
+  ~mdb_threadinfo();
+
+  MDB_txn* m_ti_rtxn;
+  unsigned int m_ti_depth; // nested lookups sharing the renewed txn
+  std::weak_ptr<bool> m_ti_env; // expires when the environment is closed
+};
+
+// Read access for the duration of one lookup. The thread holding the write
+// txn reads through it, so lookups made while a block is being added (or a
+// batch is in progress) see the pending changes; every other thread gets its
+// own read-only snapshot and never waits on the writer.
+class mdb_read_txn
+{
+public:
+  mdb_read_txn(const BlockchainLMDB& db);
+  ~mdb_read_txn();
+
+  operator MDB_txn*() { return m_txn; }
+
+private:
+  mdb_read_txn(const mdb_read_txn&);
+  mdb_read_txn& operator=(const mdb_read_txn&);
+
+  MDB_txn* m_txn;
+  mdb_threadinfo* m_tinfo; // NULL if borrowing the write txn
+  boost::shared_mutex* m_resize_lock; // held shared while m_tinfo's txn is renewed
+};
 
 class BlockchainLMDB : public BlockchainDB
 {
+  friend class mdb_read_txn;
+
 public:
   BlockchainLMDB(bool batch_transactions=false);
   ~BlockchainLMDB();
@@ -159,6 +215,25 @@ public:
 
   virtual std::vector<crypto::hash> get_hashes_range(const uint64_t& h1, const uint64_t& h2) const;
 
+  typedef std::function<bool(uint64_t height, const blobdata& block_blob, const std::vector<blobdata>& tx_blobs,
+      size_t block_size, difficulty_type cumulative_difficulty, uint64_t coins_generated)> raw_block_visitor;
+
+  /**
+   * @brief visit the stored blobs of a range of blocks
+   *
+   * Walks the block tables with cursors inside one read transaction and
+   * hands f each block's blob, the blobs of its transactions other than the
+   * miner tx, and the block's stored metadata, without parsing anything
+   * but the block.  Stops early if f returns false.
+   *
+   * @param h1 the height of the first block
+   * @param h2 the height of the last block
+   * @param f the visitor
+   *
+   * @return false if f stopped the walk, true otherwise
+   */
+  bool for_blocks_range(const uint64_t& h1, const uint64_t& h2, const raw_block_visitor& f) const;
+
   virtual crypto::hash top_block_hash() const;
 
   virtual block get_top_block() const;
@@ -183,6 +258,8 @@ public:
 
   virtual crypto::public_key get_output_key(const uint64_t& amount, const uint64_t& index) const;
 
+  virtual void get_output_keys(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<crypto::public_key>& keys) const;
+
   virtual tx_out get_output(const crypto::hash& h, const uint64_t& index) const;
 
   /**
@@ -200,6 +277,8 @@ public:
 
   virtual tx_out_index get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const;
 
+  virtual void get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<tx_out_index>& indices) const;
+
   virtual std::vector<uint64_t> get_tx_output_indices(const crypto::hash& h) const;
   virtual std::vector<uint64_t> get_tx_amount_output_indices(const crypto::hash& h) const;
 
@@ -213,14 +292,101 @@ public:
                             );
 
   virtual void set_batch_transactions(bool batch_transactions);
-  virtual void batch_start();
+  virtual void batch_start(uint64_t batch_num_blocks = 0);
   virtual void batch_commit();
   virtual void batch_stop();
   virtual void batch_abort();
 
   virtual void pop_block(block& blk, std::vector<transaction>& txs);
 
+  /**
+   * @brief set how much the memory map grows by when it runs low
+   *
+   * @param increment size in bytes, rounded up to a whole page when used
+   */
+  void set_map_resize_increment(uint64_t increment);
+
+  /**
+   * @brief get the current size of the memory map, in bytes
+   */
+  uint64_t get_map_size() const;
+
+  /**
+   * @brief get how much of the memory map is in use, in bytes
+   */
+  uint64_t get_map_used() const;
+
+  /**
+   * @brief get how many times the memory map has been grown since open()
+   */
+  uint64_t get_map_resize_count() const;
+
+  /**
+   * @brief get how many writes ran out of room in the memory map and were
+   * retried after growing it, since open()
+   */
+  uint64_t get_map_full_retry_count() const;
+
+  /**
+   * @brief set the size the memory map starts at, before open()
+   *
+   * An existing db that is larger keeps its own size.
+   *
+   * @param size size in bytes
+   */
+  void set_initial_map_size(uint64_t size);
+
 private:
+  /**
+   * @brief check whether the memory map is close to full
+   *
+   * @param threshold_size free space wanted for the next write; 0 means
+   * the resize increment
+   *
+   * @return true if less than threshold_size is left
+   */
+  bool need_resize(uint64_t threshold_size = 0) const;
+
+  /**
+   * @brief grow the memory map
+   *
+   * Waits for read txns on other threads to finish, and must not be called
+   * while a write txn is open.
+   *
+   * @param increase_size bytes to grow by; 0 means the resize increment
+   */
+  void do_resize(uint64_t increase_size = 0);
+
+  /**
+   * @brief start a new batch txn
+   */
+  void begin_batch_txn();
+
+  /**
+   * @brief estimate how much of the map adding some blocks will take
+   *
+   * Based on the sizes of the most recent blocks.
+   *
+   * @param batch_num_blocks the number of blocks to be added
+   *
+   * @return the estimated size in bytes
+   */
+  uint64_t get_estimated_batch_size(uint64_t batch_num_blocks) const;
+
+  /**
+   * @brief grow the map, if needed, to fit the next batch txn
+   *
+   * Must be called with no write txn open.
+   */
+  void check_and_resize_for_batch();
+
+  void add_block_txn( const block& blk
+                    , const size_t& block_size
+                    , const difficulty_type& cumulative_difficulty
+                    , const uint64_t& coins_generated
+                    , const std::vector<transaction>& txs
+                    );
+
   virtual void add_block( const block& blk
                 , const size_t& block_size
                 , const difficulty_type& cumulative_difficulty
@@ -275,6 +441,18 @@ private:
    */
   uint64_t get_output_global_index(const uint64_t& amount, const uint64_t& index) const;
 
+  /**
+   * @brief get the global indices of several outputs of the same amount
+   *
+   * The offsets are visited in ascending order, so the outputs of <amount>
+   * are walked once however many are asked for.
+   *
+   * @param amount the output amount
+   * @param offsets indices into the set of outputs of that amount
+   * @param global_indices filled with the global index for each offset, in order
+   */
+  void get_output_global_indices(const uint64_t& amount, const std::vector<uint64_t>& offsets, std::vector<uint64_t>& global_indices) const;
+
   void check_open() const;
 
   MDB_env* m_env;
@@ -301,14 +479,33 @@ private:
 
   MDB_dbi m_spent_keys;
 
-  uint64_t m_height;
+  std::atomic<uint64_t> m_height;
   uint64_t m_num_outputs;
   std::string m_folder;
   mdb_txn_safe* m_write_txn; // may point to either a short-lived txn or a batch txn
   mdb_txn_safe m_write_batch_txn; // persist batch txn outside of BlockchainLMDB
+  std::atomic<std::thread::id> m_writer; // thread m_write_txn belongs to
+
+  mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
+  std::shared_ptr<bool> m_env_open; // outstanding read txns check this before touching m_env
+  mutable boost::shared_mutex m_resize_lock; // held shared by every read txn, exclusively to resize
+
+  uint64_t m_initial_map_size;
+  uint64_t m_map_resize_increment;
+  uint64_t m_map_resize_count;
+  uint64_t m_map_full_retry_count;
+
+  // how many blocks the map was grown for at the start of the batch txn,
+  // and how many the batch txn has added
+  uint64_t m_batch_num_blocks;
+  uint64_t m_batch_blocks_added;
+  // the chain's height and output count when the batch txn began, for
+  // batch_abort()
+  uint64_t m_batch_start_height;
+  uint64_t m_batch_start_num_outputs;
 
   bool m_batch_transactions; // support for batch transactions
-  bool m_batch_active; // whether batch transaction is in progress
+  std::atomic<bool> m_batch_active; // whether batch transaction is in progress
 };
 
 }  // namespace cryptonote
@@ -0,0 +1,157 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "misc_log_ex.h"
+#include "thread_pool.h"
+
+namespace tools
+{
+  //------------------------------------------------------------------
+  void thread_pool::waiter::inc()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    ++m_pending;
+  }
+  //------------------------------------------------------------------
+  void thread_pool::waiter::dec()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    if (--m_pending == 0)
+      m_cond.notify_all();
+  }
+  //------------------------------------------------------------------
+  thread_pool::thread_pool(unsigned int max_threads): m_running(false)
+  {
+    start(max_threads);
+  }
+  //------------------------------------------------------------------
+  thread_pool::~thread_pool()
+  {
+    stop();
+  }
+  //------------------------------------------------------------------
+  void thread_pool::start(unsigned int max_threads)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    m_running = true;
+    for (unsigned int i = 0; i < max_threads; ++i)
+      m_threads.push_back(new boost::thread(&thread_pool::run, this));
+  }
+  //------------------------------------------------------------------
+  void thread_pool::stop()
+  {
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      m_running = false;
+      m_has_work.notify_all();
+    }
+    for (boost::thread* t : m_threads)
+    {
+      t->join();
+      delete t;
+    }
+    m_threads.clear();
+  }
+  //------------------------------------------------------------------
+  void thread_pool::resize(unsigned int max_threads)
+  {
+    stop();
+    start(max_threads);
+  }
+  //------------------------------------------------------------------
+  unsigned int thread_pool::get_max_concurrency() const
+  {
+    return m_threads.size() + 1;
+  }
+  //------------------------------------------------------------------
+  void thread_pool::submit(waiter* w, const std::function<void()>& job)
+  {
+    if (w)
+      w->inc();
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    m_queue.push_back({w, job});
+    m_has_work.notify_one();
+  }
+  //------------------------------------------------------------------
+  // Pops and runs the next queued job with m_mutex released.  Returns
+  // false if the queue was empty.
+  bool thread_pool::run_one(boost::unique_lock<boost::mutex>& lock)
+  {
+    if (m_queue.empty())
+      return false;
+    entry e = m_queue.front();
+    m_queue.pop_front();
+    lock.unlock();
+    try
+    {
+      e.job();
+    }
+    catch (const std::exception& ex)
+    {
+      LOG_ERROR("Exception in thread pool job: " << ex.what());
+    }
+    catch (...)
+    {
+      LOG_ERROR("Unknown exception in thread pool job");
+    }
+    if (e.w)
+      e.w->dec();
+    lock.lock();
+    return true;
+  }
+  //------------------------------------------------------------------
+  void thread_pool::run()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (true)
+    {
+      if (run_one(lock))
+        continue;
+      if (!m_running)
+        break;
+      m_has_work.wait(lock);
+    }
+  }
+  //------------------------------------------------------------------
+  void thread_pool::wait(waiter& w)
+  {
+    // help out with whatever is queued, then sleep on the stragglers
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      while (run_one(lock))
+      {
+        boost::unique_lock<boost::mutex> wlock(w.m_mutex);
+        if (w.m_pending == 0)
+          return;
+      }
+    }
+    boost::unique_lock<boost::mutex> lock(w.m_mutex);
+    while (w.m_pending)
+      w.m_cond.wait(lock);
+  }
+}
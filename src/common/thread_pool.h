@@ -0,0 +1,114 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace tools
+{
+  /*! \brief A fixed-size pool of worker threads for CPU bound jobs
+   *
+   * \details Jobs are grouped by a waiter, which lets the submitting thread
+   * block until every job it queued has run.  While waiting, the submitting
+   * thread drains the queue itself, so a pool with no worker threads simply
+   * runs everything inline on the caller.
+   */
+  class thread_pool
+  {
+  public:
+    /*! \brief Counts the outstanding jobs of one batch */
+    class waiter
+    {
+    public:
+      waiter(): m_pending(0) {}
+
+    private:
+      friend class thread_pool;
+
+      void inc();
+      void dec();
+
+      boost::mutex m_mutex;
+      boost::condition_variable m_cond;
+      size_t m_pending;
+    };
+
+    /*! \brief creates a pool with the given number of threads
+     *
+     * \param max_threads worker threads to spawn, 0 for none
+     */
+    explicit thread_pool(unsigned int max_threads = 0);
+    ~thread_pool();
+
+    /*! \brief queues a job to be run by the pool
+     *
+     * \param w the waiter tracking the batch this job belongs to, or NULL
+     * \param job the work to run
+     */
+    void submit(waiter* w, const std::function<void()>& job);
+
+    /*! \brief blocks until every job submitted against the waiter has run
+     *
+     * Must not be called from a job running on this pool.
+     */
+    void wait(waiter& w);
+
+    /*! \brief stops the current workers and spawns a new set
+     *
+     * Must not be called while jobs are outstanding.
+     */
+    void resize(unsigned int max_threads);
+
+    /*! \brief the number of threads that run jobs, including the waiting caller */
+    unsigned int get_max_concurrency() const;
+
+  private:
+    struct entry
+    {
+      waiter* w;
+      std::function<void()> job;
+    };
+
+    void start(unsigned int max_threads);
+    void stop();
+    bool run_one(boost::unique_lock<boost::mutex>& lock);
+    void run();
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_has_work;
+    std::deque<entry> m_queue;
+    std::vector<boost::thread*> m_threads;
+    bool m_running;
+  };
+}
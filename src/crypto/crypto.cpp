@@ -33,8 +33,11 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <list>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "common/varint.h"
 #include "warnings.h"
@@ -164,6 +167,58 @@ namespace crypto {
     hash_to_scalar(&buf, end - reinterpret_cast<char *>(&buf), res);
   }
 
+  /* derivation_to_scalar for the outputs first_index .. first_index + count - 1,
+   * hashing them side by side.
+   */
+  static void derivations_to_scalars(const key_derivation &derivation, size_t first_index, size_t count, ec_scalar *res) {
+    struct derivation_buf {
+      key_derivation derivation;
+      char output_index[(sizeof(size_t) * 8 + 6) / 7];
+    };
+    std::vector<derivation_buf> bufs(count);
+    std::vector<const void *> data(count);
+    std::vector<size_t> lengths(count);
+    std::vector<char *> hashes(count);
+    size_t i;
+    for (i = 0; i < count; i++) {
+      char *end = bufs[i].output_index;
+      bufs[i].derivation = derivation;
+      tools::write_varint(end, first_index + i);
+      assert(end <= bufs[i].output_index + sizeof bufs[i].output_index);
+      data[i] = std::addressof(bufs[i]);
+      lengths[i] = end - reinterpret_cast<char *>(std::addressof(bufs[i]));
+      hashes[i] = reinterpret_cast<char *>(std::addressof(res[i]));
+    }
+    cn_fast_hash_multi(data.data(), lengths.data(), count, hashes.data());
+    for (i = 0; i < count; i++) {
+      sc_reduce32(&res[i]);
+    }
+  }
+
+  bool crypto_ops::derive_public_keys(const key_derivation &derivation, size_t first_index, size_t count,
+    const public_key &base, public_key *derived_keys) {
+    ge_p3 point1;
+    ge_p3 point2;
+    ge_cached point3;
+    ge_p1p1 point4;
+    size_t i;
+    if (ge_frombytes_vartime(&point1, &base) != 0) {
+      return false;
+    }
+    std::vector<ec_scalar> scalars(count);
+    std::vector<ge_p2> points(count);
+    std::unique_ptr<fe[]> tmp(new fe[count]);
+    derivations_to_scalars(derivation, first_index, count, scalars.data());
+    for (i = 0; i < count; i++) {
+      ge_scalarmult_base(&point2, &scalars[i]);
+      ge_p3_to_cached(&point3, &point2);
+      ge_add(&point4, &point1, &point3);
+      ge_p1p1_to_p2(&points[i], &point4);
+    }
+    ge_tobytes_batch(reinterpret_cast<unsigned char *>(derived_keys), points.data(), count, tmp.get());
+    return true;
+  }
+
   bool crypto_ops::derive_public_key(const key_derivation &derivation, size_t output_index,
     const public_key &base, public_key &derived_key) {
     ec_scalar scalar;
@@ -338,43 +393,156 @@ POP_WARNINGS
     sc_mulsub(&sig[sec_index].r, &sig[sec_index].c, &sec, &k);
   }
 
+  /* A ring member's key and its hash_to_ec, precomputed for the double
+   * scalar multiplications of check_ring_signatures.
+   */
+  struct ring_member_precomp {
+    ge_dsmp pub;
+    ge_dsmp pub_hash;
+  };
+
+  /* The most recently used ring members, since popular outputs keep
+   * appearing in new rings. About 2.5 kB per entry.
+   */
+  class ring_member_cache {
+  public:
+    ring_member_cache() : max_size(4096) { }
+
+    bool get(const public_key &pub, ring_member_precomp &res) {
+      lock_guard<mutex> lock(cache_lock);
+      auto it = entries.find(pub);
+      if (it == entries.end()) {
+        return false;
+      }
+      lru.splice(lru.begin(), lru, it->second.lru_pos);
+      res = it->second.precomp;
+      return true;
+    }
+
+    void add(const public_key &pub, const ring_member_precomp &precomp) {
+      lock_guard<mutex> lock(cache_lock);
+      if (max_size == 0 || entries.find(pub) != entries.end()) {
+        return;
+      }
+      if (entries.size() >= max_size) {
+        entries.erase(lru.back());
+        lru.pop_back();
+      }
+      lru.push_front(pub);
+      entry &e = entries[pub];
+      e.precomp = precomp;
+      e.lru_pos = lru.begin();
+    }
+
+    void set_max_size(size_t size) {
+      lock_guard<mutex> lock(cache_lock);
+      max_size = size;
+      while (entries.size() > max_size) {
+        entries.erase(lru.back());
+        lru.pop_back();
+      }
+    }
+
+  private:
+    struct entry {
+      ring_member_precomp precomp;
+      std::list<public_key>::iterator lru_pos;
+    };
+
+    mutex cache_lock;
+    size_t max_size;
+    std::list<public_key> lru; // most recently used first
+    std::unordered_map<public_key, entry> entries;
+  };
+
+  static ring_member_cache ring_members;
+
+  void set_ring_member_cache_size(size_t size) {
+    ring_members.set_max_size(size);
+  }
+
+  static bool get_ring_member_precomp(const public_key &pub, ring_member_precomp &res) {
+    if (ring_members.get(pub, res)) {
+      return true;
+    }
+    ge_p3 point;
+    if (ge_frombytes_vartime(&point, &pub) != 0) {
+      return false;
+    }
+    ge_dsm_precomp(res.pub, &point);
+    hash_to_ec(pub, point);
+    ge_dsm_precomp(res.pub_hash, &point);
+    ring_members.add(pub, res);
+    return true;
+  }
+
   bool crypto_ops::check_ring_signature(const hash &prefix_hash, const key_image &image,
     const public_key *const *pubs, size_t pubs_count,
     const signature *sig) {
-    size_t i;
-    ge_p3 image_unp;
-    ge_dsmp image_pre;
-    ec_scalar sum, h;
-    rs_comm *const buf = reinterpret_cast<rs_comm *>(alloca(rs_comm_size(pubs_count)));
-#if !defined(NDEBUG)
-    for (i = 0; i < pubs_count; i++) {
-      assert(check_key(*pubs[i]));
+    ring_signature_ref ref = {&prefix_hash, std::addressof(image), pubs, pubs_count, sig};
+    size_t failed_index;
+    return check_ring_signatures(&ref, 1, failed_index);
+  }
+
+  bool crypto_ops::check_ring_signatures(const ring_signature_ref *sigs, size_t count, size_t &failed_index) {
+    size_t i, j, k, points_count = 0;
+    ring_member_precomp member;
+    for (j = 0; j < count; j++) {
+      points_count += 2 * sigs[j].pubs_count;
     }
+    // all a and b points, turned into bytes together to share a single field inversion
+    std::vector<ge_p2> points(points_count);
+    std::unique_ptr<fe[]> tmp(new fe[points_count]);
+    std::vector<ec_point> points_bytes(points_count);
+    k = 0;
+    for (j = 0; j < count; j++) {
+      const ring_signature_ref &ref = sigs[j];
+      ge_p3 image_unp;
+      ge_dsmp image_pre;
+#if !defined(NDEBUG)
+      for (i = 0; i < ref.pubs_count; i++) {
+        assert(check_key(*ref.pubs[i]));
+      }
 #endif
-    if (ge_frombytes_vartime(&image_unp, &image) != 0) {
-      return false;
-    }
-    ge_dsm_precomp(image_pre, &image_unp);
-    sc_0(&sum);
-    buf->h = prefix_hash;
-    for (i = 0; i < pubs_count; i++) {
-      ge_p2 tmp2;
-      ge_p3 tmp3;
-      if (sc_check(&sig[i].c) != 0 || sc_check(&sig[i].r) != 0) {
+      if (ge_frombytes_vartime(&image_unp, &*ref.image) != 0) {
+        failed_index = j;
         return false;
       }
-      if (ge_frombytes_vartime(&tmp3, &*pubs[i]) != 0) {
-        abort();
+      ge_dsm_precomp(image_pre, &image_unp);
+      for (i = 0; i < ref.pubs_count; i++) {
+        if (sc_check(&ref.sig[i].c) != 0 || sc_check(&ref.sig[i].r) != 0) {
+          failed_index = j;
+          return false;
+        }
+        if (!get_ring_member_precomp(*ref.pubs[i], member)) {
+          abort();
+        }
+        ge_double_scalarmult_base_precomp_vartime(&points[k++], &ref.sig[i].c, member.pub, &ref.sig[i].r);
+        ge_double_scalarmult_precomp2_vartime(&points[k++], &ref.sig[i].r, member.pub_hash, &ref.sig[i].c, image_pre);
       }
-      ge_double_scalarmult_base_vartime(&tmp2, &sig[i].c, &tmp3, &sig[i].r);
-      ge_tobytes(&buf->ab[i].a, &tmp2);
-      hash_to_ec(*pubs[i], tmp3);
-      ge_double_scalarmult_precomp_vartime(&tmp2, &sig[i].r, &tmp3, &sig[i].c, image_pre);
-      ge_tobytes(&buf->ab[i].b, &tmp2);
-      sc_add(&sum, &sum, &sig[i].c);
     }
-    hash_to_scalar(buf, rs_comm_size(pubs_count), h);
-    sc_sub(&h, &h, &sum);
-    return sc_isnonzero(&h) == 0;
+    ge_tobytes_batch(reinterpret_cast<unsigned char *>(points_bytes.data()), points.data(), points_count, tmp.get());
+    std::vector<char> comm;
+    k = 0;
+    for (j = 0; j < count; j++) {
+      const ring_signature_ref &ref = sigs[j];
+      ec_scalar sum, h;
+      comm.resize(rs_comm_size(ref.pubs_count));
+      rs_comm *const buf = reinterpret_cast<rs_comm *>(comm.data());
+      sc_0(&sum);
+      buf->h = *ref.prefix_hash;
+      for (i = 0; i < ref.pubs_count; i++) {
+        buf->ab[i].a = points_bytes[k++];
+        buf->ab[i].b = points_bytes[k++];
+        sc_add(&sum, &sum, &ref.sig[i].c);
+      }
+      hash_to_scalar(buf, rs_comm_size(ref.pubs_count), h);
+      sc_sub(&h, &h, &sum);
+      if (sc_isnonzero(&h) != 0) {
+        failed_index = j;
+        return false;
+      }
+    }
+    return true;
   }
 }
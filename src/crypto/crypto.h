@@ -82,6 +82,16 @@ namespace crypto {
     sizeof(key_derivation) == 32 && sizeof(key_image) == 32 &&
     sizeof(signature) == 64, "Invalid structure size");
 
+  /* A ring signature and what it signs, for check_ring_signatures.
+   */
+  struct ring_signature_ref {
+    const hash *prefix_hash;
+    const key_image *image;
+    const public_key *const *pubs;
+    std::size_t pubs_count;
+    const signature *sig;
+  };
+
   class crypto_ops {
     crypto_ops();
     crypto_ops(const crypto_ops &);
@@ -98,6 +108,8 @@ namespace crypto {
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
+    static bool derive_public_keys(const key_derivation &, std::size_t, std::size_t, const public_key &, public_key *);
+    friend bool derive_public_keys(const key_derivation &, std::size_t, std::size_t, const public_key &, public_key *);
     static void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
@@ -114,6 +126,8 @@ namespace crypto {
       const public_key *const *, std::size_t, const signature *);
     friend bool check_ring_signature(const hash &, const key_image &,
       const public_key *const *, std::size_t, const signature *);
+    static bool check_ring_signatures(const ring_signature_ref *, std::size_t, std::size_t &);
+    friend bool check_ring_signatures(const ring_signature_ref *, std::size_t, std::size_t &);
   };
 
   /* Generate a value filled with random bytes.
@@ -157,6 +171,13 @@ namespace crypto {
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
   }
+  /* Same as derive_public_key for the count outputs first_index, first_index + 1, ...,
+   * which is cheaper than deriving them one at a time.
+   */
+  inline bool derive_public_keys(const key_derivation &derivation, std::size_t first_index, std::size_t count,
+    const public_key &base, public_key *derived_keys) {
+    return crypto_ops::derive_public_keys(derivation, first_index, count, base, derived_keys);
+  }
   inline void derive_secret_key(const key_derivation &derivation, std::size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     crypto_ops::derive_secret_key(derivation, output_index, base, derived_key);
@@ -192,6 +213,20 @@ namespace crypto {
     return crypto_ops::check_ring_signature(prefix_hash, image, pubs, pubs_count, sig);
   }
 
+  /* Checks several ring signatures (e.g. all the inputs of a transaction) in
+   * one go, which is cheaper than checking them one by one. Returns true if
+   * all are valid; otherwise sets failed_index to the position of one that isn't.
+   */
+  inline bool check_ring_signatures(const ring_signature_ref *sigs, std::size_t count, std::size_t &failed_index) {
+    return crypto_ops::check_ring_signatures(sigs, count, failed_index);
+  }
+
+  /* The ring members (output keys) last used in ring signature checks are
+   * kept decompressed and precomputed, since popular outputs appear in many
+   * rings. Sets how many are kept; 0 disables this.
+   */
+  void set_ring_member_cache_size(std::size_t size);
+
   /* Variants with vector<const public_key *> parameters.
    */
   inline void generate_ring_signature(const hash &prefix_hash, const key_image &image,
@@ -207,6 +242,6 @@ namespace crypto {
   }
 }
 
-CRYPTO_MAKE_COMPARABLE(public_key)
+CRYPTO_MAKE_HASHABLE(public_key)
 CRYPTO_MAKE_HASHABLE(key_image)
 CRYPTO_MAKE_COMPARABLE(signature)
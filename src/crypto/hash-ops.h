@@ -75,11 +75,18 @@ void hash_process(union hash_state *state, const uint8_t *buf, size_t count);
 
 enum {
   HASH_SIZE = 32,
-  HASH_DATA_AREA = 136
+  HASH_DATA_AREA = 136,
+  CN_SLOW_HASH_MAX_WAYS = 3
 };
 
 void cn_fast_hash(const void *data, size_t length, char *hash);
+void cn_fast_hash_multi(const void *const *data, const size_t *length, size_t count, char *const *hash);
 void cn_slow_hash(const void *data, size_t length, char *hash);
+void cn_slow_hash_multi(const void *const *data, const size_t *length, size_t count, char *const *hash);
+void slow_hash_allocate_state(void);
+void slow_hash_allocate_state_multi(size_t ways);
+void slow_hash_free_state(void);
+void slow_hash_set_huge_pages(int enable);
 
 void hash_extra_blake(const void *data, size_t length, char *hash);
 void hash_extra_groestl(const void *data, size_t length, char *hash);
@@ -5,6 +5,12 @@
 #include "hash-ops.h"
 #include "keccak.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// four states at once with AVX2, picked at run time
+#include <immintrin.h>
+#define KECCAK_MULTI_AVX2
+#endif
+
 const uint64_t keccakf_rndc[24] = 
 {
     0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
@@ -110,3 +116,149 @@ void keccak1600(const uint8_t *in, int inlen, uint8_t *md)
 {
     keccak(in, inlen, md, sizeof(state_t));
 }
+
+#ifdef KECCAK_MULTI_AVX2
+
+#define ROTL64X4(x, y) _mm256_or_si256(_mm256_slli_epi64((x), (y)), _mm256_srli_epi64((x), 64 - (y)))
+
+// keccakf on four states at once, lane k of st[i] being word i of state k
+
+__attribute__((target("avx2")))
+static void keccakf_x4(uint64_t st[25][KECCAK_MULTI_WAYS], int rounds)
+{
+    int i, j, round;
+    __m256i s[25], t, bc[5];
+
+    for (i = 0; i < 25; i++)
+        s[i] = _mm256_loadu_si256((const __m256i *) st[i]);
+
+    for (round = 0; round < rounds; round++) {
+
+        // Theta
+        for (i = 0; i < 5; i++)
+            bc[i] = _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(s[i], s[i + 5]),
+                _mm256_xor_si256(s[i + 10], s[i + 15])), s[i + 20]);
+
+        for (i = 0; i < 5; i++) {
+            t = _mm256_xor_si256(bc[(i + 4) % 5], ROTL64X4(bc[(i + 1) % 5], 1));
+            for (j = 0; j < 25; j += 5)
+                s[j + i] = _mm256_xor_si256(s[j + i], t);
+        }
+
+        // Rho Pi
+        t = s[1];
+        for (i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            bc[0] = s[j];
+            s[j] = ROTL64X4(t, keccakf_rotc[i]);
+            t = bc[0];
+        }
+
+        //  Chi
+        for (j = 0; j < 25; j += 5) {
+            for (i = 0; i < 5; i++)
+                bc[i] = s[j + i];
+            for (i = 0; i < 5; i++)
+                s[j + i] = _mm256_xor_si256(s[j + i], _mm256_andnot_si256(bc[(i + 1) % 5], bc[(i + 2) % 5]));
+        }
+
+        //  Iota
+        s[0] = _mm256_xor_si256(s[0], _mm256_set1_epi64x(keccakf_rndc[round]));
+    }
+
+    for (i = 0; i < 25; i++)
+        _mm256_storeu_si256((__m256i *) st[i], s[i]);
+}
+
+static int keccakf_x4_supported(void)
+{
+    static int supported = -1;
+
+    if (supported < 0) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+    return supported;
+}
+
+// Each of the KECCAK_MULTI_WAYS lanes takes the next message as soon as it
+// is done with its previous one, so messages of different lengths keep all
+// lanes busy.
+
+static void keccak1600_x4(const uint8_t *const *in, const size_t *inlen, size_t count, uint8_t *const *md, size_t mdlen)
+{
+    uint64_t st[25][KECCAK_MULTI_WAYS];
+    state_t out;
+    uint64_t w[HASH_DATA_AREA / 8];
+    uint8_t temp[HASH_DATA_AREA];
+    size_t msg[KECCAK_MULTI_WAYS], done[KECCAK_MULTI_WAYS];
+    int active[KECCAK_MULTI_WAYS], last[KECCAK_MULTI_WAYS];
+    size_t next = 0, k, i, rest;
+    int busy;
+
+    memset(active, 0, sizeof(active));
+    for (;;) {
+        busy = 0;
+        for (k = 0; k < KECCAK_MULTI_WAYS; k++) {
+            if (!active[k] && next < count) {
+                active[k] = 1;
+                msg[k] = next++;
+                done[k] = 0;
+                for (i = 0; i < 25; i++)
+                    st[i][k] = 0;
+            }
+            if (!active[k])
+                continue;
+            busy = 1;
+
+            // absorb a full block, or the last one with its padding
+            rest = inlen[msg[k]] - done[k];
+            if (rest >= HASH_DATA_AREA) {
+                memcpy(w, in[msg[k]] + done[k], HASH_DATA_AREA);
+                done[k] += HASH_DATA_AREA;
+                last[k] = 0;
+            } else {
+                memcpy(temp, in[msg[k]] + done[k], rest);
+                temp[rest++] = 1;
+                memset(temp + rest, 0, HASH_DATA_AREA - rest);
+                temp[HASH_DATA_AREA - 1] |= 0x80;
+                memcpy(w, temp, HASH_DATA_AREA);
+                last[k] = 1;
+            }
+            for (i = 0; i < HASH_DATA_AREA / 8; i++)
+                st[i][k] ^= w[i];
+        }
+        if (!busy)
+            break;
+
+        keccakf_x4(st, KECCAK_ROUNDS);
+
+        for (k = 0; k < KECCAK_MULTI_WAYS; k++) {
+            if (!active[k] || !last[k])
+                continue;
+            for (i = 0; i < 25; i++)
+                out[i] = st[i][k];
+            memcpy(md[msg[k]], out, mdlen);
+            active[k] = 0;
+        }
+    }
+}
+
+#endif
+
+void keccak1600_multi(const uint8_t *const *in, const size_t *inlen, size_t count, uint8_t *const *md, size_t mdlen)
+{
+    state_t st;
+    size_t i;
+
+#ifdef KECCAK_MULTI_AVX2
+    if (count > 1 && keccakf_x4_supported()) {
+        keccak1600_x4(in, inlen, count, md, mdlen);
+        return;
+    }
+#endif
+    for (i = 0; i < count; i++) {
+        keccak(in[i], inlen[i], (uint8_t *) st, sizeof(state_t));
+        memcpy(md[i], st, mdlen);
+    }
+}
@@ -23,4 +23,12 @@ void keccakf(uint64_t st[25], int norounds);
 
 void keccak1600(const uint8_t *in, int inlen, uint8_t *md);
 
+// number of messages keccak1600_multi hashes side by side
+#define KECCAK_MULTI_WAYS 4
+
+// keccak1600 of count messages in[i], inlen[i] bytes long, copying the first
+// mdlen bytes of each state to md[i]; with AVX2 several messages are hashed
+// side by side. md[i] must not overlap any in[j].
+void keccak1600_multi(const uint8_t *const *in, const size_t *inlen, size_t count, uint8_t *const *md, size_t mdlen);
+
 #endif
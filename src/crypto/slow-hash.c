@@ -154,6 +154,8 @@ union cn_slow_hash_state
 
 THREADV uint8_t *hp_state = NULL;
 THREADV int hp_allocated = 0;
+THREADV size_t hp_ways = 0;
+static int hp_huge_pages = 1;
 
 #if defined(_MSC_VER)
 #define cpuid(info,x)    __cpuidex(info,x,0)
@@ -413,31 +415,52 @@ BOOL SetLockPagesPrivilege(HANDLE hProcess, BOOL bEnable)
 
 void slow_hash_allocate_state(void)
 {
-    int state = 0;
-    if(hp_state != NULL)
+    slow_hash_allocate_state_multi(1);
+}
+
+/**
+ * @brief allocate one 2MB scratch buffer per lane for cn_slow_hash_multi
+ *
+ * The buffers are allocated back to back in hp_state, lane n using the
+ * 2MB starting at hp_state + n * MEMORY, so cn_slow_hash keeps using the
+ * first one.  An existing allocation with at least <ways> buffers is kept.
+ *
+ * @param ways the number of scratch buffers needed
+ */
+
+void slow_hash_allocate_state_multi(size_t ways)
+{
+    size_t size = ways * MEMORY;
+    if(hp_state != NULL && hp_ways >= ways)
         return;
 
+    slow_hash_free_state();
+
+    if(hp_huge_pages)
+    {
 #if defined(_MSC_VER) || defined(__MINGW32__)
-    SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
-    hp_state = (uint8_t *) VirtualAlloc(hp_state, MEMORY, MEM_LARGE_PAGES |
-                                        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        SetLockPagesPrivilege(GetCurrentProcess(), TRUE);
+        hp_state = (uint8_t *) VirtualAlloc(hp_state, size, MEM_LARGE_PAGES |
+                                            MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 #else
 #if defined(__APPLE__) || defined(__FreeBSD__)
-    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
-                    MAP_PRIVATE | MAP_ANON, 0, 0);    
+        hp_state = mmap(0, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANON, 0, 0);    
 #else
-    hp_state = mmap(0, MEMORY, PROT_READ | PROT_WRITE,
-                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 0, 0);
+        hp_state = mmap(0, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 0, 0);
 #endif
-    if(hp_state == MAP_FAILED)
-        hp_state = NULL;
+        if(hp_state == MAP_FAILED)
+            hp_state = NULL;
 #endif
+    }
     hp_allocated = 1;
     if(hp_state == NULL)
     {
         hp_allocated = 0;
-        hp_state = (uint8_t *) malloc(MEMORY);
+        hp_state = (uint8_t *) malloc(size);
     }
+    hp_ways = ways;
 }
 
 /**
@@ -454,14 +477,30 @@ void slow_hash_free_state(void)
     else
     {
 #if defined(_MSC_VER) || defined(__MINGW32__)
-        VirtualFree(hp_state, MEMORY, MEM_RELEASE);
+        VirtualFree(hp_state, 0, MEM_RELEASE);
 #else
-        munmap(hp_state, MEMORY);
+        munmap(hp_state, hp_ways * MEMORY);
 #endif
     }
 
     hp_state = NULL;
     hp_allocated = 0;
+    hp_ways = 0;
+}
+
+/**
+ * @brief enables or disables huge page backed scratch buffers
+ *
+ * Huge pages are tried by default.  The setting is process-wide, for the
+ * buffers of every thread, and applies to buffers allocated afterwards, so it
+ * should be made before the hashing threads start.
+ *
+ * @param enable zero to always use the regular heap
+ */
+
+void slow_hash_set_huge_pages(int enable)
+{
+    hp_huge_pages = enable;
 }
 
 /**
@@ -624,6 +663,156 @@ void cn_slow_hash(const void *data, size_t length, char *hash)
     extra_hashes[state.hs.b[0] & 3](&state, 200, hash);
 }
 
+/**
+ * @brief one iteration of CryptoNight step 3 for one lane of cn_slow_hash_multi
+ *
+ * This is pre_aes(), the AES round and post_aes() from cn_slow_hash, working
+ * on the scratch buffer <l> and the lane's own a and b instead of hp_state.
+ */
+
+STATIC INLINE void mix_lane(uint8_t *l, uint64_t *a, __m128i *_b)
+{
+    RDATA_ALIGN16 uint64_t b[2];
+    RDATA_ALIGN16 uint64_t c[2];
+    __m128i _a, _c;
+    uint64_t hi, lo;
+    uint64_t *p;
+    size_t j;
+
+    j = state_index(a);
+    _c = _mm_load_si128(R128(&l[j]));
+    _a = _mm_load_si128(R128(a));
+    _c = _mm_aesenc_si128(_c, _a);
+    _mm_store_si128(R128(c), _c);
+    *_b = _mm_xor_si128(*_b, _c);
+    _mm_store_si128(R128(&l[j]), *_b);
+    j = state_index(c);
+    p = U64(&l[j]);
+    b[0] = p[0]; b[1] = p[1];
+    __mul();
+    a[0] += hi; a[1] += lo;
+    p[0] = a[0]; p[1] = a[1];
+    a[0] ^= b[0]; a[1] ^= b[1];
+    *_b = _c;
+}
+
+/**
+ * @brief CryptoNight for 2 or 3 inputs at once, interleaving step 3
+ *
+ * Step 3 is a chain of dependent random reads from the scratch buffer, so a
+ * single hash spends most of its time waiting on cache misses.  Each input
+ * here gets its own 2MB buffer and the mixing iterations of all inputs are
+ * issued alternately, letting the CPU overlap their misses.  The other steps
+ * are done one input after the other as in cn_slow_hash.  Needs AES-NI.
+ */
+
+static void cn_slow_hash_ways(const void *const *data, const size_t *length, size_t ways, char *const *hash)
+{
+    RDATA_ALIGN16 uint8_t expandedKey[240];
+    RDATA_ALIGN16 uint64_t a[CN_SLOW_HASH_MAX_WAYS][2];
+    RDATA_ALIGN16 uint64_t b[2];
+    uint8_t text[INIT_SIZE_BYTE];
+    union cn_slow_hash_state state[CN_SLOW_HASH_MAX_WAYS];
+    uint8_t *l[CN_SLOW_HASH_MAX_WAYS];
+    __m128i _b[CN_SLOW_HASH_MAX_WAYS];
+    size_t i, w;
+
+    static void (*const extra_hashes[4])(const void *, size_t, char *) =
+    {
+        hash_extra_blake, hash_extra_groestl, hash_extra_jh, hash_extra_skein
+    };
+
+    slow_hash_allocate_state_multi(ways);
+
+    /* Steps 1 and 2, see cn_slow_hash */
+    for(w = 0; w < ways; w++)
+    {
+        l[w] = &hp_state[w * MEMORY];
+        hash_process(&state[w].hs, data[w], length[w]);
+        memcpy(text, state[w].init, INIT_SIZE_BYTE);
+        aes_expand_key(state[w].hs.b, expandedKey);
+        for(i = 0; i < MEMORY / INIT_SIZE_BYTE; i++)
+        {
+            aes_pseudo_round(text, text, expandedKey, INIT_SIZE_BLK);
+            memcpy(&l[w][i * INIT_SIZE_BYTE], text, INIT_SIZE_BYTE);
+        }
+
+        U64(a[w])[0] = U64(&state[w].k[0])[0] ^ U64(&state[w].k[32])[0];
+        U64(a[w])[1] = U64(&state[w].k[0])[1] ^ U64(&state[w].k[32])[1];
+        U64(b)[0] = U64(&state[w].k[16])[0] ^ U64(&state[w].k[48])[0];
+        U64(b)[1] = U64(&state[w].k[16])[1] ^ U64(&state[w].k[48])[1];
+        _b[w] = _mm_load_si128(R128(b));
+    }
+
+    /* Step 3, interleaved.  A loop per way count keeps the lane indices constant. */
+    if(ways == 2)
+    {
+        for(i = 0; i < ITER / 2; i++)
+        {
+            mix_lane(l[0], a[0], &_b[0]);
+            mix_lane(l[1], a[1], &_b[1]);
+        }
+    }
+    else
+    {
+        for(i = 0; i < ITER / 2; i++)
+        {
+            mix_lane(l[0], a[0], &_b[0]);
+            mix_lane(l[1], a[1], &_b[1]);
+            mix_lane(l[2], a[2], &_b[2]);
+        }
+    }
+
+    /* Steps 4 and 5 */
+    for(w = 0; w < ways; w++)
+    {
+        memcpy(text, state[w].init, INIT_SIZE_BYTE);
+        aes_expand_key(&state[w].hs.b[32], expandedKey);
+        for(i = 0; i < MEMORY / INIT_SIZE_BYTE; i++)
+            aes_pseudo_round_xor(text, text, expandedKey, &l[w][i * INIT_SIZE_BYTE], INIT_SIZE_BLK);
+
+        memcpy(state[w].init, text, INIT_SIZE_BYTE);
+        hash_permutation(&state[w].hs);
+        extra_hashes[state[w].hs.b[0] & 3](&state[w], 200, hash[w]);
+    }
+}
+
+/**
+ * @brief computes cn_slow_hash of <count> inputs
+ *
+ * Inputs are hashed CN_SLOW_HASH_MAX_WAYS at a time by cn_slow_hash_ways,
+ * which needs that many scratch buffers in the calling thread.  Without
+ * AES-NI this is the same as calling cn_slow_hash for each input.
+ *
+ * @param data pointers to the inputs
+ * @param length the lengths in bytes of the inputs
+ * @param count the number of inputs
+ * @param hash pointers to the 256 bit output buffers, one per input
+ */
+
+void cn_slow_hash_multi(const void *const *data, const size_t *length, size_t count, char *const *hash)
+{
+    size_t ways;
+
+    while(count > 0)
+    {
+        ways = count < CN_SLOW_HASH_MAX_WAYS ? count : CN_SLOW_HASH_MAX_WAYS;
+        if(ways == 1 || !check_aes_hw())
+        {
+            cn_slow_hash(data[0], length[0], hash[0]);
+            ways = 1;
+        }
+        else
+        {
+            cn_slow_hash_ways(data, length, ways, hash);
+        }
+        data += ways;
+        length += ways;
+        hash += ways;
+        count -= ways;
+    }
+}
+
 #else
 // Portable implementation as a fallback
 
@@ -639,6 +828,18 @@ void slow_hash_free_state(void)
   return;
 }
 
+void slow_hash_allocate_state_multi(size_t ways)
+{
+  // As above
+  return;
+}
+
+void slow_hash_set_huge_pages(int enable)
+{
+  // As above
+  return;
+}
+
 static void (*const extra_hashes[4])(const void *, size_t, char *) = {
   hash_extra_blake, hash_extra_groestl, hash_extra_jh, hash_extra_skein
 };
@@ -782,4 +983,11 @@ void cn_slow_hash(const void *data, size_t length, char *hash) {
   oaes_free((OAES_CTX **) &aes_ctx);
 }
 
+void cn_slow_hash_multi(const void *const *data, const size_t *length, size_t count, char *const *hash) {
+  size_t i;
+  for (i = 0; i < count; i++) {
+    cn_slow_hash(data[i], length[i], hash[i]);
+  }
+}
+
 #endif
@@ -63,6 +63,21 @@ size_t tree_hash_cnt(size_t count) {
 	return cnt;
 }
 
+/// Hashes the pairs in[2*i], in[2*i+1] into out[i], for i < pairs
+static void tree_hash_pairs(const char (*in)[HASH_SIZE], size_t pairs, char (*out)[HASH_SIZE]) {
+  const void **data = alloca(pairs * sizeof(*data));
+  size_t *lengths = alloca(pairs * sizeof(*lengths));
+  char **hashes = alloca(pairs * sizeof(*hashes));
+  size_t i;
+
+  for (i = 0; i < pairs; ++i) {
+    data[i] = in[2 * i];
+    lengths[i] = 2 * HASH_SIZE;
+    hashes[i] = out[i];
+  }
+  cn_fast_hash_multi(data, lengths, pairs, hashes);
+}
+
 void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 // The blockchain block at height 202612 http://monerochain.info/block/bbd604d2ba11ba27935e006ed39c9bfdd99b76bf4a50654bc1e1e61217962698
 // contained 514 transactions, that triggered bad calculation of variable "cnt" in the original version of this function
@@ -83,29 +98,24 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
   } else if (count == 2) {
     cn_fast_hash(hashes, 2 * HASH_SIZE, root_hash);
   } else {
-    size_t i, j;
-
     size_t cnt = tree_hash_cnt( count );
     size_t max_size_t = (size_t) -1; // max allowed value of size_t 
     assert( cnt < max_size_t/2 ); // reasonable size to avoid any overflows. /2 is extra; Anyway should be limited much stronger by logical code 
     // as we have sane limits on transactions counts in blockchain rules
 
-    char (*ints)[HASH_SIZE];
+    char (*ints)[HASH_SIZE], (*next)[HASH_SIZE], (*tmp)[HASH_SIZE];
     size_t ints_size = cnt * HASH_SIZE;
     ints = alloca(ints_size); 	memset( ints , 0 , ints_size);  // allocate, and zero out as extra protection for using uninitialized mem
+    next = alloca(ints_size / 2); // each level is hashed into the other buffer, as the pairs of a level are hashed together
 
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
 
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      cn_fast_hash(hashes[i], 64, ints[j]);
-    }
-    assert(i == count);
+    tree_hash_pairs(hashes + (2 * cnt - count), count - cnt, ints + (2 * cnt - count));
 
     while (cnt > 2) {
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        cn_fast_hash(ints[i], 64, ints[j]);
-      }
+      tree_hash_pairs(ints, cnt, next);
+      tmp = ints; ints = next; next = tmp;
     }
 
     cn_fast_hash(ints[0], 64, root_hash);
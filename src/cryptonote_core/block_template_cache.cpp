@@ -0,0 +1,120 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "block_template_cache.h"
+
+namespace cryptonote
+{
+  namespace
+  {
+    // templates are rebuilt at least this often, so the pool's own
+    // housekeeping (stuck tx removal) can't leave a stale one around
+    const time_t BLOCK_TEMPLATE_CACHE_MAX_AGE = 30;
+    // number of distinct address/extra nonce pairs kept
+    const size_t BLOCK_TEMPLATE_CACHE_MAX_ENTRIES = 16;
+  }
+  //---------------------------------------------------------------------------------
+  block_template_cache::block_template_cache(): m_version(1)
+  {
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t block_template_cache::get_version() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_version;
+  }
+  //---------------------------------------------------------------------------------
+  void block_template_cache::invalidate()
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    ++m_version;
+    m_entries.clear();
+    m_changed.notify_all();
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t block_template_cache::wait_for_change(uint64_t version, uint64_t timeout_ms) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout_ms);
+    while (m_version == version)
+    {
+      if (!m_changed.timed_wait(lock, deadline))
+        break;
+    }
+    return m_version;
+  }
+  //---------------------------------------------------------------------------------
+  bool block_template_cache::get(const account_public_address& adr, const blobdata& ex_nonce, block& b, difficulty_type& diffic, uint64_t& height) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    time_t now = time(NULL);
+    for (const entry& e : m_entries)
+    {
+      if (memcmp(&e.adr, &adr, sizeof(adr)) || e.ex_nonce != ex_nonce)
+        continue;
+      if (now - e.created > BLOCK_TEMPLATE_CACHE_MAX_AGE)
+        return false;
+      b = e.b;
+      b.timestamp = now;
+      diffic = e.diffic;
+      height = e.height;
+      return true;
+    }
+    return false;
+  }
+  //---------------------------------------------------------------------------------
+  void block_template_cache::add(uint64_t version, const account_public_address& adr, const blobdata& ex_nonce, const block& b, difficulty_type diffic, uint64_t height)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    if (version != m_version)
+      return;
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+      if (!memcmp(&it->adr, &adr, sizeof(adr)) && it->ex_nonce == ex_nonce)
+      {
+        m_entries.erase(it);
+        break;
+      }
+    }
+    if (m_entries.size() >= BLOCK_TEMPLATE_CACHE_MAX_ENTRIES)
+      m_entries.pop_back();
+
+    entry e;
+    e.adr = adr;
+    e.ex_nonce = ex_nonce;
+    e.b = b;
+    e.diffic = diffic;
+    e.height = height;
+    e.created = time(NULL);
+    m_entries.push_front(e);
+  }
+}
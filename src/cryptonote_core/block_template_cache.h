@@ -0,0 +1,88 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include <list>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "cryptonote_protocol/blobdatatype.h"
+#include "cryptonote_basic_impl.h"
+#include "difficulty.h"
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Recently built block templates, so that miners and pools polling
+  // getblocktemplate don't each cost a full create_block_template.
+  //
+  // The cache has a version which core bumps whenever the template could
+  // change (a tx entered the pool, or the chain changed), dropping every
+  // cached template.  Callers can wait for the version to move instead of
+  // polling.
+  class block_template_cache
+  {
+  public:
+    block_template_cache();
+
+    uint64_t get_version() const;
+
+    // drops all cached templates and wakes up waiters
+    void invalidate();
+
+    // waits until the version differs from the given one, or until
+    // timeout_ms passes.  Returns the current version.
+    uint64_t wait_for_change(uint64_t version, uint64_t timeout_ms) const;
+
+    // fills in a cached template for this address and extra nonce if there
+    // is one built at the current version and recently enough
+    bool get(const account_public_address& adr, const blobdata& ex_nonce, block& b, difficulty_type& diffic, uint64_t& height) const;
+
+    // caches a template built at the given version, unless the version has
+    // moved on since
+    void add(uint64_t version, const account_public_address& adr, const blobdata& ex_nonce, const block& b, difficulty_type diffic, uint64_t height);
+
+  private:
+    struct entry
+    {
+      account_public_address adr;
+      blobdata ex_nonce;
+      block b;
+      difficulty_type diffic;
+      uint64_t height;
+      time_t created;
+    };
+
+    mutable boost::mutex m_lock;
+    mutable boost::condition_variable m_changed;
+    uint64_t m_version;
+    std::list<entry> m_entries;
+  };
+}
@@ -63,8 +63,18 @@ using epee::string_tools::pod_to_hex;
 
 DISABLE_VS_WARNINGS(4267)
 
+// number of checked ring signatures remembered before the cache is flushed
+#define VERIFIED_RING_SIGNATURES_CACHE_SIZE 100000
+
+// most ring signatures handed to crypto::check_ring_signatures at once
+#define RING_SIGNATURE_CHECK_BATCH_SIZE 16
+
+// number of recent blocks kept in m_block_window; enough for the largest of
+// the difficulty, block reward and timestamp windows
+#define BLOCK_WINDOW_SIZE std::max<size_t>({DIFFICULTY_BLOCKS_COUNT, CRYPTONOTE_REWARD_BLOCKS_WINDOW, BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW + 1})
+
 //------------------------------------------------------------------
-Blockchain::Blockchain(tx_memory_pool& tx_pool):m_db(), m_tx_pool(tx_pool), m_current_block_cumul_sz_limit(0), m_is_in_checkpoint_zone(false), m_is_blockchain_storing(false), m_enforce_dns_checkpoints(false)
+Blockchain::Blockchain(tx_memory_pool& tx_pool):m_db(), m_tx_pool(tx_pool), m_current_block_cumul_sz_limit(0), m_block_window(BLOCK_WINDOW_SIZE), m_block_window_height(0), m_is_in_checkpoint_zone(false), m_is_blockchain_storing(false), m_enforce_dns_checkpoints(false)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -130,14 +140,14 @@ void Blockchain::serialize(archive_t & ar, const unsigned int version)
 bool Blockchain::have_tx(const crypto::hash &id) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   return m_db->tx_exists(id);
 }
 //------------------------------------------------------------------
 bool Blockchain::have_tx_keyimg_as_spent(const crypto::key_image &key_im) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   return  m_db->has_key_image(key_im);
 }
 //------------------------------------------------------------------
@@ -148,7 +158,7 @@ template<class visitor_t>
 bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, visitor_t& vis, uint64_t* pmax_related_block_height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // verify that the input has key offsets (that it exists properly, really)
   if(!tx_in_to_key.key_offsets.size())
@@ -160,18 +170,25 @@ bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, vi
   // TODO: Investigate if this is necessary / why this is done.
   std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.key_offsets);
 
-
-  //std::vector<std::pair<crypto::hash, size_t> >& amount_outs_vec = it->second;
-  size_t count = 0;
-  for (const uint64_t& i : absolute_offsets)
+  try
   {
-    try
+    // resolve the whole ring at once rather than one db lookup per member:
+    // tx hash and output index for each output, then the txs they are from
+    std::vector<tx_out_index> output_indices;
+    m_db->get_output_tx_and_index(tx_in_to_key.amount, absolute_offsets, output_indices);
+
+    std::vector<crypto::hash> tx_hashes;
+    tx_hashes.reserve(output_indices.size());
+    for (const auto& output_index : output_indices)
     {
-      // get tx hash and output index for output
-      auto output_index = m_db->get_output_tx_and_index(tx_in_to_key.amount, i);
+      tx_hashes.push_back(output_index.first);
+    }
+    std::vector<transaction> txs = m_db->get_tx_list(tx_hashes);
 
-      // get tx that output is from
-      auto tx = m_db->get_tx(output_index.first);
+    for (size_t count = 0; count < output_indices.size(); ++count)
+    {
+      const auto& output_index = output_indices[count];
+      const transaction& tx = txs[count];
 
       // make sure output index is within range for the given transaction
       if (output_index.second >= tx.vout.size())
@@ -183,33 +200,31 @@ bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, vi
       // call to the passed boost visitor to grab the public key for the output
       if(!vis.handle_output(tx, tx.vout[output_index.second]))
       {
-        LOG_PRINT_L0("Failed to handle_output for output no = " << count << ", with absolute offset " << i);
+        LOG_PRINT_L0("Failed to handle_output for output no = " << count << ", with absolute offset " << absolute_offsets[count]);
         return false;
       }
+    }
 
-      // if on last output and pmax_related_block_height not null pointer
-      if(++count == absolute_offsets.size() && pmax_related_block_height)
+    // if pmax_related_block_height not null pointer, set it to the block
+    // height of the last output's tx
+    if(pmax_related_block_height)
+    {
+      auto h = m_db->get_tx_block_height(output_indices.back().first);
+      if(*pmax_related_block_height < h)
       {
-        // set *pmax_related_block_height to tx block height for this output
-        auto h = m_db->get_tx_block_height(output_index.first);
-        if(*pmax_related_block_height < h)
-        {
-          *pmax_related_block_height = h;
-        }
+        *pmax_related_block_height = h;
       }
-
-    }
-    catch (const OUTPUT_DNE& e)
-    {
-      LOG_PRINT_L0("Output does not exist: " << e.what());
-      return false;
-    }
-    catch (const TX_DNE& e)
-    {
-      LOG_PRINT_L0("Transaction does not exist: " << e.what());
-      return false;
     }
-
+  }
+  catch (const OUTPUT_DNE& e)
+  {
+    LOG_PRINT_L0("Output does not exist: " << e.what());
+    return false;
+  }
+  catch (const TX_DNE& e)
+  {
+    LOG_PRINT_L0("Transaction does not exist: " << e.what());
+    return false;
   }
 
   return true;
@@ -218,7 +233,7 @@ bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, vi
 uint64_t Blockchain::get_current_blockchain_height() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   return m_db->height();
 }
 //------------------------------------------------------------------
@@ -268,6 +283,8 @@ bool Blockchain::init(BlockchainDB* db, const bool testnet)
   {
   }
 
+  sync_block_window();
+
   // check how far behind we are
   uint64_t top_block_timestamp = m_db->get_top_block_timestamp();
   uint64_t timestamp_diff = time(NULL) - top_block_timestamp;
@@ -359,6 +376,9 @@ block Blockchain::pop_block_from_blockchain()
     throw;
   }
 
+  sync_block_window();
+  m_tx_pool.on_blockchain_dec(m_db->height() - 1, m_db->top_block_hash());
+
   // return transactions from popped block to the tx_pool
   for (transaction& tx : popped_txs)
   {
@@ -443,7 +463,7 @@ bool Blockchain::purge_transaction_keyimages_from_blockchain(const transaction&
 crypto::hash Blockchain::get_tail_id(uint64_t& height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   height = m_db->height() - 1;
   return get_tail_id();
 }
@@ -451,7 +471,7 @@ crypto::hash Blockchain::get_tail_id(uint64_t& height) const
 crypto::hash Blockchain::get_tail_id() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   return m_db->top_block_hash();
 }
 //------------------------------------------------------------------
@@ -470,7 +490,7 @@ crypto::hash Blockchain::get_tail_id() const
 bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   uint64_t i = 0;
   uint64_t current_multiplier = 1;
   uint64_t sz = m_db->height();
@@ -511,7 +531,7 @@ bool Blockchain::get_short_chain_history(std::list<crypto::hash>& ids) const
 crypto::hash Blockchain::get_block_id_by_height(uint64_t height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   try
   {
     return m_db->get_block_hash_from_height(height);
@@ -535,7 +555,7 @@ crypto::hash Blockchain::get_block_id_by_height(uint64_t height) const
 bool Blockchain::get_block_by_hash(const crypto::hash &h, block &blk) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // try to find block in main chain
   try
@@ -571,7 +591,7 @@ bool Blockchain::get_block_by_hash(const crypto::hash &h, block &blk) const
 void Blockchain::get_all_known_block_ids(std::list<crypto::hash> &main, std::list<crypto::hash> &alt, std::list<crypto::hash> &invalid) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   for (auto& a : m_db->get_hashes_range(0, m_db->height() - 1))
   {
@@ -592,7 +612,7 @@ void Blockchain::get_all_known_block_ids(std::list<crypto::hash> &main, std::lis
 difficulty_type Blockchain::get_difficulty_for_next_block() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   std::vector<uint64_t> timestamps;
   std::vector<difficulty_type> cumulative_difficulties;
   auto h = m_db->height();
@@ -604,10 +624,22 @@ difficulty_type Blockchain::get_difficulty_for_next_block() const
     ++offset;
   }
 
+  timestamps.reserve(h - std::min<size_t>(h, offset));
+  cumulative_difficulties.reserve(timestamps.capacity());
+  bool synced = is_block_window_synced();
   for(; offset < h; offset++)
   {
-    timestamps.push_back(m_db->get_block_timestamp(offset));
-    cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
+    const block_window_entry* e = synced ? get_block_window_entry(offset) : NULL;
+    if (e)
+    {
+      timestamps.push_back(e->timestamp);
+      cumulative_difficulties.push_back(e->cumulative_difficulty);
+    }
+    else
+    {
+      timestamps.push_back(m_db->get_block_timestamp(offset));
+      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
+    }
   }
   return next_difficulty(timestamps, cumulative_difficulties);
 }
@@ -745,7 +777,7 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
   // based on its blocks alone, need to get more blocks from the main chain
   if(alt_chain.size()< DIFFICULTY_BLOCKS_COUNT)
   {
-    CRITICAL_REGION_LOCAL(m_blockchain_lock);
+    SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
     // Figure out start and stop offsets for main chain blocks
     size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
@@ -866,7 +898,7 @@ bool Blockchain::validate_miner_transaction(const block& b, size_t cumulative_bl
 void Blockchain::get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   auto h = m_db->height();
 
   // this function is meaningless for an empty blockchain...granted it should never be empty
@@ -875,12 +907,79 @@ void Blockchain::get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count)
 
   // add size of last <count> blocks to vector <sz> (or less, if blockchain size < count)
   size_t start_offset = h - std::min<size_t>(h, count);
+  bool synced = is_block_window_synced();
   for(size_t i = start_offset; i < h; i++)
   {
-    sz.push_back(m_db->get_block_size(i));
+    const block_window_entry* e = synced ? get_block_window_entry(i) : NULL;
+    sz.push_back(e ? e->block_size : m_db->get_block_size(i));
+  }
+}
+//------------------------------------------------------------------
+// Brings m_block_window up to date with the main chain after blocks were
+// added or popped.  Entries are reused while the window's top block is
+// still on the main chain, otherwise the window is refilled from the db.
+// Must be called with m_blockchain_lock held exclusively.
+void Blockchain::sync_block_window()
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  auto h = m_db->height();
+
+  auto read_entry = [this](uint64_t height) {
+    block_window_entry e;
+    e.id = m_db->get_block_hash_from_height(height);
+    e.timestamp = m_db->get_block_timestamp(height);
+    e.cumulative_difficulty = m_db->get_block_cumulative_difficulty(height);
+    e.block_size = m_db->get_block_size(height);
+    return e;
+  };
+
+  // drop blocks that were popped
+  while (!m_block_window.empty() && m_block_window_height > h)
+  {
+    m_block_window.pop_back();
+    --m_block_window_height;
+  }
+
+  // if the chain was reorganized or written to behind our back, start over
+  if (!m_block_window.empty() && m_block_window.back().id != m_db->get_block_hash_from_height(m_block_window_height - 1))
+    m_block_window.clear();
+  if (m_block_window.empty())
+    m_block_window_height = h - std::min<uint64_t>(h, m_block_window.capacity());
+
+  // append blocks that were added
+  while (m_block_window_height < h)
+  {
+    m_block_window.push_back(read_entry(m_block_window_height));
+    ++m_block_window_height;
+  }
+
+  // after a pop, refill the front so the window stays full
+  uint64_t first = m_block_window_height - m_block_window.size();
+  while (!m_block_window.full() && first > 0)
+  {
+    --first;
+    m_block_window.push_front(read_entry(first));
   }
 }
 //------------------------------------------------------------------
+// Whether m_block_window ends at the current top block.  It might not if
+// blocks were written to the db directly rather than through this class.
+bool Blockchain::is_block_window_synced() const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  auto h = m_db->height();
+  return !m_block_window.empty() && m_block_window_height == h && m_block_window.back().id == m_db->top_block_hash();
+}
+//------------------------------------------------------------------
+// Returns the m_block_window entry for the block at <height>, or NULL if
+// that block is not in the window.  Only meaningful if the window is synced.
+const Blockchain::block_window_entry* Blockchain::get_block_window_entry(uint64_t height) const
+{
+  if (height >= m_block_window_height || height < m_block_window_height - m_block_window.size())
+    return NULL;
+  return &m_block_window[height - (m_block_window_height - m_block_window.size())];
+}
+//------------------------------------------------------------------
 uint64_t Blockchain::get_current_cumulative_blocksize_limit() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -1028,13 +1127,15 @@ bool Blockchain::complete_timestamps_vector(uint64_t start_top_height, std::vect
   if(timestamps.size() >= BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
     return true;
 
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   size_t need_elements = BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW - timestamps.size();
   CHECK_AND_ASSERT_MES(start_top_height < m_db->height(), false, "internal error: passed start_height not < " << " m_db->height() -- " << start_top_height << " >= " << m_db->height());
   size_t stop_offset = start_top_height > need_elements ? start_top_height - need_elements : 0;
+  bool synced = is_block_window_synced();
   while (start_top_height != stop_offset)
   {
-    timestamps.push_back(m_db->get_block_timestamp(start_top_height));
+    const block_window_entry* e = synced ? get_block_window_entry(start_top_height) : NULL;
+    timestamps.push_back(e ? e->timestamp : m_db->get_block_timestamp(start_top_height));
     --start_top_height;
   }
   return true;
@@ -1239,7 +1340,7 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::list<block>& blocks, std::list<transaction>& txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   if(start_offset > m_db->height())
     return false;
 
@@ -1261,7 +1362,7 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::list<block
 bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::list<block>& blocks) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   if(start_offset > m_db->height())
     return false;
 
@@ -1278,7 +1379,7 @@ bool Blockchain::get_blocks(uint64_t start_offset, size_t count, std::list<block
 bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   rsp.current_blockchain_height = get_current_blockchain_height();
   std::list<block> blocks;
   get_blocks(arg.blocks, blocks, rsp.missed_ids);
@@ -1312,7 +1413,7 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
 bool Blockchain::get_alternative_blocks(std::list<block>& blocks) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   BOOST_FOREACH(const auto& alt_bl, m_alternative_chains)
   {
@@ -1324,20 +1425,41 @@ bool Blockchain::get_alternative_blocks(std::list<block>& blocks) const
 size_t Blockchain::get_alternative_blocks_count() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   return m_alternative_chains.size();
 }
 //------------------------------------------------------------------
-// This function adds the output specified by <amount, i> to the result_outs container
-// unlocked and other such checks should be done by here.
-void Blockchain::add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) const
+// This function adds those of the outputs specified by <amount, offsets>
+// whose transactions are unlocked to the result_outs container.  The
+// outputs are looked up together, in one pass over the outputs of <amount>.
+void Blockchain::add_outs_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, const std::vector<uint64_t>& offsets) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  if (offsets.empty())
+    return;
 
-  COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
-  oen.global_amount_index = i;
-  oen.out_key = m_db->get_output_key(amount, i);
+  // get tx_hash, tx_out_index from DB
+  std::vector<tx_out_index> indices;
+  m_db->get_output_tx_and_index(amount, offsets, indices);
+
+  std::vector<uint64_t> unlocked;
+  for (size_t i = 0; i < indices.size(); ++i)
+  {
+    if (is_tx_spendtime_unlocked(m_db->get_tx_unlock_time(indices[i].first)))
+      unlocked.push_back(offsets[i]);
+  }
+
+  std::vector<crypto::public_key> keys;
+  m_db->get_output_keys(amount, unlocked, keys);
+
+  for (size_t i = 0; i < unlocked.size(); ++i)
+  {
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
+    oen.global_amount_index = unlocked[i];
+    oen.out_key = keys[i];
+  }
 }
 //------------------------------------------------------------------
 // This function takes an RPC request for mixins and creates an RPC response
@@ -1348,7 +1470,7 @@ bool Blockchain::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUT
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   srand(static_cast<unsigned int>(time(NULL)));
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // for each amount that we need to get mixins for, get <n> random outputs
   // from BlockchainDB where <n> is req.outs_count (number of mixins).
@@ -1362,52 +1484,38 @@ bool Blockchain::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUT
 
     // if there aren't enough outputs to mix with (or just enough),
     // use all of them.  Eventually this should become impossible.
-    if (m_db->get_num_outputs(amount) <= req.outs_count)
+    auto num_outs = m_db->get_num_outputs(amount);
+    if (num_outs <= req.outs_count)
     {
-      for (uint64_t i = 0; i < m_db->get_num_outputs(amount); i++)
+      std::vector<uint64_t> offsets;
+      for (uint64_t i = 0; i < num_outs; i++)
       {
-        // get tx_hash, tx_out_index from DB
-        tx_out_index toi = m_db->get_output_tx_and_index(amount, i);
-
-        // if tx is unlocked, add output to result_outs
-        if (is_tx_spendtime_unlocked(m_db->get_tx_unlock_time(toi.first)))
-        {
-          add_out_to_get_random_outs(result_outs, amount, i);
-        }
-
+        offsets.push_back(i);
       }
+      add_outs_to_get_random_outs(result_outs, amount, offsets);
     }
     else
     {
-      // while we still need more mixins
-      auto num_outs = m_db->get_num_outputs(amount);
-      while (result_outs.outs.size() < req.outs_count)
+      // while we still need more mixins, and haven't gone through every
+      // possible output (in which case we've gotten all we can)
+      while (result_outs.outs.size() < req.outs_count && seen_indices.size() < num_outs)
       {
-        // if we've gone through every possible output, we've gotten all we can
-        if (seen_indices.size() == num_outs)
+        // draw as many output indices as are still missing, skipping any
+        // we've already seen, then look them all up together.  Those whose
+        // tx is still locked are dropped and make for another round.
+        std::vector<uint64_t> offsets;
+        while (result_outs.outs.size() + offsets.size() < req.outs_count && seen_indices.size() < num_outs)
         {
-          break;
+          uint64_t i = m_db->get_random_output(amount);
+          if (seen_indices.count(i))
+          {
+            continue;
+          }
+          seen_indices.emplace(i);
+          offsets.push_back(i);
         }
 
-        // get a random output index from the DB.  If we've already seen it,
-        // return to the top of the loop and try again, otherwise add it to the
-        // list of output indices we've seen.
-        uint64_t i = m_db->get_random_output(amount);
-        if (seen_indices.count(i))
-        {
-          continue;
-        }
-        seen_indices.emplace(i);
-
-        // get tx_hash, tx_out_index from DB
-        tx_out_index toi = m_db->get_output_tx_and_index(amount, i);
-
-        // if the output's transaction is unlocked, add the output's index to
-        // our list.
-        if (is_tx_spendtime_unlocked(m_db->get_tx_unlock_time(toi.first)))
-        {
-          add_out_to_get_random_outs(result_outs, amount, i);
-        }
+        add_outs_to_get_random_outs(result_outs, amount, offsets);
       }
     }
   }
@@ -1420,7 +1528,7 @@ bool Blockchain::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUT
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // make sure the request includes at least the genesis block, otherwise
   // how can we expect to sync from the client that the block list came from?
@@ -1487,7 +1595,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 uint64_t Blockchain::block_difficulty(uint64_t i) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   try
   {
     return m_db->get_block_difficulty(i);
@@ -1503,7 +1611,7 @@ template<class t_ids_container, class t_blocks_container, class t_missed_contain
 bool Blockchain::get_blocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   for (const auto& block_hash : block_ids)
   {
@@ -1527,7 +1635,7 @@ template<class t_ids_container, class t_tx_container, class t_missed_container>
 bool Blockchain::get_transactions(const t_ids_container& txs_ids, t_tx_container& txs, t_missed_container& missed_txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   for (const auto& tx_hash : txs_ids)
   {
@@ -1552,7 +1660,7 @@ void Blockchain::print_blockchain(uint64_t start_index, uint64_t end_index)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::stringstream ss;
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   auto h = m_db->height();
   if(start_index > h)
   {
@@ -1580,7 +1688,7 @@ void Blockchain::print_blockchain_index()
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::stringstream ss;
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   auto height = m_db->height();
   if (height != 0)
   {
@@ -1608,7 +1716,7 @@ void Blockchain::print_blockchain_outs(const std::string& file)
 bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // if we can't find the split point, return false
   if(!find_blockchain_supplement(qblock_ids, resp.start_height))
@@ -1632,7 +1740,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
 bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   // if a specific start height has been requested
   if(req_start_block > 0)
@@ -1686,7 +1794,7 @@ bool Blockchain::add_block_as_invalid(const block_extended_info& bei, const cryp
 bool Blockchain::have_block(const crypto::hash& id) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   if(m_db->block_exists(id))
   {
@@ -1719,7 +1827,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, block_verification_
 size_t Blockchain::get_total_transactions() const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   return m_db->get_tx_count();
 }
 //------------------------------------------------------------------
@@ -1732,7 +1840,7 @@ size_t Blockchain::get_total_transactions() const
 bool Blockchain::check_for_double_spend(const transaction& tx, key_images_container& keys_this_block) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   struct add_transaction_input_visitor: public boost::static_visitor<bool>
   {
     key_images_container& m_spent_keys;
@@ -1781,7 +1889,7 @@ bool Blockchain::check_for_double_spend(const transaction& tx, key_images_contai
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   if (!m_db->tx_exists(tx_id))
   {
     LOG_PRINT_RED_L1("warning: get_tx_outputs_gindexs failed to find transaction with id = " << tx_id);
@@ -1801,7 +1909,7 @@ bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<u
 bool Blockchain::check_tx_inputs(const transaction& tx, uint64_t& max_used_block_height, crypto::hash& max_used_block_id) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
   bool res = check_tx_inputs(tx, &max_used_block_height);
   if(!res) return false;
   CHECK_AND_ASSERT_MES(max_used_block_height < m_db->height(), false,  "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_db->height());
@@ -1823,14 +1931,38 @@ bool Blockchain::have_tx_keyimges_as_spent(const transaction &tx) const
 //------------------------------------------------------------------
 // This function validates transaction inputs and their keys.  Previously
 // it also performed double spend checking, but that has been moved to its
-// own function.
+// own function.  The output keys for every input are gathered from the db
+// first, then the ring signatures are checked on the verification pool.
 bool Blockchain::check_tx_inputs(const transaction& tx, uint64_t* pmax_used_block_height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  size_t sig_index = 0;
   if(pmax_used_block_height)
     *pmax_used_block_height = 0;
 
+  std::vector<ring_signature_check> checks;
+  if(!collect_ring_signature_checks(tx, checks, pmax_used_block_height))
+    return false;
+
+  size_t failed_index = 0;
+  if(!check_ring_signatures(checks, failed_index))
+  {
+    const ring_signature_check& check = checks[failed_index];
+    LOG_PRINT_L1("Failed to check ring signature for tx " << get_transaction_hash(tx) << "  vin key with k_image: " << boost::get<txin_to_key>(tx.vin[check.input_index]).k_image << "  sig_index: " << check.input_index);
+    return false;
+  }
+
+  return true;
+}
+//------------------------------------------------------------------
+// Appends a ring_signature_check for each input of <tx> to <checks>,
+// validating the inputs and fetching the output keys they reference.
+// The signatures themselves are left to check_ring_signatures().
+bool Blockchain::collect_ring_signature_checks(const transaction& tx, std::vector<ring_signature_check>& checks, uint64_t* pmax_used_block_height) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  size_t sig_index = 0;
+
   crypto::hash tx_prefix_hash = get_transaction_prefix_hash(tx);
 
   for (const auto& txin : tx.vin)
@@ -1846,17 +1978,24 @@ bool Blockchain::check_tx_inputs(const transaction& tx, uint64_t* pmax_used_bloc
     // basically, make sure number of inputs == number of signatures
     CHECK_AND_ASSERT_MES(sig_index < tx.signatures.size(), false, "wrong transaction: not signature entry for input with index= " << sig_index);
 
+    checks.push_back(ring_signature_check());
+    ring_signature_check& check = checks.back();
+    check.tx = &tx;
+    check.input_index = sig_index;
+    check.tx_prefix_hash = tx_prefix_hash;
+
     // make sure that output being spent matches up correctly with the
     // signature spending it.
-    if(!check_tx_input(in_to_key, tx_prefix_hash, tx.signatures[sig_index], pmax_used_block_height))
+    if(!get_input_output_keys(in_to_key, check.output_keys, pmax_used_block_height))
     {
-      LOG_PRINT_L1("Failed to check ring signature for tx " << get_transaction_hash(tx) << "  vin key with k_image: " << in_to_key.k_image << "  sig_index: " << sig_index);
+      LOG_PRINT_L1("Failed to get output keys for tx " << get_transaction_hash(tx) << "  vin key with k_image: " << in_to_key.k_image << "  sig_index: " << sig_index);
       if (pmax_used_block_height) // a default value of NULL is used when called from Blockchain::handle_block_to_main_chain()
       {
         LOG_PRINT_L1("  *pmax_used_block_height: " << *pmax_used_block_height);
       }
       return false;
     }
+    CHECK_AND_ASSERT_MES(tx.signatures[sig_index].size() == check.output_keys.size(), false, "internal error: tx signatures count=" << tx.signatures[sig_index].size() << " mismatch with outputs keys count for inputs=" << check.output_keys.size());
 
     sig_index++;
   }
@@ -1864,6 +2003,290 @@ bool Blockchain::check_tx_inputs(const transaction& tx, uint64_t* pmax_used_bloc
   return true;
 }
 //------------------------------------------------------------------
+// Identifies a ring signature check by everything the signature covers:
+// the message, the key image, the ring members and the signature itself.
+// If two checks have the same id, they have the same outcome.
+crypto::hash Blockchain::get_ring_signature_check_id(const ring_signature_check& check) const
+{
+  const transaction& tx = *check.tx;
+  const std::vector<crypto::signature>& sig = tx.signatures[check.input_index];
+  std::string buf;
+  buf.reserve(sizeof(crypto::hash) + sizeof(crypto::key_image) + check.output_keys.size() * sizeof(crypto::public_key) + sig.size() * sizeof(crypto::signature));
+  buf.append(reinterpret_cast<const char*>(&check.tx_prefix_hash), sizeof(check.tx_prefix_hash));
+  buf.append(reinterpret_cast<const char*>(&boost::get<txin_to_key>(tx.vin[check.input_index]).k_image), sizeof(crypto::key_image));
+  buf.append(reinterpret_cast<const char*>(check.output_keys.data()), check.output_keys.size() * sizeof(crypto::public_key));
+  buf.append(reinterpret_cast<const char*>(sig.data()), sig.size() * sizeof(crypto::signature));
+  return crypto::cn_fast_hash(buf.data(), buf.size());
+}
+//------------------------------------------------------------------
+// Checks a batch of ring signatures, fanning them out over the
+// verification pool in groups handed to crypto::check_ring_signatures.
+// Does not touch the db, so the blockchain lock need not be held.  Stops
+// scheduling further work as soon as one signature fails; <failed_index>
+// is set to the position of a failing check.
+//
+// Signatures that pass are remembered, so a transaction checked when it
+// enters the pool (or by prepare_handle_incoming_blocks) is not checked
+// again when its block is added.
+bool Blockchain::check_ring_signatures(const std::vector<ring_signature_check>& checks, size_t& failed_index) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  if(m_is_in_checkpoint_zone)
+    return true;
+
+  std::vector<crypto::hash> ids(checks.size());
+  std::vector<size_t> pending;
+  {
+    CRITICAL_REGION_LOCAL(m_verified_ring_signatures_lock);
+    for (size_t i = 0; i < checks.size(); ++i)
+    {
+      ids[i] = get_ring_signature_check_id(checks[i]);
+      if(m_verified_ring_signatures.find(ids[i]) == m_verified_ring_signatures.end())
+        pending.push_back(i);
+    }
+  }
+
+  std::vector<std::vector<const crypto::public_key *>> p_output_keys(pending.size());
+  std::vector<crypto::ring_signature_ref> refs(pending.size());
+  for (size_t n = 0; n < pending.size(); ++n)
+  {
+    const ring_signature_check& check = checks[pending[n]];
+    const transaction& tx = *check.tx;
+    for (const auto& k : check.output_keys)
+      p_output_keys[n].push_back(&k);
+    crypto::ring_signature_ref& ref = refs[n];
+    ref.prefix_hash = &check.tx_prefix_hash;
+    ref.image = &boost::get<txin_to_key>(tx.vin[check.input_index]).k_image;
+    ref.pubs = p_output_keys[n].data();
+    ref.pubs_count = p_output_keys[n].size();
+    ref.sig = tx.signatures[check.input_index].data();
+  }
+
+  // checks pending[first, first + count) in one go
+  std::atomic<bool> failed(false);
+  std::vector<char> results(checks.size(), 1);
+  auto check_batch = [&](size_t first, size_t count)
+  {
+    size_t batch_failed_index = 0;
+    if(!crypto::check_ring_signatures(refs.data() + first, count, batch_failed_index))
+    {
+      results[pending[first + batch_failed_index]] = 0;
+      failed = true;
+    }
+  };
+
+  // several signatures per job, as checking them together saves some work,
+  // but not so many that the pool threads are left without any
+  size_t threads = m_verify_pool.get_max_concurrency();
+  size_t batch_size = std::max<size_t>(1, std::min<size_t>(RING_SIGNATURE_CHECK_BATCH_SIZE, pending.size() / std::max<size_t>(threads, 1)));
+  if(pending.size() <= batch_size || threads < 2)
+  {
+    for (size_t first = 0; first < pending.size() && !failed; first += RING_SIGNATURE_CHECK_BATCH_SIZE)
+      check_batch(first, std::min<size_t>(RING_SIGNATURE_CHECK_BATCH_SIZE, pending.size() - first));
+  }
+  else
+  {
+    tools::thread_pool::waiter waiter;
+    for (size_t first = 0; first < pending.size(); first += batch_size)
+    {
+      size_t count = std::min(batch_size, pending.size() - first);
+      m_verify_pool.submit(&waiter, [&, first, count]()
+      {
+        if(failed)
+          return;
+        check_batch(first, count);
+      });
+    }
+    m_verify_pool.wait(waiter);
+  }
+
+  if(failed)
+  {
+    failed_index = std::find(results.begin(), results.end(), 0) - results.begin();
+    return false;
+  }
+
+  CRITICAL_REGION_LOCAL(m_verified_ring_signatures_lock);
+  if(m_verified_ring_signatures.size() + pending.size() > VERIFIED_RING_SIGNATURES_CACHE_SIZE)
+    m_verified_ring_signatures.clear();
+  for (size_t i : pending)
+    m_verified_ring_signatures.insert(ids[i]);
+  return true;
+}
+//------------------------------------------------------------------
+// Computes the long hashes of a batch of incoming blocks on the verification
+// pool, CN_SLOW_HASH_MAX_WAYS blocks per task so that each task can
+// interleave them, and keeps them for handle_block_to_main_chain.  Blocks
+// that fail to parse are left for the normal path to reject.
+void Blockchain::precompute_proofs_of_work(const std::list<block_complete_entry>& blocks_entry)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  TIME_MEASURE_START(pow_time);
+
+  std::vector<blobdata> blobs;
+  std::vector<crypto::hash> ids;
+  for (const auto& entry : blocks_entry)
+  {
+    block b;
+    if(!parse_and_validate_block_from_blob(entry.block, b))
+      continue;
+    if(b.miner_tx.vin.size() != 1 || b.miner_tx.vin[0].type() != typeid(txin_gen))
+      continue;
+    // the long hash of this block is hardcoded, see get_block_longhash
+    if(boost::get<txin_gen>(b.miner_tx.vin[0]).height == 202612)
+      continue;
+    blobs.push_back(get_block_hashing_blob(b));
+    ids.push_back(get_block_hash(b));
+  }
+  if(blobs.empty())
+    return;
+
+  std::vector<crypto::hash> pows(blobs.size());
+  {
+    tools::thread_pool::waiter waiter;
+    for (size_t first = 0; first < blobs.size(); first += crypto::CN_SLOW_HASH_MAX_WAYS)
+    {
+      m_verify_pool.submit(&waiter, [&, first]()
+      {
+        size_t count = std::min<size_t>(crypto::CN_SLOW_HASH_MAX_WAYS, blobs.size() - first);
+        const void* data[crypto::CN_SLOW_HASH_MAX_WAYS];
+        size_t lengths[crypto::CN_SLOW_HASH_MAX_WAYS];
+        crypto::hash* hashes[crypto::CN_SLOW_HASH_MAX_WAYS];
+        for (size_t i = 0; i < count; ++i)
+        {
+          data[i] = blobs[first + i].data();
+          lengths[i] = blobs[first + i].size();
+          hashes[i] = &pows[first + i];
+        }
+        crypto::cn_slow_hash_multi(data, lengths, count, hashes);
+      });
+    }
+    m_verify_pool.wait(waiter);
+  }
+
+  {
+    CRITICAL_REGION_LOCAL(m_precomputed_pow_lock);
+    for (size_t i = 0; i < ids.size(); ++i)
+      m_precomputed_pow[ids[i]] = pows[i];
+  }
+
+  TIME_MEASURE_FINISH(pow_time);
+  LOG_PRINT_L1("Prepared " << blocks_entry.size() << " blocks: " << pows.size() << " proofs of work computed in advance, " << pow_time << "ms");
+}
+//------------------------------------------------------------------
+// Sync pipeline, run on a batch of downloaded blocks before they are handed
+// to the core one at a time.  The transactions are parsed and hashed in
+// parallel, the output keys their inputs reference are fetched from the db,
+// and the ring signatures are checked on the verification pool.  Signatures
+// that pass are remembered by check_ring_signatures(), so the serialized
+// handle_incoming_tx/handle_incoming_block path that follows only has to do
+// the db work.  The parsed transactions are handed back in <txs>, in the
+// order of their blobs, so that path need not parse them again; if any blob
+// fails to parse, <txs> is left empty and the blobs are parsed as usual.
+//
+// Nothing here rejects anything: inputs spending outputs created earlier in
+// the same batch are not in the db yet, and any failure is left for the
+// serialized path to report.
+bool Blockchain::prepare_handle_incoming_blocks(const std::list<block_complete_entry>& blocks_entry, std::vector<transaction>& parsed_txs)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  parsed_txs.clear();
+  // proof of work is checked in the checkpoint zone as well
+  precompute_proofs_of_work(blocks_entry);
+
+  if(m_is_in_checkpoint_zone)
+    return true;
+
+  TIME_MEASURE_START(prepare_time);
+
+  std::vector<const blobdata*> blobs;
+  for (const auto& entry : blocks_entry)
+  {
+    for (const auto& tx_blob : entry.txs)
+      blobs.push_back(&tx_blob);
+  }
+  if(blobs.empty())
+    return true;
+
+  // stage one: parse and hash
+  std::vector<transaction> txs(blobs.size());
+  std::vector<crypto::hash> tx_hashes(blobs.size());
+  std::vector<char> parsed(blobs.size(), 0);
+  {
+    tools::thread_pool::waiter waiter;
+    for (size_t i = 0; i < blobs.size(); ++i)
+    {
+      m_verify_pool.submit(&waiter, [&, i]()
+      {
+        crypto::hash tx_prefix_hash;
+        parsed[i] = parse_and_validate_tx_from_blob(*blobs[i], txs[i], tx_hashes[i], tx_prefix_hash);
+      });
+    }
+    m_verify_pool.wait(waiter);
+  }
+
+  // stage two: fetch the output keys the inputs reference
+  std::vector<ring_signature_check> checks;
+  {
+    SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
+    for (size_t i = 0; i < txs.size(); ++i)
+    {
+      if(!parsed[i] || m_db->tx_exists(tx_hashes[i]))
+        continue;
+
+      bool available = true;
+      for (const auto& txin : txs[i].vin)
+      {
+        if(txin.type() != typeid(txin_to_key))
+        {
+          available = false;
+          break;
+        }
+        const txin_to_key& in_to_key = boost::get<txin_to_key>(txin);
+        if(in_to_key.key_offsets.empty())
+        {
+          available = false;
+          break;
+        }
+        std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+        if(absolute_offsets.back() >= m_db->get_num_outputs(in_to_key.amount))
+        {
+          available = false;
+          break;
+        }
+      }
+      if(!available)
+        continue;
+
+      std::vector<ring_signature_check> tx_checks;
+      if(collect_ring_signature_checks(txs[i], tx_checks, NULL))
+        std::move(tx_checks.begin(), tx_checks.end(), std::back_inserter(checks));
+    }
+  }
+
+  // stage three: check the signatures
+  size_t failed_index = 0;
+  check_ring_signatures(checks, failed_index);
+
+  if(std::find(parsed.begin(), parsed.end(), 0) == parsed.end())
+    parsed_txs = std::move(txs);
+
+  TIME_MEASURE_FINISH(prepare_time);
+  LOG_PRINT_L1("Prepared " << blocks_entry.size() << " blocks: " << checks.size() << " ring signatures from " << blobs.size() << " transactions checked in advance, " << prepare_time << "ms");
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::cleanup_handle_incoming_blocks()
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  // the verified ring signatures stay, so a tx seen again later (in an
+  // alternative block, or relayed) is not checked again; the cache is
+  // bounded in check_ring_signatures()
+  CRITICAL_REGION_LOCAL(m_precomputed_pow_lock);
+  m_precomputed_pow.clear();
+  return true;
+}
+//------------------------------------------------------------------
 // This function checks to see if a tx is unlocked.  unlock_time is either
 // a block index or a unix time.
 bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time) const
@@ -1888,20 +2311,18 @@ bool Blockchain::is_tx_spendtime_unlocked(uint64_t unlock_time) const
   return false;
 }
 //------------------------------------------------------------------
-// This function locates all outputs associated with a given input (mixins)
-// and validates that they exist and are usable.  It also checks the ring
-// signature for each input.
-bool Blockchain::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height) const
+// This function locates all outputs associated with a given input (mixins),
+// validates that they exist and are usable, and returns their public keys.
+bool Blockchain::get_input_output_keys(const txin_to_key& txin, std::vector<crypto::public_key>& output_keys, uint64_t* pmax_related_block_height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  SHARED_CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
   struct outputs_visitor
   {
-    std::vector<const crypto::public_key *>& m_p_output_keys;
     std::vector<crypto::public_key >& m_output_keys;
     const Blockchain& m_bch;
-    outputs_visitor(std::vector<crypto::public_key >& output_keys, std::vector<const crypto::public_key *>& p_output_keys, const Blockchain& bch) : m_output_keys(output_keys), m_p_output_keys(p_output_keys), m_bch(bch)
+    outputs_visitor(std::vector<crypto::public_key >& output_keys, const Blockchain& bch) : m_output_keys(output_keys), m_bch(bch)
     {}
     bool handle_output(const transaction& tx, const tx_out& out)
     {
@@ -1923,30 +2344,21 @@ bool Blockchain::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_
     }
   };
 
-  //check ring signature
-  std::vector<crypto::public_key> output_keys;
-  std::vector<const crypto::public_key *> p_output_keys;
-  outputs_visitor vi(output_keys, p_output_keys, *this);
+  output_keys.clear();
+  output_keys.reserve(txin.key_offsets.size());
+  outputs_visitor vi(output_keys, *this);
   if(!scan_outputkeys_for_indexes(txin, vi, pmax_related_block_height))
   {
     LOG_PRINT_L1("Failed to get output keys for tx with amount = " << print_money(txin.amount) << " and count indexes " << txin.key_offsets.size());
     return false;
   }
 
-  for (auto& k : output_keys)
-  {
-    p_output_keys.push_back(&k);
-  }
-
   if(txin.key_offsets.size() != output_keys.size())
   {
     LOG_PRINT_L1("Output keys for tx with amount = " << txin.amount << " and count indexes " << txin.key_offsets.size() << " returned wrong keys count " << output_keys.size());
     return false;
   }
-  CHECK_AND_ASSERT_MES(sig.size() == output_keys.size(), false, "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size());
-  if(m_is_in_checkpoint_zone)
-    return true;
-  return crypto::check_ring_signature(tx_prefix_hash, txin.k_image, p_output_keys, sig.data());
+  return true;
 }
 //------------------------------------------------------------------
 //TODO: Is this intended to do something else?  Need to look into the todo there.
@@ -2001,9 +2413,11 @@ bool Blockchain::check_block_timestamp(const block& b) const
   // using +1 because BlockchainDB::height() returns the index of the top block,
   // not the size of the blockchain (0-indexed)
   size_t offset = h - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW - 1;
+  bool synced = is_block_window_synced();
   for(;offset < h; ++offset)
   {
-    timestamps.push_back(m_db->get_block_timestamp(offset));
+    const block_window_entry* e = synced ? get_block_window_entry(offset) : NULL;
+    timestamps.push_back(e ? e->timestamp : m_db->get_block_timestamp(offset));
   }
 
   return check_block_timestamp(timestamps, b);
@@ -2017,6 +2431,7 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
   LOG_PRINT_L3("Blockchain::" << __func__);
 
   TIME_MEASURE_START(block_processing_time);
+  uint64_t hash_calculations_before = get_hash_calculation_count();
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   if(bl.prev_id != get_tail_id())
   {
@@ -2061,7 +2476,20 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
   // check PoW now.
   // FIXME: height parameter is not used...should it be used or should it not
   // be a parameter?
-  proof_of_work = get_block_longhash(bl, m_db->height());
+  bool pow_precomputed = false;
+  if(m_db->height() != 202612)
+  {
+    CRITICAL_REGION_LOCAL(m_precomputed_pow_lock);
+    auto it = m_precomputed_pow.find(id);
+    if(it != m_precomputed_pow.end())
+    {
+      proof_of_work = it->second;
+      m_precomputed_pow.erase(it);
+      pow_precomputed = true;
+    }
+  }
+  if(!pow_precomputed)
+    proof_of_work = get_block_longhash(bl, m_db->height());
 
   // validate proof_of_work versus difficulty target
   if(!check_hash(proof_of_work, current_diffic))
@@ -2101,12 +2529,17 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
 
   std::vector<transaction> txs;
   key_images_container keys;
+  std::vector<ring_signature_check> sig_checks;
+
+  // sig_checks points into txs, so it must not reallocate
+  txs.reserve(bl.tx_hashes.size());
 
   uint64_t fee_summary = 0;
 
   // Iterate over the block's transaction hashes, grabbing each
   // from the tx_pool and validating them.  Each is then added
   // to txs.  Keys spent in each are added to <keys> by the double spend check.
+  // Ring signatures for the whole block are checked in one batch afterwards.
   for (const crypto::hash& tx_id : bl.tx_hashes)
   {
     transaction tx;
@@ -2133,8 +2566,8 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
     // taken from the tx_pool back to it if the block fails verification.
     txs.push_back(tx);
 
-    // validate that transaction inputs and the keys spending them are correct.
-    if(!check_tx_inputs(tx))
+    // validate that transaction inputs exist and gather the keys they spend.
+    if(!collect_ring_signature_checks(txs.back(), sig_checks, NULL))
     {
       LOG_PRINT_L1("Block with id: " << id  << " has at least one transaction (id: " << tx_id << ") with wrong inputs.");
 
@@ -2156,6 +2589,15 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
     cumulative_block_size += blob_size;
   }
 
+  size_t failed_index = 0;
+  if(!bvc.m_verifivation_failed && !check_ring_signatures(sig_checks, failed_index))
+  {
+    const ring_signature_check& check = sig_checks[failed_index];
+    LOG_PRINT_L1("Block with id: " << id << " has at least one transaction (id: " << get_transaction_hash(*check.tx) << ") with wrong ring signature at sig_index " << check.input_index);
+    add_block_as_invalid(bl, id);
+    bvc.m_verifivation_failed = true;
+  }
+
   uint64_t base_reward = 0;
   uint64_t already_generated_coins = m_db->height() ? m_db->get_block_already_generated_coins(m_db->height() - 1) : 0;
   if(!validate_miner_transaction(bl, cumulative_block_size, fee_summary, base_reward, already_generated_coins))
@@ -2175,7 +2617,10 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
   cumulative_difficulty = current_diffic;
   already_generated_coins = already_generated_coins + base_reward;
   if(m_db->height())
-    cumulative_difficulty += m_db->get_block_cumulative_difficulty(m_db->height() - 1);
+  {
+    const block_window_entry* e = is_block_window_synced() ? get_block_window_entry(m_db->height() - 1) : NULL;
+    cumulative_difficulty += e ? e->cumulative_difficulty : m_db->get_block_cumulative_difficulty(m_db->height() - 1);
+  }
 
   update_next_cumulative_size_limit();
 
@@ -2218,11 +2663,14 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
     << std::endl << "HEIGHT " << new_height << ", difficulty:\t" << current_diffic
     << std::endl << "block reward: " << print_money(fee_summary + base_reward) << "(" << print_money(base_reward) << " + " << print_money(fee_summary)
     << "), coinbase_blob_size: " << coinbase_blob_size << ", cumulative size: " << cumulative_block_size
-    << ", " << block_processing_time << "("<< target_calculating_time << "/" << longhash_calculating_time << ")ms");
+    << ", " << block_processing_time << "("<< target_calculating_time << "/" << longhash_calculating_time << ")ms"
+    << ", tx/block hashes computed: " << get_hash_calculation_count() - hash_calculations_before);
+
+  sync_block_window();
 
   bvc.m_added_to_main_chain = true;
 
-  // appears to be a NOP *and* is called elsewhere.  wat?
+  // invalidates the pool's cached tx readiness for block templates
   m_tx_pool.on_blockchain_inc(new_height, id);
 
   return true;
@@ -2248,6 +2696,7 @@ bool Blockchain::add_new_block(const block& bl_, block_verification_context& bvc
   //copy block here to let modify block.target
   block bl = bl_;
   crypto::hash id = get_block_hash(bl);
+  bvc.m_block_id = id;
   CRITICAL_REGION_LOCAL(m_tx_pool);//to avoid deadlock lets lock tx_pool for whole add/reorganize process
   CRITICAL_REGION_LOCAL1(m_blockchain_lock);
   if(have_block(id))
@@ -2336,6 +2785,13 @@ bool Blockchain::update_checkpoints(const std::string& file_path, bool check_dns
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::set_max_verify_threads(unsigned int threads)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  // the thread waiting on a batch runs jobs too, so it counts as one
+  m_verify_pool.resize(threads > 1 ? threads - 1 : 0);
+}
+//------------------------------------------------------------------
 void Blockchain::set_enforce_dns_checkpoints(bool enforce_checkpoints)
 {
   m_enforce_dns_checkpoints = enforce_checkpoints;
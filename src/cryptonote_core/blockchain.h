@@ -32,6 +32,7 @@
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/list.hpp>
+#include <boost/circular_buffer.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/global_fun.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -49,6 +50,7 @@
 #include "cryptonote_core/cryptonote_format_utils.h"
 #include "verification_context.h"
 #include "crypto/hash.h"
+#include "common/thread_pool.h"
 #include "checkpoints.h"
 #include "blockchain_db/blockchain_db.h"
 
@@ -123,9 +125,10 @@ namespace cryptonote
     bool get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res) const;
     bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) const;
     bool store_blockchain();
-    bool check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL) const;
     bool check_tx_inputs(const transaction& tx, uint64_t* pmax_used_block_height = NULL) const;
     bool check_tx_inputs(const transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id) const;
+    bool prepare_handle_incoming_blocks(const std::list<block_complete_entry>& blocks_entry, std::vector<transaction>& txs);
+    bool cleanup_handle_incoming_blocks();
     uint64_t get_current_cumulative_blocksize_limit() const;
     bool is_storing_blockchain()const{return m_is_blockchain_storing;}
     uint64_t block_difficulty(uint64_t i) const;
@@ -145,6 +148,21 @@ namespace cryptonote
     void set_enforce_dns_checkpoints(bool enforce);
     bool update_checkpoints(const std::string& file_path, bool check_dns);
 
+    void set_max_verify_threads(unsigned int threads);
+
+    // one input's ring signature, with the output keys it refers to already
+    // fetched from the db so that it can be checked without the db or lock.
+    // tx must outlive the check.
+    struct ring_signature_check
+    {
+      const transaction* tx;
+      size_t input_index;
+      crypto::hash tx_prefix_hash;
+      std::vector<crypto::public_key> output_keys;
+    };
+
+    bool check_ring_signatures(const std::vector<ring_signature_check>& checks, size_t& failed_index) const;
+
     BlockchainDB& get_db()
     {
       return *m_db;
@@ -159,10 +177,21 @@ namespace cryptonote
     typedef std::unordered_map<crypto::hash, block> blocks_by_hash;
     typedef std::map<uint64_t, std::vector<std::pair<crypto::hash, size_t>>> outputs_container; //crypto::hash - tx hash, size_t - index of out in transaction
 
+    // the per-block values the difficulty, timestamp and block size
+    // checks need for the most recent blocks of the main chain
+    struct block_window_entry
+    {
+      crypto::hash id;
+      uint64_t timestamp;
+      difficulty_type cumulative_difficulty;
+      size_t block_size;
+    };
+
     BlockchainDB* m_db;
 
     tx_memory_pool& m_tx_pool;
-    mutable epee::critical_section m_blockchain_lock; // TODO: add here reader/writer lock
+    // queries hold this shared, anything that changes the chain holds it exclusively
+    mutable epee::recursive_shared_critical_section m_blockchain_lock;
 
     // main chain
     blocks_container m_blocks;               // height  -> block_extended_info
@@ -179,12 +208,23 @@ namespace cryptonote
     blocks_ext_by_hash m_invalid_blocks;     // crypto::hash -> block_extended_info
     outputs_container m_outputs;
 
+    // recent main chain blocks, oldest first, ending at height
+    // m_block_window_height - 1.  Only changed under an exclusive lock.
+    boost::circular_buffer<block_window_entry> m_block_window;
+    uint64_t m_block_window_height;
 
     checkpoints m_checkpoints;
     std::atomic<bool> m_is_in_checkpoint_zone;
     std::atomic<bool> m_is_blockchain_storing;
     bool m_enforce_dns_checkpoints;
 
+    mutable tools::thread_pool m_verify_pool;
+    mutable epee::critical_section m_verified_ring_signatures_lock;
+    mutable std::unordered_set<crypto::hash> m_verified_ring_signatures;
+    // block id -> long hash, filled by prepare_handle_incoming_blocks
+    epee::critical_section m_precomputed_pow_lock;
+    std::unordered_map<crypto::hash, crypto::hash> m_precomputed_pow;
+
     bool switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::iterator>& alt_chain, bool discard_disconnected_chain);
     block pop_block_from_blockchain();
     bool purge_transaction_from_blockchain(const crypto::hash& tx_id);
@@ -202,7 +242,7 @@ namespace cryptonote
     bool push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes);
     bool pop_transaction_from_global_index(const transaction& tx, const crypto::hash& tx_id);
     void get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count) const;
-    void add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i) const;
+    void add_outs_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, const std::vector<uint64_t>& offsets) const;
     bool is_tx_spendtime_unlocked(uint64_t unlock_time) const;
     bool add_block_as_invalid(const block& bl, const crypto::hash& h);
     bool add_block_as_invalid(const block_extended_info& bei, const crypto::hash& h);
@@ -211,8 +251,15 @@ namespace cryptonote
     uint64_t get_adjusted_time() const;
     bool complete_timestamps_vector(uint64_t start_height, std::vector<uint64_t>& timestamps);
     bool update_next_cumulative_size_limit();
+    void sync_block_window();
+    bool is_block_window_synced() const;
+    const block_window_entry* get_block_window_entry(uint64_t height) const;
 
     bool check_for_double_spend(const transaction& tx, key_images_container& keys_this_block) const;
+    bool get_input_output_keys(const txin_to_key& txin, std::vector<crypto::public_key>& output_keys, uint64_t* pmax_related_block_height) const;
+    bool collect_ring_signature_checks(const transaction& tx, std::vector<ring_signature_check>& checks, uint64_t* pmax_used_block_height) const;
+    crypto::hash get_ring_signature_check_id(const ring_signature_check& check) const;
+    void precompute_proofs_of_work(const std::list<block_complete_entry>& blocks_entry);
   };
 
 
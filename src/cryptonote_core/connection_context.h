@@ -30,12 +30,74 @@
 
 #pragma once
 #include <unordered_set>
+#include <deque>
+#include <list>
+#include <memory>
 #include <atomic>
 #include "net/net_utils_base.h"
 #include "copyable_atomic.h"
+#include "syncobj.h"
+#include "crypto/hash.h"
+#include "cryptonote_config.h"
 
 namespace cryptonote
 {
+  /************************************************************************/
+  /* Bounded set of block/tx ids a peer is known to have (it announced    */
+  /* them to us or we relayed them to it); oldest ids are forgotten first */
+  /* Copies of a connection context share the same set.                   */
+  /************************************************************************/
+  class known_inventory
+  {
+  public:
+    known_inventory(size_t max_count = CRYPTONOTE_PROTOCOL_KNOWN_INVENTORY_MAX_COUNT): m_data(std::make_shared<data>(max_count))
+    {}
+
+    bool contains(const crypto::hash& id) const
+    {
+      CRITICAL_REGION_LOCAL(m_data->m_lock);
+      return m_data->m_ids.count(id) != 0;
+    }
+
+    //returns true if at least one of the ids was not known yet; all of them are known afterwards
+    bool add(const std::list<crypto::hash>& ids)
+    {
+      bool added = false;
+      CRITICAL_REGION_LOCAL(m_data->m_lock);
+      for(const crypto::hash& id: ids)
+      {
+        if(!m_data->m_ids.insert(id).second)
+          continue;
+        added = true;
+        m_data->m_order.push_back(id);
+        if(m_data->m_order.size() > m_data->m_max_count)
+        {
+          m_data->m_ids.erase(m_data->m_order.front());
+          m_data->m_order.pop_front();
+        }
+      }
+      return added;
+    }
+
+    size_t size() const
+    {
+      CRITICAL_REGION_LOCAL(m_data->m_lock);
+      return m_data->m_ids.size();
+    }
+
+  private:
+    struct data
+    {
+      data(size_t max_count): m_max_count(max_count) {}
+
+      mutable epee::critical_section m_lock;
+      std::unordered_set<crypto::hash> m_ids;
+      std::deque<crypto::hash> m_order;
+      const size_t m_max_count;
+    };
+    std::shared_ptr<data> m_data;
+  };
+
 
   struct cryptonote_connection_context: public epee::net_utils::connection_context_base
   {
@@ -54,6 +116,7 @@ namespace cryptonote
     uint64_t m_remote_blockchain_height;
     uint64_t m_last_response_height;
     epee::copyable_atomic m_callback_request_count; //in debug purpose: problem with double callback rise
+    known_inventory m_known_inventory;
     //size_t m_score;  TODO: add score calculations
   };
 
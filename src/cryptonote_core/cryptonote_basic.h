@@ -186,16 +186,36 @@ namespace cryptonote
     transaction_prefix(){}
   };
 
+  /*! \struct blob_hash_cache
+   *
+   * \brief hash and blob size of an object, remembered from the blob it was parsed from
+   *
+   * Filled in by parse_and_validate_tx_from_blob and
+   * parse_and_validate_block_from_blob, so get_transaction_hash and
+   * get_block_hash don't have to serialize the object again.  Anything that
+   * changes a parsed object afterwards must call its invalidate_hashes().
+   */
+  struct blob_hash_cache
+  {
+    bool valid = false;
+    crypto::hash hash;
+    size_t blob_size;
+  };
+
   class transaction: public transaction_prefix
   {
   public:
     std::vector<std::vector<crypto::signature> > signatures; //count signatures  always the same as inputs count
+    blob_hash_cache hash_cache; // not serialized
 
     transaction();
     virtual ~transaction();
     void set_null();
+    void invalidate_hashes() { hash_cache.valid = false; }
 
     BEGIN_SERIALIZE_OBJECT()
+      if (!W)
+        invalidate_hashes();
       FIELDS(*static_cast<transaction_prefix *>(this))
 
       ar.tag("signatures");
@@ -254,6 +274,7 @@ namespace cryptonote
     vout.clear();
     extra.clear();
     signatures.clear();
+    invalidate_hashes();
   }
 
   inline
@@ -297,8 +318,13 @@ namespace cryptonote
   {
     transaction miner_tx;
     std::vector<crypto::hash> tx_hashes;
+    blob_hash_cache hash_cache; // not serialized
+
+    void invalidate_hashes() { hash_cache.valid = false; miner_tx.invalidate_hashes(); }
 
     BEGIN_SERIALIZE_OBJECT()
+      if (!W)
+        invalidate_hashes();
       FIELDS(*static_cast<block_header *>(this))
       FIELD(miner_tx)
       FIELD(tx_hashes)
@@ -148,6 +148,8 @@ namespace boost
     a & x.vout;
     a & x.extra;
     a & x.signatures;
+    if (Archive::is_loading::value)
+      x.invalidate_hashes();
   }
 
 
@@ -162,6 +164,8 @@ namespace boost
     //------------------
     a & b.miner_tx;
     a & b.tx_hashes;
+    if (Archive::is_loading::value)
+      b.invalidate_hashes();
   }
 }
 }
@@ -54,6 +54,30 @@ DISABLE_VS_WARNINGS(4355)
 
 namespace cryptonote
 {
+  namespace
+  {
+#if BLOCKCHAIN_DB == DB_LMDB
+    // only Blockchain checks ring signatures in parallel; the option is not
+    // registered for blockchain_storage, so the daemon rejects it there
+    const command_line::arg_descriptor<unsigned int> arg_verify_threads = {
+      "verify-threads"
+    , "Number of threads used to check ring signatures, 0 to use all cores"
+    , 0
+    };
+#endif
+
+    const command_line::arg_descriptor<uint64_t> arg_db_map_resize_increment = {
+      "db-map-resize-increment"
+    , "Size in MiB by which the LMDB memory map grows when it runs low"
+    , 1024
+    };
+
+    const command_line::arg_descriptor<uint64_t> arg_max_txpool_size = {
+      "max-txpool-size"
+    , "Size in MiB of transactions the memory pool holds before dropping those paying the least per byte"
+    , CRYPTONOTE_MEMPOOL_DEFAULT_MAX_SIZE >> 20
+    };
+  }
 
   //-----------------------------------------------------------------------------------------------
   core::core(i_cryptonote_protocol* pprotocol):
@@ -126,8 +150,13 @@ namespace cryptonote
     graceful_exit();
   }
   //-----------------------------------------------------------------------------------
-  void core::init_options(boost::program_options::options_description& /*desc*/)
+  void core::init_options(boost::program_options::options_description& desc)
   {
+#if BLOCKCHAIN_DB == DB_LMDB
+    command_line::add_arg(desc, arg_verify_threads);
+#endif
+    command_line::add_arg(desc, arg_db_map_resize_increment);
+    command_line::add_arg(desc, arg_max_txpool_size);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_command_line(const boost::program_options::variables_map& vm)
@@ -156,6 +185,13 @@ namespace cryptonote
 
 
     set_enforce_dns_checkpoints(command_line::get_arg(vm, daemon_args::arg_dns_checkpoints));
+    m_mempool.set_max_size(command_line::get_arg(vm, arg_max_txpool_size) << 20);
+#if BLOCKCHAIN_DB == DB_LMDB
+    unsigned int verify_threads = command_line::get_arg(vm, arg_verify_threads);
+    if (!verify_threads)
+      verify_threads = boost::thread::hardware_concurrency();
+    m_blockchain_storage.set_max_verify_threads(verify_threads);
+#endif
     test_drop_download_height(command_line::get_arg(vm, command_line::arg_test_drop_download_height));
     
     if (command_line::get_arg(vm, command_line::arg_test_drop_download) == true)
@@ -212,7 +248,9 @@ namespace cryptonote
     BlockchainDB* db = nullptr;
     if (db_type == "lmdb")
     {
-      db = new BlockchainLMDB();
+      BlockchainLMDB* lmdb = new BlockchainLMDB();
+      lmdb->set_map_resize_increment(command_line::get_arg(vm, arg_db_map_resize_increment) << 20);
+      db = lmdb;
     }
     else if (db_type == "berkeley")
     {
@@ -323,8 +361,7 @@ namespace cryptonote
   bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block)
   {
     tvc = boost::value_initialized<tx_verification_context>();
-    //want to process all transactions sequentially
-    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    //transactions are verified concurrently, the pool serializes insertion
 
     if(tx_blob.size() > get_max_tx_size())
     {
@@ -345,6 +382,26 @@ namespace cryptonote
     }
     //std::cout << "!"<< tx.vin.size() << std::endl;
 
+    return handle_parsed_tx(tx, tx_hash, tx_blob.size(), tvc, keeped_by_block);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_tx(const blobdata& tx_blob, const transaction& tx, tx_verification_context& tvc, bool keeped_by_block)
+  {
+    tvc = boost::value_initialized<tx_verification_context>();
+
+    if(tx_blob.size() > get_max_tx_size())
+    {
+      LOG_PRINT_L1("WRONG TRANSACTION BLOB, too big size " << tx_blob.size() << ", rejected");
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
+    // the hash was cached when tx was parsed
+    return handle_parsed_tx(tx, get_transaction_hash(tx), tx_blob.size(), tvc, keeped_by_block);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_parsed_tx(const transaction& tx, const crypto::hash& tx_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block)
+  {
     if(!check_tx_syntax(tx))
     {
       LOG_PRINT_L1("WRONG TRANSACTION BLOB, Failed to check tx " << tx_hash << " syntax, rejected");
@@ -359,11 +416,13 @@ namespace cryptonote
       return false;
     }
 
-    bool r = add_new_tx(tx, tx_hash, tx_prefixt_hash, tx_blob.size(), tvc, keeped_by_block);
+    bool r = add_new_tx(tx, tx_hash, blob_size, tvc, keeped_by_block);
     if(tvc.m_verifivation_failed)
     {LOG_PRINT_RED_L1("Transaction verification failed: " << tx_hash);}
     else if(tvc.m_verifivation_impossible)
     {LOG_PRINT_RED_L1("Transaction verification impossible: " << tx_hash);}
+    else if(tvc.m_fee_too_low)
+    {LOG_PRINT_L1("Transaction not added, the pool is full and its fee is too low: " << tx_hash);}
 
     if(tvc.m_added_to_pool)
       LOG_PRINT_L1("tx added: " << tx_hash);
@@ -449,10 +508,9 @@ namespace cryptonote
   bool core::add_new_tx(const transaction& tx, tx_verification_context& tvc, bool keeped_by_block)
   {
     crypto::hash tx_hash = get_transaction_hash(tx);
-    crypto::hash tx_prefix_hash = get_transaction_prefix_hash(tx);
     blobdata bl;
     t_serializable_object_to_blob(tx, bl);
-    return add_new_tx(tx, tx_hash, tx_prefix_hash, bl.size(), tvc, keeped_by_block);
+    return add_new_tx(tx, tx_hash, bl.size(), tvc, keeped_by_block);
   }
   //-----------------------------------------------------------------------------------------------
   size_t core::get_blockchain_total_transactions()
@@ -465,7 +523,7 @@ namespace cryptonote
   //  return m_blockchain_storage.get_outs(amount, pkeys);
   //}
   //-----------------------------------------------------------------------------------------------
-  bool core::add_new_tx(const transaction& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prefix_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block)
+  bool core::add_new_tx(const transaction& tx, const crypto::hash& tx_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block)
   {
     if(m_mempool.have_tx(tx_hash))
     {
@@ -479,12 +537,33 @@ namespace cryptonote
       return true;
     }
 
-    return m_mempool.add_tx(tx, tx_hash, blob_size, tvc, keeped_by_block);
+    bool r = m_mempool.add_tx(tx, tx_hash, blob_size, tvc, keeped_by_block);
+    if(tvc.m_added_to_pool || tvc.m_pool_pruned)
+      m_block_template_cache.invalidate();
+    return r;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::get_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, const blobdata& ex_nonce)
   {
-    return m_blockchain_storage.create_block_template(b, adr, diffic, height, ex_nonce);
+    if(m_block_template_cache.get(adr, ex_nonce, b, diffic, height) && b.prev_id == m_blockchain_storage.get_tail_id())
+      return true;
+
+    // read before building, so a change while we build isn't cached over
+    uint64_t version = m_block_template_cache.get_version();
+    if(!m_blockchain_storage.create_block_template(b, adr, diffic, height, ex_nonce))
+      return false;
+    m_block_template_cache.add(version, adr, ex_nonce, b, diffic, height);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_block_template_version() const
+  {
+    return m_block_template_cache.get_version();
+  }
+  //-----------------------------------------------------------------------------------------------
+  uint64_t core::wait_block_template_change(uint64_t version, uint64_t timeout_ms) const
+  {
+    return m_block_template_cache.wait_for_change(version, timeout_ms);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp)
@@ -536,7 +615,7 @@ namespace cryptonote
   {
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
     m_miner.pause();
-    m_blockchain_storage.add_new_block(b, bvc);
+    add_new_block(b, bvc);
     //anyway - update miner template
     update_miner_block_template();
     m_miner.resume();
@@ -565,7 +644,7 @@ namespace cryptonote
       BOOST_FOREACH(auto& tx,  txs)
         arg.b.txs.push_back(t_serializable_object_to_blob(tx));
 
-      m_pprotocol->relay_block(arg, exclude_context);
+      m_pprotocol->relay_block(arg, bvc.m_block_id, exclude_context);
     }
     return bvc.m_added_to_main_chain;
   }
@@ -581,7 +660,10 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::add_new_block(const block& b, block_verification_context& bvc)
   {
-    return m_blockchain_storage.add_new_block(b, bvc);
+    bool r = m_blockchain_storage.add_new_block(b, bvc);
+    if(bvc.m_added_to_main_chain)
+      m_block_template_cache.invalidate();
+    return r;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate)
@@ -611,6 +693,25 @@ namespace cryptonote
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::prepare_handle_incoming_blocks(const std::list<block_complete_entry> &blocks, std::vector<transaction>& txs)
+  {
+#if BLOCKCHAIN_DB == DB_LMDB
+    return m_blockchain_storage.prepare_handle_incoming_blocks(blocks, txs);
+#else
+    txs.clear();
+    return true;
+#endif
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::cleanup_handle_incoming_blocks()
+  {
+#if BLOCKCHAIN_DB == DB_LMDB
+    return m_blockchain_storage.cleanup_handle_incoming_blocks();
+#else
+    return true;
+#endif
+  }
+  //-----------------------------------------------------------------------------------------------
   // Used by the RPC server to check the size of an incoming
   // block_blob
   bool core::check_incoming_block_size(const blobdata& block_blob)
@@ -633,6 +734,11 @@ namespace cryptonote
     return m_mempool.get_transactions_count();
   }
   //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_pool_transactions_size()
+  {
+    return m_mempool.get_transactions_size();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block(const crypto::hash& id)
   {
     return m_blockchain_storage.have_block(id);
@@ -45,6 +45,7 @@
 #include "blockchain_storage.h"
 #endif
 #include "miner.h"
+#include "block_template_cache.h"
 #include "connection_context.h"
 #include "cryptonote_core/cryptonote_stat_info.h"
 #include "warnings.h"
@@ -65,7 +66,11 @@ namespace cryptonote
      bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote_connection_context& context);
      bool on_idle();
      bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block);
+     // as above, for a tx already parsed from tx_blob by prepare_handle_incoming_blocks
+     bool handle_incoming_tx(const blobdata& tx_blob, const transaction& tx, tx_verification_context& tvc, bool keeped_by_block);
      bool handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate = true);
+     bool prepare_handle_incoming_blocks(const std::list<block_complete_entry> &blocks, std::vector<transaction>& txs);
+     bool cleanup_handle_incoming_blocks();
      bool check_incoming_block_size(const blobdata& block_blob);
      i_cryptonote_protocol* get_protocol(){return m_pprotocol;}
 
@@ -73,6 +78,10 @@ namespace cryptonote
      virtual bool handle_block_found( block& b);
      virtual bool get_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, const blobdata& ex_nonce);
 
+     // the template version moves whenever get_block_template could give a
+     // different template (pool or chain changed)
+     uint64_t get_block_template_version() const;
+     uint64_t wait_block_template_change(uint64_t version, uint64_t timeout_ms) const;
 
      miner& get_miner(){return m_miner;}
      static void init_options(boost::program_options::options_description& desc);
@@ -109,6 +118,7 @@ namespace cryptonote
 
      bool get_pool_transactions(std::list<transaction>& txs);
      size_t get_pool_transactions_count();
+     uint64_t get_pool_transactions_size();
      size_t get_blockchain_total_transactions();
      //bool get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys);
      bool have_block(const crypto::hash& id);
@@ -142,8 +152,9 @@ namespace cryptonote
      void stop();
 
    private:
-     bool add_new_tx(const transaction& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prefix_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block);
+     bool add_new_tx(const transaction& tx, const crypto::hash& tx_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block);
      bool add_new_tx(const transaction& tx, tx_verification_context& tvc, bool keeped_by_block);
+     bool handle_parsed_tx(const transaction& tx, const crypto::hash& tx_hash, size_t blob_size, tx_verification_context& tvc, bool keeped_by_block);
      bool add_new_block(const block& b, block_verification_context& bvc);
      bool load_state_data();
      bool parse_tx_from_blob(transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash, const blobdata& blob);
@@ -167,13 +178,13 @@ namespace cryptonote
 	 uint64_t m_test_drop_download_height = 0;
 
      tx_memory_pool m_mempool;
+     block_template_cache m_block_template_cache;
 #if BLOCKCHAIN_DB == DB_LMDB
      Blockchain m_blockchain_storage;
 #else
      blockchain_storage m_blockchain_storage;
 #endif
      i_cryptonote_protocol* m_pprotocol;
-     epee::critical_section m_incoming_tx_lock;
      //m_miner and m_miner_addres are probably temporary here
      miner m_miner;
      account_public_address m_miner_address;
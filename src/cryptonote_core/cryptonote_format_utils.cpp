@@ -31,6 +31,7 @@
 #include "include_base_utils.h"
 using namespace epee;
 
+#include <atomic>
 #include "cryptonote_format_utils.h"
 #include <boost/foreach.hpp>
 #include "cryptonote_config.h"
@@ -38,12 +39,36 @@ using namespace epee;
 #include "crypto/crypto.h"
 #include "crypto/hash.h"
 
+namespace
+{
+  // transaction and block hashes computed so far, see get_hash_calculation_count()
+  std::atomic<uint64_t> hash_calculation_count(0);
+}
+
 namespace cryptonote
 {
+  //---------------------------------------------------------------
+  static void cache_hash(blob_hash_cache& cache, const crypto::hash& hash, size_t blob_size)
+  {
+    cache.hash = hash;
+    cache.blob_size = blob_size;
+    cache.valid = true;
+  }
+  //---------------------------------------------------------------
+  static bool calculate_transaction_hash(const transaction& t, crypto::hash& res, size_t& blob_size)
+  {
+    ++hash_calculation_count;
+    return get_object_hash(t, res, blob_size);
+  }
+  //---------------------------------------------------------------
+  uint64_t get_hash_calculation_count()
+  {
+    return hash_calculation_count;
+  }
   //---------------------------------------------------------------
   void get_transaction_prefix_hash(const transaction_prefix& tx, crypto::hash& h)
   {
-    std::ostringstream s;
+    binary_string_ostream s;
     binary_archive<true> a(s);
     ::serialization::serialize(a, const_cast<transaction_prefix&>(tx));
     crypto::cn_fast_hash(s.str().data(), s.str().size(), h);
@@ -58,23 +83,45 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx)
   {
-    std::stringstream ss;
-    ss << tx_blob;
+    binary_span_istream ss(tx_blob);
     binary_archive<false> ba(ss);
     bool r = ::serialization::serialize(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
+    // a non canonical blob hashes differently from the transaction serialized back
+    if (ba.is_canonical())
+    {
+      ++hash_calculation_count;
+      crypto::hash tx_hash;
+      crypto::cn_fast_hash(tx_blob.data(), tx_blob.size(), tx_hash);
+      cache_hash(tx.hash_cache, tx_hash, tx_blob.size());
+    }
     return true;
   }
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash)
   {
-    std::stringstream ss;
-    ss << tx_blob;
+    binary_span_istream ss(tx_blob);
     binary_archive<false> ba(ss);
     bool r = ::serialization::serialize(ba, tx);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse transaction from blob");
     //TODO: validate tx
 
+    ++hash_calculation_count;
+    if (ba.is_canonical())
+    {
+      // a canonical blob was read to its end, so it is the prefix followed
+      // only by the fixed size signatures, and both hashes are taken from
+      // the blob together; otherwise the prefix is serialized again
+      size_t signatures_size = 0;
+      BOOST_FOREACH(const auto& s, tx.signatures)
+        signatures_size += s.size() * sizeof(crypto::signature);
+      const void* data[2] = {tx_blob.data(), tx_blob.data()};
+      size_t lengths[2] = {tx_blob.size(), tx_blob.size() - signatures_size};
+      crypto::hash* hashes[2] = {&tx_hash, &tx_prefix_hash};
+      crypto::cn_fast_hash_multi(data, lengths, 2, hashes);
+      cache_hash(tx.hash_cache, tx_hash, tx_blob.size());
+      return true;
+    }
     crypto::cn_fast_hash(tx_blob.data(), tx_blob.size(), tx_hash);
     get_transaction_prefix_hash(tx, tx_prefix_hash);
     return true;
@@ -84,6 +131,7 @@ namespace cryptonote
     tx.vin.clear();
     tx.vout.clear();
     tx.extra.clear();
+    tx.invalidate_hashes();
 
     keypair txkey = keypair::generate();
     add_tx_pub_key_to_extra(tx, txkey.pub);
@@ -241,8 +289,7 @@ namespace cryptonote
     if(tx_extra.empty())
       return true;
 
-    std::string extra_str(reinterpret_cast<const char*>(tx_extra.data()), tx_extra.size());
-    std::istringstream iss(extra_str);
+    binary_span_istream iss(tx_extra.data(), tx_extra.size());
     binary_archive<false> ar(iss);
 
     bool eof = false;
@@ -326,6 +373,7 @@ namespace cryptonote
     tx.vin.clear();
     tx.vout.clear();
     tx.signatures.clear();
+    tx.invalidate_hashes();
 
     tx.version = CURRENT_TRANSACTION_VERSION;
     tx.unlock_time = unlock_time;
@@ -561,16 +609,26 @@ namespace cryptonote
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     money_transfered = 0;
-    size_t i = 0;
     BOOST_FOREACH(const tx_out& o,  tx.vout)
-    {
       CHECK_AND_ASSERT_MES(o.target.type() ==  typeid(txout_to_key), false, "wrong type id in transaction out" );
-      if(is_out_to_acc(acc, boost::get<txout_to_key>(o.target), tx_pub_key, i))
+    if(tx.vout.empty())
+      return true;
+
+    // same as is_out_to_acc on each output, but with the derivation computed
+    // once and the output keys derived together
+    crypto::key_derivation derivation;
+    if(!generate_key_derivation(tx_pub_key, acc.m_view_secret_key, derivation))
+      return true;
+    std::vector<crypto::public_key> keys(tx.vout.size());
+    if(!crypto::derive_public_keys(derivation, 0, keys.size(), acc.m_account_address.m_spend_public_key, keys.data()))
+      return true;
+    for (size_t i = 0; i < tx.vout.size(); ++i)
+    {
+      if(keys[i] == boost::get<txout_to_key>(tx.vout[i].target).key)
       {
         outs.push_back(i);
-        money_transfered += o.amount;
+        money_transfered += tx.vout[i].amount;
       }
-      i++;
     }
     return true;
   }
@@ -602,19 +660,32 @@ namespace cryptonote
   {
     crypto::hash h = null_hash;
     size_t blob_size = 0;
-    get_object_hash(t, h, blob_size);
+    get_transaction_hash(t, h, blob_size);
     return h;
   }
   //---------------------------------------------------------------
   bool get_transaction_hash(const transaction& t, crypto::hash& res)
   {
     size_t blob_size = 0;
-    return get_object_hash(t, res, blob_size);
+    return get_transaction_hash(t, res, blob_size);
   }
   //---------------------------------------------------------------
   bool get_transaction_hash(const transaction& t, crypto::hash& res, size_t& blob_size)
   {
-    return get_object_hash(t, res, blob_size);
+    if (t.hash_cache.valid)
+    {
+      res = t.hash_cache.hash;
+      blob_size = t.hash_cache.blob_size;
+      return true;
+    }
+    return calculate_transaction_hash(t, res, blob_size);
+  }
+  //---------------------------------------------------------------
+  size_t get_object_blobsize(const transaction& t)
+  {
+    if (t.hash_cache.valid)
+      return t.hash_cache.blob_size;
+    return t_serializable_object_to_blob(t).size();
   }
   //---------------------------------------------------------------
   blobdata get_block_hashing_blob(const block& b)
@@ -626,17 +697,22 @@ namespace cryptonote
     return blob;
   }
   //---------------------------------------------------------------
-  bool get_block_hash(const block& b, crypto::hash& res)
+  // b_blob, when given, is the blob b was parsed from and serializes back to
+  static bool calculate_block_hash(const block& b, crypto::hash& res, const blobdata* b_blob = NULL)
   {
+    ++hash_calculation_count;
     // EXCEPTION FOR BLOCK 202612
     const std::string correct_blob_hash_202612 = "3a8a2b3a29b50fc86ff73dd087ea43c6f0d6b8f936c849194d5c84c737903966";
     const std::string existing_block_id_202612 = "bbd604d2ba11ba27935e006ed39c9bfdd99b76bf4a50654bc1e1e61217962698";
-    crypto::hash block_blob_hash = get_blob_hash(block_to_blob(b));
-
-    if (string_tools::pod_to_hex(block_blob_hash) == correct_blob_hash_202612)
+    // that blob's coinbase is at height 202612, so don't hash the whole blob of any other block
+    if (b.miner_tx.vin.size() == 1 && b.miner_tx.vin[0].type() == typeid(txin_gen) && boost::get<txin_gen>(b.miner_tx.vin[0]).height == 202612)
     {
-      string_tools::hex_to_pod(existing_block_id_202612, res);
-      return true;
+      crypto::hash block_blob_hash = b_blob ? get_blob_hash(*b_blob) : get_blob_hash(block_to_blob(b));
+      if (string_tools::pod_to_hex(block_blob_hash) == correct_blob_hash_202612)
+      {
+        string_tools::hex_to_pod(existing_block_id_202612, res);
+        return true;
+      }
     }
     bool hash_result = get_object_hash(get_block_hashing_blob(b), res);
 
@@ -653,6 +729,16 @@ namespace cryptonote
     return hash_result;
   }
   //---------------------------------------------------------------
+  bool get_block_hash(const block& b, crypto::hash& res)
+  {
+    if (b.hash_cache.valid)
+    {
+      res = b.hash_cache.hash;
+      return true;
+    }
+    return calculate_block_hash(b, res);
+  }
+  //---------------------------------------------------------------
   crypto::hash get_block_hash(const block& b)
   {
     crypto::hash p = null_hash;
@@ -732,13 +818,55 @@ namespace cryptonote
     return p;
   }
   //---------------------------------------------------------------
+  // Same as get_block_longhash for each block (at the matching height),
+  // with the slow hashes computed CN_SLOW_HASH_MAX_WAYS at a time.
+  bool get_block_longhashes(const std::vector<block>& blocks, const std::vector<uint64_t>& heights, std::vector<crypto::hash>& res)
+  {
+    CHECK_AND_ASSERT_MES(blocks.size() == heights.size(), false, "get_block_longhashes: " << blocks.size() << " blocks but " << heights.size() << " heights");
+    res.resize(blocks.size());
+
+    std::vector<blobdata> blobs;
+    std::vector<crypto::hash*> hashes;
+    blobs.reserve(blocks.size());
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+      if (heights[i] == 202612)
+      {
+        get_block_longhash(blocks[i], res[i], heights[i]);
+        continue;
+      }
+      blobs.push_back(get_block_hashing_blob(blocks[i]));
+      hashes.push_back(&res[i]);
+    }
+
+    std::vector<const void*> data;
+    std::vector<size_t> lengths;
+    for (const auto& bd : blobs)
+    {
+      data.push_back(bd.data());
+      lengths.push_back(bd.size());
+    }
+    crypto::cn_slow_hash_multi(data.data(), lengths.data(), data.size(), hashes.data());
+    return true;
+  }
+  //---------------------------------------------------------------
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b)
   {
-    std::stringstream ss;
-    ss << b_blob;
+    binary_span_istream ss(b_blob);
     binary_archive<false> ba(ss);
     bool r = ::serialization::serialize(ba, b);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse block from blob");
+    // a non canonical blob hashes differently from the block serialized back
+    if (ba.is_canonical())
+    {
+      crypto::hash h;
+      size_t blob_size;
+      // the coinbase hash goes into the block id anyway
+      if (calculate_transaction_hash(b.miner_tx, h, blob_size))
+        cache_hash(b.miner_tx.hash_cache, h, blob_size);
+      if (calculate_block_hash(b, h, &b_blob))
+        cache_hash(b.hash_cache, h, b_blob.size());
+    }
     return true;
   }
   //---------------------------------------------------------------
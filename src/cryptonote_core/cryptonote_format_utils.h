@@ -100,11 +100,15 @@ namespace cryptonote
   crypto::hash get_transaction_hash(const transaction& t);
   bool get_transaction_hash(const transaction& t, crypto::hash& res);
   bool get_transaction_hash(const transaction& t, crypto::hash& res, size_t& blob_size);
+  size_t get_object_blobsize(const transaction& t);
   blobdata get_block_hashing_blob(const block& b);
   bool get_block_hash(const block& b, crypto::hash& res);
   crypto::hash get_block_hash(const block& b);
+  // number of transaction and block hashes computed since startup; one served from a parsed object's cache doesn't count
+  uint64_t get_hash_calculation_count();
   bool get_block_longhash(const block& b, crypto::hash& res, uint64_t height);
   crypto::hash get_block_longhash(const block& b, uint64_t height);
+  bool get_block_longhashes(const std::vector<block>& blocks, const std::vector<uint64_t>& heights, std::vector<crypto::hash>& res);
   bool generate_genesis_block(
       block& bl
     , std::string const & genesis_tx
@@ -128,11 +132,10 @@ namespace cryptonote
   template<class t_object>
   bool t_serializable_object_to_blob(const t_object& to, blobdata& b_blob)
   {
-    std::stringstream ss;
+    b_blob.clear();
+    binary_string_ostream ss(b_blob);
     binary_archive<true> ba(ss);
-    bool r = ::serialization::serialize(ba, const_cast<t_object&>(to));
-    b_blob = ss.str();
-    return r;
+    return ::serialization::serialize(ba, const_cast<t_object&>(to));
   }
   //---------------------------------------------------------------
   template<class t_object>
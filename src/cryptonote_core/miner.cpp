@@ -48,8 +48,6 @@ using namespace epee;
 #include "miner.h"
 
 
-extern "C" void slow_hash_allocate_state();
-extern "C" void slow_hash_free_state();
 namespace cryptonote
 {
 
@@ -58,6 +56,8 @@ namespace cryptonote
     const command_line::arg_descriptor<std::string> arg_extra_messages =  {"extra-messages-file", "Specify file for extra messages to include into coinbase transactions", "", true};
     const command_line::arg_descriptor<std::string> arg_start_mining =    {"start-mining", "Specify wallet address to mining for", "", true};
     const command_line::arg_descriptor<uint32_t>      arg_mining_threads =  {"mining-threads", "Specify mining threads count", 0, true};
+    const command_line::arg_descriptor<uint32_t>      arg_mining_hash_ways =  {"mining-hash-ways", "Specify how many nonces each mining thread hashes together (1-3)", 1, true};
+    const command_line::arg_descriptor<bool>          arg_no_huge_pages =  {"no-huge-pages", "Do not try huge pages for the slow hash scratch buffers of any thread, mining or verifying blocks"};
   }
 
 
@@ -75,7 +75,8 @@ namespace cryptonote
     m_hashes(0),
     m_do_print_hashrate(false),
     m_do_mining(false),
-    m_current_hash_rate(0)
+    m_current_hash_rate(0),
+    m_hash_ways(1)
   {
 
   }
@@ -169,6 +170,8 @@ namespace cryptonote
     command_line::add_arg(desc, arg_extra_messages);
     command_line::add_arg(desc, arg_start_mining);
     command_line::add_arg(desc, arg_mining_threads);
+    command_line::add_arg(desc, arg_mining_hash_ways);
+    command_line::add_arg(desc, arg_no_huge_pages);
   }
   //-----------------------------------------------------------------------------------------------------
   bool miner::init(const boost::program_options::variables_map& vm, bool testnet)
@@ -211,6 +214,17 @@ namespace cryptonote
       }
     }
 
+    m_hash_ways = command_line::get_arg(vm, arg_mining_hash_ways);
+    if(m_hash_ways < 1 || m_hash_ways > crypto::CN_SLOW_HASH_MAX_WAYS)
+    {
+      LOG_ERROR("Mining hash ways must be between 1 and " << crypto::CN_SLOW_HASH_MAX_WAYS << ", got " << m_hash_ways);
+      return false;
+    }
+    // process-wide: block verification shares the slow hash scratch buffer
+    // allocation policy with the miner
+    if(command_line::get_arg(vm, arg_no_huge_pages))
+      crypto::slow_hash_set_huge_pages(0);
+
     return true;
   }
   //-----------------------------------------------------------------------------------------------------
@@ -293,6 +307,7 @@ namespace cryptonote
   {
     for(; bl.nonce != std::numeric_limits<uint32_t>::max(); bl.nonce++)
     {
+      bl.invalidate_hashes();
       crypto::hash h;
       get_block_longhash(bl, h, height);
 
@@ -345,8 +360,12 @@ namespace cryptonote
     uint64_t height = 0;
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
-    block b;
-	  slow_hash_allocate_state();
+    // each pass hashes <ways> nonces of this thread's sequence together
+    const size_t ways = m_hash_ways;
+    std::vector<block> blocks(ways);
+    std::vector<uint64_t> heights(ways);
+    std::vector<crypto::hash> hashes;
+    crypto::slow_hash_allocate_state_multi(ways);
     while(!m_stop)
     {
       if(m_pausers_count)//anti split workaround
@@ -359,10 +378,11 @@ namespace cryptonote
       {
         
         CRITICAL_REGION_BEGIN(m_template_lock);
-        b = m_template;
+        blocks.assign(ways, m_template);
         local_diff = m_diffic;
         height = m_height;
         CRITICAL_REGION_END();
+        heights.assign(ways, height);
         local_template_ver = m_template_no;
         nonce = m_starter_nonce + th_local_index;
       }
@@ -374,16 +394,21 @@ namespace cryptonote
         continue;
       }
 
-      b.nonce = nonce;
-      crypto::hash h;
-      get_block_longhash(b, h, height);
+      for(size_t i = 0; i != ways; i++)
+      {
+        blocks[i].nonce = nonce + i * m_threads_total;
+        blocks[i].invalidate_hashes();
+      }
+      get_block_longhashes(blocks, heights, hashes);
 
-      if(check_hash(h, local_diff))
+      for(size_t i = 0; i != ways; i++)
       {
+        if(!check_hash(hashes[i], local_diff))
+          continue;
         //we lucky!
         ++m_config.current_extra_message_index;
         LOG_PRINT_GREEN("Found block for difficulty: " << local_diff, LOG_LEVEL_0);
-        if(!m_phandler->handle_block_found(b))
+        if(!m_phandler->handle_block_found(blocks[i]))
         {
           --m_config.current_extra_message_index;
         }else
@@ -392,10 +417,10 @@ namespace cryptonote
           epee::serialization::store_t_to_json_file(m_config, m_config_folder_path + "/" + MINER_CONFIG_FILE_NAME);
         }
       }
-      nonce+=m_threads_total;
-      ++m_hashes;
+      nonce += ways * m_threads_total;
+      m_hashes += ways;
     }
-	  slow_hash_free_state();
+	  crypto::slow_hash_free_state();
     LOG_PRINT_L0("Miner thread stopped ["<< th_local_index << "]");
     return true;
   }
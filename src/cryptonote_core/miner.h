@@ -118,6 +118,7 @@ namespace cryptonote
     std::list<uint64_t> m_last_hash_rates;
     bool m_do_print_hashrate;
     bool m_do_mining;
+    uint32_t m_hash_ways;
 
   };
 }
@@ -136,7 +136,7 @@ namespace cryptonote
       if(!::do_serialize(ar, field))
         return false;
 
-      std::istringstream iss(field);
+      binary_span_istream iss(field);
       binary_archive<false> iar(iss);
       serialize_helper helper(*this);
       return ::serialization::serialize(iar, helper);
@@ -146,13 +146,13 @@ namespace cryptonote
     template <template <bool> class Archive>
     bool do_serialize(Archive<true>& ar)
     {
-      std::ostringstream oss;
+      std::string field;
+      binary_string_ostream oss(field);
       binary_archive<true> oar(oss);
       serialize_helper helper(*this);
       if(!::do_serialize(oar, helper))
         return false;
 
-      std::string field = oss.str();
       return ::serialization::serialize(ar, field);
     }
   };
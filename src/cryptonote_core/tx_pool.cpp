@@ -29,6 +29,10 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
 #include <boost/filesystem.hpp>
 #include <unordered_set>
 #include <vector>
@@ -55,16 +59,88 @@ namespace cryptonote
   namespace
   {
     size_t const TRANSACTION_SIZE_LIMIT = (((CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE * 125) / 100) - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE);
+
+    // pool log records: a header of the type byte, the tx id and the little
+    // endian uint32 size of the rest, then for POOL_LOG_ADD the kept_by_block
+    // flag and the boost serialized tx_details
+    const uint8_t POOL_LOG_ADD = 1;
+    const uint8_t POOL_LOG_REMOVE = 2;
+    const uint32_t POOL_LOG_MAX_RECORD_SIZE = 64 * 1024 * 1024;
+    // the log is rewritten once it is this much over twice the pool size
+    const uint64_t POOL_LOG_COMPACT_SLACK = 16 * 1024 * 1024;
+    // fill_block_template gives up after this many txes in a row it could
+    // not use, rather than checking the rest of a big pool one by one
+    const size_t FILL_BLOCK_TEMPLATE_MAX_SKIPPED = 100;
+
+    const size_t POOL_LOG_HEADER_SIZE = 1 + sizeof(crypto::hash) + sizeof(uint32_t);
+
+    struct pool_log_record_header
+    {
+      uint8_t type;
+      crypto::hash id;
+      uint32_t size;
+    };
+
+    bool read_log_record_header(std::istream& in, pool_log_record_header& header)
+    {
+      char type;
+      uint32_t size;
+      if (!in.get(type) || !in.read((char*)&header.id, sizeof(header.id)) || !in.read((char*)&size, sizeof(size)))
+        return false;
+      header.type = type;
+      header.size = swap32le(size);
+      return true;
+    }
+
+    std::string encode_tx_details(const tx_memory_pool::tx_details& txd)
+    {
+      std::ostringstream ss;
+      ss.put(txd.kept_by_block ? 1 : 0);
+      {
+        boost::archive::binary_oarchive a(ss, boost::archive::no_header);
+        a << txd;
+      }
+      return ss.str();
+    }
+
+    bool decode_tx_details(const std::string& payload, tx_memory_pool::tx_details& txd)
+    {
+      if (payload.empty())
+        return false;
+      try
+      {
+        std::istringstream ss(payload);
+        txd.kept_by_block = ss.get() != 0;
+        boost::archive::binary_iarchive a(ss, boost::archive::no_header);
+        a >> txd;
+      }
+      catch (const std::exception& e)
+      {
+        LOG_PRINT_L1("Failed to parse memory pool log record: " << e.what());
+        return false;
+      }
+      return true;
+    }
+
+    uint64_t write_log_record(std::ostream& out, uint8_t type, const crypto::hash& id, const std::string& payload)
+    {
+      uint32_t size = swap32le(static_cast<uint32_t>(payload.size()));
+      out.put(type);
+      out.write((const char*)&id, sizeof(id));
+      out.write((const char*)&size, sizeof(size));
+      out.write(payload.data(), payload.size());
+      return POOL_LOG_HEADER_SIZE + payload.size();
+    }
   }
   //---------------------------------------------------------------------------------
 #if BLOCKCHAIN_DB == DB_LMDB
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs)
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_ready_generation(1), m_txpool_size(0), m_txpool_max_size(CRYPTONOTE_MEMPOOL_DEFAULT_MAX_SIZE), m_log_size(0), m_blockchain(bchs)
   {
 
   }
 #else
-  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_blockchain(bchs)
+  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_ready_generation(1), m_txpool_size(0), m_txpool_max_size(CRYPTONOTE_MEMPOOL_DEFAULT_MAX_SIZE), m_log_size(0), m_blockchain(bchs)
   {
 
   }
@@ -126,32 +202,71 @@ namespace cryptonote
     }
 
 
+    // The ring signature checks run without the pool lock, so txes from
+    // several peers can be verified at once.  Anything another thread
+    // added to the pool meanwhile is checked for again under the lock.
     crypto::hash max_used_block_id = null_hash;
     uint64_t max_used_block_height = 0;
     bool ch_inp_res = m_blockchain.check_tx_inputs(tx, max_used_block_height, max_used_block_id);
+    if(!ch_inp_res && !kept_by_block)
+    {
+      LOG_PRINT_L1("tx used wrong inputs, rejected");
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    if(!ch_inp_res)
+    if(m_transactions.count(id))
     {
-      if(kept_by_block)
-      {
-        //anyway add this transaction to pool, because it related to block
-        auto txd_p = m_transactions.insert(transactions_container::value_type(id, tx_details()));
-        CHECK_AND_ASSERT_MES(txd_p.second, false, "transaction already exists at inserting in memory pool");
-        txd_p.first->second.blob_size = blob_size;
-        txd_p.first->second.tx = tx;
-        txd_p.first->second.fee = inputs_amount - outputs_amount;
-        txd_p.first->second.max_used_block_id = null_hash;
-        txd_p.first->second.max_used_block_height = 0;
-        txd_p.first->second.kept_by_block = kept_by_block;
-        txd_p.first->second.receive_time = time(nullptr);
-        tvc.m_verifivation_impossible = true;
-        tvc.m_added_to_pool = true;
-      }else
+      // as for a tx that was already in the pool: not added by us, and
+      // whoever added it relays it
+      LOG_PRINT_L2("tx " << id << " was added to the pool while being verified");
+      tvc.m_verifivation_failed = false;
+      tvc.m_verifivation_impossible = false;
+      tvc.m_added_to_pool = false;
+      tvc.m_should_be_relayed = false;
+      return true;
+    }
+    if(!kept_by_block && have_tx_keyimges_as_spent(tx))
+    {
+      LOG_PRINT_L1("Transaction with id= "<< id << " used key images spent by a tx added to the pool while it was verified");
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
+    // a full pool only takes txes paying more per byte than the worst one
+    // it could drop to make room; txes kept by a block are never dropped
+    auto cheapest = find_cheapest_evictable();
+    if(!kept_by_block && m_txpool_size + blob_size > m_txpool_max_size && cheapest != m_txs_by_fee.end())
+    {
+      tx_details txd;
+      txd.fee = inputs_amount - outputs_amount;
+      txd.blob_size = blob_size;
+      txd.receive_time = time(nullptr);
+      if(!sorted_tx_compare()(get_sorted_tx_key(id, txd), *cheapest))
       {
-        LOG_PRINT_L1("tx used wrong inputs, rejected");
-        tvc.m_verifivation_failed = true;
-        return false;
+        LOG_PRINT_L1("tx " << id << " not added, the pool is full and its fee per byte is too low");
+        tvc.m_fee_too_low = true;
+        return true;
       }
+    }
+
+    if(!ch_inp_res)
+    {
+      //anyway add this transaction to pool, because it related to block
+      auto txd_p = m_transactions.insert(transactions_container::value_type(id, tx_details()));
+      CHECK_AND_ASSERT_MES(txd_p.second, false, "transaction already exists at inserting in memory pool");
+      txd_p.first->second.blob_size = blob_size;
+      txd_p.first->second.tx = tx;
+      txd_p.first->second.fee = inputs_amount - outputs_amount;
+      txd_p.first->second.max_used_block_id = null_hash;
+      txd_p.first->second.max_used_block_height = 0;
+      txd_p.first->second.kept_by_block = kept_by_block;
+      txd_p.first->second.receive_time = time(nullptr);
+      txd_p.first->second.ready_generation = 0;
+      m_txs_by_fee.insert(get_sorted_tx_key(id, txd_p.first->second));
+      tvc.m_verifivation_impossible = true;
+      tvc.m_added_to_pool = true;
     }else
     {
       //update transactions container
@@ -166,6 +281,8 @@ namespace cryptonote
       txd_p.first->second.last_failed_height = 0;
       txd_p.first->second.last_failed_id = null_hash;
       txd_p.first->second.receive_time = time(nullptr);
+      txd_p.first->second.ready_generation = 0;
+      m_txs_by_fee.insert(get_sorted_tx_key(id, txd_p.first->second));
       tvc.m_added_to_pool = true;
 
       if(txd_p.first->second.fee > 0)
@@ -184,6 +301,15 @@ namespace cryptonote
       auto ins_res = kei_image_set.insert(id);
       CHECK_AND_ASSERT_MES(ins_res.second, false, "internal error: try to insert duplicate iterator in key_image set");
     }
+    m_txpool_size += blob_size;
+    log_add(id, m_transactions[id]);
+
+    tvc.m_pool_pruned = prune();
+    if(!m_transactions.count(id))
+    {
+      tvc.m_added_to_pool = false;
+      tvc.m_should_be_relayed = false;
+    }
 
     tvc.m_verifivation_failed = false;
     //succeed
@@ -235,14 +361,63 @@ namespace cryptonote
     tx = it->second.tx;
     blob_size = it->second.blob_size;
     fee = it->second.fee;
+    remove_tx(it);
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::remove_tx(transactions_container::iterator it)
+  {
     remove_transaction_keyimages(it->second.tx);
+    m_txs_by_fee.erase(get_sorted_tx_key(it->first, it->second));
+    m_txpool_size -= it->second.blob_size;
+    log_remove(it->first);
     m_transactions.erase(it);
-    return true;
+  }
+  //---------------------------------------------------------------------------------
+  // drops the txes paying least per byte until the pool fits its budget.
+  // Txes kept by block are left alone, they came from blocks we popped.
+  tx_memory_pool::sorted_tx_container::const_iterator tx_memory_pool::find_cheapest_evictable() const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    auto it = m_txs_by_fee.end();
+    while (it != m_txs_by_fee.begin())
+    {
+      --it;
+      auto txit = m_transactions.find(it->second);
+      if (txit != m_transactions.end() && !txit->second.kept_by_block)
+        return it;
+    }
+    return m_txs_by_fee.end();
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::prune()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    bool pruned = false;
+    auto it = m_txs_by_fee.end();
+    while (m_txpool_size > m_txpool_max_size && it != m_txs_by_fee.begin())
+    {
+      --it;
+      auto txit = m_transactions.find(it->second);
+      if (txit == m_transactions.end() || txit->second.kept_by_block)
+        continue;
+      sorted_tx_key key = *it;
+      LOG_PRINT_L2("Pruning tx " << txit->first << " from the pool, fee per byte " << key.first.first);
+      remove_tx(txit);
+      pruned = true;
+      // the next worse tx is just before where this one was
+      it = m_txs_by_fee.lower_bound(key);
+    }
+    return pruned;
   }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::on_idle()
   {
     m_remove_stuck_tx_interval.do_call([this](){return remove_stuck_transactions();});
+    m_compact_log_interval.do_call([this](){return compact_log();});
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_log.is_open())
+      m_log.flush();
   }
   //---------------------------------------------------------------------------------
   //proper tx_pool handling courtesy of CryptoZoidberg and Boolberry
@@ -257,7 +432,7 @@ namespace cryptonote
          (tx_age > CRYPTONOTE_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME && it->second.kept_by_block) )
       {
         LOG_PRINT_L1("Tx " << it->first << " removed from tx pool due to outdated, age: " << tx_age );
-        m_transactions.erase(it++);
+        remove_tx(it++);
       }else
         ++it;
     }
@@ -270,6 +445,19 @@ namespace cryptonote
     return m_transactions.size();
   }
   //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::get_transactions_size() const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    return m_txpool_size;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::set_max_size(uint64_t bytes)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_txpool_max_size = bytes;
+    prune();
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::get_transactions(std::list<transaction>& txs) const
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
@@ -289,11 +477,15 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    ++m_ready_generation;
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec(uint64_t new_block_height, const crypto::hash& top_block_id)
   {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    ++m_ready_generation;
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -375,6 +567,52 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::is_transaction_ready_to_go_cached(tx_details& txd) const
+  {
+    // readiness only depends on the chain, so it holds until the tip moves
+    if(txd.ready_generation != m_ready_generation)
+    {
+      txd.ready = is_transaction_ready_to_go(txd);
+      txd.ready_generation = m_ready_generation;
+    }
+    return txd.ready;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::sorted_tx_compare::operator()(const sorted_tx_key& a, const sorted_tx_key& b) const
+  {
+    if(a.first.first != b.first.first)
+      return a.first.first > b.first.first;
+    if(a.first.second != b.first.second)
+      return a.first.second < b.first.second;
+    return memcmp(&a.second, &b.second, sizeof(crypto::hash)) < 0;
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::sorted_tx_key tx_memory_pool::get_sorted_tx_key(const crypto::hash& id, const tx_details& txd)
+  {
+    double fee_per_byte = txd.blob_size ? txd.fee / (double)txd.blob_size : 0;
+    return sorted_tx_key(std::make_pair(fee_per_byte, txd.receive_time), id);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::rebuild_indexes()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_spent_key_images.clear();
+    m_txs_by_fee.clear();
+    m_txpool_size = 0;
+    for (transactions_container::value_type& txe : m_transactions)
+    {
+      txe.second.ready_generation = 0;
+      BOOST_FOREACH(const auto& in, txe.second.tx.vin)
+      {
+        CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, txin, false);
+        m_spent_key_images[txin.k_image].insert(txe.first);
+      }
+      m_txs_by_fee.insert(get_sorted_tx_key(txe.first, txe.second));
+      m_txpool_size += txe.second.blob_size;
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_key_images(const std::unordered_set<crypto::key_image>& k_images, const transaction& tx)
   {
     for(size_t i = 0; i!= tx.vin.size(); i++)
@@ -435,11 +673,25 @@ namespace cryptonote
     size_t max_total_size = (130 * median_size) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
     std::unordered_set<crypto::key_image> k_images;
 
-    BOOST_FOREACH(transactions_container::value_type& tx, m_transactions)
+    // Greedy by fee per byte: walk the pool best first until the block
+    // is full, or until so many txes in a row did not make it that the
+    // rest are unlikely to
+    size_t skipped = 0;
+    BOOST_FOREACH(const sorted_tx_key& key, m_txs_by_fee)
     {
+      if (skipped >= FILL_BLOCK_TEMPLATE_MAX_SKIPPED)
+        break;
+
+      auto it = m_transactions.find(key.second);
+      CHECK_AND_ASSERT_MES(it != m_transactions.end(), false, "tx " << key.second << " in fee index but not in pool");
+      transactions_container::value_type& tx = *it;
+
       // Can not exceed maximum block size
       if (max_total_size < total_size + tx.second.blob_size)
+      {
+        ++skipped;
         continue;
+      }
 
       // If adding this tx will make the block size
       // greater than CRYPTONOTE_GETBLOCKTEMPLATE_MAX
@@ -447,7 +699,10 @@ namespace cryptonote
       // keep block sizes from becoming too unwieldly
       // to propagate at 60s block times.
       if ( (total_size + tx.second.blob_size) > CRYPTONOTE_GETBLOCKTEMPLATE_MAX_BLOCK_SIZE )
+      {
+        ++skipped;
         continue;
+      }
 
       // If we've exceeded the penalty free size,
       // stop including more tx
@@ -457,9 +712,13 @@ namespace cryptonote
       // Skip transactions that are not ready to be
       // included into the blockchain or that are
       // missing key images
-      if (!is_transaction_ready_to_go(tx.second) || have_key_images(k_images, tx.second.tx))
+      if (!is_transaction_ready_to_go_cached(tx.second) || have_key_images(k_images, tx.second.tx))
+      {
+        ++skipped;
         continue;
+      }
 
+      skipped = 0;
       bl.tx_hashes.push_back(tx.first);
       total_size += tx.second.blob_size;
       fee += tx.second.fee;
@@ -474,28 +733,53 @@ namespace cryptonote
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
     m_config_folder = config_folder;
+    std::string log_file_path = config_folder + "/" + CRYPTONOTE_POOLDATA_LOG_FILENAME;
     std::string state_file_path = config_folder + "/" + CRYPTONOTE_POOLDATA_FILENAME;
     boost::system::error_code ec;
-    if(!boost::filesystem::exists(state_file_path, ec))
-      return true;
-    bool res = tools::unserialize_obj_from_file(*this, state_file_path);
-    if(!res)
+    if(boost::filesystem::exists(log_file_path, ec))
     {
-      LOG_PRINT_L1("Failed to load memory pool from file " << state_file_path);
-
-      m_transactions.clear();
-      m_spent_key_images.clear();
+      if(!load_log(log_file_path))
+      {
+        LOG_PRINT_L1("Failed to load memory pool from file " << log_file_path);
+        m_transactions.clear();
+      }
+    }
+    else if(boost::filesystem::exists(state_file_path, ec))
+    {
+      // whole pool dump from before the log
+      if(!tools::unserialize_obj_from_file(*this, state_file_path))
+      {
+        LOG_PRINT_L1("Failed to load memory pool from file " << state_file_path);
+        m_transactions.clear();
+      }
     }
 
     for (auto it = m_transactions.begin(); it != m_transactions.end(); ) {
       auto it2 = it++;
       if (it2->second.blob_size >= TRANSACTION_SIZE_LIMIT) {
-        LOG_PRINT_L1("Transaction " << get_transaction_hash(it2->second.tx) << " is too big (" << it2->second.blob_size << " bytes), removing it from pool");
-        remove_transaction_keyimages(it2->second.tx);
+        LOG_PRINT_L1("Transaction " << it2->first << " is too big (" << it2->second.blob_size << " bytes), removing it from pool");
         m_transactions.erase(it2);
       }
     }
 
+    if (!rebuild_indexes())
+    {
+      LOG_PRINT_L1("Failed to index memory pool, dropping it");
+      m_transactions.clear();
+      rebuild_indexes();
+    }
+    prune();
+
+    // start the log over from what was loaded
+    if (!tools::create_directories_if_necessary(m_config_folder))
+    {
+      LOG_PRINT_L1("Failed to create data directory: " << m_config_folder);
+      return false;
+    }
+    if (!compact_log())
+      return false;
+    boost::filesystem::remove(state_file_path, ec);
+
     // Ignore deserialization error
     return true;
   }
@@ -503,18 +787,113 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::deinit()
   {
-    if (!tools::create_directories_if_necessary(m_config_folder))
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_log.is_open())
     {
-      LOG_PRINT_L1("Failed to create data directory: " << m_config_folder);
+      m_log.close();
+      if (m_log.fail())
+        LOG_PRINT_L1("Failed to write memory pool log " << m_config_folder << "/" << CRYPTONOTE_POOLDATA_LOG_FILENAME);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::load_log(const std::string& path)
+  {
+    std::ifstream in(path, std::ios_base::binary | std::ios_base::in);
+    if (in.fail())
       return false;
+
+    uint64_t good_size = 0;
+    while (true)
+    {
+      pool_log_record_header header;
+      if (!read_log_record_header(in, header) || header.size > POOL_LOG_MAX_RECORD_SIZE)
+        break;
+      std::string payload(header.size, '\0');
+      if (header.size && !in.read(&payload[0], header.size))
+        break;
+
+      if (header.type == POOL_LOG_ADD)
+      {
+        tx_details txd;
+        if (!decode_tx_details(payload, txd))
+          break;
+        m_transactions[header.id] = txd;
+      }
+      else if (header.type == POOL_LOG_REMOVE)
+      {
+        m_transactions.erase(header.id);
+      }
+      else
+      {
+        break;
+      }
+      good_size += POOL_LOG_HEADER_SIZE + header.size;
     }
 
-    std::string state_file_path = m_config_folder + "/" + CRYPTONOTE_POOLDATA_FILENAME;
-    bool res = tools::serialize_obj_to_file(*this, state_file_path);
-    if(!res)
+    boost::system::error_code ec;
+    uint64_t file_size = boost::filesystem::file_size(path, ec);
+    if (!ec && good_size < file_size)
+      LOG_PRINT_L1("Ignoring the last " << file_size - good_size << " bytes of " << path << ", the daemon probably died while writing them");
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::write_log(const std::string& path)
+  {
+    std::ofstream out(path, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    if (out.fail())
+      return false;
+    for (const transactions_container::value_type& txe : m_transactions)
+      write_log_record(out, POOL_LOG_ADD, txe.first, encode_tx_details(txe.second));
+    out.close();
+    return !out.fail();
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::log_add(const crypto::hash& id, const tx_details& txd)
+  {
+    if (m_log.is_open())
+      m_log_size += write_log_record(m_log, POOL_LOG_ADD, id, encode_tx_details(txd));
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::log_remove(const crypto::hash& id)
+  {
+    if (m_log.is_open())
+      m_log_size += write_log_record(m_log, POOL_LOG_REMOVE, id, std::string());
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::compact_log()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_log.is_open() && m_log_size <= 2 * m_txpool_size + POOL_LOG_COMPACT_SLACK)
+      return true;
+
+    std::string log_file_path = m_config_folder + "/" + CRYPTONOTE_POOLDATA_LOG_FILENAME;
+    std::string tmp_file_path = log_file_path + ".tmp";
+    if (!write_log(tmp_file_path))
+    {
+      LOG_PRINT_L1("Failed to write memory pool log " << tmp_file_path);
+      return false;
+    }
+
+    if (m_log.is_open())
+      m_log.close();
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmp_file_path, log_file_path, ec);
+    if (ec)
     {
-      LOG_PRINT_L1("Failed to serialize memory pool to file " << state_file_path);
+      LOG_PRINT_L1("Failed to replace memory pool log " << log_file_path << ": " << ec.message());
+      return false;
+    }
+
+    m_log.clear();
+    m_log.open(log_file_path, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+    if (m_log.fail())
+    {
+      LOG_PRINT_L1("Failed to open memory pool log " << log_file_path);
+      return false;
     }
+    m_log_size = boost::filesystem::file_size(log_file_path, ec);
+    LOG_PRINT_L2("Memory pool log rewritten, " << m_transactions.size() << " txes, " << m_log_size << " bytes");
     return true;
   }
 }
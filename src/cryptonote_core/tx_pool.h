@@ -31,6 +31,7 @@
 #pragma once
 #include "include_base_utils.h"
 
+#include <fstream>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -79,10 +80,13 @@ namespace cryptonote
     // load/store operations
     bool init(const std::string& config_folder);
     bool deinit();
+    // byte budget for tx blobs, past it the lowest fee per byte txes go
+    void set_max_size(uint64_t bytes);
     bool fill_block_template(block &bl, size_t median_size, uint64_t already_generated_coins, size_t &total_size, uint64_t &fee);
     void get_transactions(std::list<transaction>& txs) const;
     bool get_transaction(const crypto::hash& h, transaction& tx) const;
     size_t get_transactions_count() const;
+    uint64_t get_transactions_size() const;
     std::string print_pool(bool short_format) const;
 
     /*bool flush_pool(const std::strig& folder);
@@ -112,6 +116,10 @@ namespace cryptonote
       uint64_t last_failed_height;
       crypto::hash last_failed_id;
       time_t receive_time;
+      // cached is_transaction_ready_to_go result, valid while
+      // ready_generation matches the pool's m_ready_generation
+      uint64_t ready_generation;
+      bool ready;
     };
 
   private:
@@ -123,13 +131,48 @@ namespace cryptonote
     static bool append_key_images(std::unordered_set<crypto::key_image>& kic, const transaction& tx);
 
     bool is_transaction_ready_to_go(tx_details& txd) const;
+    bool is_transaction_ready_to_go_cached(tx_details& txd) const;
     typedef std::unordered_map<crypto::hash, tx_details > transactions_container;
     typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
 
+    // index of the pool for block templates, best first: highest fee per
+    // byte, then earliest received, then tx id to keep keys unique
+    typedef std::pair<std::pair<double, time_t>, crypto::hash> sorted_tx_key;
+    struct sorted_tx_compare
+    {
+      bool operator()(const sorted_tx_key& a, const sorted_tx_key& b) const;
+    };
+    typedef std::set<sorted_tx_key, sorted_tx_compare> sorted_tx_container;
+
+    static sorted_tx_key get_sorted_tx_key(const crypto::hash& id, const tx_details& txd);
+    bool rebuild_indexes();
+    void remove_tx(transactions_container::iterator it);
+    // the lowest fee per byte tx which prune() may drop, end() if none
+    sorted_tx_container::const_iterator find_cheapest_evictable() const;
+    // returns whether any tx was dropped
+    bool prune();
+
+    // The pool is persisted as a log of added and removed txes, appended
+    // to as the pool changes and rewritten from the pool when it gets
+    // much bigger than the pool itself.
+    bool load_log(const std::string& path);
+    bool write_log(const std::string& path);
+    void log_add(const crypto::hash& id, const tx_details& txd);
+    void log_remove(const crypto::hash& id);
+    bool compact_log();
+
     mutable epee::critical_section m_transactions_lock;
     transactions_container m_transactions;
     key_images_container m_spent_key_images;
+    sorted_tx_container m_txs_by_fee;
+    // bumped whenever the chain tip changes, invalidating tx_details::ready
+    uint64_t m_ready_generation;
+    uint64_t m_txpool_size;
+    uint64_t m_txpool_max_size;
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
+    std::ofstream m_log;
+    uint64_t m_log_size;
+    epee::math_helper::once_a_time_seconds<60> m_compact_log_interval;
 
     //transactions_container m_alternative_transactions;
 
@@ -29,6 +29,8 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #pragma once
+#include "crypto/hash.h"
+
 namespace cryptonote
 {
   /************************************************************************/
@@ -40,6 +42,8 @@ namespace cryptonote
     bool m_verifivation_failed; //bad tx, should drop connection
     bool m_verifivation_impossible; //the transaction is related with an alternative blockchain
     bool m_added_to_pool; 
+    bool m_pool_pruned; //other txes were dropped from the full pool, maybe this one too
+    bool m_fee_too_low; //not added, the pool is full and the fee per byte is too low to get in
   };
 
   struct block_verification_context
@@ -48,5 +52,6 @@ namespace cryptonote
     bool m_verifivation_failed; //bad block, should drop connection
     bool m_marked_as_orphaned;
     bool m_already_exists;
+    crypto::hash m_block_id; //set once the block is parsed, so callers needn't hash it again
   };
 }
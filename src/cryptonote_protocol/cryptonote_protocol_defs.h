@@ -70,6 +70,9 @@ namespace cryptonote
 	uint64_t avg_upload;
 	uint64_t current_upload;
 
+    uint64_t send_queue_depth;
+    uint64_t send_bytes_in_flight;
+
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(incoming)
       KV_SERIALIZE(localhost)
@@ -87,6 +90,8 @@ namespace cryptonote
       KV_SERIALIZE(current_download)
       KV_SERIALIZE(avg_upload)
       KV_SERIALIZE(current_upload)
+      KV_SERIALIZE(send_queue_depth)
+      KV_SERIALIZE(send_bytes_in_flight)
     END_KV_SERIALIZE_MAP()
   };
 
@@ -118,7 +118,7 @@ namespace cryptonote
 
 
     //----------------- i_bc_protocol_layout ---------------------------------------
-    virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
+    virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, const crypto::hash& block_id, cryptonote_connection_context& exclude_context);
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context);
     //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
@@ -149,12 +149,24 @@ namespace cryptonote
       }
 
       template<class t_parametr>
-      bool relay_post_notify(typename t_parametr::request& arg, cryptonote_connection_context& exlude_context)
+      bool relay_post_notify(typename t_parametr::request& arg, cryptonote_connection_context& exlude_context, const std::list<crypto::hash>& inventory)
       {
         LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(exlude_context) << "] post relay " << typeid(t_parametr).name() << " -->");
+        exlude_context.m_known_inventory.add(inventory);
+        //pick the peers which don't know all of the relayed objects yet, and remember they do from now on
+        std::list<boost::uuids::uuid> connections;
+        m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id)->bool
+        {
+          if(peer_id && context.m_connection_id != exlude_context.m_connection_id && context.m_known_inventory.add(inventory))
+            connections.push_back(context.m_connection_id);
+          return true;
+        });
+        if(connections.empty())
+          return true;
+        //serialized once, the same buffer goes to every selected peer
         std::string arg_buff;
         epee::serialization::store_t_to_binary(arg, arg_buff);
-        return m_p2p->relay_notify_to_all(t_parametr::ID, arg_buff, exlude_context);
+        return m_p2p->relay_notify_to_list(t_parametr::ID, arg_buff, connections);
       }
 
 			virtual std::ofstream& get_logreq() const ;
@@ -245,6 +245,9 @@ namespace cryptonote
 
 	  cnx.current_download = cntxt.m_current_speed_down / 1024;
 	  cnx.current_upload = cntxt.m_current_speed_up / 1024;
+
+      cnx.send_queue_depth = cntxt.m_send_queue_depth;
+      cnx.send_bytes_in_flight = cntxt.m_send_bytes_in_flight;
 	  
       connections.push_back(cnx);
 
@@ -315,6 +318,11 @@ namespace cryptonote
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
 
+    std::list<crypto::hash> announced;
+    for(auto tx_blob_it = arg.b.txs.begin(); tx_blob_it!=arg.b.txs.end();tx_blob_it++)
+      announced.push_back(get_blob_hash(*tx_blob_it));
+    context.m_known_inventory.add(announced);
+
     for(auto tx_blob_it = arg.b.txs.begin(); tx_blob_it!=arg.b.txs.end();tx_blob_it++)
     {
       cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
@@ -342,7 +350,7 @@ namespace cryptonote
     {
       ++arg.hop;
       //TODO: Add here announce protocol usage
-      relay_block(arg, context);
+      relay_block(arg, bvc.m_block_id, context);
     }else if(bvc.m_marked_as_orphaned)
     {
       context.m_state = cryptonote_connection_context::state_synchronizing;
@@ -362,6 +370,11 @@ namespace cryptonote
     if(context.m_state != cryptonote_connection_context::state_normal)
       return 1;
 
+    std::list<crypto::hash> announced;
+    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end();tx_blob_it++)
+      announced.push_back(get_blob_hash(*tx_blob_it));
+    context.m_known_inventory.add(announced);
+
     for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end();)
     {
       cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
@@ -535,8 +548,15 @@ namespace cryptonote
 			LOG_PRINT_CCONTEXT_YELLOW( "Got NEW BLOCKS inside of " << __FUNCTION__ << ": size: " << arg.blocks.size() , LOG_LEVEL_0);
 			
       if (m_core.get_test_drop_download() && m_core.get_test_drop_download_height()) { // DISCARD BLOCKS for testing
-				
-				
+
+		  // parse and check signatures for the whole batch up front, the
+		  // loop below then only has to do the serialized db work
+		  std::vector<transaction> parsed_txs;
+		  m_core.prepare_handle_incoming_blocks(arg.blocks, parsed_txs);
+		  epee::misc_utils::auto_scope_leave_caller cleanup_handler = epee::misc_utils::create_scope_leave_handler(
+		    boost::bind(&t_core::cleanup_handle_incoming_blocks, &m_core));
+
+		  size_t tx_index = 0;
 		  BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
 		  {
 			// process transactions
@@ -544,7 +564,11 @@ namespace cryptonote
 			BOOST_FOREACH(auto& tx_blob, block_entry.txs)
 			{
 			  tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-			  m_core.handle_incoming_tx(tx_blob, tvc, true);
+			  if(tx_index < parsed_txs.size())
+			    m_core.handle_incoming_tx(tx_blob, parsed_txs[tx_index], tvc, true);
+			  else
+			    m_core.handle_incoming_tx(tx_blob, tvc, true);
+			  ++tx_index;
 			  if(tvc.m_verifivation_failed)
 			  {
 				LOG_ERROR_CCONTEXT("transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = " 
@@ -753,15 +777,20 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
-  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, const crypto::hash& block_id, cryptonote_connection_context& exclude_context)
   {
-    return relay_post_notify<NOTIFY_NEW_BLOCK>(arg, exclude_context);
+    std::list<crypto::hash> inventory;
+    inventory.push_back(block_id);
+    return relay_post_notify<NOTIFY_NEW_BLOCK>(arg, exclude_context, inventory);
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)
   {
-    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+    std::list<crypto::hash> inventory;
+    BOOST_FOREACH(const blobdata& tx_blob, arg.txs)
+      inventory.push_back(get_blob_hash(tx_blob));
+    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context, inventory);
   }
 
 	/// @deprecated
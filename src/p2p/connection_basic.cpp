@@ -155,6 +155,9 @@ connection_basic::connection_basic(boost::asio::io_service& io_service, std::ato
 	socket_(io_service),
 	m_want_close_connection(false), 
 	m_was_shutdown(false),
+	m_send_que_in_flight(0),
+	m_send_que_bytes(0),
+	m_send_que_bytes_in_flight(0),
 	m_ref_sock_count(ref_sock_count)
 { 
 	++ref_sock_count; // increase the global counter
@@ -49,6 +49,7 @@
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 #include <atomic>
+#include <deque>
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
@@ -83,6 +84,16 @@ class connection_basic_pimpl; // PIMPL for this class
   
   std::string to_string(t_connection_type type);
 
+  /// one piece of outgoing data; the buffer is immutable and may be shared by several connections
+  struct send_que_entry
+  {
+    boost::shared_ptr<const std::string> buffer;
+    size_t offset;
+    size_t size;
+
+    const char* data() const { return buffer->data() + offset; }
+  };
+
 class connection_basic { // not-templated base class for rapid developmet of some code parts
 	public:
 		std::unique_ptr< connection_basic_pimpl > mI; // my Implementation
@@ -91,7 +102,10 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    std::deque<send_que_entry> m_send_que;
+    size_t m_send_que_in_flight; // number of entries at the front of m_send_que that the current async_write is sending
+    uint64_t m_send_que_bytes; // total bytes in m_send_que
+    uint64_t m_send_que_bytes_in_flight; // bytes in the entries being sent
     volatile bool m_is_multithreaded;
     double m_start_time;
     /// Strand to ensure the connection's handlers are not called concurrently.
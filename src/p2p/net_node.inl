@@ -1133,9 +1133,17 @@ namespace nodetool
       return true;
     });
 
+    return relay_notify_to_list(command, data_buff, connections);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const std::string& data_buff, const std::list<net_connection_id>& connections)
+  {
+    // frame the payload once, every connection queues the same buffer
+    boost::shared_ptr<const std::string> packet = m_net_server.get_config_object().make_notify_packet(command, data_buff);
     BOOST_FOREACH(const auto& c_id, connections)
     {
-      m_net_server.get_config_object().notify(command, data_buff, c_id);
+      m_net_server.get_config_object().notify_packet(packet, c_id);
     }
     return true;
   }
@@ -41,9 +41,38 @@ using namespace epee;
 #include "crypto/hash.h"
 #include "core_rpc_server_error_codes.h"
 #include "daemon/command_line_args.h"
+#if BLOCKCHAIN_DB == DB_LMDB
+#include "blockchain_db/lmdb/db_lmdb.h"
+#endif
 
 namespace cryptonote
 {
+  namespace
+  {
+    // longest a getblocktemplate long poll may block, in seconds
+    const uint64_t GETBLOCKTEMPLATE_LONG_POLL_MAX_TIMEOUT = 60;
+    // how long a request over its method's concurrency limit may wait for a slot
+    const uint64_t RPC_REQUEST_QUEUE_TIMEOUT = 2000;
+    // methods whose cost grows with the request, and which get a share of
+    // the rpc threads instead of all of them
+    const char* const RPC_LIMITED_METHODS[] = {"getblocks.bin", "get_o_indexes.bin", "getrandom_outs.bin", "gettransactions", "get_transaction_pool"};
+
+    // memory map figures of the db, left at 0 for backends without one
+    void fill_db_map_info(core& c, COMMAND_RPC_GET_INFO::response& res)
+    {
+      res.db_map_size = res.db_map_used = res.db_map_resizes = res.db_map_full_retries = 0;
+#if BLOCKCHAIN_DB == DB_LMDB
+      const BlockchainLMDB* db = dynamic_cast<const BlockchainLMDB*>(&c.get_blockchain_storage().get_db());
+      if (db)
+      {
+        res.db_map_size = db->get_map_size();
+        res.db_map_used = db->get_map_used();
+        res.db_map_resizes = db->get_map_resize_count();
+        res.db_map_full_retries = db->get_map_full_retry_count();
+      }
+#endif
+    }
+  }
 
   //-----------------------------------------------------------------------------------
   void core_rpc_server::init_options(boost::program_options::options_description& desc)
@@ -51,6 +80,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
     command_line::add_arg(desc, arg_testnet_rpc_bind_port);
+    command_line::add_arg(desc, arg_rpc_threads);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   core_rpc_server::core_rpc_server(
@@ -59,6 +89,9 @@ namespace cryptonote
     )
     : m_core(cr)
     , m_p2p(p2p)
+    , m_long_polls(0)
+    , m_max_long_polls(1)
+    , m_threads_count(2)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::handle_command_line(
@@ -69,6 +102,18 @@ namespace cryptonote
 
     m_bind_ip = command_line::get_arg(vm, arg_rpc_bind_ip);
     m_port = command_line::get_arg(vm, p2p_bind_arg);
+
+    m_threads_count = command_line::get_arg(vm, arg_rpc_threads);
+    if (!m_threads_count)
+      m_threads_count = std::max(2u, boost::thread::hardware_concurrency());
+
+    // limited methods get half the threads each, and together may hold all
+    // but one of them (running or queued), so cheap calls always get through
+    m_request_limiter.set_max_pending(std::max<size_t>(1, m_threads_count - 1));
+    for (const char* method : RPC_LIMITED_METHODS)
+      m_request_limiter.set_limit(method, std::max<size_t>(1, m_threads_count / 2));
+    // long polls hold an rpc thread, so leave at least one free for others
+    m_max_long_polls = std::max<size_t>(1, m_threads_count - 1);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -103,10 +148,22 @@ namespace cryptonote
     return check_core_busy();
   }
 #define CHECK_CORE_READY() do { if(!check_core_ready()){res.status =  CORE_RPC_STATUS_BUSY;return true;} } while(0)
+#define TRACK_RPC_REQUEST(method) rpc_request_guard rpc_guard(m_request_limiter, method, RPC_REQUEST_QUEUE_TIMEOUT); \
+  do { if(!rpc_guard.entered()){res.status =  CORE_RPC_STATUS_BUSY;return true;} } while(0)
+#define TRACK_JSON_RPC_REQUEST(method) rpc_request_guard rpc_guard(m_request_limiter, method, RPC_REQUEST_QUEUE_TIMEOUT); \
+  do { if(!rpc_guard.entered()){error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;error_resp.message = "Server is busy.";return false;} } while(0)
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_cached_response(const std::string& key, std::string& body, uint64_t& version)
+  {
+    // read before the response is built, so a change while we build isn't cached over
+    version = m_core.get_block_template_version();
+    return m_response_cache.get(key, version, body);
+  }
 
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res)
   {
+    TRACK_RPC_REQUEST("getheight");
     CHECK_CORE_BUSY();
     res.height = m_core.get_current_blockchain_height();
     res.status = CORE_RPC_STATUS_OK;
@@ -115,24 +172,28 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_info(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res)
   {
+    TRACK_RPC_REQUEST("getinfo");
     CHECK_CORE_BUSY();
     res.height = m_core.get_current_blockchain_height();
     res.target_height = m_core.get_target_blockchain_height();
     res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block();
     res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
     res.tx_pool_size = m_core.get_pool_transactions_count();
+    res.tx_pool_bytes = m_core.get_pool_transactions_size();
     res.alt_blocks_count = m_core.get_blockchain_storage().get_alternative_blocks_count();
     uint64_t total_conn = m_p2p.get_connections_count();
     res.outgoing_connections_count = m_p2p.get_outgoing_connections_count();
     res.incoming_connections_count = total_conn - res.outgoing_connections_count;
     res.white_peerlist_size = m_p2p.get_peerlist_manager().get_white_peers_count();
     res.grey_peerlist_size = m_p2p.get_peerlist_manager().get_gray_peers_count();
+    fill_db_map_info(m_core, res);
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res)
   {
+    TRACK_RPC_REQUEST("getblocks.bin");
     CHECK_CORE_BUSY();
     std::list<std::pair<block, std::list<transaction> > > bs;
 
@@ -142,15 +203,31 @@ namespace cryptonote
       return false;
     }
 
+    // send the output indices along so wallets don't need a get_o_indexes.bin
+    // call for every tx paying them
+    bool have_indices = true;
+    res.output_indices.reserve(bs.size());
     BOOST_FOREACH(auto& b, bs)
     {
       res.blocks.resize(res.blocks.size()+1);
       res.blocks.back().block = block_to_blob(b.first);
+      res.output_indices.resize(res.output_indices.size()+1);
+      auto& indices = res.output_indices.back().indices;
+      indices.resize(b.second.size() + 1);
+      if (have_indices)
+        have_indices = m_core.get_tx_outputs_gindexs(get_transaction_hash(b.first.miner_tx), indices[0].indices);
+      size_t i = 1;
       BOOST_FOREACH(auto& t, b.second)
       {
         res.blocks.back().txs.push_back(tx_to_blob(t));
+        if (have_indices)
+          have_indices = m_core.get_tx_outputs_gindexs(get_transaction_hash(t), indices[i].indices);
+        ++i;
       }
     }
+    // the chain may have changed under us; the wallet then asks per tx
+    if (!have_indices)
+      res.output_indices.clear();
 
     res.status = CORE_RPC_STATUS_OK;
     return true;
@@ -158,6 +235,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res)
   {
+    TRACK_RPC_REQUEST("getrandom_outs.bin");
     CHECK_CORE_BUSY();
     res.status = "Failed";
     if(!m_core.get_random_outs_for_amounts(req, res))
@@ -187,6 +265,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_indexes(const COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& req, COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& res)
   {
+    TRACK_RPC_REQUEST("get_o_indexes.bin");
     CHECK_CORE_BUSY();
     bool r = m_core.get_tx_outputs_gindexs(req.txid, res.o_indexes);
     if(!r)
@@ -201,6 +280,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_transactions(const COMMAND_RPC_GET_TRANSACTIONS::request& req, COMMAND_RPC_GET_TRANSACTIONS::response& res)
   {
+    TRACK_RPC_REQUEST("gettransactions");
     CHECK_CORE_BUSY();
     std::vector<crypto::hash> vh;
     BOOST_FOREACH(const auto& tx_hex_str, req.txs_hashes)
@@ -243,6 +323,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_send_raw_tx(const COMMAND_RPC_SEND_RAW_TX::request& req, COMMAND_RPC_SEND_RAW_TX::response& res)
   {
+    TRACK_RPC_REQUEST("sendrawtransaction");
     CHECK_CORE_READY();
 
     std::string tx_blob;
@@ -269,6 +350,13 @@ namespace cryptonote
       return true;
     }
 
+    if(tvc.m_fee_too_low)
+    {
+      LOG_PRINT_L0("[on_send_raw_tx]: tx not added, the pool is full and its fee is too low");
+      res.status = "Failed, fee too low for a full pool";
+      return true;
+    }
+
     if(!tvc.m_should_be_relayed)
     {
       LOG_PRINT_L0("[on_send_raw_tx]: tx accepted, but not relayed");
@@ -401,6 +489,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_transaction_pool(const COMMAND_RPC_GET_TRANSACTION_POOL::request& req, COMMAND_RPC_GET_TRANSACTION_POOL::response& res)
   {
+    TRACK_RPC_REQUEST("get_transaction_pool");
     /*
     CHECK_CORE_BUSY();
     res.transactions = m_core.transaction_pool_info();
@@ -420,6 +509,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_getblockcount(const COMMAND_RPC_GETBLOCKCOUNT::request& req, COMMAND_RPC_GETBLOCKCOUNT::response& res)
   {
+    TRACK_RPC_REQUEST("getblockcount");
     CHECK_CORE_BUSY();
     res.count = m_core.get_current_blockchain_height();
     res.status = CORE_RPC_STATUS_OK;
@@ -428,6 +518,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_getblockhash(const COMMAND_RPC_GETBLOCKHASH::request& req, COMMAND_RPC_GETBLOCKHASH::response& res, epee::json_rpc::error& error_resp)
   {
+    TRACK_JSON_RPC_REQUEST("on_getblockhash");
     if(!check_core_busy())
     {
       error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
@@ -469,6 +560,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_getblocktemplate(const COMMAND_RPC_GETBLOCKTEMPLATE::request& req, COMMAND_RPC_GETBLOCKTEMPLATE::response& res, epee::json_rpc::error& error_resp)
   {
+    TRACK_JSON_RPC_REQUEST("getblocktemplate");
     if(!check_core_ready())
     {
       error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
@@ -492,9 +584,24 @@ namespace cryptonote
       return false;
     }
 
+    // long poll: if the caller already has the current template, hold the
+    // request until it changes.  When too many are waiting already, answer
+    // right away and let the caller come back.
+    if(req.long_poll_version && m_long_polls.fetch_add(1) < m_max_long_polls)
+    {
+      uint64_t timeout = req.long_poll_timeout ? std::min(req.long_poll_timeout, GETBLOCKTEMPLATE_LONG_POLL_MAX_TIMEOUT) : GETBLOCKTEMPLATE_LONG_POLL_MAX_TIMEOUT;
+      m_core.wait_block_template_change(req.long_poll_version, timeout * 1000);
+      --m_long_polls;
+    }
+    else if(req.long_poll_version)
+    {
+      --m_long_polls;
+    }
+
     block b = AUTO_VAL_INIT(b);
     cryptonote::blobdata blob_reserve;
     blob_reserve.resize(req.reserve_size, 0);
+    res.template_version = m_core.get_block_template_version();
     if(!m_core.get_block_template(b, acc, res.difficulty, res.height, blob_reserve))
     {
       error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
@@ -535,6 +642,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_submitblock(const COMMAND_RPC_SUBMITBLOCK::request& req, COMMAND_RPC_SUBMITBLOCK::response& res, epee::json_rpc::error& error_resp)
   {
+    TRACK_JSON_RPC_REQUEST("submitblock");
     CHECK_CORE_READY();
     if(req.size()!=1)
     {
@@ -607,6 +715,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_last_block_header(const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res, epee::json_rpc::error& error_resp)
   {
+    TRACK_JSON_RPC_REQUEST("getlastblockheader");
     if(!check_core_busy())
     {
       error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
@@ -642,6 +751,7 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_block_header_by_hash(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::response& res, epee::json_rpc::error& error_resp){
+    TRACK_JSON_RPC_REQUEST("getblockheaderbyhash");
     if(!check_core_busy())
     {
       error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
@@ -683,6 +793,7 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res, epee::json_rpc::error& error_resp){
+    TRACK_JSON_RPC_REQUEST("getblockheaderbyheight");
     if(!check_core_busy())
     {
       error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
@@ -717,6 +828,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_connections(const COMMAND_RPC_GET_CONNECTIONS::request& req, COMMAND_RPC_GET_CONNECTIONS::response& res, epee::json_rpc::error& error_resp)
   {
+    TRACK_JSON_RPC_REQUEST("get_connections");
     if(!check_core_busy())
     {
       error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
@@ -733,6 +845,7 @@ namespace cryptonote
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_info_json(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res, epee::json_rpc::error& error_resp)
   {
+    TRACK_JSON_RPC_REQUEST("get_info");
     if(!check_core_busy())
     {
       error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
@@ -745,12 +858,14 @@ namespace cryptonote
     res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block();
     res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
     res.tx_pool_size = m_core.get_pool_transactions_count();
+    res.tx_pool_bytes = m_core.get_pool_transactions_size();
     res.alt_blocks_count = m_core.get_blockchain_storage().get_alternative_blocks_count();
     uint64_t total_conn = m_p2p.get_connections_count();
     res.outgoing_connections_count = m_p2p.get_outgoing_connections_count();
     res.incoming_connections_count = total_conn - res.outgoing_connections_count;
     res.white_peerlist_size = m_p2p.get_peerlist_manager().get_white_peers_count();
     res.grey_peerlist_size = m_p2p.get_peerlist_manager().get_gray_peers_count();
+    fill_db_map_info(m_core, res);
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -794,6 +909,26 @@ namespace cryptonote
 	  return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_rpc_stats(const COMMAND_RPC_GET_RPC_STATS::request& req, COMMAND_RPC_GET_RPC_STATS::response& res)
+  {
+    res.threads = m_threads_count;
+    // not in get_info, whose cached responses would freeze them
+    res.cache_hits = m_response_cache.get_hits();
+    res.cache_misses = m_response_cache.get_misses();
+    for (const auto& s : m_request_limiter.get_stats())
+    {
+      rpc_method_stats ms;
+      ms.method = s.method;
+      ms.count = s.count;
+      ms.busy = s.busy;
+      ms.total_ms = s.total_ms;
+      ms.latency_histogram = s.latency_histogram;
+      res.methods.push_back(ms);
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
 
   const command_line::arg_descriptor<std::string> core_rpc_server::arg_rpc_bind_ip   = {
       "rpc-bind-ip"
@@ -813,4 +948,10 @@ namespace cryptonote
     , std::to_string(config::testnet::RPC_DEFAULT_PORT)
     };
 
+  const command_line::arg_descriptor<unsigned int> core_rpc_server::arg_rpc_threads = {
+      "rpc-threads"
+    , "Number of threads serving RPC requests, 0 to use all cores (at least 2)"
+    , 0
+    };
+
 }  // namespace cryptonote
@@ -74,18 +74,40 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
 
+    // the amount output indices of one tx's outputs, as get_o_indexes.bin returns them
+    struct tx_output_indices
+    {
+      std::vector<uint64_t> indices;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(indices)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    // one entry per tx of a block, miner tx first
+    struct block_output_indices
+    {
+      std::vector<tx_output_indices> indices;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(indices)
+      END_KV_SERIALIZE_MAP()
+    };
+
     struct response
     {
       std::list<block_complete_entry> blocks;
       uint64_t    start_height;
       uint64_t    current_height;
       std::string status;
+      std::vector<block_output_indices> output_indices; // one per block, empty if unavailable
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(blocks)
         KV_SERIALIZE(start_height)
         KV_SERIALIZE(current_height)
         KV_SERIALIZE(status)
+        KV_SERIALIZE(output_indices)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -246,11 +268,16 @@ namespace cryptonote
       uint64_t difficulty;
       uint64_t tx_count;
       uint64_t tx_pool_size;
+      uint64_t tx_pool_bytes;
       uint64_t alt_blocks_count;
       uint64_t outgoing_connections_count;
       uint64_t incoming_connections_count;
       uint64_t white_peerlist_size;
       uint64_t grey_peerlist_size;
+      uint64_t db_map_size;
+      uint64_t db_map_used;
+      uint64_t db_map_resizes;
+      uint64_t db_map_full_retries;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
@@ -259,11 +286,16 @@ namespace cryptonote
         KV_SERIALIZE(difficulty)
         KV_SERIALIZE(tx_count)
         KV_SERIALIZE(tx_pool_size)
+        KV_SERIALIZE(tx_pool_bytes)
         KV_SERIALIZE(alt_blocks_count)
         KV_SERIALIZE(outgoing_connections_count)
         KV_SERIALIZE(incoming_connections_count)
         KV_SERIALIZE(white_peerlist_size)
         KV_SERIALIZE(grey_peerlist_size)
+        KV_SERIALIZE(db_map_size)
+        KV_SERIALIZE(db_map_used)
+        KV_SERIALIZE(db_map_resizes)
+        KV_SERIALIZE(db_map_full_retries)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -372,10 +404,14 @@ namespace cryptonote
     {
       uint64_t reserve_size;       //max 255 bytes
       std::string wallet_address;
+      uint64_t long_poll_version;  //if set and still current, wait for the template to change
+      uint64_t long_poll_timeout;  //seconds, capped by the daemon
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(reserve_size)
         KV_SERIALIZE(wallet_address)
+        KV_SERIALIZE(long_poll_version)
+        KV_SERIALIZE(long_poll_timeout)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -386,6 +422,7 @@ namespace cryptonote
       uint64_t reserved_offset;
       std::string prev_hash;
       blobdata blocktemplate_blob;
+      uint64_t template_version;
       std::string status;
 
       BEGIN_KV_SERIALIZE_MAP()
@@ -394,6 +431,7 @@ namespace cryptonote
         KV_SERIALIZE(reserved_offset)
         KV_SERIALIZE(prev_hash)
         KV_SERIALIZE(blocktemplate_blob)
+        KV_SERIALIZE(template_version)
         KV_SERIALIZE(status)
       END_KV_SERIALIZE_MAP()
     };
@@ -777,5 +815,47 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
   };
-}
 
+  struct rpc_method_stats
+  {
+    std::string method;
+    uint64_t count;
+    uint64_t busy;              //requests answered BUSY
+    uint64_t total_ms;
+    std::vector<uint64_t> latency_histogram; //latency_histogram[i]: requests under 2^i ms, last one the rest
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(method)
+      KV_SERIALIZE(count)
+      KV_SERIALIZE(busy)
+      KV_SERIALIZE(total_ms)
+      KV_SERIALIZE(latency_histogram)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_GET_RPC_STATS
+  {
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t threads;
+      uint64_t cache_hits;
+      uint64_t cache_misses;
+      std::list<rpc_method_stats> methods;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(threads)
+        KV_SERIALIZE(cache_hits)
+        KV_SERIALIZE(cache_misses)
+        KV_SERIALIZE(methods)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "misc_log_ex.h"
+#include "rpc_request_limiter.h"
+
+namespace cryptonote
+{
+  const size_t rpc_request_limiter::LATENCY_BUCKETS;
+  //---------------------------------------------------------------------------------
+  rpc_request_limiter::rpc_request_limiter(): m_max_pending(1), m_pending(0)
+  {
+  }
+  //---------------------------------------------------------------------------------
+  void rpc_request_limiter::set_max_pending(size_t max_pending)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    m_max_pending = max_pending;
+  }
+  //---------------------------------------------------------------------------------
+  void rpc_request_limiter::set_limit(const std::string& method, size_t max_concurrent)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    m_methods[method].limit = max_concurrent;
+  }
+  //---------------------------------------------------------------------------------
+  bool rpc_request_limiter::enter(const std::string& method, uint64_t timeout_ms)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    method_state& m = m_methods[method];
+    if (!m.limit)
+    {
+      ++m.running;
+      return true;
+    }
+
+    if (m_pending >= m_max_pending)
+    {
+      ++m.busy;
+      return false;
+    }
+    ++m_pending;
+
+    boost::system_time deadline = boost::get_system_time() + boost::posix_time::milliseconds(timeout_ms);
+    while (m.running >= m.limit)
+    {
+      if (!m_slot_freed.timed_wait(lock, deadline) && m.running >= m.limit)
+      {
+        --m_pending;
+        ++m.busy;
+        return false;
+      }
+    }
+    ++m.running;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void rpc_request_limiter::leave(const std::string& method, uint64_t elapsed_ms)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    method_state& m = m_methods[method];
+    --m.running;
+    if (m.limit)
+    {
+      --m_pending;
+      m_slot_freed.notify_all();
+    }
+
+    ++m.count;
+    m.total_ms += elapsed_ms;
+    size_t bucket = 0;
+    while (bucket + 1 < LATENCY_BUCKETS && elapsed_ms >= (1ull << bucket))
+      ++bucket;
+    ++m.latency_histogram[bucket];
+  }
+  //---------------------------------------------------------------------------------
+  std::vector<rpc_request_limiter::method_stats> rpc_request_limiter::get_stats() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    std::vector<method_stats> stats;
+    stats.reserve(m_methods.size());
+    for (const auto& m : m_methods)
+    {
+      method_stats s;
+      s.method = m.first;
+      s.count = m.second.count;
+      s.busy = m.second.busy;
+      s.total_ms = m.second.total_ms;
+      s.latency_histogram = m.second.latency_histogram;
+      stats.push_back(s);
+    }
+    return stats;
+  }
+  //---------------------------------------------------------------------------------
+  rpc_request_guard::rpc_request_guard(rpc_request_limiter& limiter, const std::string& method, uint64_t timeout_ms):
+    m_limiter(limiter), m_method(method), m_start(epee::misc_utils::get_tick_count())
+  {
+    m_entered = m_limiter.enter(m_method, timeout_ms);
+  }
+  //---------------------------------------------------------------------------------
+  rpc_request_guard::~rpc_request_guard()
+  {
+    if (m_entered)
+      m_limiter.leave(m_method, epee::misc_utils::get_tick_count() - m_start);
+  }
+}
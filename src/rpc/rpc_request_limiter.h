@@ -0,0 +1,115 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Admission control and latency accounting for rpc methods.
+  //
+  // A method can be given a limit on how many of its requests run at once,
+  // so that slow calls (getrandom_outs.bin, gettransactions with many
+  // txes) can't take every rpc thread away from cheap ones.  A request over
+  // its method's limit waits for a slot, but only if fewer than
+  // max_pending limited requests are already running or waiting; otherwise,
+  // or if no slot frees up in time, it is turned away and the caller
+  // answers BUSY.
+  class rpc_request_limiter
+  {
+  public:
+    // bucket i counts requests which took less than 2^i ms, the last one
+    // everything slower
+    static const size_t LATENCY_BUCKETS = 14;
+
+    struct method_stats
+    {
+      std::string method;
+      uint64_t count;
+      uint64_t busy;
+      uint64_t total_ms;
+      std::vector<uint64_t> latency_histogram;
+    };
+
+    rpc_request_limiter();
+
+    void set_max_pending(size_t max_pending);
+    // 0 for no limit
+    void set_limit(const std::string& method, size_t max_concurrent);
+
+    // takes a slot of the method, waiting at most timeout_ms for one.
+    // Returns false if the request should be answered BUSY instead.
+    bool enter(const std::string& method, uint64_t timeout_ms);
+    // gives back a slot taken by enter, and records the request's latency
+    void leave(const std::string& method, uint64_t elapsed_ms);
+
+    std::vector<method_stats> get_stats() const;
+
+  private:
+    struct method_state
+    {
+      method_state(): limit(0), running(0), count(0), busy(0), total_ms(0), latency_histogram(LATENCY_BUCKETS, 0) {}
+
+      size_t limit;
+      size_t running;
+      uint64_t count;
+      uint64_t busy;
+      uint64_t total_ms;
+      std::vector<uint64_t> latency_histogram;
+    };
+
+    mutable boost::mutex m_lock;
+    boost::condition_variable m_slot_freed;
+    std::map<std::string, method_state> m_methods;
+    size_t m_max_pending;
+    size_t m_pending;
+  };
+
+  // enters the limiter for the lifetime of a request
+  class rpc_request_guard
+  {
+  public:
+    rpc_request_guard(rpc_request_limiter& limiter, const std::string& method, uint64_t timeout_ms);
+    ~rpc_request_guard();
+
+    bool entered() const { return m_entered; }
+
+  private:
+    rpc_request_limiter& m_limiter;
+    std::string m_method;
+    uint64_t m_start;
+    bool m_entered;
+  };
+}
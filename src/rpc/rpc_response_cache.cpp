@@ -0,0 +1,126 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "rpc_response_cache.h"
+
+namespace cryptonote
+{
+  namespace
+  {
+    // bounds how stale fields not covered by the version can get
+    const time_t RPC_RESPONSE_CACHE_MAX_AGE = 5;
+    // keys and bodies together
+    const size_t RPC_RESPONSE_CACHE_MAX_BYTES = 16 * 1024 * 1024;
+    // bigger responses (getblocks.bin far from the tip) are not worth keeping
+    const size_t RPC_RESPONSE_CACHE_MAX_ENTRY_BYTES = 1024 * 1024;
+  }
+  //---------------------------------------------------------------------------------
+  rpc_response_cache::rpc_response_cache(): m_version(0), m_bytes(0), m_hits(0), m_misses(0)
+  {
+  }
+  //---------------------------------------------------------------------------------
+  bool rpc_response_cache::get(const std::string& key, uint64_t version, std::string& body)
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    if (version > m_version)
+    {
+      // everything we have was built for an older chain or pool
+      clear();
+      m_version = version;
+    }
+
+    auto it = m_index.find(key);
+    if (version != m_version || it == m_index.end())
+    {
+      ++m_misses;
+      return false;
+    }
+    if (time(NULL) - it->second->created > RPC_RESPONSE_CACHE_MAX_AGE)
+    {
+      erase(it->second);
+      ++m_misses;
+      return false;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    body = it->second->body;
+    ++m_hits;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void rpc_response_cache::add(const std::string& key, uint64_t version, const std::string& body)
+  {
+    size_t size = key.size() + body.size();
+    if (size > RPC_RESPONSE_CACHE_MAX_ENTRY_BYTES)
+      return;
+
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    if (version != m_version)
+      return;
+
+    auto it = m_index.find(key);
+    if (it != m_index.end())
+      erase(it->second);
+    while (!m_entries.empty() && m_bytes + size > RPC_RESPONSE_CACHE_MAX_BYTES)
+      erase(--m_entries.end());
+
+    entry e;
+    e.key = key;
+    e.body = body;
+    e.created = time(NULL);
+    m_entries.push_front(e);
+    m_index[key] = m_entries.begin();
+    m_bytes += size;
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t rpc_response_cache::get_hits() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_hits;
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t rpc_response_cache::get_misses() const
+  {
+    boost::unique_lock<boost::mutex> lock(m_lock);
+    return m_misses;
+  }
+  //---------------------------------------------------------------------------------
+  void rpc_response_cache::clear()
+  {
+    m_entries.clear();
+    m_index.clear();
+    m_bytes = 0;
+  }
+  //---------------------------------------------------------------------------------
+  void rpc_response_cache::erase(entries_container::iterator it)
+  {
+    m_bytes -= it->key.size() + it->body.size();
+    m_index.erase(it->key);
+    m_entries.erase(it);
+  }
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <ctime>
+#include <boost/thread/mutex.hpp>
+
+namespace cryptonote
+{
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Serialized responses of read-only rpc calls, so that the same request
+  // asked over and over between two blocks is answered without touching
+  // the blockchain or the serializer.
+  //
+  // Entries are stamped with the version core bumps whenever the pool or
+  // the chain changes (see core::get_block_template_version), and only
+  // served while that version is current.  They also expire after a few
+  // seconds, for fields that move without either (peer counts, stuck tx
+  // removal).
+  class rpc_response_cache
+  {
+  public:
+    rpc_response_cache();
+
+    // fills in the body cached for this key if it was stored at the given
+    // version and recently enough
+    bool get(const std::string& key, uint64_t version, std::string& body);
+
+    // caches a body built at the given version, unless the version has
+    // moved on since
+    void add(const std::string& key, uint64_t version, const std::string& body);
+
+    uint64_t get_hits() const;
+    uint64_t get_misses() const;
+
+  private:
+    struct entry
+    {
+      std::string key;
+      std::string body;
+      time_t created;
+    };
+    typedef std::list<entry> entries_container;
+
+    void clear();
+    void erase(entries_container::iterator it);
+
+    mutable boost::mutex m_lock;
+    uint64_t m_version;
+    entries_container m_entries; // most recently used first
+    std::unordered_map<std::string, entries_container::iterator> m_index;
+    size_t m_bytes;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+}
@@ -34,8 +34,10 @@
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <iterator>
+#include <string>
 #include <boost/type_traits/make_unsigned.hpp>
 
 #include "common/varint.h"
@@ -94,17 +96,129 @@ template <bool W>
 struct binary_archive;
 
 
-template <>
-struct binary_archive<false> : public binary_archive_base<std::istream, false>
+/*! \struct binary_span_istream
+ *
+ * \brief the input stream of binary_archive<false>: a read-only view
+ * of a byte range
+ *
+ * \detailed It has the parts of the std::istream interface that the
+ * serializers use (state flags, peek, get, read), without any of the
+ * locale or streambuf machinery, and without copying the bytes, which
+ * must outlive the stream.
+ */
+struct binary_span_istream
 {
+  binary_span_istream(const uint8_t *data, size_t size)
+    : begin_(data), cur_(data), end_(data + size), state_(std::ios_base::goodbit) { }
+  explicit binary_span_istream(const std::string &s)
+    : binary_span_istream(reinterpret_cast<const uint8_t *>(s.data()), s.size()) { }
+
+  bool good() const { return state_ == std::ios_base::goodbit; }
+  bool eof() const { return (state_ & std::ios_base::eofbit) != 0; }
+  bool fail() const { return (state_ & (std::ios_base::failbit | std::ios_base::badbit)) != 0; }
+  std::ios_base::iostate rdstate() const { return state_; }
+  void setstate(std::ios_base::iostate state) { state_ |= state; }
+  void clear(std::ios_base::iostate state = std::ios_base::goodbit) { state_ = state; }
 
-  explicit binary_archive(stream_type &s) : base_type(s) {
-    stream_type::streampos pos = stream_.tellg();
-    stream_.seekg(0, std::ios_base::end);
-    eof_pos_ = stream_.tellg();
-    stream_.seekg(pos);
+  int peek()
+  {
+    if (!good())
+      return EOF;
+    if (cur_ == end_) {
+      state_ |= std::ios_base::eofbit;
+      return EOF;
+    }
+    return *cur_;
+  }
+
+  binary_span_istream &get(char &c)
+  {
+    if (!good() || cur_ == end_) {
+      state_ |= cur_ == end_ ? std::ios_base::eofbit | std::ios_base::failbit : std::ios_base::failbit;
+      return *this;
+    }
+    c = static_cast<char>(*cur_++);
+    return *this;
   }
 
+  binary_span_istream &read(char *buf, size_t len)
+  {
+    if (!good()) {
+      state_ |= std::ios_base::failbit;
+      return *this;
+    }
+    size_t avail = end_ - cur_;
+    if (len > avail) {
+      memcpy(buf, cur_, avail);
+      cur_ = end_;
+      state_ |= std::ios_base::eofbit | std::ios_base::failbit;
+      return *this;
+    }
+    memcpy(buf, cur_, len);
+    cur_ += len;
+    return *this;
+  }
+
+  size_t tellg() const { return cur_ - begin_; }
+  size_t remaining() const { return end_ - cur_; }
+
+private:
+  friend struct binary_archive<false>;
+
+  const uint8_t *begin_;
+  const uint8_t *cur_;
+  const uint8_t *end_;
+  std::ios_base::iostate state_;
+};
+
+/*! \struct binary_string_ostream
+ *
+ * \brief the output stream of binary_archive<true>: appends to a
+ * std::string, either its own or one passed in by the caller
+ *
+ * \detailed Writing straight into the caller's string saves copying
+ * the result out, and lets a caller reuse one buffer's capacity across
+ * objects.
+ */
+struct binary_string_ostream
+{
+  binary_string_ostream() : buf_(&own_), state_(std::ios_base::goodbit) { }
+  explicit binary_string_ostream(std::string &target) : buf_(&target), state_(std::ios_base::goodbit) { }
+
+  bool good() const { return state_ == std::ios_base::goodbit; }
+  bool fail() const { return (state_ & (std::ios_base::failbit | std::ios_base::badbit)) != 0; }
+  std::ios_base::iostate rdstate() const { return state_; }
+  void setstate(std::ios_base::iostate state) { state_ |= state; }
+  void clear(std::ios_base::iostate state = std::ios_base::goodbit) { state_ = state; }
+
+  binary_string_ostream &put(char c) { buf_->push_back(c); return *this; }
+  binary_string_ostream &write(const char *buf, size_t len) { buf_->append(buf, len); return *this; }
+
+  const std::string &str() const { return *buf_; }
+
+private:
+  binary_string_ostream(const binary_string_ostream &);
+  binary_string_ostream &operator=(const binary_string_ostream &);
+
+  std::string own_;
+  std::string *buf_;
+  std::ios_base::iostate state_;
+};
+
+template <>
+struct binary_archive<false> : public binary_archive_base<binary_span_istream, false>
+{
+
+  explicit binary_archive(stream_type &s) : base_type(s), canonical_(true) { }
+
+  /*! \fn is_canonical
+   *
+   * \brief true if every varint read was complete and minimally encoded,
+   * and the whole input was read, i.e. serializing the object back gives
+   * exactly the input
+   */
+  bool is_canonical() const { return canonical_ && stream_.remaining() == 0; }
+
   template <class T>
   void serialize_int(T &v)
   {
@@ -118,16 +232,20 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
   template <class T>
   void serialize_uint(T &v, size_t width = sizeof(T))
   {
+    if (!stream_.good() || stream_.remaining() < width) {
+      // same as reading byte by byte off the end
+      stream_.setstate(stream_.good() ? std::ios_base::eofbit | std::ios_base::failbit : std::ios_base::failbit);
+      stream_.cur_ = stream_.end_;
+      return;
+    }
     T ret = 0;
     unsigned shift = 0;
     for (size_t i = 0; i < width; i++) {
-      //std::cerr << "tell: " << stream_.tellg() << " value: " << ret << std::endl;
-      char c;
-      stream_.get(c);
-      T b = (unsigned char)c;
+      T b = stream_.cur_[i];
       ret += (b << shift);	// can this be changed to OR, i think it can.
       shift += 8;
     }
+    stream_.cur_ += width;
     v = ret;
   }
   
@@ -145,8 +263,10 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
   template <class T>
   void serialize_uvarint(T &v)
   {
-    typedef std::istreambuf_iterator<char> it;
-    tools::read_varint(it(stream_), it(), v); // XXX handle failure
+    // reads in place, moving the stream's cursor along
+    int read = tools::read_varint<std::numeric_limits<T>::digits>(stream_.cur_, stream_.end_, v); // XXX handle failure
+    if (read <= 0 || (stream_.cur_[-1] & 0x80))
+      canonical_ = false;
   }
 
   void begin_array(size_t &s)
@@ -168,16 +288,15 @@ struct binary_archive<false> : public binary_archive_base<std::istream, false>
   size_t remaining_bytes() {
     if (!stream_.good())
       return 0;
-    //std::cerr << "tell: " << stream_.tellg() << std::endl;
-    assert(stream_.tellg() <= eof_pos_);
-    return eof_pos_ - stream_.tellg();
+    return stream_.remaining();
   }
-protected:
-  std::streamoff eof_pos_;
+
+private:
+  bool canonical_;
 };
 
 template <>
-struct binary_archive<true> : public binary_archive_base<std::ostream, true>
+struct binary_archive<true> : public binary_archive_base<binary_string_ostream, true>
 {
   explicit binary_archive(stream_type &s) : base_type(s) { }
 
@@ -189,10 +308,12 @@ struct binary_archive<true> : public binary_archive_base<std::ostream, true>
   template <class T>
   void serialize_uint(T v)
   {
+    char buf[sizeof(T)];
     for (size_t i = 0; i < sizeof(T); i++) {
-      stream_.put((char)(v & 0xff));
+      buf[i] = (char)(v & 0xff);
       if (1 < sizeof(T)) v >>= 8;
     }
+    stream_.write(buf, sizeof(T));
   }
 
   void serialize_blob(void *buf, size_t len, const char *delimiter="")
@@ -209,8 +330,10 @@ struct binary_archive<true> : public binary_archive_base<std::ostream, true>
   template <class T>
   void serialize_uvarint(T &v)
   {
-    typedef std::ostreambuf_iterator<char> it;
-    tools::write_varint(it(stream_), v);
+    char buf[(std::numeric_limits<T>::digits + 6) / 7];
+    char *end = buf;
+    tools::write_varint(end, v);
+    stream_.write(buf, end - buf);
   }
   void begin_array(size_t s)
   {
@@ -85,6 +85,7 @@ namespace
   const command_line::arg_descriptor<uint32_t> arg_log_level = {"set_log", "", 0, true};
   const command_line::arg_descriptor<bool> arg_testnet = {"testnet", "Used to deploy test nets. The daemon must be launched with --testnet flag", false};
   const command_line::arg_descriptor<bool> arg_restricted = {"restricted-rpc", "Restricts RPC to view only commands", false};
+  const command_line::arg_descriptor<uint32_t> arg_refresh_queue_depth = {"refresh-queue-depth", "Number of block batches to download ahead while refreshing, 0 to download and scan in turn", 2};
 
   const command_line::arg_descriptor< std::vector<std::string> > arg_command = {"command", ""};
 
@@ -273,6 +274,7 @@ bool simple_wallet::help(const std::vector<std::string> &args/* = std::vector<st
 
 simple_wallet::simple_wallet()
   : m_daemon_port(0)
+  , m_refresh_queue_depth(2)
   , m_refresh_progress_reporter(*this)
 {
   m_cmd_binder.set_handler("start_mining", boost::bind(&simple_wallet::start_mining, this, _1), "start_mining [<number_of_threads>] - Start mining in daemon");
@@ -528,6 +530,7 @@ void simple_wallet::handle_command_line(const boost::program_options::variables_
   m_electrum_seed                 = command_line::get_arg(vm, arg_electrum_seed);
   m_restore_deterministic_wallet  = command_line::get_arg(vm, arg_restore_deterministic_wallet);
   m_non_deterministic             = command_line::get_arg(vm, arg_non_deterministic);
+  m_refresh_queue_depth           = command_line::get_arg(vm, arg_refresh_queue_depth);
 }
 //----------------------------------------------------------------------------------------------------
 bool simple_wallet::try_connect_to_daemon()
@@ -609,6 +612,7 @@ bool simple_wallet::new_wallet(const std::string &wallet_file, const std::string
 
   m_wallet.reset(new tools::wallet2(testnet));
   m_wallet->callback(this);
+  m_wallet->set_refresh_queue_depth(m_refresh_queue_depth);
   m_wallet->set_seed_language(mnemonic_language);
 
   crypto::secret_key recovery_val;
@@ -662,6 +666,7 @@ bool simple_wallet::open_wallet(const string &wallet_file, const std::string& pa
   m_wallet_file = wallet_file;
   m_wallet.reset(new tools::wallet2(testnet));
   m_wallet->callback(this);
+  m_wallet->set_refresh_queue_depth(m_refresh_queue_depth);
 
   try
   {
@@ -1346,6 +1351,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_params, arg_electrum_seed );
   command_line::add_arg(desc_params, arg_testnet);
   command_line::add_arg(desc_params, arg_restricted);
+  command_line::add_arg(desc_params, arg_refresh_queue_depth);
   tools::wallet_rpc_server::init_options(desc_params);
 
   po::positional_options_description positional_options;
@@ -1430,6 +1436,7 @@ int main(int argc, char* argv[])
       daemon_address = std::string("http://") + daemon_host + ":" + std::to_string(daemon_port);
 
     tools::wallet2 wal(testnet,restricted);
+    wal.set_refresh_queue_depth(command_line::get_arg(vm, arg_refresh_queue_depth));
     try
     {
       LOG_PRINT_L0("Loading wallet...");
@@ -201,6 +201,7 @@ namespace cryptonote
     std::string m_daemon_address;
     std::string m_daemon_host;
     int m_daemon_port;
+    uint32_t m_refresh_queue_depth;
 
     epee::console_handlers_binder m_cmd_binder;
 
@@ -30,6 +30,9 @@
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
 
 #include <boost/utility/value_init.hpp>
 #include "include_base_utils.h"
@@ -139,24 +142,77 @@ bool wallet2::is_deprecated() const
   return is_old_file_format;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_t height)
+void wallet2::set_max_scan_threads(unsigned int threads)
 {
-  process_unconfirmed(tx);
-  std::vector<size_t> outs;
-  uint64_t tx_money_got_in_outs = 0;
+  m_max_scan_threads = threads;
+  m_scan_pool.reset();
+}
+//----------------------------------------------------------------------------------------------------
+tools::thread_pool& wallet2::get_scan_pool()
+{
+  if (!m_scan_pool)
+  {
+    unsigned int threads = m_max_scan_threads ? m_max_scan_threads : boost::thread::hardware_concurrency();
+    // the refreshing thread runs scan jobs too while it waits, so it counts as one
+    m_scan_pool.reset(new tools::thread_pool(threads > 1 ? threads - 1 : 0));
+  }
+  return *m_scan_pool;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::scan_tx(const cryptonote::transaction& tx, tx_scan_info& scan) const
+{
+  scan.pub_key_found = false;
+  scan.money_transfered = 0;
+  scan.outs.clear();
+  scan.key_images.clear();
 
-  std::vector<tx_extra_field> tx_extra_fields;
-  if(!parse_tx_extra(tx.extra, tx_extra_fields))
+  scan.tx_extra_fields.clear();
+  if(!parse_tx_extra(tx.extra, scan.tx_extra_fields))
   {
     // Extra may only be partially parsed, it's OK if tx_extra_fields contains public key
     LOG_PRINT_L0("Transaction extra has unsupported format: " << get_transaction_hash(tx));
   }
 
   // Don't try to extract tx public key if tx has no ouputs
+  if (tx.vout.empty())
+    return;
+
+  tx_extra_pub_key pub_key_field;
+  if(!find_tx_extra_field_by_type(scan.tx_extra_fields, pub_key_field))
+    return;
+  scan.pub_key_found = true;
+  scan.tx_pub_key = pub_key_field.pub_key;
+
+  bool r = lookup_acc_outs(m_account.get_keys(), tx, scan.tx_pub_key, scan.outs, scan.money_transfered);
+  THROW_WALLET_EXCEPTION_IF(!r, error::acc_outs_lookup_error, tx, scan.tx_pub_key, m_account.get_keys());
+
+  if(scan.outs.empty() || !scan.money_transfered)
+    return;
+
+  BOOST_FOREACH(size_t o, scan.outs)
+  {
+    THROW_WALLET_EXCEPTION_IF(tx.vout.size() <= o, error::wallet_internal_error, "wrong out in transaction: internal index=" +
+			      std::to_string(o) + ", total_outs=" + std::to_string(tx.vout.size()));
+
+    cryptonote::keypair in_ephemeral;
+    crypto::key_image ki;
+    cryptonote::generate_key_image_helper(m_account.get_keys(), scan.tx_pub_key, o, in_ephemeral, ki);
+    THROW_WALLET_EXCEPTION_IF(in_ephemeral.pub != boost::get<cryptonote::txout_to_key>(tx.vout[o].target).key,
+			      error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
+    scan.key_images.push_back(ki);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+// o_indices are the tx's output indices if the daemon sent them along with
+// the block, otherwise they are fetched here when needed
+void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_t height, const tx_scan_info& scan, const std::vector<uint64_t>* o_indices)
+{
+  process_unconfirmed(tx);
+  uint64_t tx_money_got_in_outs = scan.money_transfered;
+
   if (!tx.vout.empty()) 
   {
-    tx_extra_pub_key pub_key_field;
-    if(!find_tx_extra_field_by_type(tx_extra_fields, pub_key_field))
+    if(!scan.pub_key_found)
     {
       LOG_PRINT_L0("Public key wasn't found in the transaction extra. Skipping transaction " << get_transaction_hash(tx));
       if(0 != m_callback)
@@ -164,41 +220,36 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
       return;
     }
 
-    crypto::public_key tx_pub_key = pub_key_field.pub_key;
-    bool r = lookup_acc_outs(m_account.get_keys(), tx, tx_pub_key, outs, tx_money_got_in_outs);
-    THROW_WALLET_EXCEPTION_IF(!r, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
-
-    if(!outs.empty() && tx_money_got_in_outs)
+    if(!scan.outs.empty() && tx_money_got_in_outs)
     {
       //good news - got money! take care about it
       //usually we have only one transfer for user in transaction
-      cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
       cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response res = AUTO_VAL_INIT(res);
-      req.txid = get_transaction_hash(tx);
-      bool r = net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/get_o_indexes.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
-      THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
-      THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
-      THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_out_indices_error, res.status);
-      THROW_WALLET_EXCEPTION_IF(res.o_indexes.size() != tx.vout.size(), error::wallet_internal_error,
+      if (!o_indices)
+      {
+        cryptonote::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
+        req.txid = get_transaction_hash(tx);
+        bool r = net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/get_o_indexes.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
+        THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
+        THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
+        THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_out_indices_error, res.status);
+        o_indices = &res.o_indexes;
+      }
+      THROW_WALLET_EXCEPTION_IF(o_indices->size() != tx.vout.size(), error::wallet_internal_error,
 				"transactions outputs size=" + std::to_string(tx.vout.size()) +
-				" not match with COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES response size=" + std::to_string(res.o_indexes.size()));
+				" not match with COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES response size=" + std::to_string(o_indices->size()));
 
-      BOOST_FOREACH(size_t o, outs)
+      for (size_t i = 0; i < scan.outs.size(); ++i)
       {
-	THROW_WALLET_EXCEPTION_IF(tx.vout.size() <= o, error::wallet_internal_error, "wrong out in transaction: internal index=" +
-				  std::to_string(o) + ", total_outs=" + std::to_string(tx.vout.size()));
-
+	size_t o = scan.outs[i];
 	m_transfers.push_back(boost::value_initialized<transfer_details>());
 	transfer_details& td = m_transfers.back();
 	td.m_block_height = height;
 	td.m_internal_output_index = o;
-	td.m_global_output_index = res.o_indexes[o];
+	td.m_global_output_index = (*o_indices)[o];
 	td.m_tx = tx;
 	td.m_spent = false;
-	cryptonote::keypair in_ephemeral;
-	cryptonote::generate_key_image_helper(m_account.get_keys(), tx_pub_key, o, in_ephemeral, td.m_key_image);
-	THROW_WALLET_EXCEPTION_IF(in_ephemeral.pub != boost::get<cryptonote::txout_to_key>(tx.vout[o].target).key,
-				  error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
+	td.m_key_image = scan.key_images[i];
 
 	m_key_images[td.m_key_image] = m_transfers.size()-1;
 	LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << get_transaction_hash(tx));
@@ -228,7 +279,7 @@ void wallet2::process_new_transaction(const cryptonote::transaction& tx, uint64_
 
   tx_extra_nonce extra_nonce;
   crypto::hash payment_id = null_hash;
-  if (find_tx_extra_field_by_type(tx_extra_fields, extra_nonce))
+  if (find_tx_extra_field_by_type(scan.tx_extra_fields, extra_nonce))
   {
     if(get_payment_id_from_tx_extra_nonce(extra_nonce.nonce, payment_id))
     {
@@ -255,32 +306,59 @@ void wallet2::process_unconfirmed(const cryptonote::transaction& tx)
     m_unconfirmed_txs.erase(unconf_it);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_blockchain_entry(const cryptonote::block& b, cryptonote::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height)
+bool wallet2::is_block_scan_needed(const cryptonote::block& b) const
 {
-  //handle transactions from new block
-    
   //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
-  if(b.timestamp + 60*60*24 > m_account.get_createtime())
+  return b.timestamp + 60*60*24 > m_account.get_createtime();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::scan_block_txs(const cryptonote::block_complete_entry& bche, block_scan_info& bsi) const
+{
+  bsi.txs.resize(bche.txs.size());
+  size_t i = 0;
+  BOOST_FOREACH(auto& txblob, bche.txs)
+  {
+    bool r = parse_and_validate_tx_from_blob(txblob, bsi.txs[i++]);
+    THROW_WALLET_EXCEPTION_IF(!r, error::tx_parse_error, txblob);
+  }
+
+  bsi.tx_scans.resize(bsi.txs.size() + 1);
+  scan_tx(bsi.block.miner_tx, bsi.tx_scans[0]);
+  for (i = 0; i < bsi.txs.size(); ++i)
+    scan_tx(bsi.txs[i], bsi.tx_scans[i + 1]);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_new_blockchain_entry(const cryptonote::block_complete_entry& bche, block_scan_info& bsi, uint64_t height,
+    const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices* o_indices)
+{
+  //handle transactions from new block
+  const cryptonote::block& b = bsi.block;
+  if(is_block_scan_needed(b))
   {
+    // normally scanned up front by pull_blocks, unless a split changed which blocks are new
+    if (bsi.tx_scans.empty())
+      scan_block_txs(bche, bsi);
+
+    // older daemons don't send output indices
+    if (o_indices && o_indices->indices.size() != bsi.txs.size() + 1)
+      o_indices = NULL;
+
     TIME_MEASURE_START(miner_tx_handle_time);
-    process_new_transaction(b.miner_tx, height);
+    process_new_transaction(b.miner_tx, height, bsi.tx_scans[0], o_indices ? &o_indices->indices[0].indices : NULL);
     TIME_MEASURE_FINISH(miner_tx_handle_time);
 
     TIME_MEASURE_START(txs_handle_time);
-    BOOST_FOREACH(auto& txblob, bche.txs)
+    for (size_t i = 0; i < bsi.txs.size(); ++i)
     {
-      cryptonote::transaction tx;
-      bool r = parse_and_validate_tx_from_blob(txblob, tx);
-      THROW_WALLET_EXCEPTION_IF(!r, error::tx_parse_error, txblob);
-      process_new_transaction(tx, height);
+      process_new_transaction(bsi.txs[i], height, bsi.tx_scans[i + 1], o_indices ? &o_indices->indices[i + 1].indices : NULL);
     }
     TIME_MEASURE_FINISH(txs_handle_time);
-    LOG_PRINT_L2("Processed block: " << bl_id << ", height " << height << ", " <<  miner_tx_handle_time + txs_handle_time << "(" << miner_tx_handle_time << "/" << txs_handle_time <<")ms");
+    LOG_PRINT_L2("Processed block: " << bsi.id << ", height " << height << ", " <<  miner_tx_handle_time + txs_handle_time << "(" << miner_tx_handle_time << "/" << txs_handle_time <<")ms");
   }else
   {
     LOG_PRINT_L2( "Skipped block by timestamp, height: " << height << ", block time " << b.timestamp << ", account time " << m_account.get_createtime());
   }
-  m_blockchain.push_back(bl_id);
+  m_blockchain.push_back(bsi.id);
   ++m_local_bc_height;
 
   if (0 != m_callback)
@@ -314,29 +392,230 @@ void wallet2::get_short_chain_history(std::list<crypto::hash>& ids)
     ids.push_back(m_blockchain[0]);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_blocks(uint64_t start_height, size_t& blocks_added)
+refresh_history::refresh_history(const std::list<crypto::hash>& wallet_history)
+  : m_wallet_history(wallet_history)
+{
+}
+//----------------------------------------------------------------------------------------------------
+void refresh_history::on_response(uint64_t start_height, size_t count, const crypto::hash& first_id, const crypto::hash& last_id)
+{
+  // the response replaces whatever we had from its start on, be it the same
+  // blocks or those of a branch the daemon left
+  while (!m_fetched.empty() && m_fetched.front().first >= start_height)
+    m_fetched.pop_front();
+  m_fetched.push_front(std::make_pair(start_height, first_id));
+  if (count > 1)
+    m_fetched.push_front(std::make_pair(start_height + count - 1, last_id));
+  while (m_fetched.size() > REFRESH_HISTORY_MAX_FETCHED)
+    m_fetched.pop_back();
+}
+//----------------------------------------------------------------------------------------------------
+std::list<crypto::hash> refresh_history::get() const
+{
+  std::list<crypto::hash> ids;
+  for (const auto& f : m_fetched)
+    ids.push_back(f.second);
+  ids.insert(ids.end(), m_wallet_history.begin(), m_wallet_history.end());
+  return ids;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::fetch_blocks(epee::net_utils::http::http_simple_client& http_client, const std::string& daemon_address, const std::list<crypto::hash>& block_ids,
+    uint64_t start_height, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response& res)
 {
-  blocks_added = 0;
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
-  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
-  get_short_chain_history(req.block_ids);
+  req.block_ids = block_ids;
   req.start_height = start_height;
-  bool r = net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/getblocks.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
+  bool r = net_utils::invoke_http_bin_remote_command2(daemon_address + "/getblocks.bin", req, res, http_client, WALLET_RCP_CONNECTION_TIMEOUT);
   THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "getblocks.bin");
   THROW_WALLET_EXCEPTION_IF(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks.bin");
   THROW_WALLET_EXCEPTION_IF(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_blocks(uint64_t start_height, size_t& blocks_added)
+{
+  blocks_added = 0;
+  std::list<crypto::hash> block_ids;
+  get_short_chain_history(block_ids);
+  cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+  fetch_blocks(m_http_client, m_daemon_address, block_ids, start_height, res);
+  process_blocks(res, blocks_added);
+}
+//----------------------------------------------------------------------------------------------------
+// Like calling pull_blocks until nothing new comes, but with up to
+// m_refresh_queue_depth getblocks.bin responses fetched ahead on another
+// thread while the current one is processed.  Each request asks for the
+// blocks after the last one of the previous response, on the assumption
+// that it gets added; if it doesn't (the daemon reorganized meanwhile), the
+// daemon answers from an older common block, refresh_history rebases on it
+// and process_blocks sorts it out against m_blockchain as usual.
+//
+// The fetcher only shares the state below, never the wallet, so when we
+// return while it waits on the daemon it is left to finish on its own
+// rather than holding us up for up to WALLET_RCP_CONNECTION_TIMEOUT.
+void wallet2::pull_blocks_pipelined(uint64_t start_height, size_t& blocks_added)
+{
+  struct fetched_blocks
+  {
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res;
+    std::exception_ptr error;
+  };
+
+  struct fetcher_state
+  {
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<std::shared_ptr<fetched_blocks>> queue;
+    bool stop = false;
+    bool done = false;
+    bool busy = false;
+  };
+
+  std::shared_ptr<fetcher_state> state = std::make_shared<fetcher_state>();
+  const size_t depth = m_refresh_queue_depth;
+  const std::string daemon_address = m_daemon_address;
+
+  std::list<crypto::hash> short_history;
+  get_short_chain_history(short_history);
+
+  boost::thread fetcher([state, depth, daemon_address, short_history, start_height]()
+  {
+    epee::net_utils::http::http_simple_client http_client;
+    refresh_history history(short_history);
+    while (true)
+    {
+      {
+        boost::unique_lock<boost::mutex> lock(state->mutex);
+        while (!state->stop && state->queue.size() >= depth)
+          state->cond.wait(lock);
+        if (state->stop)
+          break;
+        state->busy = true;
+      }
+
+      std::shared_ptr<fetched_blocks> f = std::make_shared<fetched_blocks>();
+      bool last = false;
+      try
+      {
+        fetch_blocks(http_client, daemon_address, history.get(), start_height, f->res);
+        // the first block is one we have, so only more than one means progress
+        if (f->res.blocks.size() > 1)
+        {
+          cryptonote::block first, last_bl;
+          bool r = cryptonote::parse_and_validate_block_from_blob(f->res.blocks.front().block, first);
+          THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, f->res.blocks.front().block);
+          r = cryptonote::parse_and_validate_block_from_blob(f->res.blocks.back().block, last_bl);
+          THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, f->res.blocks.back().block);
+          history.on_response(f->res.start_height, f->res.blocks.size(), get_block_hash(first), get_block_hash(last_bl));
+        }
+        else
+        {
+          last = true;
+        }
+      }
+      catch (...)
+      {
+        f->error = std::current_exception();
+        last = true;
+      }
+
+      boost::unique_lock<boost::mutex> lock(state->mutex);
+      state->busy = false;
+      state->queue.push_back(f);
+      state->done = last;
+      state->cond.notify_all();
+      if (last)
+        break;
+    }
+  });
+
+  epee::misc_utils::auto_scope_leave_caller stop_fetcher = epee::misc_utils::create_scope_leave_handler([&]()
+  {
+    bool busy;
+    {
+      boost::unique_lock<boost::mutex> lock(state->mutex);
+      state->stop = true;
+      busy = state->busy;
+      state->cond.notify_all();
+    }
+    if (busy)
+      fetcher.detach();
+    else
+      fetcher.join();
+  });
+
+  while (m_run.load(std::memory_order_relaxed))
+  {
+    std::shared_ptr<fetched_blocks> f;
+    {
+      boost::unique_lock<boost::mutex> lock(state->mutex);
+      while (state->queue.empty() && !state->done)
+        state->cond.wait(lock);
+      if (state->queue.empty())
+        break;
+      f = state->queue.front();
+      state->queue.pop_front();
+      state->cond.notify_all();
+    }
 
+    if (f->error)
+      std::rethrow_exception(f->error);
+
+    size_t added = blocks_added;
+    process_blocks(f->res, blocks_added);
+    if (added == blocks_added)
+      break;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_blocks(const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response& res, size_t& blocks_added)
+{
+  // parse the blocks and look for our outputs in them on all cores first,
+  // then apply what was found in order
+  std::vector<block_scan_info> blocks(res.blocks.size());
+  tools::thread_pool& scan_pool = get_scan_pool();
+  tools::thread_pool::waiter waiter;
   size_t current_index = res.start_height;
+  size_t i = 0;
   BOOST_FOREACH(auto& bl_entry, res.blocks)
   {
-    cryptonote::block bl;
-    r = cryptonote::parse_and_validate_block_from_blob(bl_entry.block, bl);
-    THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl_entry.block);
+    block_scan_info& bsi = blocks[i++];
+    scan_pool.submit(&waiter, [this, &bl_entry, &bsi, current_index]()
+    {
+      try
+      {
+        bool r = cryptonote::parse_and_validate_block_from_blob(bl_entry.block, bsi.block);
+        THROW_WALLET_EXCEPTION_IF(!r, error::block_parse_error, bl_entry.block);
+        bsi.id = get_block_hash(bsi.block);
+
+        // blocks we already have need no scanning
+        bool known = current_index < m_blockchain.size() && bsi.id == m_blockchain[current_index];
+        if (!known && is_block_scan_needed(bsi.block))
+          scan_block_txs(bl_entry, bsi);
+      }
+      catch (...)
+      {
+        bsi.error = std::current_exception();
+      }
+    });
+    ++current_index;
+  }
+  scan_pool.wait(waiter);
+
+  bool have_indices = res.output_indices.size() == res.blocks.size();
+  current_index = res.start_height;
+  i = 0;
+  BOOST_FOREACH(auto& bl_entry, res.blocks)
+  {
+    block_scan_info& bsi = blocks[i];
+    const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices* o_indices = have_indices ? &res.output_indices[i] : NULL;
+    ++i;
+    if (bsi.error)
+      std::rethrow_exception(bsi.error);
 
-    crypto::hash bl_id = get_block_hash(bl);
+    const crypto::hash& bl_id = bsi.id;
     if(current_index >= m_blockchain.size())
     {
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(bl_entry, bsi, current_index, o_indices);
       ++blocks_added;
     }
     else if(bl_id != m_blockchain[current_index])
@@ -348,7 +627,7 @@ void wallet2::pull_blocks(uint64_t start_height, size_t& blocks_added)
         string_tools::pod_to_hex(m_blockchain[current_index]));
 
       detach_blockchain(current_index);
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(bl_entry, bsi, current_index, o_indices);
     }
     else
     {
@@ -383,7 +662,11 @@ void wallet2::refresh(uint64_t start_height, size_t & blocks_fetched, bool& rece
   {
     try
     {
-      pull_blocks(start_height, added_blocks);
+      added_blocks = 0;
+      if(m_refresh_queue_depth > 0)
+        pull_blocks_pipelined(start_height, added_blocks);
+      else
+        pull_blocks(start_height, added_blocks);
       blocks_fetched += added_blocks;
       if(!added_blocks)
         break;
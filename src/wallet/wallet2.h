@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <exception>
 #include <memory>
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/vector.hpp>
@@ -46,12 +47,14 @@
 #include "common/unordered_containers_boost_serialization.h"
 #include "crypto/chacha8.h"
 #include "crypto/hash.h"
+#include "common/thread_pool.h"
 
 #include "wallet_errors.h"
 
 #include <iostream>
 #define DEFAULT_TX_SPENDABLE_AGE                               10
 #define WALLET_RCP_CONNECTION_TIMEOUT                          200000
+#define REFRESH_HISTORY_MAX_FETCHED                            16
 
 namespace tools
 {
@@ -78,11 +81,33 @@ namespace tools
     }
   };
 
+  /*!
+   * \brief The block ids a pipelined refresh asks the daemon to continue from
+   *
+   * The first and last block of each response fetched so far, newest first,
+   * ahead of the wallet's own short chain history.  A response starting below
+   * the newest of them means the daemon reorganized: the ids above its start
+   * are dropped, so the next request continues from the new branch rather
+   * than from the wallet's history.
+   */
+  class refresh_history
+  {
+  public:
+    explicit refresh_history(const std::list<crypto::hash>& wallet_history);
+
+    void on_response(uint64_t start_height, size_t count, const crypto::hash& first_id, const crypto::hash& last_id);
+    std::list<crypto::hash> get() const;
+
+  private:
+    std::list<std::pair<uint64_t, crypto::hash>> m_fetched;
+    std::list<crypto::hash> m_wallet_history;
+  };
+
   class wallet2
   {
-    wallet2(const wallet2&) : m_run(true), m_callback(0), m_testnet(false) {};
+    wallet2(const wallet2&) : m_run(true), m_callback(0), m_testnet(false), m_max_scan_threads(0), m_refresh_queue_depth(2) {};
   public:
-    wallet2(bool testnet = false, bool restricted = false) : m_run(true), m_callback(0), m_testnet(testnet), m_restricted(restricted), is_old_file_format(false) {};
+    wallet2(bool testnet = false, bool restricted = false) : m_run(true), m_callback(0), m_testnet(testnet), m_restricted(restricted), is_old_file_format(false), m_max_scan_threads(0), m_refresh_queue_depth(2) {};
     struct transfer_details
     {
       uint64_t m_block_height;
@@ -250,7 +275,51 @@ namespace tools
     static std::vector<std::string> addresses_from_url(const std::string& url, bool& dnssec_valid);
 
     static std::string address_from_txt_record(const std::string& s);
+
+    /*!
+     * \brief  Sets how many threads scan incoming blocks for our outputs
+     * \param  threads        Number of threads, including the refreshing one,
+     *                        0 for one per core. They are started on the next scan.
+     */
+    void set_max_scan_threads(unsigned int threads);
+
+    /*!
+     * \brief  Adds the blocks of a getblocks.bin response we don't have yet,
+     *         detaching ours from where they split off if needed
+     * \param  res            The daemon's response
+     * \param  blocks_added   Incremented for each block added past our old top
+     */
+    void process_blocks(const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response& res, size_t& blocks_added);
+
+    /*!
+     * \brief  Sets how many getblocks.bin responses refresh fetches ahead
+     *         while the current one is being scanned
+     * \param  depth          Number of responses to queue, 0 to fetch and scan in turn
+     */
+    void set_refresh_queue_depth(size_t depth) { m_refresh_queue_depth = depth; }
   private:
+    // what scanning a tx for outputs to us found.  This only needs the
+    // account keys, so it is done for all blocks of a getblocks.bin
+    // response at once on m_scan_pool before the wallet state is updated.
+    struct tx_scan_info
+    {
+      std::vector<cryptonote::tx_extra_field> tx_extra_fields;
+      bool pub_key_found;
+      crypto::public_key tx_pub_key;
+      std::vector<size_t> outs;
+      uint64_t money_transfered;
+      std::vector<crypto::key_image> key_images; // one per entry in outs
+    };
+
+    struct block_scan_info
+    {
+      cryptonote::block block;
+      crypto::hash id;
+      std::vector<cryptonote::transaction> txs;
+      std::vector<tx_scan_info> tx_scans; // miner tx first, then txs; empty if not scanned yet
+      std::exception_ptr error;
+    };
+
     /*!
      * \brief  Stores wallet information to wallet file.
      * \param  keys_file_name Name of wallet file
@@ -264,14 +333,22 @@ namespace tools
      * \param password       Password of wallet file
      */
     void load_keys(const std::string& keys_file_name, const std::string& password);
-    void process_new_transaction(const cryptonote::transaction& tx, uint64_t height);
-    void process_new_blockchain_entry(const cryptonote::block& b, cryptonote::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height);
+    void scan_tx(const cryptonote::transaction& tx, tx_scan_info& scan) const;
+    void scan_block_txs(const cryptonote::block_complete_entry& bche, block_scan_info& bsi) const;
+    bool is_block_scan_needed(const cryptonote::block& b) const;
+    void process_new_transaction(const cryptonote::transaction& tx, uint64_t height, const tx_scan_info& scan, const std::vector<uint64_t>* o_indices);
+    void process_new_blockchain_entry(const cryptonote::block_complete_entry& bche, block_scan_info& bsi, uint64_t height,
+        const cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices* o_indices);
     void detach_blockchain(uint64_t height);
     void get_short_chain_history(std::list<crypto::hash>& ids);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time) const;
     bool is_transfer_unlocked(const transfer_details& td) const;
     bool clear();
     void pull_blocks(uint64_t start_height, size_t& blocks_added);
+    void pull_blocks_pipelined(uint64_t start_height, size_t& blocks_added);
+    static void fetch_blocks(epee::net_utils::http::http_simple_client& http_client, const std::string& daemon_address, const std::list<crypto::hash>& block_ids,
+        uint64_t start_height, cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response& res);
+    tools::thread_pool& get_scan_pool();
     uint64_t select_transfers(uint64_t needed_money, bool add_dust, uint64_t dust, std::list<transfer_container::iterator>& selected_transfers);
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const cryptonote::transaction& tx);
@@ -301,6 +378,9 @@ namespace tools
     bool m_restricted;
     std::string seed_language; /*!< Language of the mnemonics (seed). */
     bool is_old_file_format; /*!< Whether the wallet file is of an old file format */
+    unsigned int m_max_scan_threads;
+    std::unique_ptr<tools::thread_pool> m_scan_pool; // created by the first scan
+    size_t m_refresh_queue_depth;
   };
 }
 BOOST_CLASS_VERSION(tools::wallet2, 7)
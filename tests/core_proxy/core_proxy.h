@@ -76,7 +76,10 @@ namespace tests
     bool have_block(const crypto::hash& id);
     bool get_blockchain_top(uint64_t& height, crypto::hash& top_id);
     bool handle_incoming_tx(const cryptonote::blobdata& tx_blob, cryptonote::tx_verification_context& tvc, bool keeped_by_block);
+    bool handle_incoming_tx(const cryptonote::blobdata& tx_blob, const cryptonote::transaction& tx, cryptonote::tx_verification_context& tvc, bool keeped_by_block){return handle_incoming_tx(tx_blob, tvc, keeped_by_block);}
     bool handle_incoming_block(const cryptonote::blobdata& block_blob, cryptonote::block_verification_context& bvc, bool update_miner_blocktemplate = true);
+    bool prepare_handle_incoming_blocks(const std::list<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::transaction>& txs){txs.clear(); return true;}
+    bool cleanup_handle_incoming_blocks(){return true;}
     void pause_mine(){}
     void resume_mine(){}
     bool on_idle(){return true;}
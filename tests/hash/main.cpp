@@ -29,10 +29,12 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <ios>
 #include <string>
+#include <vector>
 
 #include "warnings.h"
 #include "crypto/hash.h"
@@ -51,6 +53,22 @@ extern "C" {
     }
     tree_hash((const char (*)[32]) data, length >> 5, hash);
   }
+
+  static void hash_slow_multi(const void *data, size_t length, char *hash) {
+    // the input goes in the first and last of three lanes, a different one in the middle
+    vector<char> other((const char *) data, (const char *) data + length);
+    other.push_back(0);
+    const void *inputs[3] = {data, other.data(), data};
+    size_t lengths[3] = {length, other.size(), length};
+    char outputs[3][32], other_hash[32];
+    char *output_ptrs[3] = {outputs[0], outputs[1], outputs[2]};
+    cn_slow_hash_multi(inputs, lengths, 3, output_ptrs);
+    cn_slow_hash(other.data(), other.size(), other_hash);
+    if (memcmp(outputs[0], outputs[2], 32) != 0 || memcmp(outputs[1], other_hash, 32) != 0) {
+      throw ios_base::failure("Lanes of cn_slow_hash_multi disagree");
+    }
+    memcpy(hash, outputs[0], 32);
+  }
 }
 POP_WARNINGS
 
@@ -58,7 +76,7 @@ extern "C" typedef void hash_f(const void *, size_t, char *);
 struct hash_func {
   const string name;
   hash_f &f;
-} hashes[] = {{"fast", cn_fast_hash}, {"slow", cn_slow_hash}, {"tree", hash_tree},
+} hashes[] = {{"fast", cn_fast_hash}, {"slow", cn_slow_hash}, {"slow-multi", hash_slow_multi}, {"tree", hash_tree},
   {"extra-blake", hash_extra_blake}, {"extra-groestl", hash_extra_groestl},
   {"extra-jh", hash_extra_jh}, {"extra-skein", hash_extra_skein}};
 
@@ -39,7 +39,9 @@
 
 #include "multi_tx_test_base.h"
 
-template<size_t a_ring_size>
+// a_cached: whether the ring members stay precomputed between checks, as
+// popular outputs do in the daemon
+template<size_t a_ring_size, bool a_cached>
 class test_check_ring_signature : private multi_tx_test_base<a_ring_size>
 {
   static_assert(0 < a_ring_size, "ring_size must be greater than 0");
@@ -67,6 +69,8 @@ public:
 
     get_transaction_prefix_hash(m_tx, m_tx_prefix_hash);
 
+    crypto::set_ring_member_cache_size(a_cached ? ring_size : 0);
+
     return true;
   }
 
@@ -0,0 +1,80 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <vector>
+
+#include "crypto/hash.h"
+
+template<size_t a_count, bool a_multi>
+class test_cn_fast_hash_multi
+{
+public:
+  static const size_t loop_count = 10000;
+  static const size_t message_size = 64;
+
+  bool init()
+  {
+    m_messages.resize(a_count * message_size);
+    for (size_t i = 0; i < m_messages.size(); ++i)
+      m_messages[i] = static_cast<char>(i);
+
+    m_lengths.assign(a_count, size_t(message_size));
+    m_hashes.resize(a_count);
+    for (size_t i = 0; i < a_count; ++i)
+    {
+      m_data.push_back(&m_messages[i * message_size]);
+      m_hash_ptrs.push_back(&m_hashes[i]);
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    if (a_multi)
+    {
+      crypto::cn_fast_hash_multi(m_data.data(), m_lengths.data(), a_count, m_hash_ptrs.data());
+    }
+    else
+    {
+      for (size_t i = 0; i < a_count; ++i)
+        crypto::cn_fast_hash(m_data[i], m_lengths[i], m_hashes[i]);
+    }
+    return true;
+  }
+
+private:
+  std::vector<char> m_messages;
+  std::vector<const void*> m_data;
+  std::vector<size_t> m_lengths;
+  std::vector<crypto::hash> m_hashes;
+  std::vector<crypto::hash*> m_hash_ptrs;
+};
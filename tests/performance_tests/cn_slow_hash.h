@@ -33,10 +33,12 @@
 #include "crypto/crypto.h"
 #include "cryptonote_core/cryptonote_basic.h"
 
+template<size_t a_ways, bool a_huge_pages>
 class test_cn_slow_hash
 {
 public:
   static const size_t loop_count = 10;
+  static const size_t hashes_per_call = a_ways;
 
 #pragma pack(push, 1)
   struct data_t
@@ -55,14 +57,32 @@ public:
     if (!epee::string_tools::hex_to_pod("bbec2cacf69866a8e740380fe7b818fc78f8571221742d729d9d02d7f8989b87", m_expected_hash))
       return false;
 
+    // scratch buffers are kept per thread, drop the ones of the previous test
+    crypto::slow_hash_free_state();
+    crypto::slow_hash_set_huge_pages(a_huge_pages);
     return true;
   }
 
   bool test()
   {
-    crypto::hash hash;
-    crypto::cn_slow_hash(&m_data, sizeof(m_data), hash);
-    return hash == m_expected_hash;
+    const void* data[a_ways];
+    size_t lengths[a_ways];
+    crypto::hash hashes[a_ways];
+    crypto::hash* hash_ptrs[a_ways];
+    for (size_t i = 0; i < a_ways; ++i)
+    {
+      data[i] = &m_data;
+      lengths[i] = sizeof(m_data);
+      hash_ptrs[i] = &hashes[i];
+    }
+
+    crypto::cn_slow_hash_multi(data, lengths, a_ways, hash_ptrs);
+    for (size_t i = 0; i < a_ways; ++i)
+    {
+      if (hashes[i] != m_expected_hash)
+        return false;
+    }
+    return true;
   }
 
 private:
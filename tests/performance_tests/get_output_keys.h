@@ -0,0 +1,145 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+
+#include "cryptonote_core/cryptonote_basic.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "crypto/crypto.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "../unit_tests/unit_tests_utils.h"
+
+// Resolves the public keys of a ring's worth of outputs of one amount from
+// an LMDB db, either one get_output_key() call per ring member or a single
+// get_output_keys() call for the whole ring.
+template<size_t a_ring_size, bool batched>
+class test_get_output_keys
+{
+  static_assert(0 < a_ring_size, "ring_size must be greater than 0");
+
+public:
+  static const size_t loop_count = 1000;
+  static const size_t ring_size = a_ring_size;
+
+  static const size_t blocks_count = 100;
+  static const size_t outputs_per_block = 100;
+
+  test_get_output_keys() : m_db(true), m_amount(1000000000)
+  {
+  }
+
+  ~test_get_output_keys()
+  {
+    if (m_db.is_open())
+      m_db.close();
+  }
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    try
+    {
+      m_db.open(m_dir.path().string());
+
+      // every block's miner tx pays outputs_per_block outputs of one amount
+      m_db.batch_start(blocks_count);
+      crypto::hash prev_id = null_hash;
+      for (size_t height = 0; height < blocks_count; ++height)
+      {
+        block b = AUTO_VAL_INIT(b);
+        b.major_version = CURRENT_BLOCK_MAJOR_VERSION;
+        b.minor_version = CURRENT_BLOCK_MINOR_VERSION;
+        b.timestamp = height;
+        b.prev_id = prev_id;
+        b.miner_tx.version = CURRENT_TRANSACTION_VERSION;
+        b.miner_tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+
+        txin_gen in;
+        in.height = height;
+        b.miner_tx.vin.push_back(in);
+
+        for (size_t i = 0; i < outputs_per_block; ++i)
+        {
+          crypto::public_key pub;
+          crypto::secret_key sec;
+          crypto::generate_keys(pub, sec);
+
+          tx_out out;
+          out.amount = m_amount;
+          out.target = txout_to_key(pub);
+          b.miner_tx.vout.push_back(out);
+        }
+
+        m_db.add_block(b, 0, height + 1, m_amount * outputs_per_block * (height + 1), std::vector<transaction>());
+        prev_id = get_block_hash(b);
+      }
+      m_db.batch_stop();
+    }
+    catch (const std::exception& e)
+    {
+      std::cerr << "Failed to populate test db: " << e.what() << std::endl;
+      return false;
+    }
+
+    // ring members are spread over the whole set, in ascending order as
+    // they are in a tx input
+    const uint64_t num_outputs = blocks_count * outputs_per_block;
+    for (size_t i = 0; i < ring_size; ++i)
+    {
+      m_offsets.push_back(i * (num_outputs / ring_size) + crypto::rand<uint64_t>() % (num_outputs / ring_size));
+    }
+
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<crypto::public_key> keys;
+    if (batched)
+    {
+      m_db.get_output_keys(m_amount, m_offsets, keys);
+    }
+    else
+    {
+      for (uint64_t offset : m_offsets)
+      {
+        keys.push_back(m_db.get_output_key(m_amount, offset));
+      }
+    }
+    return keys.size() == ring_size;
+  }
+
+private:
+  cryptonote::BlockchainLMDB m_db;
+  uint64_t m_amount;
+  unit_test::temp_directory m_dir;
+  std::vector<uint64_t> m_offsets;
+};
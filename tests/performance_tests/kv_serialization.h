@@ -0,0 +1,158 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+// Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
+
+#pragma once
+
+#include <string>
+
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage.h"
+#include "storages/portable_storage_template_helper.h"
+
+// NOTIFY_RESPONSE_GET_OBJECTS with a_block_count blocks of 10 txes each,
+// roughly what a syncing peer receives per request
+template<size_t a_block_count>
+class test_kv_serialization_base
+{
+public:
+  typedef cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request message_type;
+
+  bool init()
+  {
+    for (size_t i = 0; i < a_block_count; ++i)
+    {
+      cryptonote::block_complete_entry bce;
+      bce.block.assign(400, static_cast<char>(i));
+      for (size_t j = 0; j < 10; ++j)
+        bce.txs.push_back(std::string(2000, static_cast<char>(i + j)));
+      m_request.blocks.push_back(bce);
+    }
+    m_request.current_blockchain_height = a_block_count;
+    return true;
+  }
+
+protected:
+  message_type m_request;
+};
+
+// COMMAND_RPC_GET_BLOCKS_FAST response with a_block_count blocks of 10 txes
+// of 2 outputs each, what a refreshing wallet receives per request
+template<size_t a_block_count>
+class test_kv_blocks_fast_base
+{
+public:
+  typedef cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response message_type;
+
+  bool init()
+  {
+    for (size_t i = 0; i < a_block_count; ++i)
+    {
+      cryptonote::block_complete_entry bce;
+      cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices boi;
+      bce.block.assign(400, static_cast<char>(i));
+      for (size_t j = 0; j <= 10; ++j)
+      {
+        // the miner tx has indices but no blob
+        if (j > 0)
+          bce.txs.push_back(std::string(2000, static_cast<char>(i + j)));
+        cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices toi;
+        toi.indices.push_back(i * 20 + j);
+        toi.indices.push_back(i * 20 + j + 1);
+        boi.indices.push_back(toi);
+      }
+      m_request.blocks.push_back(bce);
+      m_request.output_indices.push_back(boi);
+    }
+    m_request.start_height = 0;
+    m_request.current_height = a_block_count;
+    m_request.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+
+protected:
+  message_type m_request;
+};
+
+template<class t_base, bool a_streaming>
+class test_kv_store_base : public t_base
+{
+public:
+  static const size_t loop_count = 20;
+
+  bool test()
+  {
+    std::string buff;
+    if (a_streaming)
+      return epee::serialization::store_t_to_binary(this->m_request, buff);
+
+    epee::serialization::portable_storage ps;
+    this->m_request.store(ps);
+    return ps.store_to_binary(buff);
+  }
+};
+
+template<class t_base, bool a_streaming>
+class test_kv_load_base : public t_base
+{
+public:
+  static const size_t loop_count = 20;
+
+  bool init()
+  {
+    if (!t_base::init())
+      return false;
+    return epee::serialization::store_t_to_binary(this->m_request, m_blob);
+  }
+
+  bool test()
+  {
+    typename t_base::message_type request;
+    if (a_streaming)
+      return epee::serialization::load_t_from_binary(request, m_blob);
+
+    epee::serialization::portable_storage ps;
+    if (!ps.load_from_binary(m_blob))
+      return false;
+    return request.load(ps);
+  }
+
+private:
+  std::string m_blob;
+};
+
+template<size_t a_block_count, bool a_streaming>
+using test_kv_store = test_kv_store_base<test_kv_serialization_base<a_block_count>, a_streaming>;
+template<size_t a_block_count, bool a_streaming>
+using test_kv_load = test_kv_load_base<test_kv_serialization_base<a_block_count>, a_streaming>;
+template<size_t a_block_count, bool a_streaming>
+using test_kv_store_blocks_fast = test_kv_store_base<test_kv_blocks_fast_base<a_block_count>, a_streaming>;
+template<size_t a_block_count, bool a_streaming>
+using test_kv_load_blocks_fast = test_kv_load_base<test_kv_blocks_fast_base<a_block_count>, a_streaming>;
@@ -34,13 +34,18 @@
 // tests
 #include "construct_tx.h"
 #include "check_ring_signature.h"
+#include "cn_fast_hash_multi.h"
 #include "cn_slow_hash.h"
 #include "derive_public_key.h"
 #include "derive_secret_key.h"
 #include "generate_key_derivation.h"
 #include "generate_key_image.h"
 #include "generate_key_image_helper.h"
+#if BLOCKCHAIN_DB == DB_LMDB
+#include "get_output_keys.h"
+#endif
 #include "is_out_to_acc.h"
+#include "kv_serialization.h"
 
 unsigned int epee::g_test_dbg_lock_sleep = 0;
 
@@ -73,10 +78,21 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE2(test_construct_tx, 100, 10);
   TEST_PERFORMANCE2(test_construct_tx, 100, 100);
 
-  TEST_PERFORMANCE1(test_check_ring_signature, 1);
-  TEST_PERFORMANCE1(test_check_ring_signature, 2);
-  TEST_PERFORMANCE1(test_check_ring_signature, 10);
-  TEST_PERFORMANCE1(test_check_ring_signature, 100);
+  TEST_PERFORMANCE2(test_check_ring_signature, 1, false);
+  TEST_PERFORMANCE2(test_check_ring_signature, 1, true);
+  TEST_PERFORMANCE2(test_check_ring_signature, 2, false);
+  TEST_PERFORMANCE2(test_check_ring_signature, 2, true);
+  TEST_PERFORMANCE2(test_check_ring_signature, 10, false);
+  TEST_PERFORMANCE2(test_check_ring_signature, 10, true);
+  TEST_PERFORMANCE2(test_check_ring_signature, 100, false);
+  TEST_PERFORMANCE2(test_check_ring_signature, 100, true);
+
+#if BLOCKCHAIN_DB == DB_LMDB
+  TEST_PERFORMANCE2(test_get_output_keys, 10, false);
+  TEST_PERFORMANCE2(test_get_output_keys, 10, true);
+  TEST_PERFORMANCE2(test_get_output_keys, 100, false);
+  TEST_PERFORMANCE2(test_get_output_keys, 100, true);
+#endif
 
   TEST_PERFORMANCE0(test_is_out_to_acc);
   TEST_PERFORMANCE0(test_generate_key_image_helper);
@@ -85,7 +101,25 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE0(test_derive_public_key);
   TEST_PERFORMANCE0(test_derive_secret_key);
 
-  TEST_PERFORMANCE0(test_cn_slow_hash);
+  TEST_PERFORMANCE2(test_cn_fast_hash_multi, 4, false);
+  TEST_PERFORMANCE2(test_cn_fast_hash_multi, 4, true);
+  TEST_PERFORMANCE2(test_cn_fast_hash_multi, 16, false);
+  TEST_PERFORMANCE2(test_cn_fast_hash_multi, 16, true);
+
+  TEST_PERFORMANCE2(test_cn_slow_hash, 1, true);
+  TEST_PERFORMANCE2(test_cn_slow_hash, 2, true);
+  TEST_PERFORMANCE2(test_cn_slow_hash, 3, true);
+  TEST_PERFORMANCE2(test_cn_slow_hash, 1, false);
+  TEST_PERFORMANCE2(test_cn_slow_hash, 3, false);
+
+  TEST_PERFORMANCE2(test_kv_store, 1000, false);
+  TEST_PERFORMANCE2(test_kv_store, 1000, true);
+  TEST_PERFORMANCE2(test_kv_load, 1000, false);
+  TEST_PERFORMANCE2(test_kv_load, 1000, true);
+  TEST_PERFORMANCE2(test_kv_store_blocks_fast, 1000, false);
+  TEST_PERFORMANCE2(test_kv_store_blocks_fast, 1000, true);
+  TEST_PERFORMANCE2(test_kv_load_blocks_fast, 1000, false);
+  TEST_PERFORMANCE2(test_kv_load_blocks_fast, 1000, true);
 
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
@@ -121,6 +121,21 @@ private:
   int m_elapsed;
 };
 
+/**
+ * Tests that define hashes_per_call also get their hash rate printed
+ */
+template <typename T>
+auto print_hash_rate(const test_runner<T>& runner, int) -> decltype(T::hashes_per_call, void())
+{
+  if (0 < runner.elapsed_time())
+    std::cout << "  hash rate:     " << 1000.0 * T::loop_count * T::hashes_per_call / runner.elapsed_time() << " hashes/sec per thread\n";
+}
+
+template <typename T>
+void print_hash_rate(const test_runner<T>&, long)
+{
+}
+
 template <typename T>
 void run_test(const char* test_name)
 {
@@ -130,7 +145,9 @@ void run_test(const char* test_name)
     std::cout << test_name << " - OK:\n";
     std::cout << "  loop count:    " << T::loop_count << '\n';
     std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
-    std::cout << "  time per call: " << runner.time_per_call() << " ms/call\n" << std::endl;
+    std::cout << "  time per call: " << runner.time_per_call() << " ms/call\n";
+    print_hash_rate(runner, 0);
+    std::cout << std::endl;
   }
   else
   {
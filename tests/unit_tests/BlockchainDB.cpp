@@ -31,6 +31,7 @@
 #include <cstdio>
 #include <iostream>
 #include <chrono>
+#include <future>
 #include <thread>
 
 #include "gtest/gtest.h"
@@ -44,6 +45,7 @@ using namespace cryptonote;
 using epee::string_tools::pod_to_hex;
 
 #define ASSERT_HASH_EQ(a,b) ASSERT_EQ(pod_to_hex(a), pod_to_hex(b))
+#define EXPECT_HASH_EQ(a,b) EXPECT_EQ(pod_to_hex(a), pod_to_hex(b))
 
 namespace {  // anonymous namespace
 
@@ -322,4 +324,216 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, RetrieveOutputKeys)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  for (auto& out : this->m_blocks[1].miner_tx.vout)
+  {
+    uint64_t num_outputs = this->m_db->get_num_outputs(out.amount);
+    ASSERT_LT(0, num_outputs);
+
+    // ask for every output of the amount, last first, so the batched lookup
+    // has to put its results back in the requested order
+    std::vector<uint64_t> offsets;
+    for (uint64_t i = num_outputs; i > 0; --i)
+    {
+      offsets.push_back(i - 1);
+    }
+
+    std::vector<crypto::public_key> keys;
+    ASSERT_NO_THROW(this->m_db->get_output_keys(out.amount, offsets, keys));
+    ASSERT_EQ(offsets.size(), keys.size());
+
+    std::vector<tx_out_index> indices;
+    ASSERT_NO_THROW(this->m_db->get_output_tx_and_index(out.amount, offsets, indices));
+    ASSERT_EQ(offsets.size(), indices.size());
+
+    for (size_t i = 0; i < offsets.size(); ++i)
+    {
+      ASSERT_HASH_EQ(this->m_db->get_output_key(out.amount, offsets[i]), keys[i]);
+
+      tx_out_index toi = this->m_db->get_output_tx_and_index(out.amount, offsets[i]);
+      ASSERT_HASH_EQ(toi.first, indices[i].first);
+      ASSERT_EQ(toi.second, indices[i].second);
+    }
+
+    offsets.push_back(num_outputs);
+    ASSERT_THROW(this->m_db->get_output_keys(out.amount, offsets, keys), OUTPUT_DNE);
+  }
+}
+
+class BlockchainLMDBTest : public BlockchainDBTest<BlockchainLMDB>
+{
+};
+
+TEST_F(BlockchainLMDBTest, MapGrowsWhenNearlyFull)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // an increment this large makes the fresh 1 GiB map count as nearly full
+  BlockchainLMDB* db = static_cast<BlockchainLMDB*>(this->m_db);
+  db->set_map_resize_increment(8LL << 30);
+
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+
+  ASSERT_EQ(1, db->get_map_resize_count());
+  ASSERT_LE(9ULL << 30, db->get_map_size());
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_LT(0, db->get_map_used());
+  ASSERT_LE(db->get_map_used(), db->get_map_size());
+
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
+TEST_F(BlockchainLMDBTest, MapGrownForBatchUpFront)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  // too small a map for even one block, and too small an increment to
+  // catch up block by block
+  BlockchainLMDB* db = static_cast<BlockchainLMDB*>(this->m_db);
+  db->set_initial_map_size(64 << 10);
+  db->set_map_resize_increment(16 << 10);
+  db->set_batch_transactions(true);
+
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+
+  // the map is grown for the whole batch before its txn begins, so the
+  // batch never runs out of room
+  uint64_t resize_count = db->get_map_resize_count();
+  ASSERT_NO_THROW(db->batch_start(2));
+  ASSERT_LT(resize_count, db->get_map_resize_count());
+  resize_count = db->get_map_resize_count();
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  ASSERT_EQ(2, this->m_db->height());
+  ASSERT_NO_THROW(db->batch_stop());
+
+  ASSERT_EQ(0, db->get_map_full_retry_count());
+  ASSERT_EQ(resize_count, db->get_map_resize_count());
+  ASSERT_EQ(2, this->m_db->height());
+  ASSERT_EQ(t_sizes[1], this->m_db->get_block_size(1));
+  ASSERT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+  for (const auto& tx : this->m_txs[1])
+    ASSERT_TRUE(this->m_db->tx_exists(get_transaction_hash(tx)));
+
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
+TEST_F(BlockchainLMDBTest, BatchCommittedWhenMoreBlocksThanPlanned)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  BlockchainLMDB* db = static_cast<BlockchainLMDB*>(this->m_db);
+  db->set_batch_transactions(true);
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+
+  // a batch planned for one block commits it before taking a second
+  ASSERT_NO_THROW(db->batch_start(1));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  ASSERT_NO_THROW(db->batch_abort());
+
+  ASSERT_EQ(1, this->m_db->height());
+  ASSERT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[0])));
+  ASSERT_FALSE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
+TEST_F(BlockchainLMDBTest, ReadersSeeOnlyCommittedBatch)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  BlockchainLMDB* db = static_cast<BlockchainLMDB*>(this->m_db);
+  db->set_batch_transactions(true);
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+
+  ASSERT_NO_THROW(db->batch_start());
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(db->batch_commit());
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // the batch's own thread reads through the batch txn
+  ASSERT_EQ(2, this->m_db->height());
+  ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), this->m_db->top_block_hash());
+
+  // any other thread only sees what the batch has committed, top included
+  std::thread reader([&]() {
+    EXPECT_EQ(1, this->m_db->height());
+    EXPECT_NO_THROW(this->m_db->get_top_block_timestamp());
+    EXPECT_NO_THROW(this->m_db->get_top_block());
+    EXPECT_HASH_EQ(get_block_hash(this->m_blocks[0]), this->m_db->top_block_hash());
+    EXPECT_FALSE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+  });
+  reader.join();
+
+  ASSERT_NO_THROW(db->batch_stop());
+
+  std::thread after([&]() {
+    EXPECT_EQ(2, this->m_db->height());
+    EXPECT_HASH_EQ(get_block_hash(this->m_blocks[1]), this->m_db->top_block_hash());
+  });
+  after.join();
+
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
+TEST_F(BlockchainLMDBTest, ReadTxnReused)
+{
+  std::string fname(tmpnam(NULL));
+  this->set_prefix(fname);
+
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  this->get_filenames();
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+
+  // the same thread's txn is renewed for each lookup, and sees every commit
+  std::thread reader([&]() {
+    for (int i = 0; i < 100; ++i)
+      EXPECT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[0])));
+    EXPECT_FALSE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+    EXPECT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+    EXPECT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+  });
+  reader.join();
+  ASSERT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+
+  // a txn left over from before a reopen is dropped, not renewed
+  std::promise<void> looked_up, reopened;
+  std::thread survivor([&]() {
+    EXPECT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[0])));
+    looked_up.set_value();
+    reopened.get_future().wait();
+    EXPECT_TRUE(this->m_db->block_exists(get_block_hash(this->m_blocks[1])));
+    EXPECT_HASH_EQ(get_block_hash(this->m_blocks[1]), this->m_db->top_block_hash());
+  });
+  looked_up.get_future().wait();
+  ASSERT_NO_THROW(this->m_db->close());
+  ASSERT_NO_THROW(this->m_db->open(fname));
+  ASSERT_EQ(2, this->m_db->height());
+  reopened.set_value();
+  survivor.join();
+
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
 }  // anonymous namespace
@@ -0,0 +1,101 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "cryptonote_core/block_template_cache.h"
+
+namespace
+{
+  cryptonote::account_public_address make_address(char c)
+  {
+    cryptonote::account_public_address adr;
+    memset(&adr, c, sizeof(adr));
+    return adr;
+  }
+
+  cryptonote::block make_block(uint64_t nonce)
+  {
+    cryptonote::block b = AUTO_VAL_INIT(b);
+    b.nonce = nonce;
+    return b;
+  }
+
+  TEST(block_template_cache, hit_and_miss)
+  {
+    cryptonote::block_template_cache cache;
+    cryptonote::account_public_address a = make_address(1), a2 = make_address(2);
+    cryptonote::block b;
+    cryptonote::difficulty_type diffic;
+    uint64_t height;
+
+    ASSERT_FALSE(cache.get(a, "", b, diffic, height));
+    cache.add(cache.get_version(), a, "", make_block(7), 100, 5);
+    ASSERT_TRUE(cache.get(a, "", b, diffic, height));
+    ASSERT_EQ(7, b.nonce);
+    ASSERT_EQ(100, diffic);
+    ASSERT_EQ(5, height);
+    ASSERT_FALSE(cache.get(a2, "", b, diffic, height));
+    ASSERT_FALSE(cache.get(a, std::string(8, '\0'), b, diffic, height));
+  }
+
+  TEST(block_template_cache, invalidate)
+  {
+    cryptonote::block_template_cache cache;
+    cryptonote::account_public_address a = make_address(1);
+    cryptonote::block b;
+    cryptonote::difficulty_type diffic;
+    uint64_t height;
+
+    uint64_t version = cache.get_version();
+    cache.add(version, a, "", make_block(7), 100, 5);
+    cache.invalidate();
+    ASSERT_NE(version, cache.get_version());
+    ASSERT_FALSE(cache.get(a, "", b, diffic, height));
+
+    // a template built before the change is not cached
+    cache.add(version, a, "", make_block(7), 100, 5);
+    ASSERT_FALSE(cache.get(a, "", b, diffic, height));
+  }
+
+  TEST(block_template_cache, wait_for_change)
+  {
+    cryptonote::block_template_cache cache;
+    uint64_t version = cache.get_version();
+    ASSERT_EQ(version, cache.wait_for_change(version, 10));
+
+    boost::thread t([&cache]() { boost::this_thread::sleep(boost::posix_time::milliseconds(50)); cache.invalidate(); });
+    ASSERT_NE(version, cache.wait_for_change(version, 10000));
+    t.join();
+
+    // returns at once when the version already moved
+    ASSERT_NE(version, cache.wait_for_change(version, 10000));
+  }
+}
@@ -0,0 +1,330 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_config.h"
+
+#if BLOCKCHAIN_DB == DB_LMDB
+
+#include <chrono>
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "common/boost_serialization_helper.h"
+#include "cryptonote_core/cryptonote_boost_serialization.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "cryptonote_core/difficulty.h"
+#include "cryptonote_core/tx_pool.h"
+#include "cryptonote_core/blockchain.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#include "unit_tests_utils.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  // a coinbase-like tx; it parses and has no inputs to look up
+  blobdata make_tx_blob(uint64_t height, uint64_t amount)
+  {
+    transaction tx = AUTO_VAL_INIT(tx);
+    tx.version = CURRENT_TRANSACTION_VERSION;
+    txin_gen in;
+    in.height = height;
+    tx.vin.push_back(in);
+    tx_out out;
+    out.amount = amount;
+    txout_to_key key = AUTO_VAL_INIT(key);
+    out.target = key;
+    tx.vout.push_back(out);
+    return tx_to_blob(tx);
+  }
+
+  // adds a block with the given timestamp on top of bc's main chain
+  bool mine_block(Blockchain& bc, const account_public_address& miner, uint64_t timestamp, block& b)
+  {
+    difficulty_type diffic;
+    uint64_t height;
+    if (!bc.create_block_template(b, miner, diffic, height, blobdata()))
+      return false;
+    b.timestamp = timestamp;
+    while (!check_hash(get_block_longhash(b, height), diffic))
+      ++b.nonce;
+    block_verification_context bvc = AUTO_VAL_INIT(bvc);
+    return bc.add_new_block(b, bvc) && bvc.m_added_to_main_chain;
+  }
+
+  // the next difficulty from what the db holds, bypassing Blockchain's
+  // window of recent blocks
+  difficulty_type db_next_difficulty(BlockchainDB& db)
+  {
+    std::vector<uint64_t> timestamps;
+    std::vector<difficulty_type> cumulative_difficulties;
+    uint64_t h = db.height();
+    for (uint64_t i = std::max<uint64_t>(1, h - std::min<uint64_t>(h, DIFFICULTY_BLOCKS_COUNT)); i < h; ++i)
+    {
+      timestamps.push_back(db.get_block_timestamp(i));
+      cumulative_difficulties.push_back(db.get_block_cumulative_difficulty(i));
+    }
+    return next_difficulty(timestamps, cumulative_difficulties);
+  }
+
+  // a chain and its pool, which refer to each other
+  struct chain_and_pool
+  {
+    chain_and_pool(): pool(blockchain), blockchain(pool) {}
+
+    tx_memory_pool pool;
+    Blockchain blockchain;
+  };
+
+  // a tx with <count> inputs, each signed over a ring of two, and the
+  // ring signature checks for it
+  void make_ring_signature_checks(size_t count, transaction& tx, std::vector<Blockchain::ring_signature_check>& checks)
+  {
+    tx = transaction();
+    tx.version = CURRENT_TRANSACTION_VERSION;
+    crypto::hash prefix_hash = crypto::rand<crypto::hash>();
+    checks.resize(count);
+    tx.signatures.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      keypair real = keypair::generate();
+      keypair decoy = keypair::generate();
+      txin_to_key in = AUTO_VAL_INIT(in);
+      crypto::generate_key_image(real.pub, real.sec, in.k_image);
+      tx.vin.push_back(in);
+
+      Blockchain::ring_signature_check& check = checks[i];
+      check.tx = &tx;
+      check.input_index = i;
+      check.tx_prefix_hash = prefix_hash;
+      check.output_keys.push_back(decoy.pub);
+      check.output_keys.push_back(real.pub);
+      const crypto::public_key* pubs[] = {&check.output_keys[0], &check.output_keys[1]};
+      tx.signatures[i].resize(2);
+      crypto::generate_ring_signature(prefix_hash, in.k_image, pubs, 2, real.sec, 1, tx.signatures[i].data());
+    }
+  }
+
+  class blockchain_test : public ::testing::Test
+  {
+  protected:
+    blockchain_test()
+      : m_pool(m_blockchain)
+      , m_blockchain(m_pool)
+      , m_db(NULL)
+    {
+    }
+
+    ~blockchain_test()
+    {
+      m_blockchain.deinit();
+    }
+
+    bool init()
+    {
+      m_db = new BlockchainLMDB();
+      m_db->open((m_dir.path() / "lmdb").string());
+      return m_blockchain.init(m_db);
+    }
+
+    tx_memory_pool m_pool;
+    Blockchain m_blockchain;
+    BlockchainDB* m_db;
+    unit_test::temp_directory m_dir;
+  };
+}
+
+TEST_F(blockchain_test, prepare_hands_back_parsed_txs)
+{
+  ASSERT_TRUE(init());
+
+  std::list<block_complete_entry> entries(2);
+  entries.front().txs.push_back(make_tx_blob(1, 100));
+  entries.front().txs.push_back(make_tx_blob(2, 200));
+  entries.back().txs.push_back(make_tx_blob(3, 300));
+
+  std::vector<transaction> txs;
+  ASSERT_TRUE(m_blockchain.prepare_handle_incoming_blocks(entries, txs));
+  ASSERT_EQ(3, txs.size());
+
+  // in the order of the blobs, and hashing to what the blobs hash to
+  size_t i = 0;
+  for (const auto& entry : entries)
+  {
+    for (const auto& tx_blob : entry.txs)
+    {
+      ASSERT_EQ(get_blob_hash(tx_blob), get_transaction_hash(txs[i]));
+      ++i;
+    }
+  }
+  ASSERT_TRUE(m_blockchain.cleanup_handle_incoming_blocks());
+}
+
+TEST_F(blockchain_test, prepare_hands_back_nothing_on_bad_blob)
+{
+  ASSERT_TRUE(init());
+
+  std::list<block_complete_entry> entries(1);
+  entries.front().txs.push_back(make_tx_blob(1, 100));
+  entries.front().txs.push_back("not a transaction");
+
+  std::vector<transaction> txs(1);
+  ASSERT_TRUE(m_blockchain.prepare_handle_incoming_blocks(entries, txs));
+  ASSERT_TRUE(txs.empty());
+  ASSERT_TRUE(m_blockchain.cleanup_handle_incoming_blocks());
+}
+
+TEST_F(blockchain_test, block_window_follows_the_chain)
+{
+  ASSERT_TRUE(init());
+  account_base miner;
+  miner.generate();
+  const account_public_address& address = miner.get_keys().m_account_address;
+  uint64_t start_time = time(NULL) - 100 * DIFFICULTY_TARGET;
+
+  block b;
+  for (uint64_t i = 1; i <= 4; ++i)
+  {
+    ASSERT_TRUE(mine_block(m_blockchain, address, start_time + i * DIFFICULTY_TARGET, b));
+    ASSERT_EQ(db_next_difficulty(*m_db), m_blockchain.get_difficulty_for_next_block());
+  }
+
+  // a longer chain from the genesis block with blocks twice as fast, which
+  // ends up at a different difficulty
+  chain_and_pool alt;
+  Blockchain& alt_blockchain = alt.blockchain;
+  BlockchainDB* alt_db = new BlockchainLMDB();
+  alt_db->open((m_dir.path() / "alt").string());
+  ASSERT_TRUE(alt_blockchain.init(alt_db));
+  std::list<block> alt_blocks;
+  for (uint64_t i = 1; i <= 6; ++i)
+  {
+    ASSERT_TRUE(mine_block(alt_blockchain, address, start_time + i * DIFFICULTY_TARGET / 2, b));
+    alt_blocks.push_back(b);
+  }
+  difficulty_type alt_difficulty = alt_blockchain.get_difficulty_for_next_block();
+  ASSERT_NE(alt_difficulty, m_blockchain.get_difficulty_for_next_block());
+  alt_blockchain.deinit();
+
+  // switching to it pops blocks off the window and adds the new ones
+  for (const block& alt_block : alt_blocks)
+  {
+    block_verification_context bvc = AUTO_VAL_INIT(bvc);
+    ASSERT_TRUE(m_blockchain.add_new_block(alt_block, bvc));
+    ASSERT_FALSE(bvc.m_verifivation_failed);
+  }
+  ASSERT_EQ(get_block_hash(alt_blocks.back()), m_db->top_block_hash());
+  ASSERT_EQ(alt_difficulty, db_next_difficulty(*m_db));
+  ASSERT_EQ(alt_difficulty, m_blockchain.get_difficulty_for_next_block());
+
+  // a block popped behind Blockchain's back is not served from the window
+  block popped;
+  std::vector<transaction> popped_txs;
+  m_db->pop_block(popped, popped_txs);
+  ASSERT_EQ(db_next_difficulty(*m_db), m_blockchain.get_difficulty_for_next_block());
+
+  // and the window is rebuilt with the next block added
+  ASSERT_TRUE(mine_block(m_blockchain, address, start_time + 7 * DIFFICULTY_TARGET / 2, b));
+  ASSERT_EQ(db_next_difficulty(*m_db), m_blockchain.get_difficulty_for_next_block());
+}
+
+
+TEST(blockchain_ring_signatures, serial_and_parallel_agree)
+{
+  // more inputs than the pool's threads can take one batch each
+  const size_t count = 80;
+  transaction tx;
+  std::vector<Blockchain::ring_signature_check> checks;
+  make_ring_signature_checks(count, tx, checks);
+
+  // passing signatures are remembered, so each path gets its own chain
+  chain_and_pool serial, parallel;
+  serial.blockchain.set_max_verify_threads(1);
+  parallel.blockchain.set_max_verify_threads(4);
+  size_t failed_index = count;
+  ASSERT_TRUE(serial.blockchain.check_ring_signatures(checks, failed_index));
+  ASSERT_TRUE(parallel.blockchain.check_ring_signatures(checks, failed_index));
+  ASSERT_EQ(count, failed_index);
+}
+
+TEST(blockchain_ring_signatures, bad_signature_is_found)
+{
+  const size_t count = 80;
+  transaction tx;
+  std::vector<Blockchain::ring_signature_check> checks;
+  make_ring_signature_checks(count, tx, checks);
+  const size_t bad = 53;
+  tx.signatures[bad][0] = tx.signatures[bad][1];
+
+  // failures are not remembered, so one chain can check both ways
+  chain_and_pool cp;
+  for (unsigned int threads : {1, 2, 4, 8})
+  {
+    cp.blockchain.set_max_verify_threads(threads);
+    size_t failed_index = count;
+    ASSERT_FALSE(cp.blockchain.check_ring_signatures(checks, failed_index)) << threads << " threads";
+    ASSERT_EQ(bad, failed_index) << threads << " threads";
+  }
+}
+
+TEST(blockchain_ring_signatures, stops_at_bad_signature)
+{
+  const size_t count = 1024;
+  transaction tx;
+  std::vector<Blockchain::ring_signature_check> checks;
+  make_ring_signature_checks(count, tx, checks);
+
+  for (unsigned int threads : {1, 4})
+  {
+    // checking all of them, on a chain that does not remember them yet
+    chain_and_pool all;
+    all.blockchain.set_max_verify_threads(threads);
+    size_t failed_index = count;
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(all.blockchain.check_ring_signatures(checks, failed_index));
+    auto all_time = std::chrono::steady_clock::now() - start;
+
+    // with the first one bad, most of the rest are never looked at
+    transaction bad_tx = tx;
+    bad_tx.signatures[0][0] = bad_tx.signatures[0][1];
+    std::vector<Blockchain::ring_signature_check> bad_checks = checks;
+    for (auto& check : bad_checks)
+      check.tx = &bad_tx;
+    chain_and_pool cp;
+    cp.blockchain.set_max_verify_threads(threads);
+    start = std::chrono::steady_clock::now();
+    ASSERT_FALSE(cp.blockchain.check_ring_signatures(bad_checks, failed_index));
+    auto bad_time = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(0, failed_index);
+    ASSERT_LT(bad_time * 4, all_time) << threads << " threads";
+  }
+}
+
+#endif
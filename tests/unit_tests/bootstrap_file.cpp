@@ -0,0 +1,172 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "blockchain_converter/bootstrap_file.h"
+#include "unit_tests_utils.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  transaction make_tx(uint64_t height, uint64_t amount)
+  {
+    transaction tx = AUTO_VAL_INIT(tx);
+    tx.version = CURRENT_TRANSACTION_VERSION;
+    txin_gen in;
+    in.height = height;
+    tx.vin.push_back(in);
+    tx_out out;
+    out.amount = amount;
+    txout_to_key key = AUTO_VAL_INIT(key);
+    out.target = key;
+    tx.vout.push_back(out);
+    return tx;
+  }
+
+  // a block at height with n txs, and the blobs of those txs
+  block make_block(uint64_t height, size_t n, std::vector<blobdata>& tx_blobs)
+  {
+    block b = AUTO_VAL_INIT(b);
+    b.major_version = CURRENT_BLOCK_MAJOR_VERSION;
+    b.timestamp = 1000 + height;
+    b.miner_tx = make_tx(height, 1000);
+    tx_blobs.clear();
+    for (size_t i = 0; i < n; ++i)
+    {
+      transaction tx = make_tx(height, height * 100 + i);
+      tx_blobs.push_back(tx_to_blob(tx));
+      b.tx_hashes.push_back(get_transaction_hash(tx));
+    }
+    return b;
+  }
+
+  class bootstrap_file_test : public ::testing::Test
+  {
+  protected:
+    bootstrap_file_test()
+      : m_path(m_dir.path() / "blockchain.raw")
+    {
+    }
+
+    // blocks 0 to num_blocks - 1, block h holding h % 3 txs
+    void write(size_t num_blocks, size_t blocks_per_chunk)
+    {
+      bootstrap::writer writer(blocks_per_chunk);
+      ASSERT_TRUE(writer.open(m_path));
+      for (uint64_t h = 0; h < num_blocks; ++h)
+      {
+        std::vector<blobdata> tx_blobs;
+        block b = make_block(h, h % 3, tx_blobs);
+        m_ids.push_back(get_block_hash(b));
+        ASSERT_TRUE(writer.add_block(h, block_to_blob(b), tx_blobs, 100 + h, 1000 + h, 10000 + h));
+      }
+      ASSERT_TRUE(writer.close());
+    }
+
+    unit_test::temp_directory m_dir;
+    boost::filesystem::path m_path;
+    std::vector<crypto::hash> m_ids;
+  };
+}
+
+TEST_F(bootstrap_file_test, round_trip)
+{
+  write(5, 2);
+
+  bootstrap::reader reader;
+  ASSERT_TRUE(bootstrap::reader::is_bootstrap_file(m_path));
+  ASSERT_TRUE(reader.open(m_path));
+  ASSERT_EQ(5, reader.get_num_blocks());
+  ASSERT_EQ(3, reader.get_num_chunks());
+  ASSERT_EQ(2, reader.find_chunk(4));
+  ASSERT_EQ(3, reader.find_chunk(5));
+
+  uint64_t h = 0;
+  for (size_t i = 0; i < reader.get_num_chunks(); ++i)
+  {
+    std::vector<bootstrap::parsed_block> blocks;
+    ASSERT_TRUE(reader.read_chunk(i, blocks));
+    ASSERT_EQ(reader.get_chunk(i).num_blocks, blocks.size());
+    for (const auto& pb : blocks)
+    {
+      ASSERT_EQ(h, pb.height);
+      ASSERT_EQ(m_ids[h], get_block_hash(pb.b));
+      ASSERT_EQ(h % 3, pb.txs.size());
+      for (size_t t = 0; t < pb.txs.size(); ++t)
+        ASSERT_EQ(pb.b.tx_hashes[t], get_transaction_hash(pb.txs[t]));
+      ASSERT_EQ(100 + h, pb.block_size);
+      ASSERT_EQ(1000 + h, pb.cumulative_difficulty);
+      ASSERT_EQ(10000 + h, pb.coins_generated);
+      ++h;
+    }
+  }
+  ASSERT_EQ(5, h);
+}
+
+TEST_F(bootstrap_file_test, little_endian)
+{
+  write(1, 1);
+
+  std::ifstream in(m_path.string(), std::ios_base::binary);
+  unsigned char header[8];
+  ASSERT_TRUE(in.read(reinterpret_cast<char*>(header), sizeof(header)));
+  const unsigned char expected[8] = {'B', 'O', 'O', 'T', bootstrap::FILE_VERSION, 0, 0, 0};
+  ASSERT_EQ(0, memcmp(header, expected, sizeof(header)));
+}
+
+TEST_F(bootstrap_file_test, corrupt_chunk)
+{
+  write(4, 2);
+
+  // flip a byte of the second chunk's payload
+  bootstrap::index_entry chunk;
+  {
+    bootstrap::reader reader;
+    ASSERT_TRUE(reader.open(m_path));
+    chunk = reader.get_chunk(1);
+  }
+  {
+    std::fstream f(m_path.string(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+    f.seekg(chunk.offset + sizeof(bootstrap::chunk_header));
+    char c = f.get();
+    f.seekp(chunk.offset + sizeof(bootstrap::chunk_header));
+    f.put(c ^ 1);
+  }
+
+  bootstrap::reader reader;
+  ASSERT_TRUE(reader.open(m_path));
+  std::vector<bootstrap::parsed_block> blocks;
+  ASSERT_TRUE(reader.read_chunk(0, blocks));
+  ASSERT_FALSE(reader.read_chunk(1, blocks));
+}
@@ -421,6 +421,23 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_EQ(3, m_commands_handler.callback_counter());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, shared_notify_packet_matches_notify)
+{
+  const int expected_command = 4673261;
+  const std::string in_data(256, 'n');
+
+  test_connection_ptr conn_a = create_connection();
+  test_connection_ptr conn_b = create_connection();
+  ASSERT_EQ(1, conn_a->m_protocol_handler.notify(expected_command, in_data));
+
+  boost::shared_ptr<const std::string> packet = m_handler_config.make_notify_packet(expected_command, in_data);
+  ASSERT_EQ(sizeof(epee::levin::bucket_head2) + in_data.size(), packet->size());
+  ASSERT_EQ(1, m_handler_config.notify_packet(packet, conn_b->m_protocol_handler.get_connection_id()));
+
+  ASSERT_EQ(conn_a->last_send_data(), conn_b->last_send_data());
+  ASSERT_EQ(1, conn_b->send_counter());
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_big_packet_1)
 {
   std::string buf("yyyyyy");
@@ -530,3 +547,28 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpe
 
   ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
 }
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_many_requests_byte_by_byte)
+{
+  prepare_buf();
+  std::string buf;
+  for (size_t i = 0; i < 10; ++i)
+    buf.append(m_buf);
+
+  for (size_t i = 0; i < buf.size(); ++i)
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(buf.data() + i, 1));
+  ASSERT_EQ(10, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, reuses_receive_buffers)
+{
+  prepare_buf();
+  m_buf.append(m_buf);
+  m_buf.append(m_buf);
+
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(4, m_commands_handler.invoke_counter());
+  ASSERT_EQ(1, m_handler_config.m_recv_buffers.get_allocated_count());
+  ASSERT_EQ(3, m_handler_config.m_recv_buffers.get_reused_count());
+}
@@ -0,0 +1,242 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_template_helper.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+
+namespace
+{
+  struct child
+  {
+    std::string name;
+    uint32_t value;
+    std::list<std::string> tags;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(value)
+      KV_SERIALIZE(tags)
+    END_KV_SERIALIZE_MAP()
+
+    bool operator==(const child& c) const { return name == c.name && value == c.value && tags == c.tags; }
+  };
+
+  struct pod
+  {
+    uint64_t a;
+    uint32_t b;
+
+    bool operator==(const pod& p) const { return a == p.a && b == p.b; }
+  };
+
+  struct parent
+  {
+    uint64_t u64;
+    int8_t i8;
+    double d;
+    bool flag;
+    std::string blob;
+    child single;
+    std::list<child> children;
+    std::vector<uint64_t> numbers;
+    pod p;
+    std::vector<pod> pods;
+    uint16_t after_arrays;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(u64)
+      KV_SERIALIZE(i8)
+      KV_SERIALIZE(d)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(single)
+      KV_SERIALIZE(children)
+      KV_SERIALIZE(numbers)
+      KV_SERIALIZE_VAL_POD_AS_BLOB(p)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(pods)
+      KV_SERIALIZE(after_arrays)
+    END_KV_SERIALIZE_MAP()
+
+    bool operator==(const parent& o) const
+    {
+      return u64 == o.u64 && i8 == o.i8 && d == o.d && flag == o.flag && blob == o.blob && single == o.single &&
+        children == o.children && numbers == o.numbers && p == o.p && pods == o.pods && after_arrays == o.after_arrays;
+    }
+  };
+
+  struct parent_wide
+  {
+    uint64_t i8;
+    std::string extra;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(i8)
+      KV_SERIALIZE(extra)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  parent make_parent(size_t children_count, size_t numbers_count)
+  {
+    parent r = AUTO_VAL_INIT(r);
+    r.u64 = 0x0123456789abcdef;
+    r.i8 = -5;
+    r.d = 3.25;
+    r.flag = true;
+    r.blob = std::string("\0binary\xff", 8);
+    r.single.name = "single";
+    r.single.value = 7;
+    r.single.tags.push_back("x");
+    for (size_t i = 0; i < children_count; ++i)
+    {
+      child c;
+      c.name = "child" + std::to_string(i);
+      c.value = i;
+      for (size_t j = 0; j < i % 3; ++j)
+        c.tags.push_back(std::string(j + 1, 't'));
+      r.children.push_back(c);
+    }
+    for (size_t i = 0; i < numbers_count; ++i)
+      r.numbers.push_back(i * 1000003);
+    r.p.a = 11;
+    r.p.b = 12;
+    r.pods.resize(3);
+    r.pods[1].a = 5;
+    r.after_arrays = 300;
+    return r;
+  }
+
+  std::string store_with_tree(const parent& p)
+  {
+    epee::serialization::portable_storage ps;
+    p.store(ps);
+    std::string buff;
+    ps.store_to_binary(buff);
+    return buff;
+  }
+
+  bool load_with_tree(parent& p, const std::string& buff)
+  {
+    epee::serialization::portable_storage ps;
+    return ps.load_from_binary(buff) && p.load(ps);
+  }
+}
+
+TEST(portable_storage_stream, writer_output_is_readable_by_portable_storage)
+{
+  const size_t sizes[] = {0, 1, 63, 64, 20000};
+  for (size_t n: sizes)
+  {
+    parent p = make_parent(n, n);
+    std::string buff;
+    ASSERT_TRUE(epee::serialization::store_t_to_binary(p, buff));
+
+    parent loaded = AUTO_VAL_INIT(loaded);
+    ASSERT_TRUE(load_with_tree(loaded, buff));
+    ASSERT_TRUE(p == loaded);
+  }
+}
+
+TEST(portable_storage_stream, reader_loads_portable_storage_output)
+{
+  const size_t sizes[] = {0, 1, 63, 64, 20000};
+  for (size_t n: sizes)
+  {
+    parent p = make_parent(n, n);
+    std::string buff = store_with_tree(p);
+
+    parent loaded = AUTO_VAL_INIT(loaded);
+    ASSERT_TRUE(epee::serialization::load_t_from_binary(loaded, buff));
+    ASSERT_TRUE(p == loaded);
+  }
+}
+
+TEST(portable_storage_stream, reader_converts_and_skips_like_portable_storage)
+{
+  parent p = make_parent(2, 2);
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(p, buff));
+
+  parent_wide w = AUTO_VAL_INIT(w);
+  w.extra = "untouched";
+  // int8_t -5 can't go into an unsigned field, same as with portable_storage
+  ASSERT_FALSE(epee::serialization::load_t_from_binary(w, buff));
+
+  p.i8 = 100;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(p, buff));
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(w, buff));
+  ASSERT_EQ(100, w.i8);
+  ASSERT_EQ("untouched", w.extra);
+}
+
+TEST(portable_storage_stream, reader_rejects_truncated_buffers)
+{
+  parent p = make_parent(10, 10);
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(p, buff));
+  for (size_t len = 0; len < buff.size(); len += 7)
+  {
+    epee::serialization::portable_storage_reader reader;
+    ASSERT_FALSE(reader.load_from_binary(buff.substr(0, len)));
+  }
+}
+
+TEST(portable_storage_stream, protocol_messages_round_trip)
+{
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+  r.current_blockchain_height = 12345;
+  for (size_t i = 0; i < 100; ++i)
+  {
+    cryptonote::block_complete_entry e;
+    e.block = std::string(200 + i, 'b');
+    for (size_t j = 0; j < i % 4; ++j)
+      e.txs.push_back(std::string(300 + j, 't'));
+    r.blocks.push_back(e);
+  }
+  r.txs.push_back(std::string(1000, 'x'));
+  r.missed_ids.push_back(crypto::hash());
+
+  std::string streamed, tree;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, streamed));
+  epee::serialization::portable_storage ps;
+  r.store(ps);
+  ps.store_to_binary(tree);
+  ASSERT_EQ(tree.size(), streamed.size());
+
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r2;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(r2, tree));
+  ASSERT_EQ(r.current_blockchain_height, r2.current_blockchain_height);
+  ASSERT_EQ(r.blocks.size(), r2.blocks.size());
+  ASSERT_EQ(r.blocks.back().block, r2.blocks.back().block);
+  ASSERT_TRUE(r.blocks.back().txs == r2.blocks.back().txs);
+  ASSERT_TRUE(r.txs == r2.txs);
+  ASSERT_EQ(1, r2.missed_ids.size());
+}
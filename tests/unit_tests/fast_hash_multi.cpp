@@ -0,0 +1,90 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "crypto/hash.h"
+
+namespace
+{
+  TEST(cn_fast_hash_multi, same_as_cn_fast_hash)
+  {
+    // lengths around the 136 byte keccak block, so the lanes finish at different times
+    std::vector<std::string> messages;
+    for (size_t length : {0, 1, 32, 64, 135, 136, 137, 271, 272, 500, 64, 64, 33})
+    {
+      std::string m(length, 0);
+      for (size_t i = 0; i < length; ++i)
+        m[i] = static_cast<char>(i * 7 + length);
+      messages.push_back(m);
+    }
+
+    for (size_t count = 0; count <= messages.size(); ++count)
+    {
+      std::vector<const void *> data;
+      std::vector<size_t> lengths;
+      std::vector<crypto::hash> hashes(count);
+      std::vector<crypto::hash *> hash_ptrs;
+      for (size_t i = 0; i < count; ++i)
+      {
+        data.push_back(messages[i].data());
+        lengths.push_back(messages[i].size());
+        hash_ptrs.push_back(&hashes[i]);
+      }
+      crypto::cn_fast_hash_multi(data.data(), lengths.data(), count, hash_ptrs.data());
+      for (size_t i = 0; i < count; ++i)
+        ASSERT_EQ(crypto::cn_fast_hash(messages[i].data(), messages[i].size()), hashes[i]);
+    }
+  }
+
+  TEST(cn_fast_hash_multi, derive_public_keys_same_as_derive_public_key)
+  {
+    crypto::public_key tx_pub, spend_pub, view_pub;
+    crypto::secret_key tx_sec, spend_sec, view_sec;
+    crypto::generate_keys(tx_pub, tx_sec);
+    crypto::generate_keys(spend_pub, spend_sec);
+    crypto::generate_keys(view_pub, view_sec);
+    crypto::key_derivation derivation;
+    ASSERT_TRUE(crypto::generate_key_derivation(tx_pub, view_sec, derivation));
+
+    // output indices on both sides of the one/two byte varint boundary
+    const size_t first = 120, count = 20;
+    std::vector<crypto::public_key> keys(count);
+    ASSERT_TRUE(crypto::derive_public_keys(derivation, first, count, spend_pub, keys.data()));
+    for (size_t i = 0; i < count; ++i)
+    {
+      crypto::public_key key;
+      ASSERT_TRUE(crypto::derive_public_key(derivation, first + i, spend_pub, key));
+      ASSERT_EQ(key, keys[i]);
+    }
+  }
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/connection_context.h"
+
+namespace
+{
+  crypto::hash make_hash(uint32_t n)
+  {
+    crypto::hash h;
+    memset(&h, 0, sizeof(h));
+    memcpy(&h, &n, sizeof(n));
+    return h;
+  }
+
+  std::list<crypto::hash> make_ids(uint32_t from, uint32_t count)
+  {
+    std::list<crypto::hash> ids;
+    for (uint32_t n = from; n < from + count; ++n)
+      ids.push_back(make_hash(n));
+    return ids;
+  }
+}
+
+TEST(known_inventory, reports_only_new_ids)
+{
+  cryptonote::known_inventory inv(16);
+  ASSERT_TRUE(inv.add(make_ids(0, 4)));
+  ASSERT_FALSE(inv.add(make_ids(0, 4)));
+  ASSERT_FALSE(inv.add(make_ids(1, 2)));
+  ASSERT_TRUE(inv.add(make_ids(3, 2)));
+  ASSERT_EQ(5, inv.size());
+  ASSERT_TRUE(inv.contains(make_hash(4)));
+  ASSERT_FALSE(inv.contains(make_hash(5)));
+}
+
+TEST(known_inventory, forgets_oldest_ids_first)
+{
+  cryptonote::known_inventory inv(8);
+  ASSERT_TRUE(inv.add(make_ids(0, 12)));
+  ASSERT_EQ(8, inv.size());
+  for (uint32_t n = 0; n < 4; ++n)
+    ASSERT_FALSE(inv.contains(make_hash(n)));
+  for (uint32_t n = 4; n < 12; ++n)
+    ASSERT_TRUE(inv.contains(make_hash(n)));
+}
+
+TEST(known_inventory, copies_share_state)
+{
+  cryptonote::cryptonote_connection_context context;
+  cryptonote::cryptonote_connection_context copy = context;
+  ASSERT_TRUE(copy.m_known_inventory.add(make_ids(0, 1)));
+  ASSERT_TRUE(context.m_known_inventory.contains(make_hash(0)));
+  ASSERT_FALSE(context.m_known_inventory.add(make_ids(0, 1)));
+}
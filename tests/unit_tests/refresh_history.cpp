@@ -0,0 +1,94 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "wallet/wallet2.h"
+
+namespace
+{
+  crypto::hash make_hash(uint32_t n)
+  {
+    crypto::hash h;
+    memset(&h, 0, sizeof(h));
+    memcpy(&h, &n, sizeof(n));
+    return h;
+  }
+
+  std::list<crypto::hash> make_ids(std::initializer_list<uint32_t> ns)
+  {
+    std::list<crypto::hash> ids;
+    for (uint32_t n : ns)
+      ids.push_back(make_hash(n));
+    return ids;
+  }
+
+  // the wallet's short chain history: its top block 1000, then 999 and genesis
+  const std::list<crypto::hash> wallet_history = make_ids({1000, 999, 0});
+}
+
+TEST(refresh_history, starts_from_wallet_history)
+{
+  tools::refresh_history history(wallet_history);
+  ASSERT_EQ(wallet_history, history.get());
+}
+
+TEST(refresh_history, continues_from_last_response)
+{
+  tools::refresh_history history(wallet_history);
+  history.on_response(1000, 5, make_hash(1000), make_hash(1004));
+  ASSERT_EQ(make_ids({1004, 1000, 1000, 999, 0}), history.get());
+
+  history.on_response(1004, 5, make_hash(1004), make_hash(1008));
+  ASSERT_EQ(make_ids({1008, 1004, 1000, 1000, 999, 0}), history.get());
+}
+
+TEST(refresh_history, rebases_on_reorg)
+{
+  tools::refresh_history history(wallet_history);
+  history.on_response(1000, 5, make_hash(1000), make_hash(1004));
+  history.on_response(1004, 5, make_hash(1004), make_hash(1008));
+
+  // the daemon left the branch at 1004: it answers from 1002, and the ids
+  // above that are gone
+  history.on_response(1002, 10, make_hash(1002), make_hash(2011));
+  ASSERT_EQ(make_ids({2011, 1002, 1000, 1000, 999, 0}), history.get());
+
+  // below everything fetched: back to the wallet's history
+  history.on_response(999, 3, make_hash(999), make_hash(3001));
+  ASSERT_EQ(make_ids({3001, 999, 1000, 999, 0}), history.get());
+}
+
+TEST(refresh_history, fetched_ids_are_bounded)
+{
+  tools::refresh_history history(wallet_history);
+  for (uint32_t h = 1000; h < 1000 + 10 * REFRESH_HISTORY_MAX_FETCHED; h += 10)
+    history.on_response(h, 11, make_hash(h), make_hash(h + 10));
+  ASSERT_EQ(REFRESH_HISTORY_MAX_FETCHED + wallet_history.size(), history.get().size());
+  ASSERT_EQ(make_hash(1000 + 10 * REFRESH_HISTORY_MAX_FETCHED), history.get().front());
+}
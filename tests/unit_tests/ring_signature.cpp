@@ -0,0 +1,120 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "crypto/crypto.h"
+
+namespace
+{
+  struct signed_ring
+  {
+    crypto::hash prefix_hash;
+    crypto::key_image image;
+    std::vector<crypto::public_key> pubs;
+    std::vector<const crypto::public_key *> pub_ptrs;
+    std::vector<crypto::signature> sigs;
+
+    signed_ring(size_t ring_size, size_t real_index)
+      : pubs(ring_size), pub_ptrs(ring_size), sigs(ring_size)
+    {
+      crypto::secret_key sec, real_sec;
+      for (size_t i = 0; i < ring_size; ++i)
+      {
+        crypto::generate_keys(pubs[i], i == real_index ? real_sec : sec);
+        pub_ptrs[i] = &pubs[i];
+      }
+      prefix_hash = crypto::rand<crypto::hash>();
+      crypto::generate_key_image(pubs[real_index], real_sec, image);
+      crypto::generate_ring_signature(prefix_hash, image, pub_ptrs, real_sec, real_index, sigs.data());
+    }
+
+    crypto::ring_signature_ref ref() const
+    {
+      crypto::ring_signature_ref r = {&prefix_hash, &image, pub_ptrs.data(), pub_ptrs.size(), sigs.data()};
+      return r;
+    }
+  };
+
+  std::vector<crypto::ring_signature_ref> refs(const std::vector<signed_ring>& rings)
+  {
+    std::vector<crypto::ring_signature_ref> res;
+    for (const auto& r : rings)
+      res.push_back(r.ref());
+    return res;
+  }
+
+  TEST(ring_signature, batch_of_valid_signatures)
+  {
+    std::vector<signed_ring> rings;
+    for (size_t i = 0; i < 5; ++i)
+      rings.push_back(signed_ring(i + 1, i));
+
+    std::vector<crypto::ring_signature_ref> r = refs(rings);
+    size_t failed_index = 0;
+    ASSERT_TRUE(crypto::check_ring_signatures(r.data(), r.size(), failed_index));
+    for (const auto& ring : rings)
+      ASSERT_TRUE(crypto::check_ring_signature(ring.prefix_hash, ring.image, ring.pub_ptrs, ring.sigs.data()));
+  }
+
+  TEST(ring_signature, batch_reports_invalid_signature)
+  {
+    std::vector<signed_ring> rings;
+    for (size_t i = 0; i < 4; ++i)
+      rings.push_back(signed_ring(3, 1));
+    rings[2].prefix_hash = crypto::rand<crypto::hash>();
+
+    std::vector<crypto::ring_signature_ref> r = refs(rings);
+    size_t failed_index = 0;
+    ASSERT_FALSE(crypto::check_ring_signatures(r.data(), r.size(), failed_index));
+    ASSERT_EQ(2, failed_index);
+    ASSERT_FALSE(crypto::check_ring_signature(rings[2].prefix_hash, rings[2].image, rings[2].pub_ptrs, rings[2].sigs.data()));
+    ASSERT_TRUE(crypto::check_ring_signatures(r.data(), 2, failed_index));
+  }
+
+  TEST(ring_signature, same_result_without_ring_member_cache)
+  {
+    signed_ring ring(10, 7);
+    signed_ring other(10, 3);
+    crypto::ring_signature_ref bad = ring.ref();
+    bad.sig = other.sigs.data();
+
+    for (size_t cache_size : {4096, 0, 4, 4096})
+    {
+      crypto::set_ring_member_cache_size(cache_size);
+      size_t failed_index = 0;
+      crypto::ring_signature_ref good = ring.ref();
+      ASSERT_TRUE(crypto::check_ring_signatures(&good, 1, failed_index));
+      ASSERT_TRUE(crypto::check_ring_signatures(&good, 1, failed_index));
+      ASSERT_FALSE(crypto::check_ring_signatures(&bad, 1, failed_index));
+      ASSERT_EQ(0, failed_index);
+    }
+  }
+}
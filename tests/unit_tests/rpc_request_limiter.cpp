@@ -0,0 +1,106 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/thread/thread.hpp>
+
+#include "rpc/rpc_request_limiter.h"
+
+namespace
+{
+  TEST(rpc_request_limiter, unlimited_methods_always_enter)
+  {
+    cryptonote::rpc_request_limiter limiter;
+    limiter.set_max_pending(1);
+    limiter.set_limit("slow", 1);
+
+    ASSERT_TRUE(limiter.enter("slow", 0));
+    for (int i = 0; i < 10; ++i)
+      ASSERT_TRUE(limiter.enter("cheap", 0));
+  }
+
+  TEST(rpc_request_limiter, busy_when_queue_is_full)
+  {
+    cryptonote::rpc_request_limiter limiter;
+    limiter.set_max_pending(2);
+    limiter.set_limit("slow", 1);
+
+    ASSERT_TRUE(limiter.enter("slow", 0));
+    // may queue, but no slot frees up in time
+    ASSERT_FALSE(limiter.enter("slow", 10));
+    limiter.set_max_pending(1);
+    // no room to queue at all
+    ASSERT_FALSE(limiter.enter("slow", 1000));
+
+    limiter.leave("slow", 0);
+    ASSERT_TRUE(limiter.enter("slow", 0));
+
+    std::vector<cryptonote::rpc_request_limiter::method_stats> stats = limiter.get_stats();
+    ASSERT_EQ(1, stats.size());
+    ASSERT_EQ(1, stats[0].count);
+    ASSERT_EQ(2, stats[0].busy);
+  }
+
+  TEST(rpc_request_limiter, waiter_gets_freed_slot)
+  {
+    cryptonote::rpc_request_limiter limiter;
+    limiter.set_max_pending(2);
+    limiter.set_limit("slow", 1);
+
+    ASSERT_TRUE(limiter.enter("slow", 0));
+    boost::thread t([&limiter]() {
+      boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+      limiter.leave("slow", 50);
+    });
+    ASSERT_TRUE(limiter.enter("slow", 5000));
+    t.join();
+  }
+
+  TEST(rpc_request_limiter, latency_histogram)
+  {
+    cryptonote::rpc_request_limiter limiter;
+    const uint64_t latencies[] = {0, 1, 3, 1000000};
+    for (uint64_t ms : latencies)
+    {
+      ASSERT_TRUE(limiter.enter("m", 0));
+      limiter.leave("m", ms);
+    }
+
+    std::vector<cryptonote::rpc_request_limiter::method_stats> stats = limiter.get_stats();
+    ASSERT_EQ(1, stats.size());
+    ASSERT_EQ(4, stats[0].count);
+    ASSERT_EQ(1000004, stats[0].total_ms);
+    const std::vector<uint64_t>& h = stats[0].latency_histogram;
+    ASSERT_EQ(cryptonote::rpc_request_limiter::LATENCY_BUCKETS, h.size());
+    ASSERT_EQ(1, h[0]); // < 1 ms
+    ASSERT_EQ(1, h[1]); // < 2 ms
+    ASSERT_EQ(1, h[2]); // < 4 ms
+    ASSERT_EQ(1, h.back());
+  }
+}
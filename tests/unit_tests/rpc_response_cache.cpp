@@ -0,0 +1,129 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "net/jsonrpc_structs.h"
+#include "rpc/rpc_response_cache.h"
+
+namespace
+{
+  struct result_t
+  {
+    uint64_t height;
+    std::string status;
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(status)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  TEST(rpc_response_cache, hit_and_miss)
+  {
+    cryptonote::rpc_response_cache cache;
+    std::string body;
+
+    ASSERT_FALSE(cache.get("/getinfo", 1, body));
+    cache.add("/getinfo", 1, "info");
+    ASSERT_TRUE(cache.get("/getinfo", 1, body));
+    ASSERT_EQ("info", body);
+    ASSERT_FALSE(cache.get("/getheight", 1, body));
+
+    ASSERT_EQ(1, cache.get_hits());
+    ASSERT_EQ(2, cache.get_misses());
+  }
+
+  TEST(rpc_response_cache, version_change_drops_entries)
+  {
+    cryptonote::rpc_response_cache cache;
+    std::string body;
+
+    ASSERT_FALSE(cache.get("a", 1, body));
+    cache.add("a", 1, "1");
+    ASSERT_FALSE(cache.get("a", 2, body));
+
+    // built before the change: not cached, and the old version isn't revived
+    cache.add("a", 1, "1");
+    ASSERT_FALSE(cache.get("a", 2, body));
+    ASSERT_FALSE(cache.get("a", 1, body));
+
+    cache.add("a", 2, "2");
+    ASSERT_TRUE(cache.get("a", 2, body));
+    ASSERT_EQ("2", body);
+  }
+
+  TEST(rpc_response_cache, big_bodies_not_cached)
+  {
+    cryptonote::rpc_response_cache cache;
+    std::string body;
+
+    ASSERT_FALSE(cache.get("a", 1, body));
+    cache.add("a", 1, std::string(2 * 1024 * 1024, 'x'));
+    ASSERT_FALSE(cache.get("a", 1, body));
+  }
+
+  TEST(rpc_response_cache, evicts_least_recently_used)
+  {
+    cryptonote::rpc_response_cache cache;
+    std::string body;
+    const std::string big(1000 * 1000, 'x');
+
+    ASSERT_FALSE(cache.get("0", 1, body));
+    for (int i = 0; i < 16; ++i)
+      cache.add(std::to_string(i), 1, big);
+    // touch the oldest one so the next one goes instead
+    ASSERT_TRUE(cache.get("0", 1, body));
+    cache.add("16", 1, big);
+    cache.add("17", 1, big);
+
+    ASSERT_TRUE(cache.get("0", 1, body));
+    ASSERT_FALSE(cache.get("1", 1, body));
+    ASSERT_TRUE(cache.get("16", 1, body));
+    ASSERT_TRUE(cache.get("17", 1, body));
+  }
+
+  TEST(rpc_response_cache, json_rpc_body_takes_callers_id)
+  {
+    result_t result = {42, "OK"};
+    std::string result_json;
+    epee::serialization::store_t_to_json(result, result_json);
+
+    epee::serialization::storage_entry id0 = std::string("a"), id1 = uint64_t(7);
+    std::string body0, body1;
+    epee::json_rpc::make_response_body(id0, result_json, body0);
+    epee::json_rpc::make_response_body(id1, result_json, body1);
+    ASSERT_NE(body0, body1);
+
+    epee::json_rpc::response<result_t, std::string> resp;
+    ASSERT_TRUE(epee::serialization::load_t_from_json(resp, body1));
+    ASSERT_EQ("2.0", resp.jsonrpc);
+    ASSERT_EQ(7, boost::get<uint64_t>(resp.id));
+    ASSERT_EQ(42, resp.result.height);
+    ASSERT_EQ("OK", resp.result.status);
+  }
+}
@@ -120,14 +120,14 @@ bool try_parse(const string &blob)
 TEST(Serialization, BinaryArchiveInts) {
   uint64_t x = 0xff00000000, x1;
 
-  ostringstream oss;
+  binary_string_ostream oss;
   binary_archive<true> oar(oss);
   oar.serialize_int(x);
   ASSERT_TRUE(oss.good());
   ASSERT_EQ(8, oss.str().size());
   ASSERT_EQ(string("\0\0\0\0\xff\0\0\0", 8), oss.str());
 
-  istringstream iss(oss.str());
+  binary_span_istream iss(oss.str());
   binary_archive<false> iar(iss);
   iar.serialize_int(x1);
   ASSERT_EQ(8, iss.tellg());
@@ -139,22 +139,50 @@ TEST(Serialization, BinaryArchiveInts) {
 TEST(Serialization, BinaryArchiveVarInts) {
   uint64_t x = 0xff00000000, x1;
 
-  ostringstream oss;
+  binary_string_ostream oss;
   binary_archive<true> oar(oss);
   oar.serialize_varint(x);
   ASSERT_TRUE(oss.good());
   ASSERT_EQ(6, oss.str().size());
   ASSERT_EQ(string("\x80\x80\x80\x80\xF0\x1F", 6), oss.str());
 
-  istringstream iss(oss.str());
+  binary_span_istream iss(oss.str());
   binary_archive<false> iar(iss);
   iar.serialize_varint(x1);
   ASSERT_TRUE(iss.good());
   ASSERT_EQ(x, x1);
 }
 
+TEST(Serialization, BinaryArchiveTruncated) {
+  const std::string blob("\x01\x02\x03", 3);
+  uint64_t x;
+
+  binary_span_istream iss(blob);
+  binary_archive<false> iar(iss);
+  ASSERT_EQ(3, iar.remaining_bytes());
+  iar.serialize_int(x);
+  ASSERT_FALSE(iss.good());
+  ASSERT_TRUE(iss.eof());
+  ASSERT_EQ(0, iar.remaining_bytes());
+
+  uint16_t y;
+  ASSERT_FALSE(serialization::parse_binary(blob, y)); // trailing byte left over
+  ASSERT_TRUE(serialization::parse_binary(blob.substr(0, 2), y));
+  ASSERT_EQ(0x0201, y);
+}
+
+TEST(Serialization, BinaryArchiveAppendsToBuffer) {
+  std::string buf("prefix");
+  binary_string_ostream oss(buf);
+  binary_archive<true> oar(oss);
+  uint32_t x = 0x04030201;
+  oar.serialize_int(x);
+  ASSERT_TRUE(oss.good());
+  ASSERT_EQ(string("prefix\x01\x02\x03\x04", 10), buf);
+}
+
 TEST(Serialization, Test1) {
-  ostringstream str;
+  binary_string_ostream str;
   binary_archive<true> ar(str);
 
   Struct1 s1;
@@ -0,0 +1,120 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "syncobj.h"
+
+namespace
+{
+  // long enough for a thread which could take the section to have done so
+  const std::chrono::milliseconds SETTLE_TIME(100);
+
+  TEST(recursive_shared_critical_section, exclusive_is_reentrant)
+  {
+    epee::recursive_shared_critical_section cs;
+    cs.lock();
+    cs.lock();
+    cs.lock_shared();
+    cs.unlock_shared();
+    cs.unlock();
+    cs.unlock();
+
+    // released, so another thread gets it
+    std::atomic<bool> locked(false);
+    std::thread t([&]() { cs.lock(); locked = true; cs.unlock(); });
+    t.join();
+    ASSERT_TRUE(locked);
+  }
+
+  TEST(recursive_shared_critical_section, readers_share)
+  {
+    epee::recursive_shared_critical_section cs;
+    cs.lock_shared();
+
+    std::atomic<bool> locked(false);
+    std::thread t([&]() { cs.lock_shared(); locked = true; cs.unlock_shared(); });
+    t.join();
+    ASSERT_TRUE(locked);
+
+    cs.unlock_shared();
+  }
+
+  TEST(recursive_shared_critical_section, writer_waits_for_readers)
+  {
+    epee::recursive_shared_critical_section cs;
+    cs.lock_shared();
+
+    std::atomic<bool> locked(false);
+    std::thread t([&]() { cs.lock(); locked = true; cs.unlock(); });
+    std::this_thread::sleep_for(SETTLE_TIME);
+    ASSERT_FALSE(locked);
+
+    cs.unlock_shared();
+    t.join();
+    ASSERT_TRUE(locked);
+  }
+
+  TEST(recursive_shared_critical_section, readers_wait_for_writer)
+  {
+    epee::recursive_shared_critical_section cs;
+    cs.lock();
+
+    std::atomic<bool> locked(false);
+    std::thread t([&]() { cs.lock_shared(); locked = true; cs.unlock_shared(); });
+    std::this_thread::sleep_for(SETTLE_TIME);
+    ASSERT_FALSE(locked);
+
+    cs.unlock();
+    t.join();
+    ASSERT_TRUE(locked);
+  }
+
+  TEST(recursive_shared_critical_section, nested_reader_passes_waiting_writer)
+  {
+    epee::recursive_shared_critical_section cs;
+    cs.lock_shared();
+
+    std::atomic<bool> locked(false);
+    std::thread t([&]() { cs.lock(); locked = true; cs.unlock(); });
+    std::this_thread::sleep_for(SETTLE_TIME);
+
+    // would deadlock if it queued behind the writer
+    cs.lock_shared();
+    cs.unlock_shared();
+    ASSERT_FALSE(locked);
+
+    cs.unlock_shared();
+    t.join();
+    ASSERT_TRUE(locked);
+  }
+}
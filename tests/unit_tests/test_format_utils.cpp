@@ -203,3 +203,171 @@ TEST(validate_parse_amount_case, validate_parse_amount)
   r = cryptonote::parse_amount(res, "1 00.00 00");
   ASSERT_FALSE(r);
 }
+
+namespace
+{
+  cryptonote::transaction make_miner_tx()
+  {
+    cryptonote::transaction tx = AUTO_VAL_INIT(tx);
+    cryptonote::account_base acc;
+    acc.generate();
+    cryptonote::construct_miner_tx(0, 0, 10000000000000, 1000, TEST_FEE, acc.get_keys().m_account_address, tx, "", 1);
+    return tx;
+  }
+}
+
+TEST(cached_hashes, parsed_tx_hash_is_not_recalculated)
+{
+  cryptonote::transaction constructed = make_miner_tx();
+  ASSERT_FALSE(constructed.hash_cache.valid);
+  cryptonote::blobdata blob = cryptonote::tx_to_blob(constructed);
+
+  cryptonote::transaction tx;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(blob, tx));
+  ASSERT_TRUE(tx.hash_cache.valid);
+
+  uint64_t calculations = cryptonote::get_hash_calculation_count();
+  crypto::hash h;
+  size_t blob_size;
+  ASSERT_TRUE(cryptonote::get_transaction_hash(tx, h, blob_size));
+  ASSERT_EQ(cryptonote::get_transaction_hash(constructed), h);
+  ASSERT_EQ(blob.size(), blob_size);
+  ASSERT_EQ(blob.size(), cryptonote::get_object_blobsize(tx));
+  ASSERT_EQ(calculations + 1, cryptonote::get_hash_calculation_count()); // only the constructed one
+}
+
+TEST(cached_hashes, invalidated_tx_hash_is_recalculated)
+{
+  cryptonote::transaction tx;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(cryptonote::tx_to_blob(make_miner_tx()), tx));
+  crypto::hash h = cryptonote::get_transaction_hash(tx);
+
+  tx.unlock_time += 1;
+  tx.invalidate_hashes();
+  ASSERT_NE(h, cryptonote::get_transaction_hash(tx));
+  ASSERT_EQ(cryptonote::get_blob_hash(cryptonote::tx_to_blob(tx)), cryptonote::get_transaction_hash(tx));
+
+  cryptonote::transaction copy = tx;
+  copy.set_null();
+  ASSERT_FALSE(copy.hash_cache.valid);
+}
+
+TEST(cached_hashes, non_canonical_tx_blob_is_not_cached)
+{
+  cryptonote::transaction constructed = make_miner_tx();
+  cryptonote::blobdata blob = cryptonote::tx_to_blob(constructed);
+  // version 1 encoded as a two byte varint
+  ASSERT_EQ(1, blob[0]);
+  blob.replace(0, 1, "\x81\x00", 2);
+
+  cryptonote::transaction tx;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(blob, tx));
+  ASSERT_FALSE(tx.hash_cache.valid);
+  ASSERT_EQ(cryptonote::get_transaction_hash(constructed), cryptonote::get_transaction_hash(tx));
+}
+
+TEST(cached_hashes, tx_blob_with_trailing_bytes_is_not_cached)
+{
+  cryptonote::blobdata blob = cryptonote::tx_to_blob(make_miner_tx());
+  cryptonote::transaction tx;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(blob, tx));
+  ASSERT_TRUE(tx.hash_cache.valid);
+
+  // the trailing byte isn't part of the tx, so the blob's hash and size
+  // must not stand for the tx's, even in one parsed before
+  blob.push_back('\0');
+  ASSERT_FALSE(cryptonote::parse_and_validate_tx_from_blob(blob, tx));
+  ASSERT_FALSE(tx.hash_cache.valid);
+}
+
+TEST(cached_hashes, parsed_block_hash_matches_calculated)
+{
+  cryptonote::block b = AUTO_VAL_INIT(b);
+  b.miner_tx = make_miner_tx();
+  b.timestamp = 1234;
+  b.tx_hashes.push_back(crypto::cn_fast_hash("tx", 2));
+  crypto::hash calculated = cryptonote::get_block_hash(b);
+  cryptonote::blobdata blob = cryptonote::block_to_blob(b);
+
+  cryptonote::block parsed;
+  ASSERT_TRUE(cryptonote::parse_and_validate_block_from_blob(blob, parsed));
+  ASSERT_TRUE(parsed.hash_cache.valid);
+  ASSERT_TRUE(parsed.miner_tx.hash_cache.valid);
+  ASSERT_EQ(blob.size(), parsed.hash_cache.blob_size);
+
+  uint64_t calculations = cryptonote::get_hash_calculation_count();
+  ASSERT_EQ(calculated, cryptonote::get_block_hash(parsed));
+  ASSERT_EQ(cryptonote::get_transaction_hash(b.miner_tx), cryptonote::get_transaction_hash(parsed.miner_tx));
+  ASSERT_EQ(calculations + 1, cryptonote::get_hash_calculation_count()); // only b.miner_tx
+
+  parsed.nonce += 1;
+  parsed.invalidate_hashes();
+  ASSERT_FALSE(parsed.miner_tx.hash_cache.valid);
+  ASSERT_NE(calculated, cryptonote::get_block_hash(parsed));
+}
+
+TEST(cached_hashes, block_blob_with_trailing_bytes_is_not_cached)
+{
+  cryptonote::block b = AUTO_VAL_INIT(b);
+  b.miner_tx = make_miner_tx();
+  cryptonote::blobdata blob = cryptonote::block_to_blob(b);
+  cryptonote::block parsed;
+  ASSERT_TRUE(cryptonote::parse_and_validate_block_from_blob(blob, parsed));
+  ASSERT_TRUE(parsed.hash_cache.valid);
+
+  blob.push_back('\0');
+  ASSERT_FALSE(cryptonote::parse_and_validate_block_from_blob(blob, parsed));
+  ASSERT_FALSE(parsed.hash_cache.valid);
+  ASSERT_FALSE(parsed.miner_tx.hash_cache.valid);
+}
+
+namespace
+{
+  // a tx with one input and its ring signature
+  cryptonote::transaction make_signed_tx()
+  {
+    cryptonote::transaction tx;
+    tx.version = 1;
+    cryptonote::txin_to_key in;
+    in.amount = 1;
+    in.key_offsets.push_back(5);
+    in.key_offsets.push_back(7);
+    in.k_image = crypto::rand<crypto::key_image>();
+    tx.vin.push_back(in);
+    tx.signatures.resize(1);
+    tx.signatures[0].push_back(crypto::rand<crypto::signature>());
+    tx.signatures[0].push_back(crypto::rand<crypto::signature>());
+    return tx;
+  }
+}
+
+TEST(cached_hashes, prefix_hash_taken_from_blob)
+{
+  cryptonote::transaction tx = make_signed_tx();
+  cryptonote::transaction parsed;
+  crypto::hash tx_hash, tx_prefix_hash;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(cryptonote::tx_to_blob(tx), parsed, tx_hash, tx_prefix_hash));
+  ASSERT_EQ(cryptonote::get_transaction_hash(tx), tx_hash);
+  ASSERT_EQ(cryptonote::get_transaction_prefix_hash(tx), tx_prefix_hash);
+}
+
+TEST(cached_hashes, prefix_hash_of_non_canonical_blob)
+{
+  cryptonote::transaction tx = make_signed_tx();
+  cryptonote::blobdata blob = cryptonote::tx_to_blob(tx);
+  // version 1 encoded as a two byte varint, so the prefix in the blob is a
+  // byte longer than the one the tx serializes to
+  ASSERT_EQ(1, blob[0]);
+  blob.replace(0, 1, "\x81\x00", 2);
+
+  cryptonote::transaction parsed;
+  crypto::hash tx_hash, tx_prefix_hash;
+  ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(blob, parsed, tx_hash, tx_prefix_hash));
+  ASSERT_EQ(cryptonote::get_transaction_prefix_hash(tx), tx_prefix_hash);
+  ASSERT_FALSE(parsed.hash_cache.valid);
+
+  // and a blob with bytes after the signatures isn't a tx at all
+  blob = cryptonote::tx_to_blob(tx);
+  blob.push_back('\0');
+  ASSERT_FALSE(cryptonote::parse_and_validate_tx_from_blob(blob, parsed, tx_hash, tx_prefix_hash));
+}
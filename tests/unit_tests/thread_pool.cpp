@@ -0,0 +1,82 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+
+#include "common/thread_pool.h"
+
+namespace
+{
+  void run_batch(tools::thread_pool& pool, size_t jobs)
+  {
+    std::atomic<size_t> done(0);
+    tools::thread_pool::waiter waiter;
+    for (size_t i = 0; i < jobs; ++i)
+      pool.submit(&waiter, [&done]() { ++done; });
+    pool.wait(waiter);
+    ASSERT_EQ(jobs, done);
+  }
+
+  TEST(thread_pool, runs_inline_without_threads)
+  {
+    tools::thread_pool pool;
+    ASSERT_EQ(1, pool.get_max_concurrency());
+    run_batch(pool, 100);
+  }
+
+  TEST(thread_pool, runs_all_jobs)
+  {
+    tools::thread_pool pool(4);
+    ASSERT_EQ(5, pool.get_max_concurrency());
+    run_batch(pool, 1000);
+    run_batch(pool, 0);
+  }
+
+  TEST(thread_pool, resize)
+  {
+    tools::thread_pool pool(2);
+    run_batch(pool, 100);
+    pool.resize(0);
+    ASSERT_EQ(1, pool.get_max_concurrency());
+    run_batch(pool, 100);
+    pool.resize(3);
+    ASSERT_EQ(4, pool.get_max_concurrency());
+    run_batch(pool, 100);
+  }
+
+  TEST(thread_pool, survives_throwing_job)
+  {
+    tools::thread_pool pool(2);
+    tools::thread_pool::waiter waiter;
+    pool.submit(&waiter, []() { throw std::runtime_error("test"); });
+    pool.wait(waiter);
+    run_batch(pool, 10);
+  }
+}
@@ -0,0 +1,488 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "include_base_utils.h"
+#include "common/boost_serialization_helper.h"
+#include "common/int-util.h"
+#include "cryptonote_core/cryptonote_boost_serialization.h"
+#include "cryptonote_core/tx_pool.h"
+#include "unit_tests_utils.h"
+#if BLOCKCHAIN_DB == DB_LMDB
+#include "cryptonote_core/blockchain.h"
+#include "blockchain_db/lmdb/db_lmdb.h"
+#else
+#include "cryptonote_core/blockchain_storage.h"
+#endif
+
+using namespace cryptonote;
+
+namespace
+{
+  const uint8_t LOG_ADD = 1;
+  const uint8_t LOG_REMOVE = 2;
+
+  // a tx spending one made up key image; the pool never looks at the chain
+  // for anything loaded from disk until it builds a block template
+  tx_memory_pool::tx_details make_tx_details(uint8_t n, size_t blob_size, uint64_t fee, bool kept_by_block = false)
+  {
+    tx_memory_pool::tx_details txd = AUTO_VAL_INIT(txd);
+    txin_to_key in = AUTO_VAL_INIT(in);
+    in.amount = fee + 1;
+    in.k_image.data[0] = n;
+    txd.tx.vin.push_back(in);
+    txd.blob_size = blob_size;
+    txd.fee = fee;
+    txd.kept_by_block = kept_by_block;
+    txd.receive_time = 1000 + n;
+    return txd;
+  }
+
+  crypto::hash make_id(uint8_t n)
+  {
+    crypto::hash h = null_hash;
+    h.data[0] = n;
+    return h;
+  }
+
+  // a poolstate.log record as tx_memory_pool writes it
+  std::string log_record(uint8_t type, const crypto::hash& id, const tx_memory_pool::tx_details* txd)
+  {
+    std::string payload;
+    if (txd)
+    {
+      std::ostringstream ss;
+      ss.put(txd->kept_by_block ? 1 : 0);
+      {
+        boost::archive::binary_oarchive a(ss, boost::archive::no_header);
+        a << *txd;
+      }
+      payload = ss.str();
+    }
+
+    std::string record;
+    record.push_back(type);
+    record.append((const char*)&id, sizeof(id));
+    uint32_t size = swap32le(static_cast<uint32_t>(payload.size()));
+    record.append((const char*)&size, sizeof(size));
+    return record + payload;
+  }
+
+  std::string log_add(uint8_t n, size_t blob_size, uint64_t fee, bool kept_by_block = false)
+  {
+    tx_memory_pool::tx_details txd = make_tx_details(n, blob_size, fee, kept_by_block);
+    return log_record(LOG_ADD, make_id(n), &txd);
+  }
+
+  std::string log_remove(uint8_t n)
+  {
+    return log_record(LOG_REMOVE, make_id(n), NULL);
+  }
+
+  class tx_pool_test : public ::testing::Test
+  {
+  protected:
+    tx_pool_test()
+      : m_pool(m_blockchain)
+      , m_blockchain(m_pool)
+    {
+    }
+
+    ~tx_pool_test()
+    {
+      m_pool.deinit();
+    }
+
+    std::string path(const char* name) const
+    {
+      return (m_dir.path() / name).string();
+    }
+
+    void write_file(const char* name, const std::string& data) const
+    {
+      std::ofstream out(path(name), std::ios_base::binary | std::ios_base::trunc);
+      out << data;
+    }
+
+    bool init()
+    {
+      return m_pool.init(m_dir.path().string());
+    }
+
+    tx_memory_pool m_pool;
+#if BLOCKCHAIN_DB == DB_LMDB
+    Blockchain m_blockchain;
+#else
+    blockchain_storage m_blockchain;
+#endif
+    unit_test::temp_directory m_dir;
+  };
+}
+
+TEST_F(tx_pool_test, size_accounting)
+{
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME, log_add(1, 1000, 10) + log_add(2, 2000, 100) + log_add(3, 3000, 10, true));
+  ASSERT_TRUE(init());
+  ASSERT_EQ(3, m_pool.get_transactions_count());
+  ASSERT_EQ(6000, m_pool.get_transactions_size());
+
+  // dropping txes takes their bytes off
+  m_pool.set_max_size(5000);
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+  ASSERT_EQ(5000, m_pool.get_transactions_size());
+  transaction tx;
+  ASSERT_FALSE(m_pool.get_transaction(make_id(1), tx));
+}
+
+TEST_F(tx_pool_test, eviction_order)
+{
+  // fee per byte: 1 -> 10, 2 -> 5, 3 -> 20, 4 -> 1 but kept by a block
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME,
+      log_add(1, 1000, 10000) + log_add(2, 1000, 5000) + log_add(3, 1000, 20000) + log_add(4, 1000, 1000, true));
+  ASSERT_TRUE(init());
+  ASSERT_EQ(4, m_pool.get_transactions_count());
+
+  transaction tx;
+  m_pool.set_max_size(3000);
+  ASSERT_EQ(3, m_pool.get_transactions_count());
+  ASSERT_FALSE(m_pool.get_transaction(make_id(2), tx));
+
+  m_pool.set_max_size(2000);
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+  ASSERT_FALSE(m_pool.get_transaction(make_id(1), tx));
+
+  // txes kept by a block stay, however little they pay
+  m_pool.set_max_size(0);
+  ASSERT_EQ(1, m_pool.get_transactions_count());
+  ASSERT_TRUE(m_pool.get_transaction(make_id(4), tx));
+}
+
+TEST_F(tx_pool_test, log_replay)
+{
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME,
+      log_add(1, 1000, 10) + log_add(2, 1000, 10) + log_remove(1) + log_add(3, 1000, 10) + log_remove(4));
+  ASSERT_TRUE(init());
+
+  transaction tx;
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+  ASSERT_FALSE(m_pool.get_transaction(make_id(1), tx));
+  ASSERT_TRUE(m_pool.get_transaction(make_id(2), tx));
+  ASSERT_TRUE(m_pool.get_transaction(make_id(3), tx));
+}
+
+TEST_F(tx_pool_test, torn_tail)
+{
+  std::string good = log_add(1, 1000, 10) + log_add(2, 1000, 10);
+  std::string torn = log_add(3, 1000, 10);
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME, good + torn.substr(0, torn.size() - 7));
+  ASSERT_TRUE(init());
+
+  transaction tx;
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+  ASSERT_FALSE(m_pool.get_transaction(make_id(3), tx));
+
+  // the log is rewritten without the torn record
+  ASSERT_EQ(good.size(), boost::filesystem::file_size(path(CRYPTONOTE_POOLDATA_LOG_FILENAME)));
+}
+
+TEST_F(tx_pool_test, compaction)
+{
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME,
+      log_add(1, 1000, 10) + log_add(2, 1000, 10) + log_remove(1) + log_remove(2) + log_add(3, 1000, 10));
+  ASSERT_TRUE(init());
+  ASSERT_EQ(1, m_pool.get_transactions_count());
+
+  // only what is still in the pool is written back
+  ASSERT_EQ(log_add(3, 1000, 10).size(), boost::filesystem::file_size(path(CRYPTONOTE_POOLDATA_LOG_FILENAME)));
+  ASSERT_FALSE(boost::filesystem::exists(path(CRYPTONOTE_POOLDATA_LOG_FILENAME ".tmp")));
+
+  // and is read back the same
+  ASSERT_TRUE(m_pool.deinit());
+  ASSERT_TRUE(init());
+  transaction tx;
+  ASSERT_EQ(1, m_pool.get_transactions_count());
+  ASSERT_TRUE(m_pool.get_transaction(make_id(3), tx));
+  ASSERT_EQ(1000, m_pool.get_transactions_size());
+}
+
+TEST_F(tx_pool_test, legacy_import)
+{
+  // a pool dump as daemons from before the log left it
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME, log_add(1, 1000, 10) + log_add(2, 2000, 10));
+  ASSERT_TRUE(init());
+  ASSERT_TRUE(tools::serialize_obj_to_file(m_pool, path(CRYPTONOTE_POOLDATA_FILENAME)));
+  ASSERT_TRUE(m_pool.deinit());
+  ASSERT_TRUE(boost::filesystem::remove(path(CRYPTONOTE_POOLDATA_LOG_FILENAME)));
+
+  tx_memory_pool pool(m_blockchain);
+  ASSERT_TRUE(pool.init(m_dir.path().string()));
+  transaction tx;
+  ASSERT_EQ(2, pool.get_transactions_count());
+  ASSERT_EQ(3000, pool.get_transactions_size());
+  ASSERT_TRUE(pool.get_transaction(make_id(2), tx));
+
+  // the dump is replaced by the log
+  ASSERT_FALSE(boost::filesystem::exists(path(CRYPTONOTE_POOLDATA_FILENAME)));
+  ASSERT_TRUE(boost::filesystem::exists(path(CRYPTONOTE_POOLDATA_LOG_FILENAME)));
+  pool.deinit();
+}
+
+#if BLOCKCHAIN_DB == DB_LMDB
+namespace
+{
+  // a tx whose inputs were checked against the chain up to the given block,
+  // as is_transaction_ready_to_go leaves it
+  std::string log_add_checked(uint8_t n, size_t blob_size, uint64_t fee, uint64_t height, const crypto::hash& block_id)
+  {
+    tx_memory_pool::tx_details txd = make_tx_details(n, blob_size, fee);
+    txd.max_used_block_height = height;
+    txd.max_used_block_id = block_id;
+    return log_record(LOG_ADD, make_id(n), &txd);
+  }
+
+  // the pool on top of a chain holding the genesis block
+  class tx_pool_chain_test : public tx_pool_test
+  {
+  protected:
+    tx_pool_chain_test(): m_db(NULL)
+    {
+    }
+
+    ~tx_pool_chain_test()
+    {
+      if (m_db)
+        m_blockchain.deinit();
+    }
+
+    bool init_chain()
+    {
+      m_db = new BlockchainLMDB();
+      m_db->open((m_dir.path() / "lmdb").string());
+      return m_blockchain.init(m_db);
+    }
+
+    bool fill(block& bl, size_t median_size = CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE)
+    {
+      bl = block();
+      size_t total_size;
+      uint64_t fee;
+      return m_pool.fill_block_template(bl, median_size, 0, total_size, fee);
+    }
+
+    // mines <count> blocks paying miner, and enough blocks on top of them to
+    // unlock their coinbase outputs, and gives the largest output of each;
+    // the blocks are spaced out in time so the difficulty stays at 1
+    bool mine_spendable_outputs(const account_base& miner, size_t count, std::vector<tx_source_entry>& sources)
+    {
+      std::vector<block> paying;
+      size_t total = count + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+      uint64_t timestamp = time(NULL) - total * DIFFICULTY_TARGET;
+      for (size_t i = 0; i < total; ++i)
+      {
+        block b;
+        difficulty_type diffic;
+        uint64_t height;
+        if (!m_blockchain.create_block_template(b, miner.get_keys().m_account_address, diffic, height, blobdata()))
+          return false;
+        b.timestamp = timestamp + i * DIFFICULTY_TARGET;
+        block_verification_context bvc = AUTO_VAL_INIT(bvc);
+        if (!m_blockchain.add_new_block(b, bvc) || !bvc.m_added_to_main_chain)
+          return false;
+        if (i < count)
+          paying.push_back(b);
+      }
+
+      sources.clear();
+      for (const block& b : paying)
+      {
+        size_t o = 0;
+        for (size_t i = 1; i < b.miner_tx.vout.size(); ++i)
+          if (b.miner_tx.vout[i].amount > b.miner_tx.vout[o].amount)
+            o = i;
+        std::vector<uint64_t> gindexes;
+        if (!m_blockchain.get_tx_outputs_gindexs(get_transaction_hash(b.miner_tx), gindexes))
+          return false;
+
+        tx_source_entry src;
+        src.outputs.push_back(tx_source_entry::output_entry(gindexes[o], boost::get<txout_to_key>(b.miner_tx.vout[o].target).key));
+        src.real_output = 0;
+        src.real_out_tx_key = get_tx_pub_key_from_extra(b.miner_tx);
+        src.real_output_in_tx_index = o;
+        src.amount = b.miner_tx.vout[o].amount;
+        sources.push_back(src);
+      }
+      return true;
+    }
+
+    // a tx spending src to miner, paying fee
+    bool spend(const account_base& miner, const tx_source_entry& src, uint64_t fee, transaction& tx)
+    {
+      std::vector<tx_source_entry> sources(1, src);
+      std::vector<tx_destination_entry> destinations(1, tx_destination_entry(src.amount - fee, miner.get_keys().m_account_address));
+      return construct_tx(miner.get_keys(), sources, destinations, std::vector<uint8_t>(), tx, 0);
+    }
+
+    BlockchainDB* m_db;
+  };
+}
+
+TEST_F(tx_pool_chain_test, fill_by_fee_per_byte)
+{
+  ASSERT_TRUE(init_chain());
+  crypto::hash genesis = m_blockchain.get_block_id_by_height(0);
+  // fee per byte: 1 -> 10, 2 -> 30, 3 -> 20
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME,
+      log_add_checked(1, 1000, 10000, 0, genesis) + log_add_checked(2, 500, 15000, 0, genesis) + log_add_checked(3, 2000, 40000, 0, genesis));
+  ASSERT_TRUE(init());
+
+  block bl;
+  size_t total_size;
+  uint64_t fee;
+  ASSERT_TRUE(m_pool.fill_block_template(bl, CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE, 0, total_size, fee));
+  ASSERT_EQ(3, bl.tx_hashes.size());
+  ASSERT_EQ(make_id(2), bl.tx_hashes[0]);
+  ASSERT_EQ(make_id(3), bl.tx_hashes[1]);
+  ASSERT_EQ(make_id(1), bl.tx_hashes[2]);
+  ASSERT_EQ(3500, total_size);
+  ASSERT_EQ(65000, fee);
+
+  // a smaller block takes the best that fits: 2, then 1 as 3 does not
+  size_t median_size = (2000 + CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE) * 100 / 130;
+  ASSERT_TRUE(fill(bl, median_size));
+  ASSERT_EQ(2, bl.tx_hashes.size());
+  ASSERT_EQ(make_id(2), bl.tx_hashes[0]);
+  ASSERT_EQ(make_id(1), bl.tx_hashes[1]);
+}
+
+TEST_F(tx_pool_chain_test, readiness_follows_the_chain)
+{
+  ASSERT_TRUE(init_chain());
+
+  // the block about to be added, and a tx using an output of it
+  account_base miner;
+  miner.generate();
+  block b1;
+  difficulty_type diffic;
+  uint64_t height;
+  ASSERT_TRUE(m_blockchain.create_block_template(b1, miner.get_keys().m_account_address, diffic, height, blobdata()));
+  ASSERT_EQ(1, height);
+  write_file(CRYPTONOTE_POOLDATA_LOG_FILENAME, log_add_checked(1, 1000, 10000, 1, get_block_hash(b1)));
+  ASSERT_TRUE(init());
+
+  block bl;
+  ASSERT_TRUE(fill(bl));
+  ASSERT_TRUE(bl.tx_hashes.empty());
+
+  // on_blockchain_inc drops the cached verdict
+  block_verification_context bvc = AUTO_VAL_INIT(bvc);
+  ASSERT_TRUE(m_blockchain.add_new_block(b1, bvc));
+  ASSERT_TRUE(bvc.m_added_to_main_chain);
+  ASSERT_TRUE(fill(bl));
+  ASSERT_EQ(1, bl.tx_hashes.size());
+  ASSERT_EQ(make_id(1), bl.tx_hashes[0]);
+
+  // and so does on_blockchain_dec, as Blockchain calls it on popping a block
+  block popped;
+  std::vector<transaction> popped_txs;
+  m_db->pop_block(popped, popped_txs);
+  ASSERT_TRUE(m_pool.on_blockchain_dec(m_db->height() - 1, m_db->top_block_hash()));
+  ASSERT_TRUE(fill(bl));
+  ASSERT_TRUE(bl.tx_hashes.empty());
+}
+
+TEST_F(tx_pool_chain_test, concurrent_double_spend)
+{
+  ASSERT_TRUE(init_chain());
+  ASSERT_TRUE(init());
+
+  account_base miner;
+  miner.generate();
+  std::vector<tx_source_entry> sources;
+  ASSERT_TRUE(mine_spendable_outputs(miner, 1, sources));
+
+  // two txes spending the same output, which differ in their fee
+  transaction txs[2];
+  for (size_t i = 0; i < 2; ++i)
+    ASSERT_TRUE(spend(miner, sources[0], (i + 2) * FEE_PER_KB, txs[i]));
+  ASSERT_NE(get_transaction_hash(txs[0]), get_transaction_hash(txs[1]));
+
+  // both verify before either holds the pool lock, as far as the threads
+  // line up; either way only one may get in
+  tx_verification_context tvc0 = AUTO_VAL_INIT(tvc0), tvc1 = AUTO_VAL_INIT(tvc1);
+  std::atomic<bool> go(false);
+  std::thread t0([&]() { while (!go) std::this_thread::yield(); m_pool.add_tx(txs[0], tvc0, false); });
+  std::thread t1([&]() { while (!go) std::this_thread::yield(); m_pool.add_tx(txs[1], tvc1, false); });
+  go = true;
+  t0.join();
+  t1.join();
+
+  ASSERT_EQ(1, m_pool.get_transactions_count());
+  ASSERT_NE(tvc0.m_added_to_pool, tvc1.m_added_to_pool);
+  ASSERT_NE(tvc0.m_verifivation_failed, tvc1.m_verifivation_failed);
+  ASSERT_TRUE(m_pool.have_tx(get_transaction_hash(txs[tvc0.m_added_to_pool ? 0 : 1])));
+}
+
+TEST_F(tx_pool_chain_test, full_pool_turns_away_low_fee)
+{
+  ASSERT_TRUE(init_chain());
+  ASSERT_TRUE(init());
+
+  account_base miner;
+  miner.generate();
+  std::vector<tx_source_entry> sources;
+  ASSERT_TRUE(mine_spendable_outputs(miner, 2, sources));
+  transaction rich, poor;
+  ASSERT_TRUE(spend(miner, sources[0], 10 * FEE_PER_KB, rich));
+  ASSERT_TRUE(spend(miner, sources[1], 2 * FEE_PER_KB, poor));
+
+  tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+  ASSERT_TRUE(m_pool.add_tx(rich, tvc, false));
+  ASSERT_TRUE(tvc.m_added_to_pool);
+  ASSERT_FALSE(tvc.m_fee_too_low);
+
+  // with no room left, a tx paying less per byte than any in the pool is
+  // turned away, and says why
+  m_pool.set_max_size(get_object_blobsize(rich));
+  ASSERT_EQ(1, m_pool.get_transactions_count());
+  tvc = AUTO_VAL_INIT(tvc);
+  ASSERT_TRUE(m_pool.add_tx(poor, tvc, false));
+  ASSERT_FALSE(tvc.m_verifivation_failed);
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_FALSE(tvc.m_should_be_relayed);
+  ASSERT_TRUE(tvc.m_fee_too_low);
+  ASSERT_FALSE(m_pool.have_tx(get_transaction_hash(poor)));
+}
+#endif
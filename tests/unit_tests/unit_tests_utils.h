@@ -32,6 +32,8 @@
 
 #include <atomic>
 
+#include <boost/filesystem.hpp>
+
 namespace unit_test
 {
   class call_counter
@@ -61,4 +63,30 @@ namespace unit_test
   private:
     std::atomic<size_t> m_counter;
   };
+
+  // a new empty directory under the system temp directory, removed with
+  // everything in it when this goes away
+  class temp_directory
+  {
+  public:
+    temp_directory()
+      : m_path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path())
+    {
+      boost::filesystem::create_directories(m_path);
+    }
+
+    ~temp_directory()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_path, ec);
+    }
+
+    const boost::filesystem::path& path() const { return m_path; }
+
+  private:
+    temp_directory(const temp_directory&);
+    temp_directory& operator=(const temp_directory&);
+
+    boost::filesystem::path m_path;
+  };
 }
@@ -0,0 +1,145 @@
+// Copyright (c) 2014-2015, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "cryptonote_core/cryptonote_format_utils.h"
+#include "wallet/wallet2.h"
+#include "unit_tests_utils.h"
+
+using namespace cryptonote;
+
+namespace
+{
+  const size_t blocks_count = 40;
+
+  // a getblocks.bin response of blocks whose miner tx and extra txs pay to
+  // either of the two addresses in turn
+  COMMAND_RPC_GET_BLOCKS_FAST::response make_response(const account_public_address& ours, const account_public_address& theirs)
+  {
+    COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+    res.start_height = 1;
+    res.current_height = blocks_count + 1;
+    res.status = CORE_RPC_STATUS_OK;
+
+    uint64_t global_index = 0;
+    crypto::hash prev_id = null_hash;
+    for (size_t height = 1; height <= blocks_count; ++height)
+    {
+      block b = AUTO_VAL_INIT(b);
+      b.major_version = CURRENT_BLOCK_MAJOR_VERSION;
+      b.minor_version = CURRENT_BLOCK_MINOR_VERSION;
+      b.timestamp = time(NULL);
+      b.prev_id = prev_id;
+
+      std::vector<transaction> txs(3);
+      for (size_t i = 0; i < txs.size(); ++i)
+      {
+        const account_public_address& to = (height + i) % 2 ? ours : theirs;
+        EXPECT_TRUE(construct_miner_tx(height, 0, 0, 0, i, to, txs[i], blobdata(), 4));
+      }
+      b.miner_tx = txs[0];
+
+      block_complete_entry bce;
+      COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices boi;
+      for (size_t i = 0; i < txs.size(); ++i)
+      {
+        if (i > 0)
+        {
+          b.tx_hashes.push_back(get_transaction_hash(txs[i]));
+          bce.txs.push_back(tx_to_blob(txs[i]));
+        }
+        COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices toi;
+        for (size_t o = 0; o < txs[i].vout.size(); ++o)
+          toi.indices.push_back(global_index++);
+        boi.indices.push_back(toi);
+      }
+      bce.block = block_to_blob(b);
+      prev_id = get_block_hash(b);
+
+      res.blocks.push_back(bce);
+      res.output_indices.push_back(boi);
+    }
+    return res;
+  }
+
+  class wallet_scan_test : public ::testing::Test
+  {
+  protected:
+    // wallets made from the same recovery key have the same keys
+    void generate(tools::wallet2& wallet, const std::string& name, const crypto::secret_key& recovery_key)
+    {
+      wallet.generate((m_dir.path() / name).string(), "", recovery_key, true, false);
+    }
+
+    unit_test::temp_directory m_dir;
+  };
+}
+
+TEST_F(wallet_scan_test, parallel_scan_finds_what_serial_scan_does)
+{
+  crypto::secret_key recovery_key;
+  crypto::public_key unused;
+  crypto::generate_keys(unused, recovery_key);
+
+  tools::wallet2 serial, parallel;
+  generate(serial, "serial", recovery_key);
+  generate(parallel, "parallel", recovery_key);
+  serial.set_max_scan_threads(1);
+  parallel.set_max_scan_threads(4);
+
+  account_base other;
+  other.generate();
+  COMMAND_RPC_GET_BLOCKS_FAST::response res = make_response(serial.get_account().get_keys().m_account_address,
+    other.get_keys().m_account_address);
+
+  size_t serial_added = 0, parallel_added = 0;
+  serial.process_blocks(res, serial_added);
+  parallel.process_blocks(res, parallel_added);
+  ASSERT_EQ(blocks_count, serial_added);
+  ASSERT_EQ(blocks_count, parallel_added);
+
+  tools::wallet2::transfer_container serial_transfers, parallel_transfers;
+  serial.get_transfers(serial_transfers);
+  parallel.get_transfers(parallel_transfers);
+  ASSERT_FALSE(serial_transfers.empty());
+  ASSERT_EQ(serial_transfers.size(), parallel_transfers.size());
+  for (size_t i = 0; i < serial_transfers.size(); ++i)
+  {
+    const tools::wallet2::transfer_details& s = serial_transfers[i];
+    const tools::wallet2::transfer_details& p = parallel_transfers[i];
+    ASSERT_EQ(get_transaction_hash(s.m_tx), get_transaction_hash(p.m_tx));
+    ASSERT_EQ(s.m_block_height, p.m_block_height);
+    ASSERT_EQ(s.m_internal_output_index, p.m_internal_output_index);
+    ASSERT_EQ(s.m_global_output_index, p.m_global_output_index);
+    ASSERT_EQ(s.m_key_image, p.m_key_image);
+    ASSERT_EQ(s.amount(), p.amount());
+  }
+  ASSERT_EQ(serial.balance(), parallel.balance());
+}